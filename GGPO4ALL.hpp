@@ -60,11 +60,16 @@ before including GGPO4ALL anywhere in your code
 #endif
 
 
-#define GGPO_ARRAY_SIZE(x) sizeof(x) / sizeof(x[0])
+#define GGPO_ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
+// both can be defined before including GGPO4ALL, e.g. to keep only warnings and up
+#ifndef GGPO_DEFAULT_LOGGER_FLAGS
 #define GGPO_DEFAULT_LOGGER_FLAGS Logger::Flags::ALL_LOGS | Logger::Flags::FLUSH_ERROR | Logger::Flags::FLUSH_FATAL
+#endif
 
+#ifndef GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY
 #define GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY "./logs"
+#endif
 
 #define GGPO_DEFAULT_RINGBUFFER_SIZE 64
 
@@ -81,12 +86,21 @@ before including GGPO4ALL anywhere in your code
 #include <string_view>
 #include <memory.h>
 #include <array>
+#include <vector>
+#include <deque>
 #include <cstddef>
 #include <cassert>
 #include <utility>
 #include <cstring>
+#include <cmath>
 
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <csignal>
 
 #include <cstdint>
 
@@ -109,11 +123,27 @@ before including GGPO4ALL anywhere in your code
     #include <sys/types.h>
     #include <sys/socket.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <netinet/udp.h>
     #include <arpa/inet.h>
     #include <fcntl.h>
     #include <unistd.h>
     #include <stdlib.h>
     #include <errno.h>
+    #include <strings.h>
+
+    // io_uring straight through the syscalls, no liburing needed
+    #if defined(__linux__) && __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+
+        // multishot recvmsg and provided buffer rings showed up in the 6.0 headers, older ones have io_uring without them
+        #if defined(IORING_RECV_MULTISHOT)
+            #define GGPO_IO_URING 1
+
+            #include <sys/mman.h>
+            #include <sys/syscall.h>
+        #endif
+    #endif
 
 #else
 
@@ -121,13 +151,38 @@ before including GGPO4ALL anywhere in your code
 
 #endif
 
+namespace GGPO::Platform
+{
+    using ProcessID =
+    #if defined(_WIN32) || defined(_WIN64)
+        DWORD;
+    #else
+        pid_t;
+    #endif
+
+    // GGPO_ASSERT needs these from the top, they're defined with the rest of the platform tools
+    inline ProcessID GetProcessID();
+    inline void AssertFailed(const char* fp_FileName, int fp_LineNumber, const char* fp_FailedExpr, ProcessID fp_ProcessID);
+}
+
  //=========================================================================================== Main Types ===========================================================================================//
 
-constexpr int MAX_PLAYERS = 4;
+constexpr int MAX_PLAYERS = 8;
 constexpr int MAX_PREDICTION_FRAMES = 8;
 constexpr int MAX_SPECTATORS = 32;
 
+constexpr int INPUT_QUEUE_LENGTH = 128;
+constexpr int SPECTATOR_FRAME_BUFFER_SIZE = 64;
+constexpr int PENDING_OUTPUT_LENGTH = 64;
+
 constexpr int SPECTATOR_INPUT_INTERVAL = 4;
+constexpr int SPECTATOR_SEND_BURST = 16;
+constexpr int PLAYER_SEND_BURST = 2;         /* input packets per send to a player, only more than one when the window doesn't fit a datagram */
+
+constexpr int MAX_DATAGRAM_SIZE = 1200;      /* bytes of udp payload, under the 1280 byte ipv6 minimum mtu with room for the ip and udp headers */
+constexpr int MIN_DATAGRAM_SIZE = 508;       /* what fits the 576 byte datagram every ipv4 host has to take, less the biggest ip header and udp's */
+
+constexpr int MAX_FRAME_DELAY_WAIT = 30;     /* frames a requested delay change waits for a repeated input before it gets forced through */
 
 namespace GGPO
 {
@@ -156,7 +211,8 @@ namespace GGPO
      * If type == PLAYERTYPE_REMOTE:
      *
      * u.remote.ip_address:  The ip address of the ggpo session which will host this
-     *       player.
+     *       player.  Numeric IPv4 ("192.168.0.2") or IPv6 ("2001:db8::2"), v6 needs
+     *       the local socket to have come up dual stack (it does wherever the OS allows).
      *
      * u.remote.port: The port where udp packets should be sent to reach this player.
      *       All the local inputs for this session will be sent to this player at
@@ -177,7 +233,7 @@ namespace GGPO
             } local;
             struct
             {
-                char           ip_address[32];
+                char           ip_address[64]; /* numeric v4 or v6, "192.168.0.2" or "2001:db8::2" */
                 unsigned short port;
             } remote;
         } u;
@@ -188,6 +244,102 @@ namespace GGPO
         int      player_num;
     };
 
+    /*
+     * When we tell a remote endpoint which of its inputs we've got.  The ack rides
+     * on every packet we send them, so this is only about whether to send one on
+     * its own when nothing else is going their way.
+     *
+     * Delayed: hold it up to a frame (DELAYED_ACK_INTERVAL) in case something else
+     *       goes out and carries it, then send it alone.  Right away when a packet
+     *       shows up ahead of a gap, so the sender finds out about the loss sooner.
+     *
+     * Immediate: an ack for every input packet as it comes in.  Most packets, but
+     *       the sender's pending output drains fastest.
+     */
+    enum class AckPolicy : uint8_t
+    {
+        Delayed = 0,
+        Immediate = 1
+    };
+
+    /*
+     * The buffer sizes a session runs with.  They used to be compile time constants
+     * (the defaults below still are), now everything gets allocated once when the
+     * session starts and never again, so a LAN session can run a tiny window and
+     * a transatlantic one the full one out of the same build.
+     *
+     * prediction_frames: How far past the last confirmed frame we run before
+     *       AddLocalInput() starts saying PREDICTION_THRESHOLD, which is also the
+     *       deepest rollback.  prediction_frames + 2 game states are kept around.
+     *       At most MAX_PREDICTION_FRAMES, the rollback telemetry's depth buckets
+     *       and the replay verifier's rollback distance are sized off that.
+     *
+     * input_queue_length: Frames of input kept per player.  Has to hold the whole
+     *       prediction window plus the frame delay, so at least twice
+     *       prediction_frames is a good idea.
+     *
+     * spectator_frame_buffer: How many confirmed frames a spectator keeps before
+     *       old ones get overwritten.
+     *
+     * pending_output_length: Unacked inputs kept per remote endpoint.  Once full,
+     *       new inputs don't get queued until the peer catches up on its acks.
+     *
+     * spectator_send_burst: How many input packets a spectator that fell behind
+     *       can get per send while it catches up (players get PLAYER_SEND_BURST).
+     *       They go out back to back, each one only as long as what it carries.
+     *       Only kicks in once more is pending than fits in a packet, so it goes with a bigger pending_output_length, and the
+     *       spectator needs a spectator_frame_buffer that can take it all.
+     *
+     * ack_policy: See AckPolicy, for every endpoint in the session.
+     *
+     * max_datagram_size: Most bytes we put in one udp datagram, nothing we send
+     *       goes over it so nothing gets fragmented on the way.  The default fits
+     *       any path that can do ipv6, raise it to 1472 if you know every hop
+     *       takes 1500 byte ethernet frames, lower it for tunnels and the like.
+     *       At least MIN_DATAGRAM_SIZE, anything past MAX_UDP_PACKET_SIZE counts as
+     *       that.  It also has to hold one frame of everyone's input with every
+     *       byte changed (UdpProtocol::MinDatagramSizeFor(num_players * input_size),
+     *       spectators get the combined input).  IsValid(num_players, input_size)
+     *       checks that too, ask it before starting a session, the backends
+     *       assert on it.  Only matters below ~650 bytes with 8 players x 32 byte
+     *       inputs.  Nothing probes the path mtu, it's up to you to pick it.
+     *
+     * coalesce: Whether what a tick has for a peer goes out as one datagram at
+     *       the end of DoPoll() and AddLocalInput() (see UdpProtocol::Flush()).
+     *       Off sends every message as its own datagram the moment it's queued,
+     *       the way it worked before bundles.  For comparing, or for reading a
+     *       packet capture.
+     */
+    struct SessionLimits
+    {
+        int      prediction_frames = MAX_PREDICTION_FRAMES;
+        int      input_queue_length = INPUT_QUEUE_LENGTH;
+        int      spectator_frame_buffer = SPECTATOR_FRAME_BUFFER_SIZE;
+        int      pending_output_length = PENDING_OUTPUT_LENGTH;
+        int      spectator_send_burst = SPECTATOR_SEND_BURST;
+        AckPolicy ack_policy = AckPolicy::Delayed;
+        int      max_datagram_size = MAX_DATAGRAM_SIZE;
+        bool     coalesce = true;
+
+        bool
+            IsValid()
+            const
+        {
+            return prediction_frames > 0
+                and prediction_frames <= MAX_PREDICTION_FRAMES
+                and input_queue_length > prediction_frames
+                and spectator_frame_buffer > 0
+                and pending_output_length > 0
+                and spectator_send_burst > 0
+                and max_datagram_size >= MIN_DATAGRAM_SIZE;
+        }
+
+        // and max_datagram_size fits one frame of their input, defined with UdpProtocol
+        bool
+            IsValid(int num_players, int input_size)
+            const;
+    };
+
     enum class ErrorCode : int
     {
         OK = 69,
@@ -237,7 +389,7 @@ namespace GGPO
         Succeeded(ErrorCode fp_Result)
         noexcept
     {
-        return fp_Result == ErrorCode::SUCCESS;
+        return fp_Result == ErrorCode::OK or fp_Result == ErrorCode::SUCCESS; // the backends hand back OK, SUCCESS is what the C API calls it
     }
 
     constexpr int INVALID_HANDLE = -1;
@@ -265,7 +417,13 @@ namespace GGPO
      * EVENTCODE_TIMESYNC - The time synchronziation code has determined
      * that this client is too far ahead of the other one and should slow
      * down to ensure fairness.  The u.timesync.frames_ahead parameter in
-     * the Event object indicates how many frames the client is.
+     * the Event object indicates how many frames the client is.  Never sent in
+     * TimeSyncMode::Continuous, poll GetFrameDilation() instead.
+     *
+     * EVENTCODE_SYNCTEST_DESYNC - The sync test resimulated a frame and got a
+     * different state than the first time around.  u.synctest_desync holds the
+     * frame, both checksums and the offset of the first byte that differs
+     * between the two saved states (-1 if only the checksums disagree).
      *
      */
     enum class EventCode : int
@@ -277,7 +435,8 @@ namespace GGPO
         DisconnectedFromPeer = 1004,
         TimeSync = 1005,
         ConnectionInterrupted = 1006,
-        ConnectionResumed = 1007
+        ConnectionResumed = 1007,
+        SyncTestDesync = 1008
     };
 
     constexpr string_view
@@ -293,6 +452,7 @@ namespace GGPO
         case EventCode::TimeSync:                return "TimeSync";
         case EventCode::ConnectionInterrupted:  return "ConnectionInterrupted";
         case EventCode::ConnectionResumed:      return "ConnectionResumed";
+        case EventCode::SyncTestDesync:         return "SyncTestDesync";
         default:                                            return "UnknownEvent";
         }
     }
@@ -341,6 +501,13 @@ namespace GGPO
             {
                 PlayerHandle  player;
             }connection_resumed;
+            struct
+            {
+                int               frame;
+                int               checksum;
+                int               expected_checksum;
+                int               first_diff_offset;
+            }synctest_desync;
         } u;
     };
 
@@ -361,9 +528,18 @@ namespace GGPO
      * minus the frame number of the last packet in the remote queue.
      *
      * network.ping - The roundtrip packet transmission time as calcuated
-     * by .net.  This will be roughly equal to the actual round trip
-     * packet transmission time + 2 the interval at which you call ggpo_idle
-     * or ggpo_advance_frame.
+     * by .net.  The time the other side sat on our report before polling
+     * is taken out, and where the platform has kernel receive timestamps
+     * (linux, mac) so is the time the reply sat on ours, so this is pretty
+     * much the wire.  Elsewhere it's the wire + up to one interval at which
+     * you call ggpo_idle or ggpo_advance_frame.
+     *
+     * network.ping_us - Same thing in microseconds, smoothed the way TCP
+     * does it (RFC 6298) with spikes thrown out.  ping is just this rounded
+     * down to whole milliseconds.
+     *
+     * network.jitter_us - The round trip time variance (rttvar) that goes
+     * with ping_us.
      *
      * network.kbps_sent - The estimated bandwidth used between the two
      * clients, in kilobits per second.
@@ -386,6 +562,8 @@ namespace GGPO
             int   recv_queue_len;
             int   ping;
             int   kbps_sent;
+            int64_t   ping_us;
+            int64_t   jitter_us;
         } network;
         struct
         {
@@ -638,6 +816,180 @@ namespace GGPO {
         }
     };
 
+    /*
+     * Same thing, but the capacity is picked at runtime.  Allocate() is the only
+     * place it touches the heap, after that it's exactly as allocation free as
+     * RingBuffer.
+     */
+    template<typename T>
+    class DynamicRingBuffer
+    {
+    public:
+        DynamicRingBuffer() = default;
+
+        explicit DynamicRingBuffer(size_t fp_MaxCapacity)
+        {
+            Allocate(fp_MaxCapacity);
+        }
+
+        void
+            Allocate(size_t fp_MaxCapacity)
+        {
+            if (fp_MaxCapacity == 0)
+            {
+                throw invalid_argument("DynamicRingBuffer size must be greater than 0");
+            }
+
+            pm_Buffer.assign(fp_MaxCapacity, T{});
+            Clear();
+        }
+
+        void
+            Clear()
+            noexcept
+        {
+            pm_Head = pm_Size = 0;
+        }
+
+        [[nodiscard]] bool
+            TryPush(const T& fp_Val)
+        {
+            if (IsFull())
+            {
+                return false;
+            }
+
+            Push(fp_Val);
+
+            return true;
+        }
+
+        void
+            Push(const T& fp_Val)
+        {
+            if (pm_Buffer.empty())
+            {
+                throw logic_error("DynamicRingBuffer used before Allocate()");
+            }
+
+            pm_Buffer[pm_Head] = fp_Val;
+            pm_Head = (pm_Head + 1) % pm_Buffer.size();
+
+            if (pm_Size < pm_Buffer.size())
+            {
+                ++pm_Size;
+            }
+        }
+
+        void
+            Pop()
+        {
+            if (IsEmpty())
+            {
+                throw underflow_error("Cannot pop from empty DynamicRingBuffer");
+            }
+
+            --pm_Size;
+        }
+
+        [[nodiscard]] T&
+            Front()
+        {
+            if (IsEmpty())
+            {
+                throw underflow_error("Cannot access front of empty DynamicRingBuffer");
+            }
+
+            return pm_Buffer[FrontIndex()];
+        }
+
+        [[nodiscard]] const T&
+            Front()
+            const
+        {
+            if (IsEmpty())
+            {
+                throw underflow_error("Cannot access front of empty DynamicRingBuffer");
+            }
+
+            return pm_Buffer[FrontIndex()];
+        }
+
+        [[nodiscard]] T&
+            Back()
+        {
+            if (IsEmpty())
+            {
+                throw out_of_range("DynamicRingBuffer::Back: buffer is empty");
+            }
+
+            return pm_Buffer[(pm_Head + pm_Buffer.size() - 1) % pm_Buffer.size()];
+        }
+
+        [[nodiscard]] T&
+            At(size_t fp_Index)
+        {
+            if (fp_Index >= pm_Size)
+            {
+                throw out_of_range("DynamicRingBuffer::At: index out of range");
+            }
+
+            return pm_Buffer[(FrontIndex() + fp_Index) % pm_Buffer.size()];
+        }
+
+        [[nodiscard]] const T&
+            At(size_t fp_Index)
+            const
+        {
+            if (fp_Index >= pm_Size)
+            {
+                throw out_of_range("DynamicRingBuffer::At: index out of range");
+            }
+
+            return pm_Buffer[(FrontIndex() + fp_Index) % pm_Buffer.size()];
+        }
+
+        [[nodiscard]] size_t
+            CurrentSize()
+            const noexcept
+        {
+            return pm_Size;
+        }
+
+        [[nodiscard]] size_t
+            MaxCapacity()
+            const noexcept
+        {
+            return pm_Buffer.size();
+        }
+
+        [[nodiscard]] bool
+            IsEmpty()
+            const noexcept
+        {
+            return pm_Size == 0;
+        }
+
+        [[nodiscard]] bool
+            IsFull()
+            const noexcept
+        {
+            return pm_Size == pm_Buffer.size();
+        }
+
+    private:
+        vector<T> pm_Buffer;
+        size_t pm_Head = 0;   // index of next write
+        size_t pm_Size = 0;   // number of valid elements
+
+    private:
+        [[nodiscard]] size_t
+            FrontIndex() const noexcept
+        {
+            return (pm_Head + pm_Buffer.size() - pm_Size) % pm_Buffer.size();
+        }
+    };
+
     template<typename T, size_t pm_MaxCapacity>
     struct FixedPushBuffer
     {
@@ -651,7 +1003,7 @@ namespace GGPO {
         constexpr void EmplaceBack(Args&&... fp_Args)
         {
             GGPO_ASSERT(pm_CurrentIndex < pm_MaxCapacity and "FixedPushBuffer overflowed!");
-            pm_Data[pm_CurrentIndex++] = T(forward<Args>(args)...); // Construct T using args, assign to slot
+            pm_Data[pm_CurrentIndex++] = T(forward<Args>(fp_Args)...); // Construct T using args, assign to slot
         }
 
         [[nodiscard]] constexpr T& operator[](size_t fp_Index)
@@ -1559,21 +1911,21 @@ namespace GGPO
 {
     constexpr const int GGPO_BITVECTOR_NIBBLE_SIZE = 8;
 
-    void
+    inline void
         BitVector_SetBit(uint8_t* vector, int* offset)
     {
         vector[(*offset) / 8] |= (1 << ((*offset) % 8));
         *offset += 1;
     }
 
-    void
+    inline void
         BitVector_ClearBit(uint8_t* vector, int* offset)
     {
         vector[(*offset) / 8] &= ~(1 << ((*offset) % 8));
         *offset += 1;
     }
 
-    void
+    inline void
         BitVector_WriteNibblet(uint8_t* vector, int nibble, int* offset)
     {
         GGPO_ASSERT(nibble < (1 << GGPO_BITVECTOR_NIBBLE_SIZE));
@@ -1591,7 +1943,7 @@ namespace GGPO
         }
     }
 
-    int
+    inline int
         BitVector_ReadBit(uint8_t* vector, int* offset)
     {
         int retval = !!(vector[(*offset) / 8] & (1 << ((*offset) % 8)));
@@ -1599,7 +1951,7 @@ namespace GGPO
         return retval;
     }
 
-    int
+    inline int
         BitVector_ReadNibblet(uint8_t* vector, int* offset)
     {
         int nibblet = 0;
@@ -1611,6 +1963,48 @@ namespace GGPO
 
         return nibblet;
     }
+
+    /*
+     * Same as the nibblet pair but for any width up to 32 bits, lsb first.  These
+     * go a byte at a time instead of a bit at a time since the input codec leans on
+     * them for every changed byte.
+     */
+    inline void
+        BitVector_WriteBits(uint8_t* vector, uint32_t value, int count, int* offset)
+    {
+        while (count > 0)
+        {
+            int shift = (*offset) % 8;
+            int take = GGPO_MIN(8 - shift, count);
+            uint8_t mask = (uint8_t)(((1u << take) - 1) << shift);
+
+            vector[(*offset) / 8] = (uint8_t)((vector[(*offset) / 8] & ~mask) | ((value << shift) & mask));
+
+            value >>= take;
+            count -= take;
+            *offset += take;
+        }
+    }
+
+    inline uint32_t
+        BitVector_ReadBits(uint8_t* vector, int count, int* offset)
+    {
+        uint32_t value = 0;
+        int done = 0;
+
+        while (done < count)
+        {
+            int shift = (*offset) % 8;
+            int take = GGPO_MIN(8 - shift, count - done);
+
+            value |= (uint32_t)((vector[(*offset) / 8] >> shift) & ((1u << take) - 1)) << done;
+
+            done += take;
+            *offset += take;
+        }
+
+        return value;
+    }
 }
 
 //=========================================================================================== BEGINNING OF ACTUAL API ===========================================================================================//
@@ -1633,7 +2027,7 @@ namespace GGPO
 
     using GGPO_SOCKET = uint64_t;
 
-    #define GGPO_INVALID_SOCKET (-1)
+    #define GGPO_INVALID_SOCKET ((GGPO_SOCKET)-1) // same all-ones value socket() hands back as -1, typed so compares stay unsigned
 
     #define GGPO_GET_LAST_ERROR() errno
     #define GGPO_NETWORK_ERROR_CODE uint32_t
@@ -1648,75 +2042,358 @@ namespace GGPO
 
     constexpr int MAX_UDP_PACKET_SIZE = 4096;
 
+    /*
+     * Binds a non-blocking udp socket on bind_port (or up to retries ports past it).
+     * Tries for an AF_INET6 dual stack socket first so v6 only peers (mobile carriers
+     * behind NAT64 and friends) can reach us directly, v4 peers show up on it as v4
+     * mapped addresses (::ffff:a.b.c.d).  Falls back to plain AF_INET when the
+     * platform won't give us v6 or won't turn IPV6_V6ONLY off.  The family that
+     * stuck is written to family if you pass one.  Pass SOCK_STREAM for socket_type
+     * to get the tcp listen socket instead (still needs a listen() after).
+     */
     inline GGPO_SOCKET
         CreateSocket
         (
             uint16_t bind_port, 
             int retries,
-            Logger* logger
+            Logger* logger,
+            int* family = nullptr,
+            int socket_type = SOCK_DGRAM
         )
     {
-        GGPO_SOCKET f_Socket;
-        sockaddr_in f_SocketIn;
-        uint16_t port;
-        int optval = 1;
-
-        f_Socket = socket(AF_INET, SOCK_DGRAM, 0);
-        setsockopt(f_Socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof optval);
-        //NOT SURE ABOUT DEFAULT SOCKET CONFIGS ON POSIX SYSTEMS VS MICROSOFT
-        // setsockopt(f_Socket, SOL_SOCKET, SO_DONTLINGER, (const char*)&optval, sizeof optval);
+        const int f_Families[] = { AF_INET6, AF_INET };
 
-        // non-blocking...
-        #if defined(_WIN32) || defined(_WIN64)
-            u_long iMode = 1;
-            ioctlsocket(f_Socket, FIONBIO, &iMode);
-        #else
-            int flags = fcntl(f_Socket, F_GETFL, 0);
-            fcntl(f_Socket, F_SETFL, flags | O_NONBLOCK);
-        #endif
+        for (int f_Family : f_Families)
+        {
+            GGPO_SOCKET f_Socket;
+            sockaddr_storage f_SocketIn;
+            uint16_t port;
+            int optval = 1;
 
-        f_SocketIn.sin_family = AF_INET;
-        f_SocketIn.sin_addr.s_addr = htonl(INADDR_ANY);
+            f_Socket = socket(f_Family, socket_type, 0);
 
-        for (port = bind_port; port <= bind_port + retries; port++)
-        {
-            f_SocketIn.sin_port = htons(port);
+            if (f_Socket == GGPO_INVALID_SOCKET)
+            {
+                continue;
+            }
 
-            if (bind(f_Socket, (sockaddr*)&f_SocketIn, sizeof f_SocketIn) != GGPO_SOCKET_ERROR)
+            if (f_Family == AF_INET6)
             {
-                logger->Info(format("Udp bound to port: {}.", port), "udp.cpp");
-                return f_Socket;
+                int v6only = 0;
+
+                if (setsockopt(f_Socket, IPPROTO_IPV6, IPV6_V6ONLY, (const char*)&v6only, sizeof v6only) == GGPO_SOCKET_ERROR)
+                {
+                    GGPO_CLOSE_SOCKET(f_Socket);
+                    continue;
+                }
             }
-        }
 
-        GGPO_CLOSE_SOCKET(f_Socket);
+            setsockopt(f_Socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof optval);
+            //NOT SURE ABOUT DEFAULT SOCKET CONFIGS ON POSIX SYSTEMS VS MICROSOFT
+            // setsockopt(f_Socket, SOL_SOCKET, SO_DONTLINGER, (const char*)&optval, sizeof optval);
 
-        return GGPO_INVALID_SOCKET;
-    }
-}
+            // non-blocking...
+            #if defined(_WIN32) || defined(_WIN64)
+                u_long iMode = 1;
+                ioctlsocket(f_Socket, FIONBIO, &iMode);
+            #else
+                int flags = fcntl(f_Socket, F_GETFL, 0);
+                fcntl(f_Socket, F_SETFL, flags | O_NONBLOCK);
+            #endif
 
-//=========================================================================================== Platform Abstraction Tools ===========================================================================================//
+            memset(&f_SocketIn, 0, sizeof f_SocketIn);
 
-namespace GGPO::Platform{
+            sockaddr_in* f_In4 = (sockaddr_in*)&f_SocketIn;
+            sockaddr_in6* f_In6 = (sockaddr_in6*)&f_SocketIn;
 
-    using ProcessID =
-    #if defined(_WIN32) || defined(_WIN64)
-        DWORD;
-    #else
-        pid_t;
-    #endif
+            if (f_Family == AF_INET6)
+            {
+                f_In6->sin6_family = AF_INET6;
+                f_In6->sin6_addr = in6addr_any;
+            }
+            else
+            {
+                f_In4->sin_family = AF_INET;
+                f_In4->sin_addr.s_addr = htonl(INADDR_ANY);
+            }
 
-    inline ProcessID 
-        GetProcessID() 
-    {
-    #if defined(_WIN32) || defined(_WIN64)
-        return GetCurrentProcessId();
-    #else
-        return getpid();
-    #endif
-    }
+            const socklen_t f_Length = (f_Family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
 
-    inline void 
+            for (port = bind_port; port <= bind_port + retries; port++)
+            {
+                if (f_Family == AF_INET6)
+                {
+                    f_In6->sin6_port = htons(port);
+                }
+                else
+                {
+                    f_In4->sin_port = htons(port);
+                }
+
+                if (bind(f_Socket, (sockaddr*)&f_SocketIn, f_Length) != GGPO_SOCKET_ERROR)
+                {
+                    logger->Info(format("{} bound to port: {} ({}).", socket_type == SOCK_STREAM ? "Tcp" : "Udp", port, f_Family == AF_INET6 ? "ipv6 dual stack" : "ipv4"), "udp.cpp");
+
+                    if (family)
+                    {
+                        *family = f_Family;
+                    }
+                    return f_Socket;
+                }
+            }
+
+            GGPO_CLOSE_SOCKET(f_Socket);
+        }
+
+        return GGPO_INVALID_SOCKET;
+    }
+
+    /*
+     * Where a packet came from / is going, v4 or v6.  The hash is worked out once
+     * when the address is set so matching an incoming packet against every endpoint
+     * (Peer2PeerBackend::OnMsg) is an integer compare unless it's actually a hit.
+     */
+    struct PeerAddress
+    {
+        sockaddr_storage    storage;
+        socklen_t           length = 0;
+        uint64_t            hash = 0;
+
+        PeerAddress()
+        {
+            Clear();
+        }
+
+        void
+            Clear()
+        {
+            memset(&storage, 0, sizeof storage);
+            length = 0;
+            hash = 0;
+        }
+
+        // from recvfrom and friends
+        bool
+            Set(const sockaddr* addr, socklen_t len)
+        {
+            Clear();
+
+            if (len <= 0 or len > (socklen_t)sizeof storage or (addr->sa_family != AF_INET and addr->sa_family != AF_INET6))
+            {
+                return false;
+            }
+
+            memcpy(&storage, addr, len);
+            length = len;
+            hash = Hash();
+
+            return true;
+        }
+
+        /*
+         * Numeric address only (no dns in the middle of a session).  socket_family is
+         * what the socket was bound as: a v4 address gets mapped for a dual stack
+         * socket, a v6 address on a v4 only socket only works if it's v4 mapped.
+         */
+        bool
+            Resolve(const char* ip, uint16_t port, int socket_family)
+        {
+            in6_addr f_Addr6;
+            in_addr f_Addr4;
+
+            Clear();
+
+            if (inet_pton(AF_INET, ip, &f_Addr4) == 1)
+            {
+                if (socket_family == AF_INET6)
+                {
+                    memset(&f_Addr6, 0, sizeof f_Addr6);
+                    f_Addr6.s6_addr[10] = 0xff;
+                    f_Addr6.s6_addr[11] = 0xff;
+                    memcpy(&f_Addr6.s6_addr[12], &f_Addr4, 4);
+
+                    return SetV6(f_Addr6, port);
+                }
+
+                return SetV4(f_Addr4, port);
+            }
+
+            if (inet_pton(AF_INET6, ip, &f_Addr6) == 1)
+            {
+                if (socket_family == AF_INET6)
+                {
+                    return SetV6(f_Addr6, port);
+                }
+
+                if (IN6_IS_ADDR_V4MAPPED(&f_Addr6))
+                {
+                    memcpy(&f_Addr4, &f_Addr6.s6_addr[12], 4);
+                    return SetV4(f_Addr4, port);
+                }
+            }
+
+            return false;
+        }
+
+        const sockaddr*
+            Get()
+            const
+        {
+            return (const sockaddr*)&storage;
+        }
+
+        int
+            Family()
+            const
+        {
+            return storage.ss_family;
+        }
+
+        uint16_t
+            Port()
+            const
+        {
+            return ntohs(Family() == AF_INET6 ? ((const sockaddr_in6*)&storage)->sin6_port : ((const sockaddr_in*)&storage)->sin_port);
+        }
+
+        // same host, different port (a tcp peer connects from an ephemeral one but listens on another)
+        void
+            SetPort(uint16_t port)
+        {
+            if (Family() == AF_INET6)
+            {
+                ((sockaddr_in6*)&storage)->sin6_port = htons(port);
+            }
+            else
+            {
+                ((sockaddr_in*)&storage)->sin_port = htons(port);
+            }
+
+            hash = Hash();
+        }
+
+        // just for logs, "1.2.3.4:7000" or "[::1]:7000"
+        string
+            ToString()
+            const
+        {
+            char f_Buffer[INET6_ADDRSTRLEN] = {};
+
+            if (Family() == AF_INET6)
+            {
+                inet_ntop(AF_INET6, (void*)&((const sockaddr_in6*)&storage)->sin6_addr, f_Buffer, sizeof f_Buffer);
+                return format("[{}]:{}", f_Buffer, Port());
+            }
+
+            inet_ntop(AF_INET, (void*)&((const sockaddr_in*)&storage)->sin_addr, f_Buffer, sizeof f_Buffer);
+            return format("{}:{}", f_Buffer, Port());
+        }
+
+        // family, port and address bytes, flow info and scope id don't make it a different peer
+        bool
+            operator==(const PeerAddress& other)
+            const
+        {
+            if (hash != other.hash or Family() != other.Family())
+            {
+                return false;
+            }
+
+            if (Family() == AF_INET6)
+            {
+                const sockaddr_in6* a = (const sockaddr_in6*)&storage;
+                const sockaddr_in6* b = (const sockaddr_in6*)&other.storage;
+
+                return a->sin6_port == b->sin6_port and memcmp(&a->sin6_addr, &b->sin6_addr, sizeof a->sin6_addr) == 0;
+            }
+
+            const sockaddr_in* a = (const sockaddr_in*)&storage;
+            const sockaddr_in* b = (const sockaddr_in*)&other.storage;
+
+            return a->sin_port == b->sin_port and a->sin_addr.s_addr == b->sin_addr.s_addr;
+        }
+
+    private:
+        bool
+            SetV4(const in_addr& addr, uint16_t port)
+        {
+            sockaddr_in* f_In4 = (sockaddr_in*)&storage;
+            f_In4->sin_family = AF_INET;
+            f_In4->sin_port = htons(port);
+            f_In4->sin_addr = addr;
+
+            length = sizeof(sockaddr_in);
+            hash = Hash();
+
+            return true;
+        }
+
+        bool
+            SetV6(const in6_addr& addr, uint16_t port)
+        {
+            sockaddr_in6* f_In6 = (sockaddr_in6*)&storage;
+            f_In6->sin6_family = AF_INET6;
+            f_In6->sin6_port = htons(port);
+            f_In6->sin6_addr = addr;
+
+            length = sizeof(sockaddr_in6);
+            hash = Hash();
+
+            return true;
+        }
+
+        // FNV-1a over the same fields operator== looks at
+        uint64_t
+            Hash()
+            const
+        {
+            const uint8_t* f_Bytes;
+            size_t f_Size;
+            uint16_t f_Port;
+
+            if (Family() == AF_INET6)
+            {
+                f_Bytes = ((const sockaddr_in6*)&storage)->sin6_addr.s6_addr;
+                f_Size = 16;
+                f_Port = ((const sockaddr_in6*)&storage)->sin6_port;
+            }
+            else
+            {
+                f_Bytes = (const uint8_t*)&((const sockaddr_in*)&storage)->sin_addr;
+                f_Size = 4;
+                f_Port = ((const sockaddr_in*)&storage)->sin_port;
+            }
+
+            uint64_t f_Hash = 14695981039346656037ULL;
+
+            f_Hash = (f_Hash ^ (uint64_t)Family()) * 1099511628211ULL;
+            f_Hash = (f_Hash ^ (uint64_t)f_Port) * 1099511628211ULL;
+
+            for (size_t i = 0; i < f_Size; i++)
+            {
+                f_Hash = (f_Hash ^ f_Bytes[i]) * 1099511628211ULL;
+            }
+
+            return f_Hash;
+        }
+    };
+}
+
+//=========================================================================================== Platform Abstraction Tools ===========================================================================================//
+
+namespace GGPO::Platform{
+
+    inline ProcessID 
+        GetProcessID() 
+    {
+    #if defined(_WIN32) || defined(_WIN64)
+        return GetCurrentProcessId();
+    #else
+        return getpid();
+    #endif
+    }
+
+    inline void 
         AssertFailed
         (
             const char* fp_FileName, 
@@ -1749,20 +2426,51 @@ namespace GGPO::Platform{
 
     // For game timers, netcode, frame delta, etc
 inline uint64_t 
-    GetMonotonicTimeMS() 
+    GetMonotonicTimeNS() 
     noexcept
 {
 #if defined(_WIN32) || defined(_WIN64)
-    return timeGetTime(); // 32-bit, wraps after ~49.7 days
-#elif defined(__linux__) || defined(__APPLE__)
+    static const uint64_t s_Frequency = []
+    {
+        LARGE_INTEGER f_Frequency;
+        QueryPerformanceFrequency(&f_Frequency);
+        return static_cast<uint64_t>(f_Frequency.QuadPart);
+    }();
+
+    LARGE_INTEGER f_Counter;
+    QueryPerformanceCounter(&f_Counter);
+
+    const uint64_t f_Ticks = static_cast<uint64_t>(f_Counter.QuadPart);
+
+    // split so ticks * 1e9 can't overflow
+    return (f_Ticks / s_Frequency) * 1000000000ULL + (f_Ticks % s_Frequency) * 1000000000ULL / s_Frequency;
+#elif defined(__linux__)
+    struct timespec t{};
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t); // not slewed by ntp
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+#elif defined(__APPLE__)
     struct timespec t{};
     clock_gettime(CLOCK_MONOTONIC, &t);
-    return static_cast<uint64_t>(t.tv_sec) * 1000ULL + t.tv_nsec / 1000000ULL;
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
 #else
     static_assert(false, "No monotonic time source available on this platform.");
 #endif
 }
 
+inline uint64_t 
+    GetMonotonicTimeUS() 
+    noexcept
+{
+    return GetMonotonicTimeNS() / 1000ULL;
+}
+
+inline uint64_t 
+    GetMonotonicTimeMS() 
+    noexcept
+{
+    return GetMonotonicTimeNS() / 1000000ULL;
+}
+
 // Other stuff im not sure about
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -1782,6 +2490,23 @@ inline optional<string>
     return string(buf, len);
 }
 
+#else
+
+inline optional<string>
+    GetEnvVar(const char* name)
+{
+    const char* val = getenv(name);
+
+    if (not val)
+    {
+        return nullopt;
+    }
+
+    return string(val);
+}
+
+#endif //Posix OS Check //Windows OS Check
+
 inline int
     GetConfigInt(const char* name)
 {
@@ -1799,22 +2524,158 @@ inline bool
         return false;
     }
 
+#if defined(_WIN32) || defined(_WIN64)
     return atoi(val->c_str()) != 0 || _stricmp(val->c_str(), "true") == 0;
+#else
+    return atoi(val->c_str()) != 0 || strcasecmp(val->c_str(), "true") == 0;
+#endif
 }
-    
-#endif //Posix OS Check //Windows OS Check
+}
+
+namespace GGPO
+{
+    /*
+     * Where the protocol gets its time from.  Defaults to the platform's raw
+     * monotonic clock, swap it out to run the netcode on simulated time (tests,
+     * network simulators, replays).
+     */
+    class IClock
+    {
+    public:
+        virtual ~IClock() { }
+        virtual uint64_t NowNS() = 0;
+
+        uint64_t
+            NowUS()
+        {
+            return NowNS() / 1000ULL;
+        }
+    };
+
+    class MonotonicClock : public IClock
+    {
+    public:
+        uint64_t
+            NowNS()
+            override
+        {
+            return Platform::GetMonotonicTimeNS();
+        }
+
+        static MonotonicClock&
+            Get()
+        {
+            static MonotonicClock s_Clock;
+            return s_Clock;
+        }
+    };
 }
 
 //==================================================================================== GameInput ============================================================================================//
 
-// GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8 must be less than
-// 2^BITVECTOR_NIBBLE_SIZE (see ln 1189)
+// GAMEINPUT_MAX_BYTES is per player, GameInput carries up to GAMEINPUT_MAX_PLAYERS of them.
+// These are only ceilings for the by-value GameInput, the InputQueue stores at the real
+// input size and the wire codec (see UdpMsg) sizes its byte indices off the real size too
 
-constexpr int GAMEINPUT_MAX_BYTES = 9;
-constexpr int GAMEINPUT_MAX_PLAYERS = 2;
+constexpr int GAMEINPUT_MAX_BYTES = 32;
+constexpr int GAMEINPUT_MAX_PLAYERS = 8;
 
 namespace GGPO
 {
+    /*
+     * Quiet input compares for the hot path (every received frame goes through a
+     * couple of these).  Everything is folded into one xor/or accumulator a word at a
+     * time so there's no early out to mispredict, and with Size known at compile time
+     * the loop unrolls into a handful of wide loads (SSE/NEON compares at -O2 for
+     * 16 and 32 bytes).  GameInput::equal is the chatty version for debugging.
+     */
+    template <int Size>
+    bool
+        InputBitsEqual(const char* a, const char* b)
+    {
+        constexpr int lv_Words = Size - Size % 8;
+        constexpr int lv_Bytes = lv_Words + ((Size % 8 >= 4) ? 4 : 0);
+
+        uint64_t diff = 0;
+
+        for (int i = 0; i < lv_Words; i += 8)
+        {
+            uint64_t lv_A, lv_B;
+            memcpy(&lv_A, a + i, 8);
+            memcpy(&lv_B, b + i, 8);
+            diff |= lv_A ^ lv_B;
+        }
+
+        if constexpr (lv_Bytes != lv_Words)
+        {
+            uint32_t lv_A, lv_B;
+            memcpy(&lv_A, a + lv_Words, 4);
+            memcpy(&lv_B, b + lv_Words, 4);
+            diff |= lv_A ^ lv_B;
+        }
+
+        for (int i = lv_Bytes; i < Size; i++)
+        {
+            diff |= (uint8_t)(a[i] ^ b[i]);
+        }
+
+        return diff == 0;
+    }
+
+    // for sizes we don't have a specialization for (combined multi player inputs mostly)
+    inline bool
+        InputBitsEqual(const char* a, const char* b, int size)
+    {
+        uint64_t diff = 0;
+        int i = 0;
+
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t lv_A, lv_B;
+            memcpy(&lv_A, a + i, 8);
+            memcpy(&lv_B, b + i, 8);
+            diff |= lv_A ^ lv_B;
+        }
+
+        if (i + 4 <= size)
+        {
+            uint32_t lv_A, lv_B;
+            memcpy(&lv_A, a + i, 4);
+            memcpy(&lv_B, b + i, 4);
+            diff |= lv_A ^ lv_B;
+            i += 4;
+        }
+
+        for (; i < size; i++)
+        {
+            diff |= (uint8_t)(a[i] ^ b[i]);
+        }
+
+        return diff == 0;
+    }
+
+    /*
+     * Picks the specialization with a switch instead of a function pointer so the
+     * compare inlines into the caller.  The size never changes once a queue is set
+     * up, so the branch predicts every time.  Only the usual power of 2 sizes get
+     * their own case, anything else takes the runtime loop above, which is within
+     * a couple of instructions of the unrolled version for odd sizes anyway.
+     */
+    inline bool
+        CompareInputBits(const char* a, const char* b, int size)
+    {
+        switch (size)
+        {
+        case 1:     return InputBitsEqual<1>(a, b);
+        case 2:     return InputBitsEqual<2>(a, b);
+        case 4:     return InputBitsEqual<4>(a, b);
+        case 8:     return InputBitsEqual<8>(a, b);
+        case 16:    return InputBitsEqual<16>(a, b);
+        case 32:    return InputBitsEqual<32>(a, b);
+        default:    return InputBitsEqual(a, b, size);
+        }
+    }
+
     struct GameInput
     {
         enum Constants
@@ -1921,11 +2782,25 @@ namespace GGPO
             return f_Description;
         }
 
-        bool 
-            equal
-            (
-                GameInput& other,
-                bool bitsonly = false,
+        /*
+         * Quiet bits + size compare, use this one anywhere that runs per frame.
+         */
+        bool
+            bits_equal(const GameInput& other)
+            const
+        {
+            return size == other.size and InputBitsEqual(bits, other.bits, size);
+        }
+
+        /*
+         * Diagnostic compare, logs every field that differs.  Way too slow (and
+         * noisy) for the hot path, see bits_equal.
+         */
+        bool 
+            equal
+            (
+                GameInput& other,
+                bool bitsonly,
                 Logger* logger
             )
         {
@@ -1955,13 +2830,293 @@ namespace GGPO
 
 //==================================================================================== InputQueue ============================================================================================//
 
-#define PREVIOUS_FRAME(offset)   (((offset) == 0) ? (INPUT_QUEUE_LENGTH - 1) : ((offset) - 1))
-
 namespace GGPO
 {
-    constexpr int INPUT_QUEUE_LENGTH = 128;
     constexpr int DEFAULT_INPUT_SIZE = 4;
 
+    /*
+     * Guesses what a player is going to press on frames we don't have input for
+     * yet.  Every misprediction costs a rollback, so a better guess here is the
+     * cheapest CPU we'll ever save.
+     *
+     * Predict: prediction comes in as a copy of last_confirmed, change whatever
+     *       you disagree with.  frames_ahead is how far past last_confirmed the
+     *       frame being predicted is (always >= 1).
+     *
+     * OnConfirmedInput: called with every input the queue receives, in frame
+     *       order, so stateful predictors can learn.  Frames the queue pads in
+     *       when the frame delay goes up are not passed along.
+     *
+     * One instance per queue, they keep per player state.
+     */
+    class IInputPredictor
+    {
+    public:
+        virtual ~IInputPredictor() { }
+        virtual void Predict(const GameInput& last_confirmed, int frames_ahead, GameInput* prediction) = 0;
+        virtual void OnConfirmedInput(const GameInput&) { }
+    };
+
+    /*
+     * What GGPO always did: the player keeps doing exactly what they did last.
+     * Also what an InputQueue does when it has no predictor at all.
+     */
+    class HoldLastInputPredictor : public IInputPredictor
+    {
+    public:
+        void
+            Predict(const GameInput&, int, GameInput*)
+            override
+        {
+        }
+    };
+
+    /*
+     * Hold-last, except buttons get let go.  A bit that has been held for
+     * release_after frames is predicted to be released from then on, which is a
+     * lot closer to how people mash than holding forever.
+     */
+    class BitDecayInputPredictor : public IInputPredictor
+    {
+    public:
+        BitDecayInputPredictor(int release_after)
+        {
+            _release_after = GGPO_MAX(release_after, 0);
+            memset(_held_frames, 0, sizeof _held_frames);
+        }
+
+        void
+            Predict(const GameInput& last_confirmed, int frames_ahead, GameInput* prediction)
+            override
+        {
+            const int num_bits = last_confirmed.size * 8;
+
+            for (int i = 0; i < num_bits; i++)
+            {
+                if (last_confirmed.value(i) and _held_frames[i] + frames_ahead > _release_after)
+                {
+                    prediction->clear(i);
+                }
+            }
+        }
+
+        void
+            OnConfirmedInput(const GameInput& input)
+            override
+        {
+            const int num_bits = input.size * 8;
+
+            for (int i = 0; i < num_bits; i++)
+            {
+                if (not input.value(i))
+                {
+                    _held_frames[i] = 0;
+                }
+                else if (_held_frames[i] < UINT16_MAX)
+                {
+                    _held_frames[i]++;
+                }
+            }
+        }
+
+    protected:
+        int         _release_after;
+        uint16_t    _held_frames[GAMEINPUT_MAX_BYTES * 8];
+    };
+
+    /*
+     * First order Markov chain over whole input states, learned online from the
+     * confirmed inputs.  Each entry remembers a handful of states that followed
+     * it and how often; predicting n frames ahead walks the most likely chain n
+     * times.  Unknown states fall back to hold-last.
+     *
+     * The table is direct mapped and small on purpose (~10 KB per player at the
+     * max input size), a collision just means we forget the older state.
+     */
+    class MarkovInputPredictor : public IInputPredictor
+    {
+    public:
+        static constexpr int TABLE_SIZE = 64;
+        static constexpr int SUCCESSORS = 4;
+
+        MarkovInputPredictor()
+        {
+            memset(_table, 0, sizeof _table);
+            memset(_previous, 0, sizeof _previous);
+            _has_previous = false;
+        }
+
+        void
+            Predict(const GameInput& last_confirmed, int frames_ahead, GameInput* prediction)
+            override
+        {
+            const int size = last_confirmed.size;
+
+            for (int i = 0; i < frames_ahead; i++)
+            {
+                const Entry* entry = Find(prediction->bits, size);
+
+                if (not entry)
+                {
+                    break;
+                }
+
+                int best = 0;
+
+                for (int j = 1; j < SUCCESSORS; j++)
+                {
+                    if (entry->counts[j] > entry->counts[best])
+                    {
+                        best = j;
+                    }
+                }
+
+                if (entry->counts[best] == 0)
+                {
+                    break;
+                }
+
+                memcpy(prediction->bits, entry->next[best], size);
+            }
+        }
+
+        void
+            OnConfirmedInput(const GameInput& input)
+            override
+        {
+            if (_has_previous)
+            {
+                Learn(_previous, input.bits, input.size);
+            }
+
+            memcpy(_previous, input.bits, input.size);
+            _has_previous = true;
+        }
+
+    protected:
+        struct Entry
+        {
+            bool        used;
+            char        key[GAMEINPUT_MAX_BYTES];
+            char        next[SUCCESSORS][GAMEINPUT_MAX_BYTES];
+            uint16_t    counts[SUCCESSORS];
+        };
+
+        static uint32_t
+            Hash(const char* bits, int size)
+        {
+            uint32_t hash = 2166136261u; // FNV-1a
+
+            for (int i = 0; i < size; i++)
+            {
+                hash = (hash ^ (uint8_t)bits[i]) * 16777619u;
+            }
+
+            return hash;
+        }
+
+        const Entry*
+            Find(const char* bits, int size)
+            const
+        {
+            const Entry& entry = _table[Hash(bits, size) % TABLE_SIZE];
+
+            if (not entry.used or memcmp(entry.key, bits, size) != 0)
+            {
+                return nullptr;
+            }
+
+            return &entry;
+        }
+
+        void
+            Learn(const char* from, const char* to, int size)
+        {
+            Entry& entry = _table[Hash(from, size) % TABLE_SIZE];
+
+            if (not entry.used or memcmp(entry.key, from, size) != 0)
+            {
+                memset(&entry, 0, sizeof entry);
+                memcpy(entry.key, from, size);
+                entry.used = true;
+            }
+
+            int weakest = 0;
+
+            for (int i = 0; i < SUCCESSORS; i++)
+            {
+                if (entry.counts[i] and memcmp(entry.next[i], to, size) == 0)
+                {
+                    if (entry.counts[i] == UINT16_MAX)
+                    {
+                        // halve everything so old habits fade instead of saturating
+                        for (int j = 0; j < SUCCESSORS; j++)
+                        {
+                            entry.counts[j] /= 2;
+                        }
+                    }
+
+                    entry.counts[i]++;
+                    return;
+                }
+
+                if (entry.counts[i] < entry.counts[weakest])
+                {
+                    weakest = i;
+                }
+            }
+
+            memcpy(entry.next[weakest], to, size);
+            entry.counts[weakest] = 1;
+        }
+
+    protected:
+        Entry   _table[TABLE_SIZE];
+        char    _previous[GAMEINPUT_MAX_BYTES];
+        bool    _has_previous;
+    };
+
+    /*
+     * How well a queue's predictor is doing.  Only frames that were actually
+     * handed out as predictions and have since been confirmed are counted.
+     *
+     * The baseline_ numbers are what hold-last would have scored on the very
+     * same frames, so RollbackFramesSaved() is an estimate of how many frames of
+     * resimulation the predictor saved (negative means it's making things worse).
+     */
+    struct PredictionStats
+    {
+        int64_t   frames_predicted = 0;
+        int64_t   frames_correct = 0;
+        int64_t   baseline_frames_correct = 0;
+        int64_t   rollback_frames = 0;
+        int64_t   baseline_rollback_frames = 0;
+
+        double
+            HitRate()
+            const
+        {
+            return frames_predicted ? (double)frames_correct / frames_predicted : 1.0;
+        }
+
+        int64_t
+            RollbackFramesSaved()
+            const
+        {
+            return baseline_rollback_frames - rollback_frames;
+        }
+    };
+
+    /*
+     * One player's inputs, kept structure-of-arrays style.  A slot's frame number is
+     * implied by its index (the queue starts at frame 0 and never skips one, so
+     * frame f always lives in slot f % capacity) and the input bytes are packed back
+     * to back exactly input_size apart.  A 2 byte input costs 2 bytes a frame
+     * instead of a whole GameInput, and pulling a run of frames out is a memcpy.
+     *
+     * The predictions we handed out and what hold-last would have said (see
+     * PredictionStats) are kept in arrays of their own with the same layout.
+     */
     class InputQueue
     {
     private:
@@ -1974,18 +3129,27 @@ namespace GGPO
 
            GGPO_ASSERT(input_queue_logger)
             
-            Init(-1, input_size);
+            Init(-1, input_size, INPUT_QUEUE_LENGTH);
         };
 
         ~InputQueue() = default;
 
     public:
+        /*
+         * The only place the queue allocates, length frames of storage up front.
+         */
         void
-            Init(int id, int input_size)
+            Init(int id, int input_size, int length)
         {
+            GGPO_ASSERT(length > 0);
+            GGPO_ASSERT(input_size > 0 and input_size <= GAMEINPUT_MAX_BYTES);
+
             _id = id;
+            _input_size = input_size;
+            _capacity = length;
             _head = 0;
             _tail = 0;
+            _tail_frame = 0;
             _length = 0;
             _frame_delay = 0;
             _first_frame = true;
@@ -1993,19 +3157,14 @@ namespace GGPO
             _first_incorrect_frame = GameInput::NullFrame;
             _last_frame_requested = GameInput::NullFrame;
             _last_added_frame = GameInput::NullFrame;
-
-            _prediction.init(GameInput::NullFrame, NULL, input_size);
-
-            /*
-             * This is safe because we know the GameInput is a proper structure (as in,
-             * no virtual methods, no contained classes, etc.).
-             */
-            memset(_inputs, 0, sizeof _inputs);
-
-            for (int i = 0; i < GGPO_ARRAY_SIZE(_inputs); i++)
-            {
-                _inputs[i].size = input_size;
-            }
+            _last_forced_misprediction = GameInput::NullFrame;
+            _last_predicted_frame = GameInput::NullFrame;
+            _prediction_frame = GameInput::NullFrame;
+            _prediction_stats = PredictionStats();
+
+            _input_bits.assign((size_t)length * input_size, 0);
+            _predicted_bits.assign((size_t)length * input_size, 0);
+            _baseline_bits.assign((size_t)length * input_size, 0);
         }
 
         int
@@ -2029,12 +3188,66 @@ namespace GGPO
             return _length;
         }
 
+        int
+            GetInputSize()
+            const
+        {
+            return _input_size;
+        }
+
         void 
             SetFrameDelay(int delay) 
         {
             _frame_delay = delay; 
         }
 
+        int
+            GetFrameDelay()
+            const
+        {
+            return _frame_delay;
+        }
+
+        /*
+         * True when the user's next input is a repeat of the newest one in the queue.
+         * That's when a frame delay change is free: the padding frames (delay went
+         * up) are copies of the same input and the dropped frame (delay went down)
+         * didn't hold anything new.
+         */
+        bool
+            IsRepeatOfLastInput(const GameInput& input)
+            const
+        {
+            if (_last_added_frame == GameInput::NullFrame)
+            {
+                return true;
+            }
+
+            return input.size == _input_size and CompareInputBits(InputBits(_last_added_frame), input.bits, _input_size);
+        }
+
+        void
+            SetForcedMispredictionInterval(int interval) //0 turns it off, only used by the replay verifier
+        {
+            _forced_misprediction_interval = interval;
+        }
+
+        /*
+         * nullptr goes back to plain hold-last.  The queue doesn't own the predictor.
+         */
+        void
+            SetPredictor(IInputPredictor* predictor)
+        {
+            _predictor = predictor;
+        }
+
+        const PredictionStats&
+            GetPredictionStats()
+            const
+        {
+            return _prediction_stats;
+        }
+
         void
             ResetPrediction
         (
@@ -2049,9 +3262,10 @@ namespace GGPO
              * There's nothing really to do other than reset our prediction
              * state and the incorrect frame counter...
              */
-            _prediction.frame = GameInput::NullFrame;
+            _prediction_frame = GameInput::NullFrame;
             _first_incorrect_frame = GameInput::NullFrame;
             _last_frame_requested = GameInput::NullFrame;
+            _last_predicted_frame = GameInput::NullFrame;
         }
 
         void
@@ -2072,22 +3286,74 @@ namespace GGPO
             if (frame >= _last_added_frame)
             {
                 _tail = _head;
+                _tail_frame = _last_added_frame + 1;
+                _length = 0;
             }
             else
             {
-                int offset = frame - _inputs[_tail].frame + 1;
+                int offset = frame - _tail_frame + 1;
 
                 input_queue_logger->Info(format("difference of {} frames.", offset), "input_queue.cpp");
                 GGPO_ASSERT(offset >= 0);
 
-                _tail = (_tail + offset) % INPUT_QUEUE_LENGTH;
+                _tail = (_tail + offset) % _capacity;
+                _tail_frame += offset;
                 _length -= offset;
             }
 
-            input_queue_logger->Info(format("after discarding, new tail is {} (frame:{}).", _tail, _inputs[_tail].frame), "input_queue.cpp");
+            input_queue_logger->Info(format("after discarding, new tail is {} (frame:{}).", _tail, _tail_frame), "input_queue.cpp");
             GGPO_ASSERT(_length >= 0);
         }
 
+        /*
+         * Copies the confirmed inputs of count frames starting at first_frame into
+         * out, out_stride bytes apart.  Pass the input size for a packed array, or
+         * num_players * input_size to interleave straight into a SynchronizeInputs
+         * style buffer.  Stops at the first frame the queue doesn't hold (anymore, or
+         * yet) and returns how many frames it copied.
+         */
+        int
+            GetInputs
+            (
+                int first_frame,
+                int count,
+                char* out,
+                int out_stride
+            )
+            const
+        {
+            GGPO_ASSERT(_first_incorrect_frame == GameInput::NullFrame || first_frame + count <= _first_incorrect_frame);
+
+            if (count <= 0 or not HoldsFrame(first_frame))
+            {
+                return 0;
+            }
+
+            count = GGPO_MIN(count, _last_added_frame - first_frame + 1);
+
+            if (out_stride != _input_size)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    memcpy(out + (size_t)i * out_stride, InputBits(first_frame + i), _input_size);
+                }
+                return count;
+            }
+
+            // packed on both ends, at most two copies depending on where the ring wraps
+            const int first_slot = first_frame % _capacity;
+            const int before_wrap = GGPO_MIN(count, _capacity - first_slot);
+
+            memcpy(out, InputBits(first_frame), (size_t)before_wrap * _input_size);
+
+            if (before_wrap < count)
+            {
+                memcpy(out + (size_t)before_wrap * _input_size, _input_bits.data(), (size_t)(count - before_wrap) * _input_size);
+            }
+
+            return count;
+        }
+
         bool
             GetConfirmedInput
             (
@@ -2097,26 +3363,39 @@ namespace GGPO
             const
         {
             GGPO_ASSERT(_first_incorrect_frame == GameInput::NullFrame || requested_frame < _first_incorrect_frame);
-            int offset = requested_frame % INPUT_QUEUE_LENGTH;
 
-            if (_inputs[offset].frame != requested_frame)
+            if (not HoldsFrame(requested_frame))
             {
                 return false;
             }
 
-            *input = _inputs[offset];
+            ToGameInput(requested_frame, InputBits(requested_frame), input);
 
             return true;
         }
 
+        /*
+         * Writes the input for requested_frame (input size bytes) into out, the
+         * confirmed one if we have it, a prediction if not.  Returns true when it
+         * was confirmed.
+         *
+         * InputBytes is for callers that know the input size at compile time (see
+         * FixedSession), the copies become fixed size moves.  0 means use _input_size.
+         *
+         * This runs for every player every frame (and every resimulated frame), so
+         * it only logs when the queue changes mode, not per call.
+         */
+        template <int InputBytes = 0>
         bool
             GetInput
             (
                 int requested_frame, 
-                GameInput* input
+                char* out
             )
         {
-            input_queue_logger->Info(format("requesting input frame {}.", requested_frame), "input_queue.cpp");
+            GGPO_ASSERT(InputBytes == 0 or InputBytes == _input_size);
+
+            const int input_size = InputBytes ? InputBytes : _input_size;
 
             /*
             * No one should ever try to grab any input when we have a prediction
@@ -2131,86 +3410,106 @@ namespace GGPO
             */
             _last_frame_requested = requested_frame;
 
-            GGPO_ASSERT(requested_frame >= _inputs[_tail].frame);
+            GGPO_ASSERT(requested_frame >= _tail_frame);
 
-            if (_prediction.frame == GameInput::NullFrame)
+            if (_prediction_frame == GameInput::NullFrame)
             {
                 /*
                 * If the frame requested is in our range, fetch it out of the queue and
                 * return it.
                 */
-                int offset = requested_frame - _inputs[_tail].frame;
-
-                if (offset < _length)
+                if (requested_frame - _tail_frame < _length)
                 {
-                    offset = (offset + _tail) % INPUT_QUEUE_LENGTH;
-                    GGPO_ASSERT(_inputs[offset].frame == requested_frame);
-                    *input = _inputs[offset];
-                    input_queue_logger->Info(format("returning confirmed frame number {}.", input->frame), "input_queue.cpp");
+                    memcpy(out, InputBits(requested_frame), input_size);
                     return true;
                 }
 
                 /*
                 * The requested frame isn't in the queue.  Bummer.  This means we need
-                * to return a prediction frame.  Predict that the user will do the
-                * same thing they did last time.
+                * to start predicting, beginning right after the last frame we've got.
                 */
-                if (requested_frame == 0)
-                {
-                    input_queue_logger->Info("basing new prediction frame from nothing, you're client wants frame 0.", "input_queue.cpp");
-                    _prediction.erase();
-                }
-                else if (_last_added_frame == GameInput::NullFrame)
-                {
-                    input_queue_logger->Info("basing new prediction frame from nothing, since we have no frames yet.", "input_queue.cpp");
-                    _prediction.erase();
-                }
-                else
-                {
-                    input_queue_logger->Info(format("basing new prediction frame from previously added frame (queue entry:{}, frame:{}).", PREVIOUS_FRAME(_head), _inputs[PREVIOUS_FRAME(_head)].frame), "input_queue.cpp");
-                    _prediction = _inputs[PREVIOUS_FRAME(_head)];
-                }
-                _prediction.frame++;
+                _prediction_frame = (_last_added_frame == GameInput::NullFrame) ? 0 : _last_added_frame + 1;
+                _last_predicted_frame = _prediction_frame - 1;
+
+                input_queue_logger->Info(format("entering prediction mode at frame {}.", _prediction_frame), "input_queue.cpp");
             }
 
-            GGPO_ASSERT(_prediction.frame >= 0);
+            GGPO_ASSERT(_prediction_frame >= 0);
 
             /*
-            * If we've made it this far, we must be predicting.  Go ahead and
-            * forward the prediction frame contents.  Be sure to return the
-            * frame number requested by the client, though.
+            * Predictions are kept per frame since the predictor may well say something
+            * different for frame n+3 than for n+1.  AddDelayedInputToQueue() then
+            * checks every confirmed input against exactly what we handed out.
             */
-            *input = _prediction;
-            input->frame = requested_frame;
-            input_queue_logger->Info(format("returning prediction frame number {} ({}).", input->frame, _prediction.frame), "input_queue.cpp");
-
-            return false;
-        }
-
-        void
-            AddInput(GameInput& input)
-        {
-            int new_frame;
+            while (_last_predicted_frame < requested_frame)
+            {
+                PredictFrame(++_last_predicted_frame);
+            }
 
-            input_queue_logger->Info(format("adding input frame number {} to queue.", input.frame), "input_queue.cpp");
+            char* prediction = PredictedBits(requested_frame);
 
             /*
-            * These next two lines simply verify that inputs are passed in
-            * sequentially by the user, regardless of frame delay.
+            * Replay verification can ask for deliberately wrong predictions so the
+            * rollback path gets exercised even when the predictor would have been right.
+            * Flipping the stored prediction (rather than just the returned copy) means
+            * AddDelayedInputToQueue() will catch it and report the frame as incorrect.
             */
-            GGPO_ASSERT(_last_user_added_frame == GameInput::NullFrame || input.frame == _last_user_added_frame + 1);
-
-            _last_user_added_frame = input.frame;
+            if (_forced_misprediction_interval > 0 and requested_frame > _last_forced_misprediction and requested_frame % _forced_misprediction_interval == 0)
+            {
+                input_queue_logger->Info(format("forcing misprediction on frame {}.", requested_frame), "input_queue.cpp");
+                prediction[0] = ~prediction[0];
+                _last_forced_misprediction = requested_frame;
+            }
 
             /*
-            * Move the queue head to the correct point in preparation to
+            * If we've made it this far, we must be predicting.  Go ahead and
+            * forward the prediction frame contents.
+            */
+            memcpy(out, prediction, input_size);
+
+            return false;
+        }
+
+        bool
+            GetInput
+            (
+                int requested_frame, 
+                GameInput* input
+            )
+        {
+            input->frame = requested_frame;
+            input->size = _input_size;
+            memset(input->bits, 0, sizeof(input->bits));
+
+            return GetInput(requested_frame, input->bits);
+        }
+
+        void
+            AddInput(GameInput& input)
+        {
+            int new_frame;
+
+            input_queue_logger->Info(format("adding input frame number {} to queue.", input.frame), "input_queue.cpp");
+
+            GGPO_ASSERT(input.size == _input_size);
+
+            /*
+            * These next two lines simply verify that inputs are passed in
+            * sequentially by the user, regardless of frame delay.
+            */
+            GGPO_ASSERT(_last_user_added_frame == GameInput::NullFrame || input.frame == _last_user_added_frame + 1);
+
+            _last_user_added_frame = input.frame;
+
+            /*
+            * Move the queue head to the correct point in preparation to
             * input the frame into the queue.
             */
             new_frame = AdvanceQueueHead(input.frame);
 
             if (new_frame != GameInput::NullFrame)
             {
-                AddDelayedInputToQueue(input, new_frame);
+                AddDelayedInputToQueue(input.bits, new_frame);
             }
 
             /*
@@ -2222,13 +3521,120 @@ namespace GGPO
         }
 
     protected:
+        bool
+            HoldsFrame(int frame)
+            const
+        {
+            return frame >= 0 and frame <= _last_added_frame and frame > _last_added_frame - _capacity;
+        }
+
+        const char*
+            InputBits(int frame)
+            const
+        {
+            return _input_bits.data() + (size_t)(frame % _capacity) * _input_size;
+        }
+
+        char*
+            InputBits(int frame)
+        {
+            return _input_bits.data() + (size_t)(frame % _capacity) * _input_size;
+        }
+
+        char*
+            PredictedBits(int frame)
+        {
+            return _predicted_bits.data() + (size_t)(frame % _capacity) * _input_size;
+        }
+
+        char*
+            BaselineBits(int frame)
+        {
+            return _baseline_bits.data() + (size_t)(frame % _capacity) * _input_size;
+        }
+
+        /*
+         * GetConfirmedInput() and the predictor interface still talk GameInput, so
+         * those get built on the spot.  Without a predictor only GetConfirmedInput()
+         * does, GetInput() copies bits.
+         */
+        void
+            ToGameInput(int frame, const char* bits, GameInput* input)
+            const
+        {
+            input->frame = frame;
+            input->size = _input_size;
+            memset(input->bits, 0, sizeof(input->bits));
+            memcpy(input->bits, bits, _input_size);
+        }
+
+        void
+            PredictFrame(int frame)
+        {
+            char* prediction = PredictedBits(frame);
+
+            if (_last_added_frame == GameInput::NullFrame)
+            {
+                input_queue_logger->Info(format("basing prediction for frame {} on nothing, since we have no frames yet.", frame), "input_queue.cpp");
+                memset(prediction, 0, _input_size);
+                memset(BaselineBits(frame), 0, _input_size);
+                return;
+            }
+
+            const char* last = InputBits(_last_added_frame);
+
+            if (_predictor)
+            {
+                GameInput last_confirmed, guess;
+
+                ToGameInput(_last_added_frame, last, &last_confirmed);
+                guess = last_confirmed;
+
+                _predictor->Predict(last_confirmed, frame - _last_added_frame, &guess);
+                memcpy(prediction, guess.bits, _input_size);
+            }
+            else
+            {
+                memcpy(prediction, last, _input_size);
+            }
+
+            memcpy(BaselineBits(frame), last, _input_size);
+        }
+
+        void
+            RecordPrediction(const char* bits, int frame_number)
+        {
+            const bool correct = CompareInputBits(PredictedBits(frame_number), bits, _input_size);
+            const bool baseline_correct = CompareInputBits(BaselineBits(frame_number), bits, _input_size);
+
+            _prediction_stats.frames_predicted++;
+            _prediction_stats.frames_correct += correct;
+            _prediction_stats.baseline_frames_correct += baseline_correct;
+
+            // everything from the first bad frame up to the newest requested one gets resimulated
+            if (not correct and _first_incorrect_frame == GameInput::NullFrame)
+            {
+                _prediction_stats.rollback_frames += _last_frame_requested - frame_number + 1;
+            }
+
+            if (not baseline_correct)
+            {
+                _prediction_stats.baseline_rollback_frames += _last_frame_requested - frame_number + 1;
+
+                // hold-last would have rolled back right here and predicted the rest off this input
+                for (int frame = frame_number + 1; frame <= _last_predicted_frame; frame++)
+                {
+                    memcpy(BaselineBits(frame), bits, _input_size);
+                }
+            }
+        }
 
         int
             AdvanceQueueHead(int frame)
         {
             input_queue_logger->Info(format("advancing queue head to frame {}.", frame), "input_queue.cpp");
 
-            int expected_frame = _first_frame ? 0 : _inputs[PREVIOUS_FRAME(_head)].frame + 1;
+            int expected_frame = _first_frame ? 0 : _last_added_frame + 1;
 
             frame += _frame_delay;
 
@@ -2252,51 +3658,66 @@ namespace GGPO
                 * left.
                 */
                 input_queue_logger->Info(format("Adding padding frame {} to account for change in frame delay.", expected_frame), "input_queue.cpp");
-                GameInput& last_frame = _inputs[PREVIOUS_FRAME(_head)];
-                AddDelayedInputToQueue(last_frame, expected_frame);
+
+                // nothing to replicate yet when the delay was set before the first input, pad with a blank one
+                static const char blank[GAMEINPUT_MAX_BYTES] = { };
+                AddDelayedInputToQueue(_last_added_frame == GameInput::NullFrame ? blank : InputBits(_last_added_frame), expected_frame, true);
                 expected_frame++;
             }
 
-            GGPO_ASSERT(frame == 0 || frame == _inputs[PREVIOUS_FRAME(_head)].frame + 1);
+            GGPO_ASSERT(frame == 0 || frame == _last_added_frame + 1);
             return frame;
         }
 
         void
-            AddDelayedInputToQueue(GameInput& input, int frame_number)
+            AddDelayedInputToQueue(const char* bits, int frame_number, bool padding = false)
         {
             input_queue_logger->Info(format("adding delayed input frame number {} to queue.", frame_number), "input_queue.cpp");
 
-            GGPO_ASSERT(input.size == _prediction.size);
-
             GGPO_ASSERT(_last_added_frame == GameInput::NullFrame || frame_number == _last_added_frame + 1);
-
-            GGPO_ASSERT(frame_number == 0 || _inputs[PREVIOUS_FRAME(_head)].frame == frame_number - 1);
+            GGPO_ASSERT(frame_number % _capacity == _head);
 
             /*
             * Add the frame to the back of the queue
             */
-            _inputs[_head] = input;
-            _inputs[_head].frame = frame_number;
-            _head = (_head + 1) % INPUT_QUEUE_LENGTH;
+            memcpy(InputBits(frame_number), bits, _input_size);
+
+            /*
+            * Padding frames are copies we made up, nobody actually pressed them.
+            */
+            if (_predictor and not padding)
+            {
+                GameInput confirmed;
+                ToGameInput(frame_number, InputBits(frame_number), &confirmed);
+                _predictor->OnConfirmedInput(confirmed);
+            }
+
+            _head = (_head + 1) % _capacity;
             _length++;
             _first_frame = false;
 
             _last_added_frame = frame_number;
 
-            if (_prediction.frame != GameInput::NullFrame)
+            if (_prediction_frame != GameInput::NullFrame)
             {
-                GGPO_ASSERT(frame_number == _prediction.frame);
+                GGPO_ASSERT(frame_number == _prediction_frame);
 
                 /*
                 * We've been predicting...  See if the inputs we've gotten match
                 * what we've been predicting.  If so, don't worry about it.  If not,
                 * remember the first input which was incorrect so we can report it
-                * in GetFirstIncorrectFrame()
+                * in GetFirstIncorrectFrame().  Frames nobody asked for yet were never
+                * simulated, so there's nothing to be wrong about there.
                 */
-                if (_first_incorrect_frame == GameInput::NullFrame and not _prediction.equal(input, true))
+                if (frame_number <= _last_predicted_frame)
                 {
-                    input_queue_logger->Info(format("frame {} does not match prediction.  marking error.", frame_number), "input_queue.cpp");
-                    _first_incorrect_frame = frame_number;
+                    RecordPrediction(InputBits(frame_number), frame_number);
+
+                    if (_first_incorrect_frame == GameInput::NullFrame and not CompareInputBits(PredictedBits(frame_number), InputBits(frame_number), _input_size))
+                    {
+                        input_queue_logger->Info(format("frame {} does not match prediction.  marking error.", frame_number), "input_queue.cpp");
+                        _first_incorrect_frame = frame_number;
+                    }
                 }
 
                 /*
@@ -2305,23 +3726,27 @@ namespace GGPO
                 * of predition mode entirely!  Otherwise, advance the prediction frame
                 * count up.
                 */
-                if (_prediction.frame == _last_frame_requested and _first_incorrect_frame == GameInput::NullFrame)
+                if (_prediction_frame == _last_frame_requested and _first_incorrect_frame == GameInput::NullFrame)
                 {
                     input_queue_logger->Info("prediction is correct!  dumping out of prediction mode.", "input_queue.cpp");
-                    _prediction.frame = GameInput::NullFrame;
+                    _prediction_frame = GameInput::NullFrame;
+                    _last_predicted_frame = GameInput::NullFrame;
                 }
                 else
                 {
-                    _prediction.frame++;
+                    _prediction_frame++;
                 }
             }
-            GGPO_ASSERT(_length <= INPUT_QUEUE_LENGTH);
+            GGPO_ASSERT(_length <= _capacity);
         }
 
     protected:
         int                  _id;
-        int                  _head;
+        int                  _input_size;
+        int                  _capacity;
+        int                  _head;         /* slot the next frame goes in */
         int                  _tail;
+        int                  _tail_frame;   /* the frame in slot _tail, oldest one still queued */
         int                  _length;
         bool                 _first_frame;
 
@@ -2332,8 +3757,17 @@ namespace GGPO
 
         int                  _frame_delay;
 
-        GameInput            _inputs[INPUT_QUEUE_LENGTH];
-        GameInput            _prediction;
+        int                  _forced_misprediction_interval = 0;
+        int                  _last_forced_misprediction;
+
+        IInputPredictor*     _predictor = nullptr;
+        int                  _prediction_frame; /* next frame we expect while predicting, NullFrame when we aren't */
+        int                  _last_predicted_frame;
+        PredictionStats      _prediction_stats;
+
+        vector<char>         _input_bits;       /* _input_size bytes per frame, frame f in slot f % _capacity */
+        vector<char>         _predicted_bits;   /* what we handed out for each predicted frame, same layout */
+        vector<char>         _baseline_bits;    /* what hold-last would have handed out, same layout */
     };
 }
 
@@ -2344,8 +3778,126 @@ constexpr int MIN_UNIQUE_FRAMES = 10;
 constexpr int MIN_FRAME_ADVANTAGE = 3;
 constexpr int MAX_FRAME_ADVANTAGE = 9;
 
+constexpr float FRAME_PACING_HORIZON = 60.0f;   /* frames we give continuous pacing to close the gap */
+constexpr float MAX_FRAME_DILATION = 0.03f;     /* never stretch a frame by more than this */
+
+constexpr int RTT_OUTLIER_K = 4;                /* a sample this many rttvars off the smoothed rtt is a spike */
+constexpr uint64_t RTT_OUTLIER_FLOOR_US = 5000; /* ...but never reject anything closer than this */
+constexpr int RTT_OUTLIER_LIMIT = 3;            /* this many spikes in a row means the path changed */
+
  namespace GGPO
  { 
+      /*
+       * How the session keeps both sides' clocks in step.
+       *
+       * Discrete - The classic way, every RECOMMENDATION_INTERVAL frames the one
+       * that's ahead gets an EventCode::TimeSync telling it how many whole frames
+       * to stall.
+       *
+       * Continuous - No events, the game asks GetFrameDilation() every frame and
+       * runs that frame for (frame period * dilation) instead.  Only the one
+       * that's ahead ever gets more than 1.0, so the drift is soaked up a
+       * fraction of a millisecond at a time and nothing ever hitches.
+       */
+      enum class TimeSyncMode
+      {
+          Discrete,
+          Continuous
+      };
+
+      /*
+       * Smoothed round trip time, RFC 6298 style: srtt and rttvar are EWMAs with
+       * alpha = 1/8 and beta = 1/4.  A sample more than RTT_OUTLIER_K rttvars off
+       * srtt is thrown away as a spike (hello Wi-Fi), unless RTT_OUTLIER_LIMIT of
+       * them show up in a row, in which case the path really did change and we
+       * start over from the new sample.
+       */
+      class RttEstimator
+      {
+      public:
+          void
+              Reset()
+          {
+              _srtt = 0;
+              _rttvar = 0;
+              _has_sample = false;
+              _outliers_in_a_row = 0;
+          }
+
+          /*
+           * Returns false if the sample got rejected as an outlier.
+           */
+          bool
+              AddSample(uint64_t rtt)
+          {
+              const int64_t sample = (int64_t)rtt;
+
+              if (not _has_sample)
+              {
+                  Restart(sample);
+                  return true;
+              }
+
+              const int64_t error = sample - _srtt;
+              const int64_t deviation = error < 0 ? -error : error;
+              const int64_t threshold = GGPO_MAX(RTT_OUTLIER_K * _rttvar, (int64_t)RTT_OUTLIER_FLOOR_US);
+
+              if (deviation > threshold)
+              {
+                  if (++_outliers_in_a_row < RTT_OUTLIER_LIMIT)
+                  {
+                      return false;
+                  }
+
+                  Restart(sample);
+                  return true;
+              }
+
+              _outliers_in_a_row = 0;
+              _rttvar += (deviation - _rttvar) / 4;
+              _srtt += error / 8;
+
+              return true;
+          }
+
+          uint64_t
+              GetSmoothed()
+              const
+          {
+              return (uint64_t)_srtt;
+          }
+
+          uint64_t
+              GetVariance()
+              const
+          {
+              return (uint64_t)_rttvar;
+          }
+
+          bool
+              HasSample()
+              const
+          {
+              return _has_sample;
+          }
+
+      protected:
+          void
+              Restart(int64_t sample)
+          {
+              _srtt = sample;
+              _rttvar = sample / 2;
+              _has_sample = true;
+              _outliers_in_a_row = 0;
+          }
+
+      protected:
+          int64_t     _srtt = 0;
+          int64_t     _rttvar = 0;
+          bool        _has_sample = false;
+          int         _outliers_in_a_row = 0;
+      };
+
       class TimeSync
       {
       public:
@@ -2353,11 +3905,17 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
           {
               memset(_local, 0, sizeof(_local));
               memset(_remote, 0, sizeof(_remote));
+              _local_sum = _remote_sum = 0;
+              _local_sum_sq = _remote_sum_sq = 0;
               _next_prediction = FRAME_WINDOW_SIZE * 3;
           }
 
           virtual ~TimeSync() = default;
  
+          /*
+           * Keeps running sums (and sums of squares, for the jitter) of both windows
+           * so recommend_frame_wait_duration() doesn't have to walk them every call.
+           */
           void
               advance_frame
               (
@@ -2366,10 +3924,17 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
                   int radvantage
               )
           {
+              const int slot = input.frame % FRAME_WINDOW_SIZE;
+
+              _local_sum += advantage - _local[slot];
+              _local_sum_sq += (int64_t)advantage * advantage - (int64_t)_local[slot] * _local[slot];
+              _remote_sum += radvantage - _remote[slot];
+              _remote_sum_sq += (int64_t)radvantage * radvantage - (int64_t)_remote[slot] * _remote[slot];
+
               // Remember the last frame and frame advantage
               _last_inputs[input.frame % GGPO_ARRAY_SIZE(_last_inputs)] = input;
-              _local[input.frame % GGPO_ARRAY_SIZE(_local)] = advantage;
-              _remote[input.frame % GGPO_ARRAY_SIZE(_remote)] = radvantage;
+              _local[slot] = advantage;
+              _remote[slot] = radvantage;
           }
 
           int
@@ -2380,23 +3945,9 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
               )
           {
               // Average our local and remote frame advantages
-              int i, sum = 0;
-              float advantage, radvantage;
-
-              for (i = 0; i < GGPO_ARRAY_SIZE(_local); i++)
-              {
-                  sum += _local[i];
-              }
-
-              advantage = sum / (float)GGPO_ARRAY_SIZE(_local);
-              sum = 0;
-
-              for (i = 0; i < GGPO_ARRAY_SIZE(_remote); i++)
-              {
-                  sum += _remote[i];
-              }
-
-              radvantage = sum / (float)GGPO_ARRAY_SIZE(_remote);
+              int i;
+              const float advantage = _local_sum / (float)FRAME_WINDOW_SIZE;
+              const float radvantage = _remote_sum / (float)FRAME_WINDOW_SIZE;
 
               static atomic<int> count = 0;
               count++;
@@ -2411,10 +3962,13 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
 
               // Both clients agree that we're the one ahead.  Split
               // the difference between the two to figure out how long to
-              // sleep for.
-              int sleep_frames = (int)(((radvantage - advantage) / 2) + 0.5);
+              // sleep for.  Whatever part of that gap is just jitter (one
+              // standard deviation of the split) gets left alone, otherwise a noisy
+              // link has us stalling on one side, then the other, then back.
+              const float jitter = sqrtf(Variance(_local_sum, _local_sum_sq) + Variance(_remote_sum, _remote_sum_sq)) / 2;
+              int sleep_frames = (int)(((radvantage - advantage) / 2) - jitter + 0.5);
 
-              logger->Info(format("iteration {}:  sleep frames is {}", count, sleep_frames), "timesync.cpp");
+              logger->Info(format("iteration {}:  sleep frames is {} (jitter {})", count.load(), sleep_frames, jitter), "timesync.cpp");
 
               // Some things just aren't worth correcting for.  Make sure
               // the difference is relevant before proceeding.
@@ -2431,9 +3985,9 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
               {
                   for (i = 1; i < GGPO_ARRAY_SIZE(_last_inputs); i++)
                   {
-                      if (not _last_inputs[i].equal(_last_inputs[0], true))
+                      if (not _last_inputs[i].bits_equal(_last_inputs[0]))
                       {
-                          logger->Info(format("iteration {}:  rejecting due to input stuff at position {}...!!!", count, i), "timesync.cpp");
+                          logger->Info(format("iteration {}:  rejecting due to input stuff at position {}...!!!", count.load(), i), "timesync.cpp");
                           return 0;
                       }
                   }
@@ -2442,2062 +3996,6950 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
               // Success!!! Recommend the number of frames to sleep and adjust
               return GGPO_MIN(sleep_frames, MAX_FRAME_ADVANTAGE);
           }
+
+          /*
+           * The continuous version of the above.  Same split-the-difference and
+           * jitter allowance, but instead of a whole number of frames to drop it
+           * hands back how much longer (> 1) each frame should take for the gap
+           * to close over FRAME_PACING_HORIZON frames.  No MIN_FRAME_ADVANTAGE
+           * threshold, small gaps just get small corrections.
+           *
+           * Like the discrete version only the one that's ahead does anything.
+           * If the one behind sped up too, any bias both sides see in the
+           * advantages (they each think they're a little behind) has both of
+           * them running fast together and the game drifts off real time.
+           */
+          float
+              recommend_frame_dilation()
+              const
+          {
+              const float advantage = _local_sum / (float)FRAME_WINDOW_SIZE;
+              const float radvantage = _remote_sum / (float)FRAME_WINDOW_SIZE;
+
+              // positive when we're the one ahead, same as sleep_frames above
+              const float gap = (radvantage - advantage) / 2;
+              const float jitter = sqrtf(Variance(_local_sum, _local_sum_sq) + Variance(_remote_sum, _remote_sum_sq)) / 2;
+
+              if (gap <= jitter)
+              {
+                  return 1.0f;
+              }
+
+              return 1.0f + GGPO_MIN((gap - jitter) / FRAME_PACING_HORIZON, MAX_FRAME_DILATION);
+          }
  
+      protected:
+          static float
+              Variance(int64_t sum, int64_t sum_sq)
+          {
+              const float mean = sum / (float)FRAME_WINDOW_SIZE;
+              return GGPO_MAX(sum_sq / (float)FRAME_WINDOW_SIZE - mean * mean, 0.0f);
+          }
+
       protected:
           int         _local[FRAME_WINDOW_SIZE];
           int         _remote[FRAME_WINDOW_SIZE];
+          int64_t     _local_sum;
+          int64_t     _remote_sum;
+          int64_t     _local_sum_sq;
+          int64_t     _remote_sum_sq;
           GameInput   _last_inputs[MIN_UNIQUE_FRAMES];
           int         _next_prediction;
       };
  }
  
- //==================================================================================== Sync ============================================================================================//
-
-namespace GGPO
-{
-     class SyncTestBackend;
-
-     class Sync
-     {
-    private:
-        unique_ptr<Logger> sync_logger = nullptr;
-
-     public:
-         struct Config
-         {
-             int                     num_prediction_frames;
-             int                     num_players;
-             int                     input_size;
-         };
-         struct Event
-         {
-             enum
-             {
-                 ConfirmedInput,
-             } type;
-             union
-             {
-                 struct confirmedInput
-                 {
-                     GameInput   input;
-                 };
-             } u;
-         };
+//==================================================================================== UdpMsg ============================================================================================//
 
-     public:
-         Sync(UdpMsg::connect_status* connect_status) :
-             _local_connect_status(connect_status),
-             _input_queues(NULL)
-         {
-             sync_logger = Logger::CreateUnique("SyncLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+constexpr int MAX_COMPRESSED_BITS = 4096;
+constexpr int UDP_MSG_MAX_PLAYERS = 8;
 
-             GGPO_ASSERT(sync_logger)
+static_assert(UDP_MSG_MAX_PLAYERS <= 32, "peer connect status changes are tracked in a 32 bit mask");
 
-             _framecount = 0;
-             _last_confirmed_frame = -1;
-             _max_prediction_frames = 0;
-             memset(&_savedstate, 0, sizeof(_savedstate));
-         }
+/*
+ * Goes out in every SyncRequest and SyncReply, a peer on another version never
+ * gets synchronized with.  Bump it whenever anything below changes shape or
+ * meaning.  Builds from before there was one can't sync with this one either,
+ * the header they send is laid out differently.
+ *
+ * 1: original GGPO (never sent).
+ * 2: acks in every header, Bundle, byte wise input codec, quality_reply.hold
+ *    (the other side's hold comes off the rtt, a peer that doesn't send it
+ *    would have its whole frame of polling counted as ping).
+ */
+constexpr uint8_t UDP_PROTOCOL_VERSION = 2;
 
-         virtual ~Sync()
-         {
-             /*
-              * Delete frames manually here rather than in a destructor of the SavedFrame
-              * structure so we can efficently copy frames via weak references.
-              */
+//#pragma pack(push, 1)
 
-             delete[] _input_queues;
-             _input_queues = NULL;
-         }
+struct UdpMsg
+{
+    enum MsgType
+    {
+        Invalid = 0,
+        SyncRequest = 1,
+        SyncReply = 2,
+        Input = 3,
+        QualityReport = 4,
+        QualityReply = 5,
+        KeepAlive = 6,
+        InputAck = 7,
+        Bundle = 8,     /* several of the others in one datagram, see UdpProtocol::PumpSendQueue() */
+    };
 
-         void
-             Init(Sync::Config& config)
-         {
-             _config = config;
-             _framecount = 0;
+    struct connect_status
+    {
+        bool disconnected; //= false; THESE initialized values cause a deleted function error ill change this later i want deafult initialized values for memory safety
+        int last_frame; //= -1;
+    };
 
-             _max_prediction_frames = config.num_prediction_frames;
+    struct
+    {
+        uint16_t         magic;
+        uint16_t         sequence_number;
+        uint8_t          type;            /* packet type */
+        uint16_t         ack_seq;         /* newest sequence number we took in from them */
+        uint32_t         ack_bits;        /* bit n: we took ack_seq - n too.  0 until we've taken anything */
+        int32_t          ack_frame;       /* newest input frame we have from them, on every packet so anything can carry the ack */
+    } hdr;
+    union
+    {
+        struct
+        {
+            uint32_t      random_request;  /* please reply back with this random data */
+            uint16_t      remote_magic;
+            uint8_t       remote_endpoint;
+            uint8_t       protocol_version; /* UDP_PROTOCOL_VERSION */
+        } sync_request;
 
-             CreateQueues(config);
-         }
+        struct
+        {
+            uint32_t      random_reply;    /* OK, here's your random data back */
+            uint8_t       protocol_version;
+        } sync_reply;
 
-         void
-             SetLastConfirmedFrame(int frame)
-         {
-             _last_confirmed_frame = frame;
-             if (_last_confirmed_frame > 0)
-             {
-                 for (int i = 0; i < _config.num_players; i++)
-                 {
-                     _input_queues[i].DiscardConfirmedFrames(frame - 1);
-                 }
-             }
-         }
+        struct
+        {
+            int8_t        frame_advantage; /* what's the other guy's frame advantage? */
+            uint32_t      ping;
+        } quality_report;
 
-         void
-             SetFrameDelay(int queue, int delay)
-         {
-             _input_queues[queue].SetFrameDelay(delay);
-         }
+        struct
+        {
+            uint32_t      pong;
+            uint32_t      hold; /* us the report sat with them before they answered, comes off the rtt (protocol version 2) */
+        } quality_reply;
 
-         bool
-             AddLocalInput(int queue, GameInput& input)
-         {
-             int frames_behind = _framecount - _last_confirmed_frame;
+        struct
+        {
+            connect_status    peer_connect_status[UDP_MSG_MAX_PLAYERS];
 
-             if (_framecount >= _max_prediction_frames && frames_behind >= _max_prediction_frames)
-             {
-                 sync_logger->Info("Rejecting input from emulator: reached prediction barrier.", "sync.cpp");
-                 return false;
-             }
+            uint32_t            start_frame;
 
-             if (_framecount == 0)
-             {
-                 SaveCurrentFrame();
-             }
+            int               disconnect_requested : 1;
 
-             sync_logger->Info(format("Sending undelayed local frame {} to queue {}.", _framecount, queue), "sync.cpp");
+            uint16_t            num_bits;
+            uint16_t            input_size; // XXX: shouldn't be in every single packet!
+            uint8_t             bits[MAX_COMPRESSED_BITS]; /* must be last */
+        } input;
 
-             input.frame = _framecount;
-             _input_queues[queue].AddInput(input);
+    } u;
 
-             return true;
-         }
+public:
+    // not sizeof(hdr), without the pack above the union starts past the header's padding
+    int PacketSize()
+    {
+        return (int)((char*)&u - (char*)this) + PayloadSize();
+    }
 
-         void
-             AddRemoteInput(int queue, GameInput& input)
-         {
-             _input_queues[queue].AddInput(input);
-         }
+    int PayloadSize()
+    {
+        int size;
 
-         int
-             GetConfirmedInputs(void* values, int size, int frame)
-         {
-             int disconnect_flags = 0;
-             char* output = (char*)values;
+        switch (hdr.type)
+        {
+        case SyncRequest:   return sizeof(u.sync_request);
+        case SyncReply:     return sizeof(u.sync_reply);
+        case QualityReport: return sizeof(u.quality_report);
+        case QualityReply:  return sizeof(u.quality_reply);
+        case InputAck:      return 0; /* all in the header now */
+        case KeepAlive:     return 0;
+        case Bundle:        return 0; /* never sent as a UdpMsg, the messages just follow the header */
+        case Input:
+            size = (int)((char*)&u.input.bits - (char*)&u.input);
+            size += (u.input.num_bits + 7) / 8;
+            return size;
+        }
 
-             GGPO_ASSERT(size >= _config.num_players * _config.input_size);
+        GGPO_ASSERT(false); // ??????????
 
-             memset(output, 0, size);
+        return 0;
+    }
 
-             for (int i = 0; i < _config.num_players; i++)
-             {
-                 GameInput input;
-                 if (_local_connect_status[i].disconnected && frame > _local_connect_status[i].last_frame)
-                 {
-                     disconnect_flags |= (1 << i);
-                     input.erase();
-                 }
-                 else
-                 {
-                     _input_queues[i].GetConfirmedInput(frame, &input);
-                 }
-                 memcpy(output + (i * _config.input_size), input.bits, _config.input_size);
-             }
-             return disconnect_flags;
-         }
+    UdpMsg(MsgType t) { hdr.type = (uint8_t)t; }
+};
 
-         int
-             SynchronizeInputs(void* values, int size)
-         {
-             int disconnect_flags = 0;
-             char* output = (char*)values;
+//#pragma pack(pop) 
 
-             GGPO_ASSERT(size >= _config.num_players * _config.input_size);
+namespace GGPO
+{
+    /*
+     * How the input stream is packed into UdpMsg::input.bits, one frame at a time
+     * against the frame before it:
+     *
+     *     for every byte that changed:  1 | byte index | new byte value (8 bits)
+     *     then a single 0 to close out the frame
+     *
+     * GGPO originally did this per bit (1 | on/off | 8 bit button index), which capped
+     * the whole input at 256 bits and paid 10 bits for every bit that flipped.  Going
+     * by bytes the index is only as wide as the input size needs (3 bits for 8 bytes,
+     * 8 bits for 8 players x 32 bytes), and a stick axis that moved costs one entry no
+     * matter how many of its bits changed.  A single button press still costs ~1.5 bytes.
+     */
+    inline int
+        InputCodec_IndexBits(int size)
+    {
+        int bits = 0;
 
-             memset(output, 0, size);
-             for (int i = 0; i < _config.num_players; i++)
-             {
-                 GameInput input;
+        while ((1 << bits) < size)
+        {
+            bits++;
+        }
 
-                 if (_local_connect_status[i].disconnected and _framecount > _local_connect_status[i].last_frame)
-                 {
-                     disconnect_flags |= (1 << i);
-                     input.erase();
-                 }
-                 else
-                 {
-                     _input_queues[i].GetInput(_framecount, &input);
-                 }
-                 memcpy(output + (i * _config.input_size), input.bits, _config.input_size);
-             }
-             return disconnect_flags;
-         }
+        return bits;
+    }
 
-         void
-             IncrementFrame(void)
-         {
-             _framecount++;
-             SaveCurrentFrame();
-         }
+    inline void
+        InputCodec_EncodeFrame(uint8_t* vector, const char* previous, const char* current, int size, int* offset)
+    {
+        const int index_bits = InputCodec_IndexBits(size);
 
-         int
-             GetFrameCount()
-             const
-         {
-             return _framecount;
-         }
+        int i = 0;
 
-         bool
-             GetEvent(Event& e)
-         {
-             if (_event_queue.CurrentSize())
-             {
-                 e = _event_queue.Front();
-                 _event_queue.Pop();
-                 return true;
-             }
+        while (i < size)
+        {
+            // most of a big input sits still frame to frame, hop over unchanged runs
+            if (i + 8 <= size and memcmp(previous + i, current + i, 8) == 0)
+            {
+                i += 8;
+                continue;
+            }
 
-             return false;
-         }
+            if (previous[i] != current[i])
+            {
+                BitVector_SetBit(vector, offset);
+                BitVector_WriteBits(vector, (uint32_t)i, index_bits, offset);
+                BitVector_WriteBits(vector, (uint8_t)current[i], 8, offset);
+            }
 
-     protected:
-         friend SyncTestBackend;
+            i++;
+        }
 
-         struct SavedFrame
-         {
-             string buf;
-             int      frame;
-             int      checksum;
-             SavedFrame() : buf(), frame(-1), checksum(0) { }
-         };
-         struct SavedState
-         {
-             SavedFrame frames[MAX_PREDICTION_FRAMES + 2];
-             int head;
-         };
+        BitVector_ClearBit(vector, offset);
+    }
 
-         void
-             LoadFrame(int frame)
-         {
-             //// find the frame in question
-             //if (frame == _framecount)
-             //{
-             //    sync_logger->Info("Skipping NOP.", "sync.cpp");
-             //    return;
-             //}
+    /*
+     * Applies one frame worth of changes on top of current (pass NULL to just skip
+     * over the frame).  Returns false if the frame runs past num_bits or points
+     * outside the input, the packet is garbage at that point so stop reading it.
+     */
+    inline bool
+        InputCodec_DecodeFrame(uint8_t* vector, int num_bits, char* current, int size, int* offset)
+    {
+        const int index_bits = InputCodec_IndexBits(size);
 
-             //// Move the head pointer back and load it up
-             //_savedstate.head = FindSavedFrameIndex(frame);
-             //SavedFrame* state = _savedstate.frames + _savedstate.head;
+        while (true)
+        {
+            if (*offset >= num_bits)
+            {
+                return false;
+            }
 
-             //sync_logger->Info(format("=== Loading frame info {} (checksum: {}).", state->frame, state->checksum), "sync.cpp");
+            if (not BitVector_ReadBit(vector, offset))
+            {
+                return true;
+            }
 
-             //GGPO_ASSERT(state->buf and state->cbuf);
+            if (*offset + index_bits + 8 > num_bits)
+            {
+                return false;
+            }
 
-             //_callbacks.load_game_state(state->buf);
+            int index = (int)BitVector_ReadBits(vector, index_bits, offset);
+            uint8_t value = (uint8_t)BitVector_ReadBits(vector, 8, offset);
 
-             //// Reset framecount and the head of the state ring-buffer to point in
-             //// advance of the current frame (as if we had just finished executing it).
-             //_framecount = state->frame;
-             //_savedstate.head = (_savedstate.head + 1) % GGPO_ARRAY_SIZE(_savedstate.frames);
-         }
+            if (index >= size)
+            {
+                return false;
+            }
 
-         void
-             SaveCurrentFrame()
-         {
-             ///*
-             // * See StateCompress for the real save feature implemented by FinalBurn.
-             // * Write everything into the head, then advance the head pointer.
-             // */
-             //SavedFrame* state = _savedstate.frames + _savedstate.head;
+            if (current)
+            {
+                current[index] = (char)value;
+            }
+        }
+    }
+}
 
-             //state->frame = _framecount;
-             //_callbacks.save_game_state(state->buf, &state->frame, &state->checksum, state->frame);
+ //==================================================================================== Sync ============================================================================================//
 
-             //sync_logger->Info(format("=== Saved frame info {} (checksum: {}).", state->frame, state->checksum), "sync.cpp");
-             //_savedstate.head = (_savedstate.head + 1) % GGPO_ARRAY_SIZE(_savedstate.frames);
-         }
+namespace GGPO
+{
+    /*
+     * The game side of a replay.  Sync uses one to save, load and resimulate frames
+     * when it rolls back, SyncTestBackend drives one to resimulate the frames it is
+     * checking, and the replay verifier runs one per worker thread at the same time,
+     * so every worker needs its own instance that shares no mutable state with the
+     * others (that's kinda the whole point uwu).
+     *
+     * AdvanceFrame must only step the simulation with the inputs it's given, it must
+     * not call back into the session.
+     */
+    class IReplayGame
+    {
+    public:
+        virtual ~IReplayGame() { }
+        virtual void AdvanceFrame(const char* inputs, int size) = 0;
+        virtual void SaveState(string& buf, int* checksum) = 0;
+        virtual void LoadState(const string& buf) = 0;
+    };
 
-         int
-             FindSavedFrameIndex(int frame)
-         {
-             int i, count = GGPO_ARRAY_SIZE(_savedstate.frames);
+    struct RollbackTelemetrySnapshot
+    {
+        static constexpr int DEPTH_BUCKETS = MAX_PREDICTION_FRAMES + 2; /* last bucket catches anything deeper */
+
+        uint64_t   rollbacks;
+        uint64_t   depth_histogram[DEPTH_BUCKETS];
+        uint64_t   resimulated_frames;
+
+        uint64_t   save_count;
+        uint64_t   save_ticks;
+        uint64_t   load_count;
+        uint64_t   load_ticks;
+        uint64_t   advance_count;  /* resimulated frames only, normal frames are advanced by the game itself */
+        uint64_t   advance_ticks;
+
+        uint64_t   prediction_barrier_rejections;
+        uint64_t   frames_predicted[MAX_PLAYERS];
+        uint64_t   frames_mispredicted[MAX_PLAYERS];
+    };
 
-             for (i = 0; i < count; i++)
-             {
-                 if (_savedstate.frames[i].frame == frame)
-                 {
-                     break;
-                 }
-             }
-             if (i == count)
-             {
-                 GGPO_ASSERT(FALSE);
-             }
+    /*
+     * Rollback cost counters for capacity planning.  Written by the session thread,
+     * read from any thread through GetSnapshot().  Every field is its own relaxed
+     * atomic so a metrics thread never blocks (or gets blocked by) the game.  Each
+     * counter is exact, the snapshot as a whole isn't taken atomically, which is
+     * fine for graphs.
+     *
+     * Counters only ever go up: diff two snapshots to get rates like resimulated
+     * frames per second.
+     *
+     * Timings are in whatever unit the timer hook returns (nanoseconds from a
+     * high resolution clock is the obvious choice).  Without a timer only the
+     * counts are kept.
+     */
+    class RollbackTelemetry
+    {
+    public:
+        using Timer = uint64_t(*)();
 
-             return i;
-         }
+        RollbackTelemetry()
+        {
+            for (int i = 0; i < RollbackTelemetrySnapshot::DEPTH_BUCKETS; i++)
+            {
+                _depth_histogram[i].store(0, memory_order_relaxed);
+            }
 
-         SavedFrame&
-             GetLastSavedFrame()
+            for (int i = 0; i < MAX_PLAYERS; i++)
+            {
+                _frames_predicted[i].store(0, memory_order_relaxed);
+                _frames_mispredicted[i].store(0, memory_order_relaxed);
+            }
+        }
+
+        void
+            SetTimer(Timer timer)
+        {
+            _timer = timer;
+        }
+
+        uint64_t
+            Now()
+            const
+        {
+            return _timer ? _timer() : 0;
+        }
+
+        void
+            OnRollback(int depth)
+        {
+            const int bucket = GGPO_MIN(GGPO_MAX(depth, 0), RollbackTelemetrySnapshot::DEPTH_BUCKETS - 1);
+
+            _rollbacks.fetch_add(1, memory_order_relaxed);
+            _depth_histogram[bucket].fetch_add(1, memory_order_relaxed);
+        }
+
+        void
+            OnResimulatedFrame()
+        {
+            _resimulated_frames.fetch_add(1, memory_order_relaxed);
+        }
+
+        void
+            AddSave(uint64_t ticks)
+        {
+            _save_count.fetch_add(1, memory_order_relaxed);
+            _save_ticks.fetch_add(ticks, memory_order_relaxed);
+        }
+
+        void
+            AddLoad(uint64_t ticks)
+        {
+            _load_count.fetch_add(1, memory_order_relaxed);
+            _load_ticks.fetch_add(ticks, memory_order_relaxed);
+        }
+
+        void
+            AddAdvance(uint64_t ticks)
+        {
+            _advance_count.fetch_add(1, memory_order_relaxed);
+            _advance_ticks.fetch_add(ticks, memory_order_relaxed);
+        }
+
+        void
+            OnPredictionBarrier()
+        {
+            _prediction_barrier_rejections.fetch_add(1, memory_order_relaxed);
+        }
+
+        void
+            SetPredictionStats(int player, const PredictionStats& stats)
+        {
+            if (player < 0 or player >= MAX_PLAYERS)
+            {
+                return;
+            }
+
+            _frames_predicted[player].store((uint64_t)stats.frames_predicted, memory_order_relaxed);
+            _frames_mispredicted[player].store((uint64_t)(stats.frames_predicted - stats.frames_correct), memory_order_relaxed);
+        }
+
+        void
+            GetSnapshot(RollbackTelemetrySnapshot* snapshot)
+            const
+        {
+            snapshot->rollbacks = _rollbacks.load(memory_order_relaxed);
+
+            for (int i = 0; i < RollbackTelemetrySnapshot::DEPTH_BUCKETS; i++)
+            {
+                snapshot->depth_histogram[i] = _depth_histogram[i].load(memory_order_relaxed);
+            }
+
+            snapshot->resimulated_frames = _resimulated_frames.load(memory_order_relaxed);
+            snapshot->save_count = _save_count.load(memory_order_relaxed);
+            snapshot->save_ticks = _save_ticks.load(memory_order_relaxed);
+            snapshot->load_count = _load_count.load(memory_order_relaxed);
+            snapshot->load_ticks = _load_ticks.load(memory_order_relaxed);
+            snapshot->advance_count = _advance_count.load(memory_order_relaxed);
+            snapshot->advance_ticks = _advance_ticks.load(memory_order_relaxed);
+            snapshot->prediction_barrier_rejections = _prediction_barrier_rejections.load(memory_order_relaxed);
+
+            for (int i = 0; i < MAX_PLAYERS; i++)
+            {
+                snapshot->frames_predicted[i] = _frames_predicted[i].load(memory_order_relaxed);
+                snapshot->frames_mispredicted[i] = _frames_mispredicted[i].load(memory_order_relaxed);
+            }
+        }
+
+    protected:
+        Timer               _timer = nullptr;
+
+        atomic<uint64_t>    _rollbacks{ 0 };
+        atomic<uint64_t>    _depth_histogram[RollbackTelemetrySnapshot::DEPTH_BUCKETS];
+        atomic<uint64_t>    _resimulated_frames{ 0 };
+
+        atomic<uint64_t>    _save_count{ 0 };
+        atomic<uint64_t>    _save_ticks{ 0 };
+        atomic<uint64_t>    _load_count{ 0 };
+        atomic<uint64_t>    _load_ticks{ 0 };
+        atomic<uint64_t>    _advance_count{ 0 };
+        atomic<uint64_t>    _advance_ticks{ 0 };
+
+        atomic<uint64_t>    _prediction_barrier_rejections{ 0 };
+        atomic<uint64_t>    _frames_predicted[MAX_PLAYERS];
+        atomic<uint64_t>    _frames_mispredicted[MAX_PLAYERS];
+    };
+
+     class SyncTestBackend;
+
+     class Sync
+     {
+    private:
+        unique_ptr<Logger> sync_logger = nullptr;
+
+     public:
+         /*
+          * input_queue_length of 0 means INPUT_QUEUE_LENGTH, see SessionLimits.
+          */
+         struct Config
          {
-             int i = _savedstate.head - 1;
+             int                     num_prediction_frames;
+             int                     num_players;
+             int                     input_size;
+             int                     input_queue_length;
+         };
+         struct Event
+         {
+             enum
+             {
+                 ConfirmedInput,
+             } type;
+             union
+             {
+                 struct confirmedInput
+                 {
+                     GameInput   input;
+                 };
+             } u;
+         };
 
-             if (i < 0)
+     public:
+         Sync(UdpMsg::connect_status* connect_status) :
+             _local_connect_status(connect_status),
+             _input_queues(NULL)
+         {
+             sync_logger = Logger::CreateUnique("SyncLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+
+             GGPO_ASSERT(sync_logger)
+
+             _framecount = 0;
+             _last_confirmed_frame = -1;
+             _max_prediction_frames = 0;
+             _savedstate.head = 0; // the frames hold strings, so no memset'ing this one
+         }
+
+         virtual ~Sync()
+         {
+             /*
+              * Delete frames manually here rather than in a destructor of the SavedFrame
+              * structure so we can efficently copy frames via weak references.
+              */
+
+             delete[] _input_queues;
+             _input_queues = NULL;
+         }
+
+         void
+             Init(Sync::Config& config)
+         {
+             if (config.input_queue_length <= 0)
              {
-                 i = GGPO_ARRAY_SIZE(_savedstate.frames) - 1;
+                 config.input_queue_length = INPUT_QUEUE_LENGTH;
              }
 
-             return _savedstate.frames[i];
+             GGPO_ASSERT(config.num_prediction_frames > 0 and config.input_queue_length > config.num_prediction_frames);
+
+             _config = config;
+             _framecount = 0;
+
+             _max_prediction_frames = config.num_prediction_frames;
+             _savedstate.frames.assign(config.num_prediction_frames + 2, SavedFrame());
+             _savedstate.head = 0;
+             _resimulated_inputs.assign((size_t)config.num_players * config.input_size, 0);
+
+             CreateQueues(config);
+         }
+
+         /*
+          * The game we save, load and resimulate when rolling back.  Without one the
+          * saved frames stay empty and AdjustSimulation() can't do anything.
+          */
+         void
+             SetGame(IReplayGame* game)
+         {
+             _game = game;
+         }
+
+         void
+             SetTelemetry(RollbackTelemetry* telemetry)
+         {
+             _telemetry = telemetry;
          }
 
          bool
-             CreateQueues(Config& config)
+             InRollback()
+             const
          {
-             delete[] _input_queues;
-             _input_queues = new InputQueue[_config.num_players];
+             return _rollingback;
+         }
 
-             for (int i = 0; i < _config.num_players; i++)
+         void
+             SetLastConfirmedFrame(int frame)
+         {
+             _last_confirmed_frame = frame;
+             if (_last_confirmed_frame > 0)
              {
-                 _input_queues[i].Init(i, _config.input_size);
+                 for (int i = 0; i < _config.num_players; i++)
+                 {
+                     _input_queues[i].DiscardConfirmedFrames(frame - 1);
+                 }
              }
+         }
 
-             return true;
+         void
+             SetFrameDelay(int queue, int delay)
+         {
+             _input_queues[queue].SetFrameDelay(delay);
+             _pending_frame_delay[queue] = delay;
          }
 
+         /*
+          * Same as SetFrameDelay(), but the change only goes through on a local
+          * input that repeats the previous one (see InputQueue::IsRepeatOfLastInput).
+          * Raising the delay still pads the queue, but with copies of what the player
+          * is holding anyway, and lowering it only drops a frame that held nothing new.
+          * Someone who never holds still for a frame would keep it waiting forever,
+          * so after MAX_FRAME_DELAY_WAIT frames it goes through anyway.
+          */
          void
-             ResetPrediction(int frameNumber)
+             RequestFrameDelay(int queue, int delay)
          {
-             for (int i = 0; i < _config.num_players; i++)
+             if (_pending_frame_delay[queue] != delay)
              {
-                 _input_queues[i].ResetPrediction(frameNumber);
+                 _pending_frame_delay_since[queue] = _framecount;
              }
+             _pending_frame_delay[queue] = delay;
          }
 
-     protected:
-         SavedState     _savedstate;
-         Config         _config;
+         int
+             GetFrameDelay(int queue)
+             const
+         {
+             return _input_queues[queue].GetFrameDelay();
+         }
 
-         int            _last_confirmed_frame;
-         int            _framecount;
-         int            _max_prediction_frames;
+         /*
+          * Rollbacks since the last call, for whoever is tuning the frame delay.
+          */
+         void
+             TakeRollbackCounts(int* rollbacks, int* frames, int* deepest)
+         {
+             *rollbacks = _window_rollbacks;
+             *frames = _window_rollback_frames;
+             *deepest = _window_deepest_rollback;
 
-         InputQueue* _input_queues;
+             _window_rollbacks = _window_rollback_frames = _window_deepest_rollback = 0;
+         }
 
-         RingBuffer<Event, 32> _event_queue;
-         UdpMsg::connect_status* _local_connect_status;
-     };
+         void
+             SetPredictor(int queue, IInputPredictor* predictor)
+         {
+             _input_queues[queue].SetPredictor(predictor);
+         }
 
-}
+         const PredictionStats&
+             GetPredictionStats(int queue)
+             const
+         {
+             return _input_queues[queue].GetPredictionStats();
+         }
 
-//==================================================================================== IPollSink ============================================================================================//
+         /*
+          * input.frame comes back as the frame the input landed on after the delay,
+          * NullFrame if a lowered delay dropped it.  When a raised delay padded the
+          * queue, first_frame is the first padding frame, so everything from there
+          * up to input.frame is new and has to go out to the other peers (see
+          * GetLocalInput).  Otherwise it's input.frame too.
+          */
+         bool
+             AddLocalInput(int queue, GameInput& input, int* first_frame = nullptr)
+         {
+             int frames_behind = _framecount - _last_confirmed_frame;
 
-#if defined(_WIN32) || defined(_WIN64) //idfk
-    #define GGPO_HANDLE HANDLE
- #else
-    #define GGPO_HANDLE uint32_t
- #endif
+             if (_framecount >= _max_prediction_frames && frames_behind >= _max_prediction_frames)
+             {
+                 sync_logger->Info("Rejecting input from emulator: reached prediction barrier.", "sync.cpp");
 
- namespace GGPO
- {
-     constexpr int MAX_POLLABLE_HANDLES = 64;
- 
-      class IPollSink 
-      {
-      public:
-          virtual ~IPollSink() { }
-          virtual bool OnHandlePoll(void*) { return true; }
-          virtual bool OnMsgPoll(void*) { return true; }
-          virtual bool OnPeriodicPoll(void*, int) { return true; }
-          virtual bool OnLoopPoll(void*) { return true; }
-      };
- 
-      class Poll 
-      {
-      public:
+                 if (_telemetry)
+                 {
+                     _telemetry->OnPredictionBarrier();
+                 }
+                 return false;
+             }
 
-        Poll(void) :
-            _handle_count(0),
-            _start_time(0)
-        {
-            /*
-            * Create a dummy handle to simplify things.
-            */
-            //MSVC GARBO NEED A UNIX REPLACEMENT IF EVEN REQUIRED
-            #if defined(_WIN32) || defined(_WIN64)
-                _handles[_handle_count++] = CreateEvent(NULL, true, false, NULL);
-            #else
+             if (_framecount == 0)
+             {
+                 SaveCurrentFrame();
+             }
 
-            #endif
-        }
+             if (_pending_frame_delay[queue] != _input_queues[queue].GetFrameDelay())
+             {
+                 if (_input_queues[queue].IsRepeatOfLastInput(input))
+                 {
+                     sync_logger->Info(format("Changing frame delay of queue {} from {} to {} at frame {}.", queue, _input_queues[queue].GetFrameDelay(), _pending_frame_delay[queue], _framecount), "sync.cpp");
+                     _input_queues[queue].SetFrameDelay(_pending_frame_delay[queue]);
+                 }
+                 else if (_framecount - _pending_frame_delay_since[queue] >= MAX_FRAME_DELAY_WAIT)
+                 {
+                     sync_logger->Warning(format("Forcing frame delay of queue {} from {} to {} at frame {}, no repeated input for {} frames.", queue, _input_queues[queue].GetFrameDelay(), _pending_frame_delay[queue], _framecount, _framecount - _pending_frame_delay_since[queue]), "sync.cpp");
+                     _input_queues[queue].SetFrameDelay(_pending_frame_delay[queue]);
+                 }
+             }
 
-          void
-              RegisterHandle
-              (
-                  IPollSink* sink,
-                  HANDLE h,
-                  void* cookie = NULL
-              )
-          {
-              GGPO_ASSERT(_handle_count < MAX_POLLABLE_HANDLES - 1);
+             sync_logger->Info(format("Sending undelayed local frame {} to queue {}.", _framecount, queue), "sync.cpp");
 
-              _handles[_handle_count] = h;
-              _handle_sinks[_handle_count] = PollSinkCb(sink, cookie);
-              _handle_count++;
-          }
+             const int last_added = _input_queues[queue].GetLastConfirmedFrame();
 
-          void 
-              RegisterMsgLoop
-              (
-                  IPollSink* sink, 
-                  void* cookie = NULL
-              ) 
-          {
-              _msg_sinks.PushBack(PollSinkCb(sink, cookie));
-          }
-          void 
-              RegisterPeriodic
-              (
-                  IPollSink* sink, 
-                  int interval, 
-                  void* cookie = NULL
-              ) 
-          {
-              _periodic_sinks.PushBack(PollPeriodicSinkCb(sink, cookie, interval));
-          }
+             input.frame = _framecount;
+             _input_queues[queue].AddInput(input);
 
-          void
-              RegisterLoop
-              (
-                  IPollSink* sink, 
-                  void* cookie = NULL
-              ) 
-          {
-              _loop_sinks.PushBack(PollSinkCb(sink, cookie));
-          }
- 
-          void
-              Run()
-          {
-              while (Pump(100))
-              {
-                  continue; //? y continue lmfao i mean i get it but like ok ig
-              }
-          }
+             if (first_frame)
+             {
+                 *first_frame = input.frame == GameInput::NullFrame ? GameInput::NullFrame : last_added + 1;
+             }
 
-          bool
-              Pump(int timeout)
-          {
-              int i, res;
-              bool finished = false;
+             return true;
+         }
 
-              if (_start_time == 0)
-              {
-                  _start_time = Platform::GetMonotonicTimeMS();
-              }
+         // a local frame AddLocalInput() already queued, padding included
+         bool
+             GetLocalInput(int queue, int frame, GameInput* input)
+             const
+         {
+             return _input_queues[queue].GetConfirmedInput(frame, input);
+         }
 
-              int elapsed = Platform::GetMonotonicTimeMS() - _start_time;
-              int maxwait = ComputeWaitTime(elapsed);
+         void
+             AddRemoteInput(int queue, GameInput& input)
+         {
+             _input_queues[queue].AddInput(input);
+         }
 
-              if (maxwait != INFINITE)
-              {
-                  timeout = GGPO_MIN(timeout, maxwait);
-              }
+         template <int Players = 0, int InputBytes = 0>
+         int
+             GetConfirmedInputs(void* values, int size, int frame)
+         {
+             GGPO_ASSERT(Players == 0 or Players == _config.num_players);
+             GGPO_ASSERT(InputBytes == 0 or InputBytes == _config.input_size);
 
-              res = WaitForMultipleObjects(_handle_count, _handles, false, timeout);
+             const int num_players = Players ? Players : _config.num_players;
+             const int input_size = InputBytes ? InputBytes : _config.input_size;
 
-              if (res >= WAIT_OBJECT_0 && res < WAIT_OBJECT_0 + _handle_count)
-              {
-                  i = res - WAIT_OBJECT_0;
-                  finished = not _handle_sinks[i].sink->OnHandlePoll(_handle_sinks[i].cookie) or finished;
-              }
+             int disconnect_flags = 0;
+             char* output = (char*)values;
 
-              for (i = 0; i < _msg_sinks.CurrentSize(); i++)
-              {
-                  PollSinkCb& cb = _msg_sinks[i];
-                  finished = not cb.sink->OnMsgPoll(cb.cookie) or finished;
-              }
+             GGPO_ASSERT(size >= num_players * input_size);
 
-              for (i = 0; i < _periodic_sinks.CurrentSize(); i++)
-              {
-                  PollPeriodicSinkCb& cb = _periodic_sinks[i];
+             memset(output, 0, size);
 
-                  if (cb.interval + cb.last_fired <= elapsed)
-                  {
-                      cb.last_fired = (elapsed / cb.interval) * cb.interval;
-                      finished = not cb.sink->OnPeriodicPoll(cb.cookie, cb.last_fired) or finished;
-                  }
-              }
+             for (int i = 0; i < num_players; i++)
+             {
+                 if (_local_connect_status[i].disconnected && frame > _local_connect_status[i].last_frame)
+                 {
+                     disconnect_flags |= (1 << i);
+                 }
+                 else
+                 {
+                     _input_queues[i].GetInputs(frame, 1, output + (i * input_size), input_size);
+                 }
+             }
+             return disconnect_flags;
+         }
 
-              for (i = 0; i < _loop_sinks.CurrentSize(); i++)
-              {
-                  PollSinkCb& cb = _loop_sinks[i];
-                  finished = not cb.sink->OnLoopPoll(cb.cookie) or finished;
-              }
+         /*
+          * Players/InputBytes let a caller that knows the session shape at compile
+          * time (FixedSession) get this loop unrolled and every copy fixed size.
+          * Leave them 0 for the runtime sizes from the config.
+          */
+         template <int Players = 0, int InputBytes = 0>
+         int
+             SynchronizeInputs(void* values, int size)
+         {
+             GGPO_ASSERT(Players == 0 or Players == _config.num_players);
+             GGPO_ASSERT(InputBytes == 0 or InputBytes == _config.input_size);
 
-              return finished;
-          }
- 
-        protected:
-            int
-                ComputeWaitTime(int elapsed)
-          {
-              int waitTime = INFINITE;
-              size_t count = _periodic_sinks.CurrentSize();
+             const int num_players = Players ? Players : _config.num_players;
+             const int input_size = InputBytes ? InputBytes : _config.input_size;
 
-              if (count > 0)
-              {
-                  for (int i = 0; i < count; i++)
-                  {
-                      PollPeriodicSinkCb& cb = _periodic_sinks[i];
-                      int timeout = (cb.interval + cb.last_fired) - elapsed;
+             int disconnect_flags = 0;
+             char* output = (char*)values;
 
-                      if (waitTime == INFINITE or (timeout < waitTime))
-                      {
-                          waitTime = GGPO_MAX(timeout, 0);
-                      }
-                  }
-              }
-              return waitTime;
-          }
- 
-          struct PollSinkCb 
-          {
-              IPollSink* sink;
-              void* cookie;
-              PollSinkCb() : sink(NULL), cookie(NULL) { }
-              PollSinkCb(IPollSink* s, void* c) : sink(s), cookie(c) { }
-          };
- 
-          struct PollPeriodicSinkCb : public PollSinkCb 
-          {
-              int         interval;
-              int         last_fired;
-              PollPeriodicSinkCb() : PollSinkCb(NULL, NULL), interval(0), last_fired(0) { }
-              PollPeriodicSinkCb(IPollSink* s, void* c, int i) :
-                  PollSinkCb(s, c), interval(i), last_fired(0) { }
-          };
- 
-          int               _start_time;
-          int               _handle_count;
-          HANDLE            _handles[MAX_POLLABLE_HANDLES];
-          PollSinkCb        _handle_sinks[MAX_POLLABLE_HANDLES];
- 
-          FixedPushBuffer<PollSinkCb, 16>          _msg_sinks;
-          FixedPushBuffer<PollSinkCb, 16>          _loop_sinks;
-          FixedPushBuffer<PollPeriodicSinkCb, 16>  _periodic_sinks;
-      };
- }
+             const int used = num_players * input_size;
 
- //==================================================================================== Udp ============================================================================================//
+             GGPO_ASSERT(size >= used);
 
-namespace GGPO
-{
-     class Udp
-     {
-     public:
-         struct Stats
-         {
-             int      bytes_sent;
-             int      packets_sent;
-             float    kbps_sent;
-         };
+             // each queue writes its player's bytes straight into place, only the slack gets cleared
+             if (size > used)
+             {
+                 memset(output + used, 0, size - used);
+             }
+
+             for (int i = 0; i < num_players; i++)
+             {
+                 char* player_input = output + (i * input_size);
+
+                 if (_local_connect_status[i].disconnected and _framecount > _local_connect_status[i].last_frame)
+                 {
+                     disconnect_flags |= (1 << i);
+                     memset(player_input, 0, input_size);
+                 }
+                 else
+                 {
+                     _input_queues[i].GetInput<InputBytes>(_framecount, player_input);
+                 }
+             }
+             return disconnect_flags;
+         }
 
-         struct Callbacks
+         void
+             IncrementFrame(void)
          {
-             virtual ~Callbacks() { }
-             virtual void OnMsg(sockaddr_in& from, UdpMsg* msg, int len) = 0;
-         };
+             _framecount++;
+             SaveCurrentFrame();
 
-     public:
-         Udp()
+             if (_telemetry and not _rollingback)
+             {
+                 for (int i = 0; i < _config.num_players; i++)
+                 {
+                     _telemetry->SetPredictionStats(i, _input_queues[i].GetPredictionStats());
+                 }
+             }
+         }
+
+         void
+             CheckSimulation()
          {
-             udp_logger = Logger::CreateUnique("UDPLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
-            GGPO_ASSERT(udp_logger) 
+             int seek_to;
+
+             if (not CheckSimulationConsistency(&seek_to))
+             {
+                 AdjustSimulation(seek_to);
+             }
          }
 
          void
-             Init(uint16_t port, Poll* poll, Callbacks* callbacks)
+             AdjustSimulation(int seek_to)
          {
-             _callbacks = callbacks;
+             if (not _game)
+             {
+                 sync_logger->Error(format("Can't roll back to frame {}, no game was set.", seek_to), "sync.cpp");
+                 return;
+             }
 
-             _poll = poll;
-             _poll->RegisterLoop(this);
+             int framecount = _framecount;
+             int count = _framecount - seek_to;
 
-             udp_logger->Info(format("binding udp socket to port {}.", port), "udp.cpp");
-             _socket = CreateSocket(port, 0, udp_logger.get());
+             sync_logger->Info(format("Catching up, rolling back {} frames.", count), "sync.cpp");
+
+             if (_telemetry)
+             {
+                 _telemetry->OnRollback(count);
+             }
+
+             _window_rollbacks++;
+             _window_rollback_frames += count;
+             _window_deepest_rollback = GGPO_MAX(_window_deepest_rollback, count);
+
+             _rollingback = true;
+
+             /*
+              * Flush our input queue and load the last frame.
+              */
+             LoadFrame(seek_to);
+             GGPO_ASSERT(_framecount == seek_to);
+
+             /*
+              * Advance frame by frame (stuffing notifications back to
+              * the master).
+              */
+             ResetPrediction(_framecount);
+
+             for (int i = 0; i < count; i++)
+             {
+                 ResimulateFrame();
+             }
+
+             GGPO_ASSERT(_framecount == framecount);
+
+             _rollingback = false;
+
+             sync_logger->Info("---", "sync.cpp");
          }
 
-         void
-             SendTo
-             (
-                 char* buffer, 
-                 int len, 
-                 int flags, 
-                 struct sockaddr* dst,
-                 int destlen
-             )
+         int
+             GetFrameCount()
+             const
+         {
+             return _framecount;
+         }
+
+         bool
+             GetEvent(Event& e)
+         {
+             if (_event_queue.CurrentSize())
+             {
+                 e = _event_queue.Front();
+                 _event_queue.Pop();
+                 return true;
+             }
+
+             return false;
+         }
+
+     protected:
+         friend SyncTestBackend;
+         friend struct Session;
+
+         struct SavedFrame
          {
-             struct sockaddr_in* to = (struct sockaddr_in*)dst;
+             string buf;
+             int      frame;
+             int      checksum;
+             SavedFrame() : buf(), frame(-1), checksum(0) { }
+         };
+         struct SavedState
+         {
+             vector<SavedFrame> frames; /* num_prediction_frames + 2, sized once in Init() */
+             int head;
+         };
+
+         void
+             LoadFrame(int frame)
+         {
+             // find the frame in question
+             if (frame == _framecount)
+             {
+                 sync_logger->Info("Skipping NOP.", "sync.cpp");
+                 return;
+             }
+
+             // Move the head pointer back and load it up
+             _savedstate.head = FindSavedFrameIndex(frame);
+             SavedFrame* state = &_savedstate.frames[_savedstate.head];
+
+             sync_logger->Info(format("=== Loading frame info {} (checksum: {}).", state->frame, state->checksum), "sync.cpp");
+
+             if (_game)
+             {
+                 const uint64_t start = _telemetry ? _telemetry->Now() : 0;
+
+                 _game->LoadState(state->buf);
+
+                 if (_telemetry)
+                 {
+                     _telemetry->AddLoad(_telemetry->Now() - start);
+                 }
+             }
+
+             // Reset framecount and the head of the state ring-buffer to point in
+             // advance of the current frame (as if we had just finished executing it).
+             _framecount = state->frame;
+             _savedstate.head = (_savedstate.head + 1) % (int)_savedstate.frames.size();
+         }
+
+         void
+             SaveCurrentFrame()
+         {
+             /*
+              * Write everything into the head, then advance the head pointer.
+              */
+             SavedFrame* state = &_savedstate.frames[_savedstate.head];
+
+             state->frame = _framecount;
+
+             if (_game)
+             {
+                 const uint64_t start = _telemetry ? _telemetry->Now() : 0;
+
+                 _game->SaveState(state->buf, &state->checksum);
+
+                 if (_telemetry)
+                 {
+                     _telemetry->AddSave(_telemetry->Now() - start);
+                 }
+             }
+
+             sync_logger->Info(format("=== Saved frame info {} (checksum: {}).", state->frame, state->checksum), "sync.cpp");
+             _savedstate.head = (_savedstate.head + 1) % (int)_savedstate.frames.size();
+         }
+
+         /*
+          * What the game's advance_frame callback used to do during a rollback:
+          * grab the (now corrected) inputs for the frame, run it and save it.
+          */
+         void
+             ResimulateFrame()
+         {
+             SynchronizeInputs(_resimulated_inputs.data(), (int)_resimulated_inputs.size());
+
+             const uint64_t start = _telemetry ? _telemetry->Now() : 0;
+
+             _game->AdvanceFrame(_resimulated_inputs.data(), (int)_resimulated_inputs.size());
+
+             if (_telemetry)
+             {
+                 _telemetry->AddAdvance(_telemetry->Now() - start);
+                 _telemetry->OnResimulatedFrame();
+             }
+
+             IncrementFrame();
+         }
+
+         bool
+             CheckSimulationConsistency(int* seekTo)
+         {
+             int first_incorrect = GameInput::NullFrame;
+
+             for (int i = 0; i < _config.num_players; i++)
+             {
+                 int incorrect = _input_queues[i].GetFirstIncorrectFrame();
+
+                 if (incorrect != GameInput::NullFrame and (first_incorrect == GameInput::NullFrame or incorrect < first_incorrect))
+                 {
+                     first_incorrect = incorrect;
+                 }
+             }
+
+             if (first_incorrect == GameInput::NullFrame)
+             {
+                 sync_logger->Info("prediction ok.  proceeding.", "sync.cpp");
+                 return true;
+             }
+
+             *seekTo = first_incorrect;
+             return false;
+         }
+
+         int
+             FindSavedFrameIndex(int frame)
+         {
+             int i, count = (int)_savedstate.frames.size();
+
+             for (i = 0; i < count; i++)
+             {
+                 if (_savedstate.frames[i].frame == frame)
+                 {
+                     break;
+                 }
+             }
+             if (i == count)
+             {
+                 GGPO_ASSERT(false);
+             }
+
+             return i;
+         }
+
+         SavedFrame&
+             GetLastSavedFrame()
+         {
+             int i = _savedstate.head - 1;
+
+             if (i < 0)
+             {
+                 i = (int)_savedstate.frames.size() - 1;
+             }
+
+             return _savedstate.frames[i];
+         }
+
+         bool
+             CreateQueues(Config& config)
+         {
+             delete[] _input_queues;
+             _input_queues = new InputQueue[_config.num_players];
+
+             for (int i = 0; i < _config.num_players; i++)
+             {
+                 _input_queues[i].Init(i, _config.input_size, _config.input_queue_length);
+             }
+
+             return true;
+         }
+
+         void
+             ResetPrediction(int frameNumber)
+         {
+             for (int i = 0; i < _config.num_players; i++)
+             {
+                 _input_queues[i].ResetPrediction(frameNumber);
+             }
+         }
+
+     protected:
+         SavedState     _savedstate;
+         Config         _config;
+
+         int            _last_confirmed_frame;
+         int            _framecount;
+         int            _max_prediction_frames;
+
+         InputQueue* _input_queues;
+
+         RingBuffer<Event, 32> _event_queue;
+         UdpMsg::connect_status* _local_connect_status;
+
+         IReplayGame*          _game = nullptr;
+         RollbackTelemetry*    _telemetry = nullptr;
+         bool                  _rollingback = false;
+         vector<char>          _resimulated_inputs;
+
+         array<int, MAX_PLAYERS> _pending_frame_delay = {};
+         array<int, MAX_PLAYERS> _pending_frame_delay_since = {};
+         int                   _window_rollbacks = 0;
+         int                   _window_rollback_frames = 0;
+         int                   _window_deepest_rollback = 0;
+     };
+
+}
+
+//==================================================================================== IPollSink ============================================================================================//
+
+#if defined(_WIN32) || defined(_WIN64) //idfk
+    #define GGPO_HANDLE HANDLE
+ #else
+    #include <poll.h>
+
+    #define GGPO_HANDLE int // a file descriptor, anything poll() takes
+ #endif
+
+ namespace GGPO
+ {
+     constexpr int MAX_POLLABLE_HANDLES = 64;
+     constexpr int POLL_WAIT_FOREVER = -1;       /* INFINITE to WaitForMultipleObjects, a negative timeout to poll() */
+ 
+      class IPollSink 
+      {
+      public:
+          virtual ~IPollSink() { }
+          virtual bool OnHandlePoll(void*) { return true; }
+          virtual bool OnMsgPoll(void*) { return true; }
+          virtual bool OnPeriodicPoll(void*, int) { return true; }
+          virtual bool OnLoopPoll(void*) { return true; }
+      };
+ 
+      class Poll 
+      {
+      public:
+
+        Poll(void) :
+            _handle_count(0),
+            _start_time(0)
+        {
+            /*
+            * Create a dummy handle to simplify things.
+            */
+            #if defined(_WIN32) || defined(_WIN64)
+                _handles[_handle_count++] = CreateEvent(NULL, true, false, NULL);
+            #endif
+        }
+
+          void
+              RegisterHandle
+              (
+                  IPollSink* sink,
+                  GGPO_HANDLE h,
+                  void* cookie = NULL
+              )
+          {
+              GGPO_ASSERT(_handle_count < MAX_POLLABLE_HANDLES - 1);
+
+              _handles[_handle_count] = h;
+              _handle_sinks[_handle_count] = PollSinkCb(sink, cookie);
+              _handle_count++;
+          }
+
+          void 
+              RegisterMsgLoop
+              (
+                  IPollSink* sink, 
+                  void* cookie = NULL
+              ) 
+          {
+              _msg_sinks.PushBack(PollSinkCb(sink, cookie));
+          }
+          void 
+              RegisterPeriodic
+              (
+                  IPollSink* sink, 
+                  int interval, 
+                  void* cookie = NULL
+              ) 
+          {
+              _periodic_sinks.PushBack(PollPeriodicSinkCb(sink, cookie, interval));
+          }
+
+          void
+              RegisterLoop
+              (
+                  IPollSink* sink, 
+                  void* cookie = NULL
+              ) 
+          {
+              _loop_sinks.PushBack(PollSinkCb(sink, cookie));
+          }
+ 
+          void
+              Run()
+          {
+              while (Pump(100))
+              {
+                  continue; //? y continue lmfao i mean i get it but like ok ig
+              }
+          }
+
+          bool
+              Pump(int timeout)
+          {
+              int i, res;
+              bool finished = false;
+
+              if (_start_time == 0)
+              {
+                  _start_time = Platform::GetMonotonicTimeMS();
+              }
+
+              int elapsed = Platform::GetMonotonicTimeMS() - _start_time;
+              int maxwait = ComputeWaitTime(elapsed);
+
+              if (maxwait != POLL_WAIT_FOREVER)
+              {
+                  timeout = GGPO_MIN(timeout, maxwait);
+              }
+
+          #if defined(_WIN32) || defined(_WIN64)
+              res = WaitForMultipleObjects(_handle_count, _handles, false, timeout);
+
+              if (res >= WAIT_OBJECT_0 && res < WAIT_OBJECT_0 + _handle_count)
+              {
+                  i = res - WAIT_OBJECT_0;
+                  finished = not _handle_sinks[i].sink->OnHandlePoll(_handle_sinks[i].cookie) or finished;
+              }
+          #else
+              // no dummy handle here, poll() with nothing to watch still sleeps out the timeout
+              pollfd fds[MAX_POLLABLE_HANDLES];
+
+              for (i = 0; i < _handle_count; i++)
+              {
+                  fds[i] = { _handles[i], POLLIN, 0 };
+              }
+
+              res = ::poll(fds, (nfds_t)_handle_count, timeout);
+
+              for (i = 0; res > 0 and i < _handle_count; i++)
+              {
+                  if (fds[i].revents)
+                  {
+                      finished = not _handle_sinks[i].sink->OnHandlePoll(_handle_sinks[i].cookie) or finished;
+                      break; // one per pump, like WaitForMultipleObjects
+                  }
+              }
+          #endif
+
+              for (i = 0; i < _msg_sinks.CurrentSize(); i++)
+              {
+                  PollSinkCb& cb = _msg_sinks[i];
+                  finished = not cb.sink->OnMsgPoll(cb.cookie) or finished;
+              }
+
+              for (i = 0; i < _periodic_sinks.CurrentSize(); i++)
+              {
+                  PollPeriodicSinkCb& cb = _periodic_sinks[i];
+
+                  if (cb.interval + cb.last_fired <= elapsed)
+                  {
+                      cb.last_fired = (elapsed / cb.interval) * cb.interval;
+                      finished = not cb.sink->OnPeriodicPoll(cb.cookie, cb.last_fired) or finished;
+                  }
+              }
+
+              for (i = 0; i < _loop_sinks.CurrentSize(); i++)
+              {
+                  PollSinkCb& cb = _loop_sinks[i];
+                  finished = not cb.sink->OnLoopPoll(cb.cookie) or finished;
+              }
+
+              return finished;
+          }
+ 
+        protected:
+            int
+                ComputeWaitTime(int elapsed)
+          {
+              int waitTime = POLL_WAIT_FOREVER;
+              size_t count = _periodic_sinks.CurrentSize();
+
+              if (count > 0)
+              {
+                  for (int i = 0; i < count; i++)
+                  {
+                      PollPeriodicSinkCb& cb = _periodic_sinks[i];
+                      int timeout = (cb.interval + cb.last_fired) - elapsed;
+
+                      if (waitTime == POLL_WAIT_FOREVER or (timeout < waitTime))
+                      {
+                          waitTime = GGPO_MAX(timeout, 0);
+                      }
+                  }
+              }
+              return waitTime;
+          }
+ 
+          struct PollSinkCb 
+          {
+              IPollSink* sink;
+              void* cookie;
+              PollSinkCb() : sink(NULL), cookie(NULL) { }
+              PollSinkCb(IPollSink* s, void* c) : sink(s), cookie(c) { }
+          };
+ 
+          struct PollPeriodicSinkCb : public PollSinkCb 
+          {
+              int         interval;
+              int         last_fired;
+              PollPeriodicSinkCb() : PollSinkCb(NULL, NULL), interval(0), last_fired(0) { }
+              PollPeriodicSinkCb(IPollSink* s, void* c, int i) :
+                  PollSinkCb(s, c), interval(i), last_fired(0) { }
+          };
+ 
+          int               _start_time;
+          int               _handle_count;
+          GGPO_HANDLE       _handles[MAX_POLLABLE_HANDLES];
+          PollSinkCb        _handle_sinks[MAX_POLLABLE_HANDLES];
+ 
+          FixedPushBuffer<PollSinkCb, 16>          _msg_sinks;
+          FixedPushBuffer<PollSinkCb, 16>          _loop_sinks;
+          FixedPushBuffer<PollPeriodicSinkCb, 16>  _periodic_sinks;
+      };
+ }
+
+ //==================================================================================== Transport ============================================================================================//
+
+namespace GGPO
+{
+    // UringUdp is Udp on io_uring, still experimental (plain Udp with GSO/GRO is faster for now).  Plain Udp anywhere that doesn't have it
+    enum class TransportType : uint8_t
+    {
+        Udp = 0,
+        Tcp = 1,
+        UringUdp = 2
+    };
+
+    /*
+     * Who a transport is talking to.  What's behind it is up to the transport (an
+     * index into the address table for the built in ones, a relay session or an
+     * engine connection handle for yours), 0 is never a peer.
+     */
+    typedef uint32_t PeerId;
+
+    constexpr PeerId INVALID_PEER_ID = 0;
+
+    constexpr int TRANSPORT_BATCH_SIZE = 32;
+
+    /*
+     * One message to or from a peer, the bytes belong to whoever handed it over.
+     * age_ns is for received messages: how long ago it actually arrived, if the
+     * transport knows (kernel timestamps, a network thread that stamped it).  The
+     * session backdates its receive time by it so RTT and timeouts go off when the
+     * packet came in rather than when DoPoll got around to it.  0 means just now.
+     * answered means the transport already replied to the QualityReports and
+     * SyncRequests in it (see ThreadedTransport), the session doesn't again.
+     */
+    struct TransportPacket
+    {
+        PeerId              peer = INVALID_PEER_ID;
+        const uint8_t*      data = nullptr;
+        int                 length = 0;
+        uint64_t            age_ns = 0;
+        bool                answered = false;
+    };
+
+    /*
+     * Everything a session needs from the network.  Udp is the default, Tcp is for
+     * players whose network drops udp on the floor and MemoryTransport is a fake
+     * network for tests.  Implement it yourself to run GGPO through your engine's
+     * own sockets or relay, the session only ever calls it from DoPoll() and
+     * AddLocalInput() on whatever thread you call those from.
+     *
+     * Resolve: turn the ip/port a remote player or spectator was added with into
+     *       a PeerId.  What ip means is up to you, the built in transports want a
+     *       numeric address.  Ids have to stay the same for the whole session.
+     *
+     * Send: count messages, to any mix of peers.  The bytes are only good for the
+     *       duration of the call so send them or copy them.  Holding on to them
+     *       until Flush() is fine, the session flushes once at the end of every
+     *       DoPoll() and AddLocalInput().
+     *
+     * Receive: fill in up to max messages and return how many.  The bytes have to
+     *       stay put until the next Receive(), the session reads them in place.
+     *       Messages from anyone Resolve() didn't hand out an id for can be dropped.
+     *       Gets called again as long as it comes back with a full batch.  Fill in
+     *       age_ns if you know when they arrived.
+     *
+     * A reliable transport delivers everything, in order, for as long as the same
+     * stream (StreamId) is up.  UdpProtocol uses that to stop resending inputs it
+     * already sent, if the stream id changes it starts over from the last ack since
+     * whatever was in flight on the old stream is gone.
+     */
+    class Transport
+    {
+    public:
+        virtual ~Transport() { }
+
+        virtual bool
+            Resolve(const char* ip, uint16_t port, PeerId* peer) = 0;
+
+        virtual void
+            Send(const TransportPacket* packets, int count) = 0;
+
+        virtual int
+            Receive(TransportPacket* packets, int max) = 0;
+
+        virtual void
+            Flush()
+        {
+        }
+
+        virtual bool
+            IsReliable()
+            const
+        {
+            return false;
+        }
+
+        // 0 when there's no stream to the peer (or the transport doesn't have streams)
+        virtual uint32_t
+            StreamId(PeerId)
+            const
+        {
+            return 0;
+        }
+
+        /*
+         * What a network thread can sleep on with poll() until there's something
+         * to Receive(), see ThreadedTransport.  Fill in up to max and return how
+         * many, 0 and it naps on a timer instead.  Not used on windows.
+         */
+        virtual int
+            PollHandles(GGPO_HANDLE*, int)
+            const
+        {
+            return 0;
+        }
+    };
+
+    // PeerId <-> PeerAddress for the socket transports, ids are just index + 1
+    class PeerTable
+    {
+    public:
+        PeerId
+            Find(const PeerAddress& addr)
+            const
+        {
+            for (size_t i = 0; i < _addrs.size(); i++)
+            {
+                if (_addrs[i] == addr)
+                {
+                    return (PeerId)(i + 1);
+                }
+            }
+
+            return INVALID_PEER_ID;
+        }
+
+        PeerId
+            Add(const PeerAddress& addr)
+        {
+            PeerId peer = Find(addr);
+
+            if (peer == INVALID_PEER_ID)
+            {
+                _addrs.push_back(addr);
+                peer = (PeerId)_addrs.size();
+            }
+
+            return peer;
+        }
+
+        const PeerAddress*
+            Get(PeerId peer)
+            const
+        {
+            return (peer != INVALID_PEER_ID and peer <= _addrs.size()) ? &_addrs[peer - 1] : nullptr;
+        }
+
+    protected:
+        vector<PeerAddress> _addrs;
+    };
+}
+
+namespace GGPO
+{
+    /*
+     * Transports hand out plain byte spans and a stream one can't promise where in
+     * its buffer a message starts.  Read it in place when it's aligned for UdpMsg
+     * (always, for udp), otherwise copy it into scratch first.
+     */
+    inline UdpMsg*
+        ReceivedMsg(const TransportPacket& packet, UdpMsg* scratch)
+    {
+        if ((uintptr_t)packet.data % alignof(UdpMsg) == 0)
+        {
+            return (UdpMsg*)packet.data;
+        }
+
+        memcpy((void*)scratch, packet.data, GGPO_MIN(packet.length, (int)sizeof(UdpMsg)));
+        return scratch;
+    }
+}
+
+ //==================================================================================== Udp ============================================================================================//
+
+// kernel arrival timestamps come along with the packet through recvmsg (SO_TIMESTAMPNS on linux, SO_TIMESTAMP on the BSDs/mac)
+#if !(defined(_WIN32) || defined(_WIN64)) && (defined(SO_TIMESTAMPNS) || defined(SO_TIMESTAMP))
+    #define GGPO_KERNEL_RECV_TIMESTAMPS 1
+#endif
+
+// linux can take a run of same sized datagrams in one sendmsg (UDP_SEGMENT) and hand a run back from one recvmsg (UDP_GRO)
+#if defined(__linux__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+    #define GGPO_UDP_OFFLOAD 1
+#endif
+
+namespace GGPO
+{
+    // older than this and the wall clock probably got stepped under us, don't trust the timestamp
+    constexpr uint64_t MAX_RECV_AGE_NS = 1000000000ULL;
+
+    constexpr int UDP_GSO_MAX_SEGMENTS = 64;      // what the kernel takes in one send
+    constexpr int UDP_GSO_MAX_BYTES = 60 * 1024;  // has to fit in one ip datagram before it gets cut up
+    constexpr int UDP_GRO_BUFFER_SIZE = 65536;    // biggest run GRO hands back at once
+
+     class Udp : public Transport
+     {
+     public:
+         struct Stats
+         {
+             int      bytes_sent;
+             int      packets_sent;
+             float    kbps_sent;
+         };
+
+     public:
+         Udp()
+         {
+             udp_logger = Logger::CreateUnique("UDPLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+            GGPO_ASSERT(udp_logger) 
+         }
+
+         // gro off is for subclasses that can't take more than one packet per receive buffer
+         void
+             Init(uint16_t port, bool gro = true)
+         {
+             udp_logger->Info(format("binding udp socket to port {}.", port), "udp.cpp");
+             _socket = CreateSocket(port, 0, udp_logger.get(), &_family);
+
+             #if defined(GGPO_KERNEL_RECV_TIMESTAMPS)
+                 int optval = 1;
+
+                 #if defined(SO_TIMESTAMPNS)
+                     setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPNS, (const char*)&optval, sizeof optval);
+                 #else
+                     setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMP, (const char*)&optval, sizeof optval);
+                 #endif
+             #endif
+
+             // one max size slot per message in a batch, Receive() hands out pointers into it
+             _recv_buf.resize(TRANSPORT_BATCH_SIZE * MAX_UDP_PACKET_SIZE);
+
+             if (gro)
+             {
+                 EnableGro();
+             }
+         }
+
+         // AF_INET6 for a dual stack socket, peer addresses get resolved against this
+         int
+             GetFamily()
+             const
+         {
+             return _family;
+         }
+
+     #if !(defined(_WIN32) || defined(_WIN64))
+         int
+             PollHandles(GGPO_HANDLE* handles, int max)
+             const override
+         {
+             if (_socket == GGPO_INVALID_SOCKET or max < 1)
+             {
+                 return 0;
+             }
+
+             handles[0] = (GGPO_HANDLE)_socket;
+             return 1;
+         }
+     #endif
+
+         bool
+             Resolve(const char* ip, uint16_t port, PeerId* peer) override
+         {
+             PeerAddress addr;
+
+             if (not addr.Resolve(ip, port, _family))
+             {
+                 return false;
+             }
+
+             *peer = _peers.Add(addr);
+             return true;
+         }
+
+         void
+             Send(const TransportPacket* packets, int count) override
+         {
+             for (int i = 0; i < count; i++)
+             {
+                 const PeerAddress* dst = _peers.Get(packets[i].peer);
+
+                 if (not dst)
+                 {
+                     udp_logger->Error(format("no address for peer {}, dropping packet.", packets[i].peer), "udp.cpp");
+                     continue;
+                 }
+
+             #if defined(GGPO_UDP_OFFLOAD)
+                 const int run = SegmentRun(packets + i, count - i);
+
+                 if (run > 1 and SendSegments(packets + i, run, dst))
+                 {
+                     i += run - 1;
+                     continue;
+                 }
+             #endif
+
+                 int res = sendto(_socket, (const char*)packets[i].data, packets[i].length, 0, dst->Get(), dst->length);
+
+                 if (res == GGPO_SOCKET_ERROR)
+                 {
+                     GGPO_NETWORK_ERROR_CODE err = GGPO_GET_LAST_ERROR();
+                     udp_logger->Error(format("unknown error in sendto (erro: {}  wsaerr: {}).", res, err), "udp.cpp");
+                     GGPO_ASSERT(false && "Unknown error in sendto");
+                 }
+
+             #ifdef GGPO_DEBUG
+                 udp_logger->Info(format("sent packet length {} to {} (ret:{}).", packets[i].length, dst->ToString(), res), "udp.cpp");
+             #endif
+             }
+         }
+
+         int
+             Receive(TransportPacket* packets, int max) override
+         {
+             sockaddr_storage recv_addr;
+             socklen_t recv_addr_len;
+             PeerAddress from;
+             uint64_t stamps[TRANSPORT_BATCH_SIZE];
+             size_t used = 0;
+             int count = 0;
+
+             max = GGPO_MIN(max, TRANSPORT_BATCH_SIZE);
+
+             // whatever was left of the last GRO run goes first
+             if (_gro_rest.length > 0)
+             {
+                 memmove(_recv_buf.data(), _recv_buf.data() + _gro_rest.offset, _gro_rest.length);
+
+                 const int length = _gro_rest.length;
+                 count = SplitSegments(packets, stamps, 0, max, 0, length, _gro_rest.segment, _gro_rest.peer, _gro_rest.stamp);
+                 used = AlignUp(length);
+             }
+
+             while (count < max) //tf is this C style shiznit
+             {
+                 const int room = _gro ? UDP_GRO_BUFFER_SIZE : MAX_UDP_PACKET_SIZE;
+
+                 // out of buffer before the batch filled up, the rest waits for the next poll
+                 if (used + room > _recv_buf.size())
+                 {
+                     break;
+                 }
+
+                 uint8_t* recv_buf = _recv_buf.data() + used;
+                 uint64_t stamp = 0;
+                 int segment = 0;
+
+                 int len = ReceiveFrom(recv_buf, room, &recv_addr, &recv_addr_len, &stamp, &segment);
+
+                 // TODO: handle len == 0... indicates a disconnect.
+
+                 if (len == -1)
+                 {
+                     int error = GGPO_GET_LAST_ERROR();
+
+                     if (error != GGPO_SOCKET_ERROR_CODE)
+                     {
+                         udp_logger->Error(format("recvfrom GGPO_GET_LAST_ERROR returned {} ({}).", error, error), "udp.cpp");
+                     }
+
+                     break;
+                 }
+                 else if (len > 0)
+                 {
+                     if (not from.Set((sockaddr*)&recv_addr, recv_addr_len))
+                     {
+                         continue;
+                     }
+
+                     PeerId peer = _peers.Find(from);
+
+                     if (peer == INVALID_PEER_ID)
+                     {
+                         continue; // not anyone we were told about
+                     }
+
+                 #ifdef GGPO_DEBUG
+                     udp_logger->Info(format("recvfrom returned (len:{}  from:{}).", len, from.ToString()), "udp.cpp");
+                 #endif
+
+                     count = SplitSegments(packets, stamps, count, max, used, len, segment > 0 ? segment : len, peer, stamp);
+                     used += AlignUp(len);
+                 }
+             }
+
+             SetAges(packets, stamps, count);
+             return count;
+         }
+
+     public:
+         ~Udp(void)
+         {
+             if (_socket != GGPO_INVALID_SOCKET)
+             {
+                 GGPO_CLOSE_SOCKET(_socket);
+                 _socket = GGPO_INVALID_SOCKET;
+             }
+         }
+
+     protected:
+         /*
+          * recvfrom, plus when the kernel says the packet arrived (CLOCK_REALTIME ns,
+          * that's what the timestamps are in) if the platform hands that out.  stamp
+          * is left alone otherwise.  With GRO on the kernel can hand back a run of
+          * packets from the same sender back to back in buf, segment is how big
+          * each one is (the last can be shorter), 0 when it's just the one.
+          */
+         int
+             ReceiveFrom(uint8_t* buf, int room, sockaddr_storage* addr, socklen_t* addr_len, uint64_t* stamp, int* segment)
+         {
+         #if defined(GGPO_KERNEL_RECV_TIMESTAMPS)
+             alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(int))];
+             iovec iov;
+             msghdr hdr;
+
+             iov.iov_base = buf;
+             iov.iov_len = room;
+
+             memset(&hdr, 0, sizeof hdr);
+             hdr.msg_name = addr;
+             hdr.msg_namelen = sizeof(*addr);
+             hdr.msg_iov = &iov;
+             hdr.msg_iovlen = 1;
+             hdr.msg_control = control;
+             hdr.msg_controllen = sizeof control;
+
+             int len = (int)recvmsg(_socket, &hdr, 0);
+
+             *addr_len = hdr.msg_namelen;
+
+             if (len >= 0)
+             {
+                 ReadArrivalStamp(&hdr, stamp);
+
+                 #if defined(GGPO_UDP_OFFLOAD)
+                     ReadGroSegment(&hdr, segment);
+                 #endif
+             }
+
+             return len;
+         #else
+             *addr_len = sizeof(*addr);
+             return recvfrom(_socket, (char*)buf, room, 0, (struct sockaddr*)addr, addr_len);
+         #endif
+         }
+
+         // one packet per segment of what got received at offset in _recv_buf, what doesn't fit in the batch waits in _gro_rest
+         int
+             SplitSegments(TransportPacket* packets, uint64_t* stamps, int count, int max, size_t offset, int length, int segment, PeerId peer, uint64_t stamp)
+         {
+             _gro_rest.length = 0;
+
+             for (int at = 0; at < length; at += segment)
+             {
+                 if (count == max)
+                 {
+                     _gro_rest.offset = offset + at;
+                     _gro_rest.length = length - at;
+                     _gro_rest.segment = segment;
+                     _gro_rest.peer = peer;
+                     _gro_rest.stamp = stamp;
+                     break;
+                 }
+
+                 packets[count].peer = peer;
+                 packets[count].data = _recv_buf.data() + offset + at;
+                 packets[count].length = GGPO_MIN(segment, length - at);
+                 packets[count].age_ns = 0;
+                 stamps[count++] = stamp;
+             }
+
+             return count;
+         }
+
+         // next packet starts on an 8 byte boundary so ReceivedMsg() can read it in place
+         static size_t
+             AlignUp(int length)
+         {
+             return ((size_t)length + 7) & ~(size_t)7;
+         }
+
+         void
+             EnableGro()
+         {
+         #if defined(GGPO_UDP_OFFLOAD)
+             int optval = 1;
+
+             if (_socket != GGPO_INVALID_SOCKET and setsockopt(_socket, IPPROTO_UDP, UDP_GRO, &optval, sizeof optval) == 0)
+             {
+                 // room for a full run on top of a batch of ordinary packets
+                 _recv_buf.resize(TRANSPORT_BATCH_SIZE * MAX_UDP_PACKET_SIZE + UDP_GRO_BUFFER_SIZE);
+                 _gro = true;
+             }
+         #endif
+         }
+
+     #if defined(GGPO_UDP_OFFLOAD)
+         // how many packets from here on can go out as one GSO send: same peer, all the same size but a shorter last one
+         int
+             SegmentRun(const TransportPacket* packets, int count)
+             const
+         {
+             if (not _gso)
+             {
+                 return 1;
+             }
+
+             const int segment = packets[0].length;
+             int bytes = segment;
+             int run = 1;
+
+             while (run < count and run < UDP_GSO_MAX_SEGMENTS and packets[run].peer == packets[0].peer
+                 and packets[run].length <= segment and bytes + packets[run].length <= UDP_GSO_MAX_BYTES)
+             {
+                 bytes += packets[run].length;
+
+                 if (packets[run++].length < segment)
+                 {
+                     break;
+                 }
+             }
+
+             return run;
+         }
+
+         /*
+          * The whole run in one sendmsg, the kernel cuts it back up into one datagram
+          * per segment.  Comes back false if the kernel or the nic can't do it, the
+          * caller sends them one at a time instead and we don't try again.
+          */
+         bool
+             SendSegments(const TransportPacket* packets, int count, const PeerAddress* dst)
+         {
+             alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+             iovec iov[UDP_GSO_MAX_SEGMENTS];
+             msghdr hdr;
+
+             for (int i = 0; i < count; i++)
+             {
+                 iov[i].iov_base = (void*)packets[i].data;
+                 iov[i].iov_len = packets[i].length;
+             }
+
+             memset(control, 0, sizeof control);
+             memset(&hdr, 0, sizeof hdr);
+             hdr.msg_name = (void*)dst->Get();
+             hdr.msg_namelen = dst->length;
+             hdr.msg_iov = iov;
+             hdr.msg_iovlen = count;
+             hdr.msg_control = control;
+             hdr.msg_controllen = sizeof control;
+
+             const uint16_t segment = (uint16_t)packets[0].length;
+             cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+
+             cmsg->cmsg_level = IPPROTO_UDP;
+             cmsg->cmsg_type = UDP_SEGMENT;
+             cmsg->cmsg_len = CMSG_LEN(sizeof segment);
+             memcpy(CMSG_DATA(cmsg), &segment, sizeof segment);
+
+             if (sendmsg(_socket, &hdr, 0) < 0)
+             {
+                 const int err = errno;
+
+                 if (err == EIO or err == EINVAL or err == ENOPROTOOPT or err == EOPNOTSUPP)
+                 {
+                     udp_logger->Info(format("udp segmentation offload isn't available (errno {}), sending one packet at a time.", err), "udp.cpp");
+                     _gso = false;
+                     return false;
+                 }
+
+                 udp_logger->Error(format("unknown error in sendmsg (errno: {}), dropping {} packets.", err, count), "udp.cpp");
+                 return true;
+             }
+
+         #ifdef GGPO_DEBUG
+             udp_logger->Info(format("sent {} packets of length {} to {} in one send.", count, segment, dst->ToString()), "udp.cpp");
+         #endif
+             return true;
+         }
+
+         static void
+             ReadGroSegment(msghdr* hdr, int* segment)
+         {
+             for (cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg))
+             {
+                 if (cmsg->cmsg_level == IPPROTO_UDP and cmsg->cmsg_type == UDP_GRO)
+                 {
+                     memcpy(segment, CMSG_DATA(cmsg), sizeof(int));
+                 }
+             }
+         }
+     #endif
+
+     #if defined(GGPO_KERNEL_RECV_TIMESTAMPS)
+         // digs the arrival timestamp out of whatever control messages came with a packet
+         static void
+             ReadArrivalStamp(msghdr* hdr, uint64_t* stamp)
+         {
+             for (cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg))
+             {
+                 if (cmsg->cmsg_level != SOL_SOCKET)
+                 {
+                     continue;
+                 }
+
+                 #if defined(SO_TIMESTAMPNS)
+                     if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+                     {
+                         timespec ts;
+                         memcpy(&ts, CMSG_DATA(cmsg), sizeof ts);
+                         *stamp = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+                     }
+                 #else
+                     if (cmsg->cmsg_type == SCM_TIMESTAMP)
+                     {
+                         timeval tv;
+                         memcpy(&tv, CMSG_DATA(cmsg), sizeof tv);
+                         *stamp = (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_usec * 1000ULL;
+                     }
+                 #endif
+             }
+         }
+     #endif
+
+         // kernel arrival stamps to ages, all against one clock read right before the session gets the batch
+         static void
+             SetAges(TransportPacket* packets, const uint64_t* stamps, int count)
+         {
+             if (count == 0)
+             {
+                 return;
+             }
+
+             const uint64_t now = WallClockNS();
+
+             for (int i = 0; i < count; i++)
+             {
+                 if (stamps[i] and stamps[i] <= now and now - stamps[i] < MAX_RECV_AGE_NS)
+                 {
+                     packets[i].age_ns = now - stamps[i];
+                 }
+             }
+         }
+
+         static uint64_t
+             WallClockNS()
+         {
+         #if defined(GGPO_KERNEL_RECV_TIMESTAMPS)
+             timespec ts;
+             clock_gettime(CLOCK_REALTIME, &ts);
+             return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+         #else
+             return 0;
+         #endif
+         }
+
+         // Network transmission information
+         GGPO_SOCKET _socket = GGPO_INVALID_SOCKET;
+         int _family = AF_INET;
+
+         PeerTable _peers;
+         vector<uint8_t> _recv_buf;
+
+         bool _gso = true;   // until a send says otherwise
+         bool _gro = false;
+
+         // tail of a GRO run that didn't fit in the last batch
+         struct
+         {
+             size_t      offset = 0;
+             int         length = 0;
+             int         segment = 0;
+             PeerId      peer = INVALID_PEER_ID;
+             uint64_t    stamp = 0;
+         } _gro_rest;
+
+         unique_ptr<Logger> udp_logger = nullptr;
+
+     };
+}
+
+//==================================================================================== Udp (io_uring) ============================================================================================//
+
+namespace GGPO
+{
+#if defined(GGPO_IO_URING)
+
+    constexpr unsigned URING_SQ_ENTRIES = 256;
+    constexpr unsigned URING_CQ_ENTRIES = 4096;
+    constexpr unsigned URING_RECV_BUFFERS = 256;  // provided buffer ring, has to be a power of 2
+    constexpr unsigned URING_SEND_SLOTS = 128;
+    constexpr uint16_t URING_BUFFER_GROUP = 0;
+    constexpr uint64_t URING_RECV_TAG = ~0ULL;    // user_data of the multishot recv, sends use their slot index
+
+    // each provided buffer gets what multishot recvmsg writes: header, source address, cmsgs, then the payload
+    constexpr unsigned URING_RECV_NAME_SIZE = sizeof(sockaddr_storage);
+    constexpr unsigned URING_RECV_CONTROL_SIZE = 64;
+    constexpr unsigned URING_RECV_BUFFER_SIZE = sizeof(io_uring_recvmsg_out) + URING_RECV_NAME_SIZE + URING_RECV_CONTROL_SIZE + MAX_UDP_PACKET_SIZE;
+
+    static_assert(URING_RECV_BUFFER_SIZE % 8 == 0, "payloads have to stay aligned for ReceivedMsg()");
+
+    /*
+     * Udp on io_uring (linux 6.0+), experimental.  Plain Udp's GSO/GRO path still
+     * moves more packets per cpu, see benchmarks/UdpThroughput.  One multishot
+     * recvmsg stays armed on the socket and the kernel drops packets into a ring of
+     * provided buffers as they arrive, Receive() just reads the completion queue
+     * so it doesn't make a syscall at all.  Sends get
+     * copied into slots and queued up, a run of same sized packets to one peer
+     * sharing a slot as one segmented (GSO) sendmsg, and Flush() submits all of
+     * them with one io_uring_enter.
+     *
+     * Completions get posted to the thread that submitted, which is whoever calls
+     * Receive() and Flush(), so keep those on one thread (ThreadedTransport does).
+     * If the ring can't be set up (old kernel, seccomp, io_uring_disabled) it logs
+     * why and carries on as a plain Udp.  Same thing if the ring comes up but the
+     * kernel turns down the multishot recvmsg (5.19 has the buffer rings but not
+     * that), which only shows up as the first receive completing with an error.
+     */
+    class UringUdp : public Udp
+    {
+    public:
+        ~UringUdp(void)
+        {
+            TearDown();
+        }
+
+        void
+            Init(uint16_t port)
+        {
+            // provided buffers only hold one packet, no GRO runs unless we end up on the plain path
+            Udp::Init(port, false);
+
+            if (_socket != GGPO_INVALID_SOCKET and not SetUp())
+            {
+                udp_logger->Info(format("io_uring isn't available (errno {}), falling back to recvmsg/sendto.", errno), "udp.cpp");
+                TearDown();
+                EnableGro();
+            }
+        }
+
+        bool
+            IsUring()
+            const
+        {
+            return _ring_fd >= 0;
+        }
+
+        void
+            Send(const TransportPacket* packets, int count)
+            override
+        {
+            if (_ring_fd < 0)
+            {
+                Udp::Send(packets, count);
+                return;
+            }
+
+            for (int i = 0; i < count; )
+            {
+                const PeerAddress* dst = _peers.Get(packets[i].peer);
+
+                if (not dst or packets[i].length > MAX_UDP_PACKET_SIZE)
+                {
+                    udp_logger->Error(format("can't send {} bytes to peer {}, dropping packet.", packets[i].length, packets[i].peer), "udp.cpp");
+                    i++;
+                    continue;
+                }
+
+                // a run of same sized packets to one peer is one sendmsg with a UDP_SEGMENT cmsg, like Udp::Send()
+                int run = 1;
+
+            #if defined(GGPO_UDP_OFFLOAD)
+                run = SegmentRun(packets + i, count - i);
+            #endif
+
+                int slot = TakeSendSlot();
+                io_uring_sqe* sqe = (slot >= 0) ? NextSqe() : nullptr;
+
+                if (not sqe)
+                {
+                    if (slot >= 0)
+                    {
+                        _free_send_slots.push_back((uint16_t)slot);
+                    }
+
+                    // ring's backed up, the packets still have to go out
+                    Udp::Send(packets + i, run);
+                    i += run;
+                    continue;
+                }
+
+                SendSlot& s = _send_slots[slot];
+                size_t bytes = 0;
+
+                for (int j = i; j < i + run; j++)
+                {
+                    bytes += packets[j].length;
+                }
+
+                if (s.data.size() < bytes)
+                {
+                    s.data.resize(bytes);
+                }
+
+                bytes = 0;
+
+                for (int j = i; j < i + run; j++)
+                {
+                    memcpy(s.data.data() + bytes, packets[j].data, packets[j].length);
+                    bytes += packets[j].length;
+                }
+
+                memcpy(&s.addr, dst->Get(), dst->length);
+
+                s.iov.iov_base = s.data.data();
+                s.iov.iov_len = bytes;
+                s.segment = (run > 1) ? (uint16_t)packets[i].length : 0;
+
+                memset(&s.hdr, 0, sizeof s.hdr);
+                s.hdr.msg_name = &s.addr;
+                s.hdr.msg_namelen = dst->length;
+                s.hdr.msg_iov = &s.iov;
+                s.hdr.msg_iovlen = 1;
+
+            #if defined(GGPO_UDP_OFFLOAD)
+                if (s.segment)
+                {
+                    memset(s.control, 0, sizeof s.control);
+                    s.hdr.msg_control = s.control;
+                    s.hdr.msg_controllen = sizeof s.control;
+
+                    cmsghdr* cmsg = CMSG_FIRSTHDR(&s.hdr);
+
+                    cmsg->cmsg_level = IPPROTO_UDP;
+                    cmsg->cmsg_type = UDP_SEGMENT;
+                    cmsg->cmsg_len = CMSG_LEN(sizeof s.segment);
+                    memcpy(CMSG_DATA(cmsg), &s.segment, sizeof s.segment);
+                }
+            #endif
+
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = _socket;
+                sqe->addr = (uint64_t)(uintptr_t)&s.hdr;
+                sqe->len = 1;
+                sqe->user_data = (uint64_t)slot;
+
+                i += run;
+            }
+        }
+
+        // the one io_uring_enter a tick's sends cost, then whatever already finished gives its slot back
+        void
+            Flush()
+            override
+        {
+            if (_ring_fd >= 0)
+            {
+                Submit(0);
+                Reap();
+            }
+        }
+
+        // receives finish into the completion queue, the ring's fd polls readable when there's one waiting
+        int
+            PollHandles(GGPO_HANDLE* handles, int max)
+            const override
+        {
+            if (_ring_fd < 0)
+            {
+                return Udp::PollHandles(handles, max);
+            }
+
+            if (max < 1)
+            {
+                return 0;
+            }
+
+            handles[0] = _ring_fd;
+            return 1;
+        }
+
+        int
+            Receive(TransportPacket* packets, int max)
+            override
+        {
+            if (_ring_fd < 0)
+            {
+                return Udp::Receive(packets, max);
+            }
+
+            // what we handed out last time is done with, the kernel can have it back
+            for (uint16_t bid : _handed_out)
+            {
+                GiveBuffer(bid);
+            }
+            _handed_out.clear();
+            PublishBuffers();
+
+            if (not _recv_armed)
+            {
+                ArmRecv();
+            }
+
+            // the only syscalls on this path: (re)arming, and flushing completions that overflowed the cq
+            if (Unsubmitted() > 0 or (atomic_ref<unsigned>(*_sq_flags).load(memory_order_relaxed) & IORING_SQ_CQ_OVERFLOW))
+            {
+                Submit(0, true);
+            }
+
+            Reap();
+
+            if (_recv_unsupported)
+            {
+                udp_logger->Info("kernel doesn't do multishot recvmsg, falling back to recvmsg/sendto.", "udp.cpp");
+                TearDown();
+                EnableGro();
+                return Udp::Receive(packets, max);
+            }
+
+            uint64_t stamps[TRANSPORT_BATCH_SIZE];
+            PeerAddress from;
+            int count = 0;
+            size_t used = 0;
+
+            max = GGPO_MIN(max, TRANSPORT_BATCH_SIZE);
+
+            for (; used < _ready.size() and count < max; used++)
+            {
+                const uint16_t bid = _ready[used];
+                uint8_t* buf = _recv_buffers.data() + (size_t)bid * URING_RECV_BUFFER_SIZE;
+                io_uring_recvmsg_out* out = (io_uring_recvmsg_out*)buf;
+                uint8_t* name = buf + sizeof(io_uring_recvmsg_out);
+                uint8_t* control = name + URING_RECV_NAME_SIZE;
+                uint8_t* payload = control + URING_RECV_CONTROL_SIZE;
+
+                PeerId peer = INVALID_PEER_ID;
+
+                if (not (out->flags & MSG_TRUNC) and out->namelen <= URING_RECV_NAME_SIZE and from.Set((sockaddr*)name, out->namelen))
+                {
+                    peer = _peers.Find(from);
+                }
+
+                if (peer == INVALID_PEER_ID or out->payloadlen == 0)
+                {
+                    GiveBuffer(bid); // not anyone we were told about
+                    continue;
+                }
+
+                stamps[count] = 0;
+
+                #if defined(GGPO_KERNEL_RECV_TIMESTAMPS)
+                    msghdr hdr;
+                    memset(&hdr, 0, sizeof hdr);
+                    hdr.msg_control = control;
+                    hdr.msg_controllen = out->controllen;
+                    ReadArrivalStamp(&hdr, &stamps[count]);
+                #endif
+
+                packets[count].peer = peer;
+                packets[count].data = payload;
+                packets[count].length = (int)out->payloadlen;
+                packets[count].age_ns = 0;
+                count++;
+
+                _handed_out.push_back(bid);
+            }
+
+            _ready.erase(_ready.begin(), _ready.begin() + used);
+            PublishBuffers();
+
+            SetAges(packets, stamps, count);
+            return count;
+        }
+
+    protected:
+        struct SendSlot
+        {
+            msghdr              hdr;
+            iovec               iov;
+            sockaddr_storage    addr;
+            uint16_t            segment;    /* GSO segment size, 0 for a single packet */
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+            vector<uint8_t>     data;       /* grows to the biggest run it's carried */
+        };
+
+        bool
+            SetUp()
+        {
+            io_uring_params params;
+            memset(&params, 0, sizeof params);
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = URING_CQ_ENTRIES;
+
+            _ring_fd = (int)syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params);
+
+            if (_ring_fd < 0 or not (params.features & IORING_FEAT_SINGLE_MMAP))
+            {
+                return false;
+            }
+
+            _ring_size = GGPO_MAX(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+            _ring = (uint8_t*)mmap(nullptr, _ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+
+            _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            _sqes = (io_uring_sqe*)mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+
+            if (_ring == MAP_FAILED or _sqes == MAP_FAILED)
+            {
+                return false;
+            }
+
+            _sq_head = (unsigned*)(_ring + params.sq_off.head);
+            _sq_tail = (unsigned*)(_ring + params.sq_off.tail);
+            _sq_mask = *(unsigned*)(_ring + params.sq_off.ring_mask);
+            _sq_entries = params.sq_entries;
+            _sq_flags = (unsigned*)(_ring + params.sq_off.flags);
+            _sq_array = (unsigned*)(_ring + params.sq_off.array);
+            _sq_local_tail = *_sq_tail;
+
+            _cq_head = (unsigned*)(_ring + params.cq_off.head);
+            _cq_tail = (unsigned*)(_ring + params.cq_off.tail);
+            _cq_mask = *(unsigned*)(_ring + params.cq_off.ring_mask);
+            _cqes = (io_uring_cqe*)(_ring + params.cq_off.cqes);
+
+            // the provided buffer ring, the kernel picks a buffer out of it for every packet
+            _buf_ring_size = URING_RECV_BUFFERS * sizeof(io_uring_buf);
+            _buf_ring = (io_uring_buf*)mmap(nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+            if (_buf_ring == MAP_FAILED)
+            {
+                _buf_ring = nullptr;
+                return false;
+            }
+
+            io_uring_buf_reg reg;
+            memset(&reg, 0, sizeof reg);
+            reg.ring_addr = (uint64_t)(uintptr_t)_buf_ring;
+            reg.ring_entries = URING_RECV_BUFFERS;
+            reg.bgid = URING_BUFFER_GROUP;
+
+            if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            {
+                return false;
+            }
+
+            _recv_buffers.resize((size_t)URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE);
+
+            for (unsigned bid = 0; bid < URING_RECV_BUFFERS; bid++)
+            {
+                GiveBuffer((uint16_t)bid);
+            }
+            PublishBuffers();
+
+            _send_slots.resize(URING_SEND_SLOTS);
+
+            for (unsigned i = 0; i < URING_SEND_SLOTS; i++)
+            {
+                _send_slots[i].data.resize(MAX_UDP_PACKET_SIZE);
+                _free_send_slots.push_back((uint16_t)(URING_SEND_SLOTS - 1 - i));
+            }
+
+            _ready.reserve(URING_RECV_BUFFERS);
+            _handed_out.reserve(URING_RECV_BUFFERS);
+
+            // multishot recvmsg only looks at these two to lay out each buffer
+            memset(&_recv_hdr, 0, sizeof _recv_hdr);
+            _recv_hdr.msg_namelen = URING_RECV_NAME_SIZE;
+            _recv_hdr.msg_controllen = URING_RECV_CONTROL_SIZE;
+
+            return true;
+        }
+
+        void
+            TearDown()
+        {
+            if (_buf_ring)
+            {
+                munmap(_buf_ring, _buf_ring_size);
+                _buf_ring = nullptr;
+            }
+            if (_sqes and _sqes != MAP_FAILED)
+            {
+                munmap(_sqes, _sqes_size);
+            }
+            if (_ring and _ring != MAP_FAILED)
+            {
+                munmap(_ring, _ring_size);
+            }
+            if (_ring_fd >= 0)
+            {
+                close(_ring_fd);
+            }
+
+            _sqes = nullptr;
+            _ring = nullptr;
+            _ring_fd = -1;
+        }
+
+        io_uring_sqe*
+            NextSqe()
+        {
+            if (_sq_local_tail - atomic_ref<unsigned>(*_sq_head).load(memory_order_acquire) >= _sq_entries)
+            {
+                Submit(0);
+
+                if (_sq_local_tail - atomic_ref<unsigned>(*_sq_head).load(memory_order_acquire) >= _sq_entries)
+                {
+                    return nullptr;
+                }
+            }
+
+            const unsigned index = _sq_local_tail & _sq_mask;
+            io_uring_sqe* sqe = &_sqes[index];
+
+            memset(sqe, 0, sizeof *sqe);
+            _sq_array[index] = index;
+            _sq_local_tail++;
+
+            return sqe;
+        }
+
+        unsigned
+            Unsubmitted()
+        {
+            return _sq_local_tail - *_sq_tail;
+        }
+
+        void
+            Submit(unsigned wait_nr, bool get_events = false)
+        {
+            const unsigned to_submit = Unsubmitted();
+
+            atomic_ref<unsigned>(*_sq_tail).store(_sq_local_tail, memory_order_release);
+
+            if (to_submit > 0 or wait_nr > 0 or get_events)
+            {
+                unsigned flags = (wait_nr > 0 or get_events) ? IORING_ENTER_GETEVENTS : 0;
+
+                if (syscall(__NR_io_uring_enter, _ring_fd, to_submit, wait_nr, flags, nullptr, 0) < 0 and errno != EINTR and errno != EBUSY)
+                {
+                    udp_logger->Error(format("io_uring_enter failed (errno {}).", errno), "udp.cpp");
+                }
+            }
+        }
+
+        // eats the completion queue: sends free their slot, received packets line up in _ready
+        void
+            Reap()
+        {
+            unsigned head = *_cq_head;
+            const unsigned tail = atomic_ref<unsigned>(*_cq_tail).load(memory_order_acquire);
+
+            for (; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+
+                if (cqe.user_data != URING_RECV_TAG)
+                {
+                    if (cqe.res < 0)
+                    {
+                        SendFailed(_send_slots[cqe.user_data], -cqe.res);
+                    }
+
+                    _free_send_slots.push_back((uint16_t)cqe.user_data);
+                    continue;
+                }
+
+                if (cqe.res >= 0 and (cqe.flags & IORING_CQE_F_BUFFER))
+                {
+                    _ready.push_back((uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+                else if (cqe.res == -EINVAL or cqe.res == -EOPNOTSUPP)
+                {
+                    _recv_unsupported = true; // arming it again would just fail again, forever
+                }
+                else if (cqe.res < 0 and cqe.res != -ENOBUFS)
+                {
+                    udp_logger->Error(format("io_uring recvmsg failed (err: {}).", -cqe.res), "udp.cpp");
+                }
+
+                // out of buffers (nobody's been calling Receive) or an error, either way it needs arming again
+                if (not (cqe.flags & IORING_CQE_F_MORE))
+                {
+                    _recv_armed = false;
+                }
+            }
+
+            atomic_ref<unsigned>(*_cq_head).store(head, memory_order_release);
+        }
+
+        /*
+         * Same as Udp::SendSegments(): if the kernel or the nic turn down segmentation
+         * the run goes out again one packet at a time, and later runs don't try it.
+         */
+        void
+            SendFailed(SendSlot& s, int err)
+        {
+        #if defined(GGPO_UDP_OFFLOAD)
+            if (s.segment and (err == EIO or err == EINVAL or err == ENOPROTOOPT or err == EOPNOTSUPP))
+            {
+                udp_logger->Info(format("udp segmentation offload isn't available (errno {}), sending one packet at a time.", err), "udp.cpp");
+                _gso = false;
+
+                for (size_t offset = 0; offset < s.iov.iov_len; offset += s.segment)
+                {
+                    const size_t length = GGPO_MIN((size_t)s.segment, s.iov.iov_len - offset);
+                    sendto(_socket, (const char*)s.data.data() + offset, length, 0, (sockaddr*)&s.addr, s.hdr.msg_namelen);
+                }
+                return;
+            }
+        #endif
+
+            udp_logger->Error(format("io_uring sendmsg failed (err: {}).", err), "udp.cpp");
+        }
+
+        int
+            TakeSendSlot()
+        {
+            if (_free_send_slots.empty())
+            {
+                // everything's in flight, push it out and wait for one to come back
+                Submit(1);
+                Reap();
+            }
+
+            if (_free_send_slots.empty())
+            {
+                return -1;
+            }
+
+            int slot = _free_send_slots.back();
+            _free_send_slots.pop_back();
+            return slot;
+        }
+
+        void
+            ArmRecv()
+        {
+            io_uring_sqe* sqe = NextSqe();
+
+            if (not sqe)
+            {
+                return;
+            }
+
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->fd = _socket;
+            sqe->addr = (uint64_t)(uintptr_t)&_recv_hdr;
+            sqe->len = 1;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = URING_BUFFER_GROUP;
+            sqe->user_data = URING_RECV_TAG;
+
+            _recv_armed = true;
+        }
+
+        void
+            GiveBuffer(uint16_t bid)
+        {
+            io_uring_buf* buf = &_buf_ring[_buf_tail & (URING_RECV_BUFFERS - 1)];
+
+            buf->addr = (uint64_t)(uintptr_t)(_recv_buffers.data() + (size_t)bid * URING_RECV_BUFFER_SIZE);
+            buf->len = URING_RECV_BUFFER_SIZE;
+            buf->bid = bid;
+            _buf_tail++;
+        }
+
+        void
+            PublishBuffers()
+        {
+            atomic_ref<uint16_t>(_buf_ring[0].resv).store(_buf_tail, memory_order_release);
+        }
+
+        int _ring_fd = -1;
+        uint8_t* _ring = nullptr;
+        size_t _ring_size = 0;
+        io_uring_sqe* _sqes = nullptr;
+        size_t _sqes_size = 0;
+
+        unsigned* _sq_head = nullptr;
+        unsigned* _sq_tail = nullptr;
+        unsigned* _sq_flags = nullptr;
+        unsigned* _sq_array = nullptr;
+        unsigned _sq_mask = 0;
+        unsigned _sq_entries = 0;
+        unsigned _sq_local_tail = 0;   /* sqes filled in, *_sq_tail is what the kernel's been shown */
+
+        unsigned* _cq_head = nullptr;
+        unsigned* _cq_tail = nullptr;
+        unsigned _cq_mask = 0;
+        io_uring_cqe* _cqes = nullptr;
+
+        /*
+         * The kernel's io_uring_buf_ring: the entries, with the tail sitting in the
+         * first entry's resv.  Not the uapi struct, its flex array picks up an extra
+         * 8 bytes in front when compiled as c++.
+         */
+        io_uring_buf* _buf_ring = nullptr;
+        size_t _buf_ring_size = 0;
+        uint16_t _buf_tail = 0;
+        vector<uint8_t> _recv_buffers;
+
+        msghdr _recv_hdr;
+        bool _recv_armed = false;
+        bool _recv_unsupported = false;
+        vector<uint16_t> _ready;        /* buffer ids the kernel filled, oldest first */
+        vector<uint16_t> _handed_out;   /* given to the session by the last Receive() */
+
+        vector<SendSlot> _send_slots;
+        vector<uint16_t> _free_send_slots;
+    };
+
+#endif
+}
+
+//==================================================================================== Tcp ============================================================================================//
+
+/*
+ * Frame header for the tcp transport.  A stream has no packet boundaries so every
+ * UdpMsg goes out behind one of these, length is the payload size in network byte
+ * order.  The first frame on a connection we dial is a Hello carrying the port we
+ * listen on, the accepting side only sees our ephemeral source port otherwise and
+ * couldn't match us up with the address it was given for us.
+ */
+struct MessageTCP
+{
+    enum MsgType : uint8_t
+    {
+        Msg = 0,
+        Hello = 1,
+    };
+
+    uint16_t    length;
+    uint8_t     type;
+    uint8_t     reserved;
+};
+
+static_assert(sizeof(MessageTCP) == 4, "MessageTCP goes on the wire as is");
+
+namespace GGPO
+{
+    constexpr int MAX_TCP_CONNECTIONS = 2 * MAX_UDP_ENDPOINTS; // both sides can dial each other at once
+    constexpr int TCP_RECV_BUFFER_SIZE = 4 * ((int)sizeof(MessageTCP) + MAX_UDP_PACKET_SIZE);
+    constexpr int TCP_MAX_OUTBOX = 64 * 1024; // past this the peer has stopped reading, drop the connection
+
+    /*
+     * Reliable, ordered transport for players who can't get udp through.  Listens
+     * on the local port and dials a peer the first time something is sent to it,
+     * accepted connections get matched up to a peer by the Hello they open with.
+     * A Hello from an address Resolve() was never given closes the connection, the
+     * peer dials again on its next send once we've added it.
+     *
+     * Sockets are non blocking with TCP_NODELAY, Nagle sitting on an input for a
+     * round trip is exactly the latency we're trying not to add.  Frames collect in
+     * a per connection outbox and each Flush hands the whole thing to the kernel in
+     * one send.  Reads go into a receive buffer that lives as long as the
+     * connection, Receive() hands out frames straight out of it.
+     */
+    class Tcp : public Transport
+    {
+    public:
+        Tcp()
+        {
+            tcp_logger = Logger::CreateUnique("TCPLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+            GGPO_ASSERT(tcp_logger)
+        }
+
+        ~Tcp(void)
+        {
+            for (auto& conn : _connections)
+            {
+                Close(*conn);
+            }
+
+            if (_listener != GGPO_INVALID_SOCKET)
+            {
+                GGPO_CLOSE_SOCKET(_listener);
+                _listener = GGPO_INVALID_SOCKET;
+            }
+        }
+
+        void
+            Init(uint16_t port)
+        {
+            _port = port;
+
+            tcp_logger->Info(format("binding tcp listen socket to port {}.", port), "tcp.cpp");
+            _listener = CreateSocket(port, 0, tcp_logger.get(), &_family, SOCK_STREAM);
+
+            if (_listener == GGPO_INVALID_SOCKET or listen(_listener, MAX_TCP_CONNECTIONS) == GGPO_SOCKET_ERROR)
+            {
+                tcp_logger->Error(format("can't listen on tcp port {}, only connections we dial will work.", port), "tcp.cpp");
+            }
+        }
+
+        int
+            GetFamily()
+            const
+        {
+            return _family;
+        }
+
+        bool
+            Resolve(const char* ip, uint16_t port, PeerId* peer) override
+        {
+            PeerAddress addr;
+
+            if (not addr.Resolve(ip, port, _family))
+            {
+                return false;
+            }
+
+            *peer = _peers.Add(addr);
+            return true;
+        }
+
+        bool
+            IsReliable()
+            const override
+        {
+            return true;
+        }
+
+        uint32_t
+            StreamId(PeerId peer)
+            const override
+        {
+            Connection* conn = FindConnection(peer);
+            return conn ? conn->id : 0;
+        }
+
+        void
+            Send(const TransportPacket* packets, int count) override
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (packets[i].length <= 0 or packets[i].length > MAX_UDP_PACKET_SIZE)
+                {
+                    tcp_logger->Error(format("refusing to frame a {} byte message.", packets[i].length), "tcp.cpp");
+                    continue;
+                }
+
+                Connection* conn = FindConnection(packets[i].peer);
+
+                if (not conn)
+                {
+                    conn = Connect(packets[i].peer);
+                }
+
+                // nothing to do but drop it, UdpProtocol keeps retrying and we'll dial again then
+                if (conn)
+                {
+                    QueueFrame(*conn, MessageTCP::Msg, packets[i].data, packets[i].length);
+                }
+            }
+        }
+
+        void
+            Flush() override
+        {
+            for (auto& conn : _connections)
+            {
+                if (not conn->closed)
+                {
+                    FlushConnection(*conn);
+                }
+            }
+        }
+
+        int
+            Receive(TransportPacket* packets, int max) override
+        {
+            int count = 0;
+
+            // whatever we handed out last time is done with, so closed connections can go
+            // and everything that's left in the receive buffers can slide to the front
+            erase_if(_connections, [](const unique_ptr<Connection>& conn) { return conn->closed; });
+
+            for (auto& conn : _connections)
+            {
+                if (conn->recv_head > 0)
+                {
+                    conn->recv_len -= conn->recv_head;
+                    memmove(conn->recv_buf.data(), conn->recv_buf.data() + conn->recv_head, conn->recv_len);
+                    conn->recv_head = 0;
+                }
+            }
+
+            Accept();
+
+            for (auto& conn : _connections)
+            {
+                if (count == max)
+                {
+                    break;
+                }
+
+                if (not conn->closed)
+                {
+                    ReadSocket(*conn);
+                }
+
+                // frames that made it in before a close still count
+                if (not Deframe(*conn, packets, max, &count))
+                {
+                    Close(*conn);
+                }
+            }
+
+            return count;
+        }
+
+    #if !(defined(_WIN32) || defined(_WIN64))
+        // only while nothing is waiting to go out, a socket that was full (or still connecting) needs another try on a timer
+        int
+            PollHandles(GGPO_HANDLE* handles, int max)
+            const override
+        {
+            int count = 0;
+
+            for (const auto& conn : _connections)
+            {
+                if (not conn->closed and not conn->outbox.empty())
+                {
+                    return 0;
+                }
+            }
+
+            if (_listener != GGPO_INVALID_SOCKET and count < max)
+            {
+                handles[count++] = (GGPO_HANDLE)_listener;
+            }
+
+            for (const auto& conn : _connections)
+            {
+                if (count == max)
+                {
+                    return 0;
+                }
+
+                if (not conn->closed)
+                {
+                    handles[count++] = (GGPO_HANDLE)conn->socket;
+                }
+            }
+
+            return count;
+        }
+    #endif
+
+    protected:
+        struct Connection
+        {
+            GGPO_SOCKET         socket = GGPO_INVALID_SOCKET;
+            uint32_t            id = 0;
+            PeerId              peer = INVALID_PEER_ID; // accepted connections find out from the Hello
+            PeerAddress         addr;
+            bool                closed = false;
+
+            vector<uint8_t>     recv_buf;
+            int                 recv_head = 0;  // start of the first frame we haven't handed out
+            int                 recv_len = 0;
+            vector<uint8_t>     outbox;
+        };
+
+    #if defined(MSG_NOSIGNAL)
+        static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+    #else
+        static constexpr int SEND_FLAGS = 0; // SO_NOSIGPIPE on the socket instead, windows doesn't do SIGPIPE
+    #endif
+
+        static bool
+            WouldBlock(int err)
+        {
+        #if defined(_WIN32) || defined(_WIN64)
+            return err == WSAEWOULDBLOCK or err == WSAEINPROGRESS or err == WSAENOTCONN;
+        #else
+            return err == EWOULDBLOCK or err == EAGAIN or err == EINPROGRESS or err == ENOTCONN;
+        #endif
+        }
+
+        static void
+            ConfigureSocket(GGPO_SOCKET s)
+        {
+            int optval = 1;
+
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&optval, sizeof optval);
+
+            #if defined(SO_NOSIGPIPE)
+                setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&optval, sizeof optval);
+            #endif
+
+            #if defined(_WIN32) || defined(_WIN64)
+                u_long iMode = 1;
+                ioctlsocket(s, FIONBIO, &iMode);
+            #else
+                int flags = fcntl(s, F_GETFL, 0);
+                fcntl(s, F_SETFL, flags | O_NONBLOCK);
+            #endif
+        }
+
+        Connection*
+            FindConnection(PeerId peer)
+            const
+        {
+            for (const auto& conn : _connections)
+            {
+                if (conn->peer == peer and not conn->closed)
+                {
+                    return conn.get();
+                }
+            }
+
+            return NULL;
+        }
+
+        Connection*
+            AddConnection(GGPO_SOCKET s)
+        {
+            unique_ptr<Connection> conn = make_unique<Connection>();
+
+            conn->socket = s;
+            conn->id = ++_next_id ? _next_id : ++_next_id; // 0 means no stream
+            conn->recv_buf.resize(TCP_RECV_BUFFER_SIZE);
+
+            _connections.push_back(move(conn));
+            return _connections.back().get();
+        }
+
+        Connection*
+            Connect(PeerId peer)
+        {
+            const PeerAddress* dst = _peers.Get(peer);
+
+            if (not dst)
+            {
+                tcp_logger->Error(format("no address for peer {}, can't dial it.", peer), "tcp.cpp");
+                return NULL;
+            }
+
+            if ((int)_connections.size() >= MAX_TCP_CONNECTIONS)
+            {
+                tcp_logger->Error(format("too many tcp connections to dial {}.", dst->ToString()), "tcp.cpp");
+                return NULL;
+            }
+
+            GGPO_SOCKET s = socket(dst->Family(), SOCK_STREAM, 0);
+
+            if (s == GGPO_INVALID_SOCKET)
+            {
+                tcp_logger->Error(format("couldn't create a tcp socket (err: {}).", GGPO_GET_LAST_ERROR()), "tcp.cpp");
+                return NULL;
+            }
+
+            ConfigureSocket(s);
+
+            if (connect(s, dst->Get(), dst->length) == GGPO_SOCKET_ERROR and not WouldBlock(GGPO_GET_LAST_ERROR()))
+            {
+                tcp_logger->Error(format("connect to {} failed (err: {}).", dst->ToString(), GGPO_GET_LAST_ERROR()), "tcp.cpp");
+                GGPO_CLOSE_SOCKET(s);
+                return NULL;
+            }
+
+            Connection* conn = AddConnection(s);
+            conn->peer = peer;
+            conn->addr = *dst;
+
+            uint16_t port = htons(_port);
+            QueueFrame(*conn, MessageTCP::Hello, (const uint8_t*)&port, sizeof port);
+
+            tcp_logger->Info(format("dialing {} (stream {}).", dst->ToString(), conn->id), "tcp.cpp");
+            return conn;
+        }
+
+        void
+            Accept()
+        {
+            if (_listener == GGPO_INVALID_SOCKET)
+            {
+                return;
+            }
+
+            for (;;)
+            {
+                sockaddr_storage addr;
+                socklen_t addr_len = sizeof addr;
+
+                GGPO_SOCKET s = accept(_listener, (sockaddr*)&addr, &addr_len);
+
+                if (s == GGPO_INVALID_SOCKET)
+                {
+                    break; // nothing waiting, anything worse shows up again next poll
+                }
+
+                if ((int)_connections.size() >= MAX_TCP_CONNECTIONS)
+                {
+                    tcp_logger->Error("too many tcp connections, turning one away.", "tcp.cpp");
+                    GGPO_CLOSE_SOCKET(s);
+                    continue;
+                }
+
+                ConfigureSocket(s);
+
+                Connection* conn = AddConnection(s);
+                conn->addr.Set((sockaddr*)&addr, addr_len);
+
+                tcp_logger->Info(format("accepted tcp connection from {} (stream {}).", conn->addr.ToString(), conn->id), "tcp.cpp");
+            }
+        }
+
+        // the buffers stay allocated until Receive() drops the connection, frames might still point into them
+        void
+            Close(Connection& conn)
+        {
+            if (conn.socket != GGPO_INVALID_SOCKET)
+            {
+                GGPO_CLOSE_SOCKET(conn.socket);
+                conn.socket = GGPO_INVALID_SOCKET;
+            }
+
+            conn.closed = true;
+            conn.outbox.clear();
+        }
+
+        void
+            QueueFrame(Connection& conn, uint8_t type, const uint8_t* payload, int length)
+        {
+            MessageTCP header = {};
+            header.length = htons((uint16_t)length);
+            header.type = type;
+
+            conn.outbox.insert(conn.outbox.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof header);
+            conn.outbox.insert(conn.outbox.end(), payload, payload + length);
+        }
+
+        void
+            FlushConnection(Connection& conn)
+        {
+            size_t sent = 0;
+
+            while (sent < conn.outbox.size())
+            {
+                int res = send(conn.socket, (const char*)conn.outbox.data() + sent, (int)(conn.outbox.size() - sent), SEND_FLAGS);
+
+                if (res == GGPO_SOCKET_ERROR)
+                {
+                    int err = GGPO_GET_LAST_ERROR();
+
+                    if (WouldBlock(err))
+                    {
+                        break; // still connecting or the send buffer is full, rest goes next flush
+                    }
+
+                    tcp_logger->Error(format("send to {} failed (err: {}), closing stream {}.", conn.addr.ToString(), err, conn.id), "tcp.cpp");
+                    Close(conn);
+                    return;
+                }
+
+                sent += res;
+            }
+
+            conn.outbox.erase(conn.outbox.begin(), conn.outbox.begin() + sent);
+
+            if (conn.outbox.size() > TCP_MAX_OUTBOX)
+            {
+                tcp_logger->Error(format("{} isn't reading, closing stream {}.", conn.addr.ToString(), conn.id), "tcp.cpp");
+                Close(conn);
+            }
+        }
+
+        void
+            ReadSocket(Connection& conn)
+        {
+            // stops early when the buffer's full of frames nobody's picked up yet, the socket keeps them till next time
+            while (conn.recv_len < (int)conn.recv_buf.size())
+            {
+                int len = recv(conn.socket, (char*)conn.recv_buf.data() + conn.recv_len, (int)conn.recv_buf.size() - conn.recv_len, 0);
+
+                if (len == 0)
+                {
+                    tcp_logger->Info(format("{} closed stream {}.", conn.addr.ToString(), conn.id), "tcp.cpp");
+                    Close(conn);
+                    return;
+                }
+
+                if (len < 0)
+                {
+                    int err = GGPO_GET_LAST_ERROR();
+
+                    if (not WouldBlock(err))
+                    {
+                        tcp_logger->Error(format("recv from {} failed (err: {}), closing stream {}.", conn.addr.ToString(), err, conn.id), "tcp.cpp");
+                        Close(conn);
+                    }
+
+                    return;
+                }
+
+                conn.recv_len += len;
+            }
+        }
+
+        /*
+         * Hands out every complete frame past recv_head, up to max.  A partial frame
+         * waits for the rest, and since Receive() slides it to the front first there's
+         * always room for it.  Returns false if the stream is garbage.
+         */
+        bool
+            Deframe(Connection& conn, TransportPacket* packets, int max, int* count)
+        {
+            while (*count < max and conn.recv_len - conn.recv_head >= (int)sizeof(MessageTCP))
+            {
+                MessageTCP header;
+                memcpy(&header, conn.recv_buf.data() + conn.recv_head, sizeof header);
+
+                const int length = ntohs(header.length);
+                const uint8_t* payload = conn.recv_buf.data() + conn.recv_head + sizeof header;
+
+                if (length > MAX_UDP_PACKET_SIZE)
+                {
+                    tcp_logger->Error(format("bogus frame length {} from {}.", length, conn.addr.ToString()), "tcp.cpp");
+                    return false;
+                }
+
+                if (conn.recv_len - conn.recv_head - (int)sizeof header < length)
+                {
+                    break;
+                }
+
+                conn.recv_head += (int)sizeof header + length;
+
+                if (header.type == MessageTCP::Hello and length == sizeof(uint16_t))
+                {
+                    uint16_t port;
+                    memcpy(&port, payload, sizeof port);
+
+                    conn.addr.SetPort(ntohs(port));
+                    conn.peer = _peers.Find(conn.addr);
+
+                    // only peers we were told about get a stream, anyone else could fill the table with made up ports
+                    if (conn.peer == INVALID_PEER_ID)
+                    {
+                        tcp_logger->Error(format("hello from {}, not a peer we know, closing stream {}.", conn.addr.ToString(), conn.id), "tcp.cpp");
+                        return false;
+                    }
+
+                    tcp_logger->Info(format("stream {} is {}.", conn.id, conn.addr.ToString()), "tcp.cpp");
+                    continue;
+                }
+
+                if (header.type != MessageTCP::Msg or conn.peer == INVALID_PEER_ID)
+                {
+                    tcp_logger->Error(format("unexpected frame type {} from {}.", header.type, conn.addr.ToString()), "tcp.cpp");
+                    return false;
+                }
+
+                packets[*count].peer = conn.peer;
+                packets[*count].data = payload;
+                packets[*count].length = length;
+                (*count)++;
+            }
+
+            return true;
+        }
+
+    protected:
+        GGPO_SOCKET _listener = GGPO_INVALID_SOCKET;
+        int _family = AF_INET;
+        uint16_t _port = 0;
+
+        PeerTable _peers;
+
+        uint32_t _next_id = 0;
+        vector<unique_ptr<Connection>> _connections;
+
+        unique_ptr<Logger> tcp_logger = nullptr;
+    };
+
+    // the built in transports, bound to localport
+    inline unique_ptr<Transport>
+        CreateTransport(TransportType type, uint16_t localport)
+    {
+        if (type == TransportType::Tcp)
+        {
+            unique_ptr<Tcp> tcp = make_unique<Tcp>();
+            tcp->Init(localport);
+            return tcp;
+        }
+
+    #if defined(GGPO_IO_URING)
+        if (type == TransportType::UringUdp)
+        {
+            unique_ptr<UringUdp> udp = make_unique<UringUdp>();
+            udp->Init(localport);
+            return udp;
+        }
+    #endif
+
+        unique_ptr<Udp> udp = make_unique<Udp>();
+        udp->Init(localport);
+        return udp;
+    }
+}
+
+//==================================================================================== Network Thread ============================================================================================//
+
+namespace GGPO
+{
+    constexpr int NETWORK_THREAD_QUEUE_SIZE = 256;   // packets each way, power of 2
+    constexpr int NETWORK_THREAD_IDLE_US = 250;      // how long the network thread naps when there's nothing to do and nothing to block on
+    constexpr int NETWORK_THREAD_BLOCK_MS = 100;     // longest it blocks in poll(), anything the game thread wants wakes it sooner
+    constexpr int NETWORK_THREAD_MAX_HANDLES = 64;   // what it'll poll() on at once, past that it naps instead
+    constexpr int NETWORK_THREAD_MAX_PEERS = 64;     // peer ids we keep a stream id around for
+    constexpr int NETWORK_THREAD_SEND_WAIT_US = 2000; // longest the game thread waits on a full outbox for a reliable transport
+
+    /*
+     * Lock free queue between exactly one producer thread and one consumer thread.
+     * Slots get filled and drained in place so nothing is copied twice: the
+     * producer fills BeginPush() and publishes it with CommitPush(), the consumer
+     * reads At() and hands slots back with Pop().
+     */
+    template<typename T, size_t pm_MaxCapacity>
+    class SpscRing
+    {
+        static_assert(pm_MaxCapacity > 0 and (pm_MaxCapacity & (pm_MaxCapacity - 1)) == 0, "SpscRing size must be a power of 2");
+
+    public:
+        SpscRing() :
+            pm_Slots(pm_MaxCapacity)
+        {
+        }
+
+        // producer: the next free slot, nullptr when full
+        [[nodiscard]] T*
+            BeginPush()
+            noexcept
+        {
+            const size_t f_Tail = pm_Tail.load(memory_order_relaxed);
+
+            if (f_Tail - pm_Head.load(memory_order_acquire) == pm_MaxCapacity)
+            {
+                return nullptr;
+            }
+
+            return &pm_Slots[f_Tail & (pm_MaxCapacity - 1)];
+        }
+
+        void
+            CommitPush()
+            noexcept
+        {
+            pm_Tail.store(pm_Tail.load(memory_order_relaxed) + 1, memory_order_release);
+        }
+
+        // producer: how many BeginPush() calls in a row are going to work
+        [[nodiscard]] size_t
+            FreeSlots()
+            const noexcept
+        {
+            return pm_MaxCapacity - (pm_Tail.load(memory_order_relaxed) - pm_Head.load(memory_order_acquire));
+        }
+
+        // consumer: fp_Index slots past the oldest, nullptr if nothing's there yet
+        [[nodiscard]] T*
+            At(size_t fp_Index)
+            noexcept
+        {
+            const size_t f_Head = pm_Head.load(memory_order_relaxed);
+
+            if (f_Head + fp_Index >= pm_Tail.load(memory_order_acquire))
+            {
+                return nullptr;
+            }
+
+            return &pm_Slots[(f_Head + fp_Index) & (pm_MaxCapacity - 1)];
+        }
+
+        // consumer: done with the oldest slot, it goes back to the producer
+        void
+            Pop()
+            noexcept
+        {
+            pm_Head.store(pm_Head.load(memory_order_relaxed) + 1, memory_order_release);
+        }
+
+        [[nodiscard]] bool
+            IsEmpty()
+            const noexcept
+        {
+            return pm_Head.load(memory_order_acquire) == pm_Tail.load(memory_order_acquire);
+        }
+
+    private:
+        vector<T> pm_Slots;
+
+        // own cache lines, the two threads each hammer one of them
+        alignas(64) atomic<size_t> pm_Head{ 0 };
+        alignas(64) atomic<size_t> pm_Tail{ 0 };
+    };
+
+    struct NetworkThreadPacket
+    {
+        PeerId              peer = INVALID_PEER_ID;
+        int                 length = 0;
+        uint64_t            arrived_ns = 0;   /* monotonic, backdated by whatever age the transport underneath knew about */
+        bool                answered = false; /* the network thread already replied, see TransportPacket */
+        alignas(8) uint8_t  data[MAX_UDP_PACKET_SIZE];
+    };
+
+    /*
+     * Runs another transport on a thread of its own.  That thread sits on the
+     * socket the whole time, so packets get picked up (and stamped) when they
+     * arrive instead of whenever the game next polls, and what the session sends
+     * goes out as soon as it's flushed without the game thread making the
+     * syscalls.  Everything crosses over through two SpscRings, so neither side
+     * ever waits on a lock for a packet.
+     *
+     * QualityReports and SyncRequests get answered right here, as they come in,
+     * so the other side's ping is the wire and not our frame rate or a trip
+     * through the game thread.  The reply goes out on the header of the last
+     * thing the session sent that peer (magic, sequence number) and says how
+     * long we held the report (quality_reply.hold).  Until the session has sent
+     * the peer anything, or if the magic isn't the one the peer started with,
+     * it's left to the session like before.  The packet still goes to the game
+     * thread marked answered, the session takes the frame advantage out of it
+     * and doesn't reply again.  KeepAlives don't get a reply from anyone.
+     *
+     * When the transport has something to poll() on (PollHandles) the thread
+     * sleeps there and the game thread wakes it through a pipe, only when it's
+     * actually asleep.  Otherwise, and on windows, it naps NETWORK_THREAD_IDLE_US.
+     *
+     * The transport gets created on the network thread and only ever touched
+     * from there.  Resolve() runs over there too and blocks until it's done, it
+     * only happens when players get added.  MemoryTransport shares its network
+     * between endpoints so don't run it through here unless every endpoint is.
+     *
+     * A full outbox drops the message over udp like any other loss.  Over a
+     * reliable transport the game thread waits for room instead, but never longer
+     * than NETWORK_THREAD_SEND_WAIT_US.  Past that the message is dropped and the
+     * peer's StreamId changes, so UdpProtocol treats the stream as broken and
+     * resends everything since the last ack instead of counting on it arriving.
+     */
+    class ThreadedTransport : public Transport
+    {
+    public:
+        ThreadedTransport(TransportType type, uint16_t localport) :
+            ThreadedTransport([type, localport]() { return CreateTransport(type, localport); })
+        {
+        }
+
+        explicit ThreadedTransport(function<unique_ptr<Transport>()> create)
+        {
+            threaded_transport_logger = Logger::CreateUnique("ThreadedTransportLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+            GGPO_ASSERT(threaded_transport_logger)
+
+        #if !(defined(_WIN32) || defined(_WIN64))
+            if (pipe(_wake_pipe) == 0)
+            {
+                for (int fd : _wake_pipe)
+                {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                }
+            }
+            else
+            {
+                threaded_transport_logger->Error(format("no wake pipe (errno {}), the network thread naps instead of blocking.", errno), "threaded_transport.cpp");
+                _wake_pipe[0] = _wake_pipe[1] = -1;
+            }
+        #endif
+
+            _thread = thread(&ThreadedTransport::Run, this, move(create));
+
+            unique_lock<mutex> lock(_lock);
+            _done.wait(lock, [this] { return _started; });
+        }
+
+        ~ThreadedTransport()
+        {
+            _stop.store(true, memory_order_release);
+            Wake();
+
+            if (_thread.joinable())
+            {
+                _thread.join();
+            }
+
+        #if !(defined(_WIN32) || defined(_WIN64))
+            for (int fd : _wake_pipe)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+        #endif
+        }
+
+        bool
+            Resolve(const char* ip, uint16_t port, PeerId* peer)
+            override
+        {
+            unique_lock<mutex> lock(_lock);
+
+            if (not _inner)
+            {
+                return false;
+            }
+
+            _resolve = { ip, port, peer, false };
+            _resolve_pending.store(true, memory_order_release);
+            Wake();
+
+            _done.wait(lock, [this] { return not _resolve_pending.load(memory_order_acquire); });
+            return _resolve.result;
+        }
+
+        void
+            Send(const TransportPacket* packets, int count)
+            override
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (packets[i].length > MAX_UDP_PACKET_SIZE)
+                {
+                    threaded_transport_logger->Error(format("dropping {} byte message to peer {}, bigger than a network thread slot.", packets[i].length, packets[i].peer), "threaded_transport.cpp");
+                    continue;
+                }
+
+                NetworkThreadPacket* slot = _outbox.BeginPush();
+
+                // a reliable transport isn't supposed to lose anything, give the network thread a moment to make room
+                if (not slot and _reliable)
+                {
+                    const uint64_t give_up = MonotonicClock::Get().NowNS() + NETWORK_THREAD_SEND_WAIT_US * 1000ULL;
+
+                    do
+                    {
+                        Wake();
+                        this_thread::yield();
+                        slot = _outbox.BeginPush();
+                    } while (not slot and MonotonicClock::Get().NowNS() < give_up);
+                }
+
+                if (not slot)
+                {
+                    threaded_transport_logger->Error(format("network thread outbox full, dropping message to peer {}.", packets[i].peer), "threaded_transport.cpp");
+
+                    // the stream has a hole in it now, make it look like a new one
+                    if (_reliable and packets[i].peer < NETWORK_THREAD_MAX_PEERS)
+                    {
+                        _stream_breaks[packets[i].peer]++;
+                    }
+                    continue;
+                }
+
+                slot->peer = packets[i].peer;
+                slot->length = packets[i].length;
+                memcpy(slot->data, packets[i].data, packets[i].length);
+                _outbox.CommitPush();
+            }
+        }
+
+        int
+            Receive(TransportPacket* packets, int max)
+            override
+        {
+            // what we handed out last time is done with
+            for (; _handed_out > 0; _handed_out--)
+            {
+                _inbox.Pop();
+            }
+
+            const uint64_t now = MonotonicClock::Get().NowNS();
+            NetworkThreadPacket* slot;
+
+            while (_handed_out < max and (slot = _inbox.At(_handed_out)))
+            {
+                packets[_handed_out].peer = slot->peer;
+                packets[_handed_out].data = slot->data;
+                packets[_handed_out].length = slot->length;
+                packets[_handed_out].age_ns = now - GGPO_MIN(slot->arrived_ns, now);
+                packets[_handed_out].answered = slot->answered;
+                _handed_out++;
+            }
+
+            return _handed_out;
+        }
+
+        // the network thread sends as soon as it sees something, this just makes sure it's awake
+        void
+            Flush()
+            override
+        {
+            Wake();
+        }
+
+        bool
+            IsReliable()
+            const override
+        {
+            return _reliable;
+        }
+
+        uint32_t
+            StreamId(PeerId peer)
+            const override
+        {
+            if (peer >= NETWORK_THREAD_MAX_PEERS)
+            {
+                return 0;
+            }
+
+            const uint32_t id = _stream_ids[peer].load(memory_order_acquire);
+            return id ? id ^ (_stream_breaks[peer] << 24) : 0;
+        }
+
+    protected:
+        struct ResolveRequest
+        {
+            const char*     ip;
+            uint16_t        port;
+            PeerId*         peer;
+            bool            result;
+        };
+
+        // what the network thread knows about a peer from the packets going by, see Answer()
+        struct PeerWire
+        {
+            decltype(UdpMsg::hdr)   last_sent = {};     /* header of the newest message out to them */
+            bool                    sent = false;
+            uint16_t                remote_magic = 0;   /* theirs, off the first message they sent */
+        };
+
+        // game thread (or the destructor): get the network thread going if it's asleep
+        void
+            Wake()
+        {
+        #if !(defined(_WIN32) || defined(_WIN64))
+            // pairs with the fence in Sleep(), either we see it polling or it sees what we queued
+            atomic_thread_fence(memory_order_seq_cst);
+
+            if (_polling.load(memory_order_relaxed) and _polling.exchange(false))
+            {
+                const uint8_t byte = 0;
+                (void)!write(_wake_pipe[1], &byte, 1);
+            }
+        #endif
+
+            _wake.notify_one();
+        }
+
+        //============================ everything below here runs on the network thread ============================//
+
+        bool
+            HasWork()
+        {
+            return _stop.load(memory_order_acquire) or _resolve_pending.load(memory_order_acquire) or not _outbox.IsEmpty();
+        }
+
+        // until there's something to send or receive.  fp_Receive false when the inbox is too full to take any
+        void
+            Sleep(bool fp_Receive)
+        {
+        #if !(defined(_WIN32) || defined(_WIN64))
+            GGPO_HANDLE handles[NETWORK_THREAD_MAX_HANDLES];
+            const int count = fp_Receive and _wake_pipe[0] >= 0 ? _inner->PollHandles(handles, NETWORK_THREAD_MAX_HANDLES - 1) : 0;
+
+            if (count > 0)
+            {
+                pollfd fds[NETWORK_THREAD_MAX_HANDLES];
+
+                fds[0] = { _wake_pipe[0], POLLIN, 0 };
+
+                for (int i = 0; i < count; i++)
+                {
+                    fds[i + 1] = { handles[i], POLLIN, 0 };
+                }
+
+                _polling.store(true, memory_order_relaxed);
+                atomic_thread_fence(memory_order_seq_cst);
+
+                if (not HasWork())
+                {
+                    ::poll(fds, count + 1, NETWORK_THREAD_BLOCK_MS);
+                }
+
+                _polling.store(false, memory_order_relaxed);
+
+                if (fds[0].revents & POLLIN)
+                {
+                    uint8_t drain[64];
+                    while (read(_wake_pipe[0], drain, sizeof(drain)) > 0) { }
+                }
+                return;
+            }
+        #endif
+
+            unique_lock<mutex> lock(_lock);
+            _wake.wait_for(lock, chrono::microseconds(NETWORK_THREAD_IDLE_US), [this] { return HasWork(); });
+        }
+
+        // the header of the newest message in a packet going out to peer, for Answer()
+        void
+            NoteSent(const TransportPacket& packet)
+        {
+            const int header = (int)((char*)&_scratch.u - (char*)&_scratch);
+
+            if (packet.peer >= NETWORK_THREAD_MAX_PEERS or packet.length < header)
+            {
+                return;
+            }
+
+            decltype(UdpMsg::hdr) hdr;
+            memcpy(&hdr, packet.data, sizeof(hdr));
+
+            // a bundle's own header is only the magic, the last message in it has the newest sequence number (see UdpProtocol::BundleMessages())
+            if (hdr.type == UdpMsg::Bundle)
+            {
+                bool found = false;
+                int offset = header;
+                uint16_t size;
+
+                while (offset + (int)sizeof(size) <= packet.length)
+                {
+                    memcpy(&size, packet.data + offset, sizeof(size));
+                    offset += (int)sizeof(size);
+
+                    if (size < header or size > packet.length - offset)
+                    {
+                        break;
+                    }
+
+                    memcpy(&hdr, packet.data + offset, sizeof(hdr));
+                    offset += size;
+                    found = true;
+                }
+
+                if (not found or hdr.type == UdpMsg::Bundle)
+                {
+                    return;
+                }
+            }
+
+            _wire[packet.peer].last_sent = hdr;
+            _wire[packet.peer].sent = true;
+        }
+
+        // reply to every QualityReport and SyncRequest in the packet, true if none of them are left for the session
+        bool
+            Answer(const TransportPacket& packet, uint64_t arrived_ns)
+        {
+            const int header = (int)((char*)&_scratch.u - (char*)&_scratch);
+
+            if (packet.peer >= NETWORK_THREAD_MAX_PEERS or packet.length < header)
+            {
+                return false;
+            }
+
+            UdpMsg* msg = ReceivedMsg(packet, &_scratch);
+
+            if (msg->hdr.type != UdpMsg::Bundle)
+            {
+                return AnswerMsg(packet.peer, msg, packet.length, arrived_ns);
+            }
+
+            bool answered = true;
+            int offset = header;
+            uint16_t size;
+
+            while (offset + (int)sizeof(size) <= packet.length)
+            {
+                memcpy(&size, packet.data + offset, sizeof(size));
+                offset += (int)sizeof(size);
+
+                // UdpProtocol::OnBundle() complains about it, just leave it alone
+                if (size < header or size > sizeof(UdpMsg) or size > packet.length - offset)
+                {
+                    return false;
+                }
+
+                memcpy((void*)&_scratch, packet.data + offset, size);
+                offset += size;
+
+                answered = AnswerMsg(packet.peer, &_scratch, size, arrived_ns) and answered;
+            }
+
+            return answered;
+        }
+
+        // false for a QualityReport or SyncRequest the session has to answer itself
+        bool
+            AnswerMsg(PeerId peer, UdpMsg* msg, int len, uint64_t arrived_ns)
+        {
+            PeerWire& wire = _wire[peer];
+
+            if (not wire.remote_magic)
+            {
+                wire.remote_magic = msg->hdr.magic;
+            }
+
+            if (msg->hdr.type != UdpMsg::QualityReport and msg->hdr.type != UdpMsg::SyncRequest)
+            {
+                return true;
+            }
+
+            // nothing of ours to go on yet, or someone the session would turn away (see UdpProtocol::OnSyncRequest())
+            if (not wire.sent or msg->hdr.magic != wire.remote_magic or len < msg->PacketSize())
+            {
+                return false;
+            }
+
+            if (msg->hdr.type == UdpMsg::SyncRequest and msg->u.sync_request.protocol_version != UDP_PROTOCOL_VERSION)
+            {
+                return false;
+            }
+
+            UdpMsg reply(msg->hdr.type == UdpMsg::QualityReport ? UdpMsg::QualityReply : UdpMsg::SyncReply);
+
+            // not a new sequence number and nothing new to ack, the other side doesn't mark replies received (see UdpProtocol::OnMsg())
+            reply.hdr = wire.last_sent;
+            reply.hdr.type = (uint8_t)(msg->hdr.type == UdpMsg::QualityReport ? UdpMsg::QualityReply : UdpMsg::SyncReply);
+            reply.hdr.ack_bits = 0;
+
+            if (msg->hdr.type == UdpMsg::QualityReport)
+            {
+                const uint64_t now = MonotonicClock::Get().NowNS();
+
+                reply.u.quality_reply.pong = msg->u.quality_report.ping;
+                reply.u.quality_reply.hold = (uint32_t)((now - GGPO_MIN(arrived_ns, now)) / 1000);
+            }
+            else
+            {
+                reply.u.sync_reply.random_reply = msg->u.sync_request.random_request;
+                reply.u.sync_reply.protocol_version = UDP_PROTOCOL_VERSION;
+            }
+
+            TransportPacket packet;
+            packet.peer = peer;
+            packet.data = (const uint8_t*)&reply;
+            packet.length = reply.PacketSize();
+
+            _inner->Send(&packet, 1);
+            _replied = true;
+            return true;
+        }
+
+        void
+            Run(function<unique_ptr<Transport>()> create)
+        {
+            {
+                lock_guard<mutex> lock(_lock);
+                _inner = create();
+                _reliable = _inner and _inner->IsReliable();
+                _started = true;
+            }
+            _done.notify_all();
+
+            if (not _inner)
+            {
+                return;
+            }
+
+            TransportPacket packets[TRANSPORT_BATCH_SIZE];
+            PeerId highest_peer = INVALID_PEER_ID;
+
+            while (not _stop.load(memory_order_acquire))
+            {
+                bool busy = false;
+
+                if (_resolve_pending.load(memory_order_acquire))
+                {
+                    {
+                        lock_guard<mutex> lock(_lock);
+                        _resolve.result = _inner->Resolve(_resolve.ip, _resolve.port, _resolve.peer);
+                        if (_resolve.result)
+                        {
+                            highest_peer = GGPO_MAX(highest_peer, *_resolve.peer);
+                        }
+                        _resolve_pending.store(false, memory_order_release);
+                    }
+                    _done.notify_all();
+                }
+
+                // outgoing, in the order the session sent them
+                int count = 0;
+                NetworkThreadPacket* slot;
+
+                while (count < TRANSPORT_BATCH_SIZE and (slot = _outbox.At(count)))
+                {
+                    packets[count].peer = slot->peer;
+                    packets[count].data = slot->data;
+                    packets[count].length = slot->length;
+                    NoteSent(packets[count]);
+                    count++;
+                }
+
+                if (count > 0)
+                {
+                    _inner->Send(packets, count);
+                    _inner->Flush();
+
+                    for (int i = 0; i < count; i++)
+                    {
+                        _outbox.Pop();
+                    }
+                    busy = true;
+                }
+
+                // incoming, only when there's room for a whole batch.  Otherwise it waits in the kernel for the game to catch up
+                const bool room = _inbox.FreeSlots() >= TRANSPORT_BATCH_SIZE;
+
+                if (room)
+                {
+                    count = _inner->Receive(packets, TRANSPORT_BATCH_SIZE);
+
+                    const uint64_t now = MonotonicClock::Get().NowNS();
+
+                    for (int i = 0; i < count; i++)
+                    {
+                        slot = _inbox.BeginPush();
+                        slot->peer = packets[i].peer;
+                        slot->length = GGPO_MIN(packets[i].length, MAX_UDP_PACKET_SIZE);
+                        slot->arrived_ns = now - GGPO_MIN(packets[i].age_ns, now);
+                        slot->answered = Answer(packets[i], slot->arrived_ns);
+                        memcpy(slot->data, packets[i].data, slot->length);
+                        _inbox.CommitPush();
+
+                        highest_peer = GGPO_MAX(highest_peer, packets[i].peer);
+                    }
+                    busy = busy or count > 0;
+
+                    if (_replied)
+                    {
+                        _inner->Flush();
+                        _replied = false;
+                    }
+                }
+
+                if (_reliable)
+                {
+                    for (PeerId peer = 1; peer <= highest_peer and peer < NETWORK_THREAD_MAX_PEERS; peer++)
+                    {
+                        _stream_ids[peer].store(_inner->StreamId(peer), memory_order_release);
+                    }
+                }
+
+                if (not busy)
+                {
+                    Sleep(room);
+                }
+            }
+
+            // the transport (and its logger) was born on this thread, it dies here too
+            _inner->Flush();
+            _inner.reset();
+        }
+
+        unique_ptr<Transport> _inner;
+        bool _reliable = false;
+        bool _started = false;
+
+        thread _thread;
+        atomic<bool> _stop{ false };
+
+        mutex _lock;                      /* only for Resolve() and napping, packets never take it */
+        condition_variable _wake;         /* game thread -> network thread, when it naps */
+    #if !(defined(_WIN32) || defined(_WIN64))
+        int _wake_pipe[2] = { -1, -1 };   /* game thread -> network thread, when it's in poll() */
+        atomic<bool> _polling{ false };
+    #endif
+        condition_variable _done;         /* network thread -> game thread */
+        ResolveRequest _resolve = {};
+        atomic<bool> _resolve_pending{ false };
+
+        SpscRing<NetworkThreadPacket, NETWORK_THREAD_QUEUE_SIZE> _inbox;
+        SpscRing<NetworkThreadPacket, NETWORK_THREAD_QUEUE_SIZE> _outbox;
+        int _handed_out = 0;
+
+        atomic<uint32_t> _stream_ids[NETWORK_THREAD_MAX_PEERS] = {};
+        uint32_t _stream_breaks[NETWORK_THREAD_MAX_PEERS] = {};   /* game thread only, messages Send() had to drop per peer */
+
+        PeerWire _wire[NETWORK_THREAD_MAX_PEERS];   /* network thread only */
+        UdpMsg _scratch = UdpMsg(UdpMsg::Invalid);
+        bool _replied = false;                      /* Answer() sent something that still needs a Flush() */
+
+        unique_ptr<Logger> threaded_transport_logger = nullptr;
+    };
+}
+
+//==================================================================================== Memory Transport ============================================================================================//
+
+namespace GGPO
+{
+    class MemoryTransport;
+
+    /*
+     * A pretend network for tests and benchmarks, no sockets and no threads.  Every
+     * MemoryTransport on the same network can reach the others by the ip/port it was
+     * attached with.  Send copies the message into the receiver's inbox and Receive
+     * hands it out once it's due.  Delay, jitter and loss work like netem (so jitter
+     * can reorder), timed off whatever clock you give it so a whole session can run
+     * on simulated time.
+     */
+    class MemoryNetwork
+    {
+    public:
+        struct Link
+        {
+            uint64_t    delay_us = 0;
+            uint64_t    jitter_us = 0;
+            int         loss_percent = 0;
+        };
+
+        MemoryNetwork(IClock* clock = nullptr, uint32_t seed = 1) :
+            _clock(clock ? clock : &MonotonicClock::Get()),
+            _random(seed ? seed : 1)
+        {
+        }
+
+        // applies to everything sent from here on, both directions
+        void
+            SetLink(const Link& link)
+        {
+            _link = link;
+        }
+
+        static string
+            Address(const char* ip, uint16_t port)
+        {
+            return string(ip) + ":" + to_string(port);
+        }
+
+    protected:
+        friend class MemoryTransport;
+
+        void
+            Attach(const string& address, MemoryTransport* transport)
+        {
+            _nodes[address] = transport;
+        }
+
+        void
+            Detach(const string& address)
+        {
+            _nodes.erase(address);
+        }
+
+        void
+            Deliver(const string& from, const string& to, const uint8_t* data, int length);
+
+        // xorshift, same seed same losses so a flaky looking test fails the same way every run
+        uint32_t
+            Random()
+        {
+            _random ^= _random << 13;
+            _random ^= _random >> 17;
+            _random ^= _random << 5;
+            return _random;
+        }
+
+        IClock*     _clock;
+        uint32_t    _random;
+        Link        _link;
+
+        unordered_map<string, MemoryTransport*> _nodes;
+    };
+
+    class MemoryTransport : public Transport
+    {
+    public:
+        MemoryTransport(MemoryNetwork& network, const char* ip, uint16_t port) :
+            _network(network),
+            _address(MemoryNetwork::Address(ip, port))
+        {
+            _network.Attach(_address, this);
+        }
+
+        ~MemoryTransport()
+        {
+            _network.Detach(_address);
+        }
+
+        bool
+            Resolve(const char* ip, uint16_t port, PeerId* peer) override
+        {
+            const string address = MemoryNetwork::Address(ip, port);
+
+            *peer = FindPeer(address);
+
+            if (*peer == INVALID_PEER_ID)
+            {
+                _peers.push_back(address);
+                *peer = (PeerId)_peers.size();
+            }
+
+            return true;
+        }
+
+        void
+            Send(const TransportPacket* packets, int count) override
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (packets[i].peer != INVALID_PEER_ID and packets[i].peer <= _peers.size())
+                {
+                    _network.Deliver(_address, _peers[packets[i].peer - 1], packets[i].data, packets[i].length);
+                }
+            }
+        }
+
+        int
+            Receive(TransportPacket* packets, int max) override
+        {
+            const uint64_t now = _network._clock->NowUS();
+            int count = 0;
+
+            _handed_out.clear(); // the last batch is done with
+
+            while (count < max and not _inbox.empty() and _inbox.front().deliver_at <= now)
+            {
+                _handed_out.push_back(move(_inbox.front()));
+                _inbox.pop_front();
+
+                const Packet& packet = _handed_out.back();
+                const PeerId peer = FindPeer(packet.from);
+
+                if (peer != INVALID_PEER_ID)
+                {
+                    packets[count].peer = peer;
+                    packets[count].data = packet.bytes.data();
+                    packets[count].length = (int)packet.bytes.size();
+                    packets[count].age_ns = (now - packet.deliver_at) * 1000ULL; // like a kernel timestamp would
+                    count++;
+                }
+            }
+
+            return count;
+        }
+
+        // everything in the inbox, due or not
+        size_t
+            Pending()
+            const
+        {
+            return _inbox.size();
+        }
+
+    protected:
+        friend class MemoryNetwork;
+
+        struct Packet
+        {
+            string              from;
+            uint64_t            deliver_at = 0;
+            vector<uint8_t>     bytes;
+        };
+
+        void
+            Enqueue(Packet&& packet)
+        {
+            // keep the inbox in delivery order, jitter can put a packet ahead of ones sent before it
+            auto it = _inbox.end();
+
+            while (it != _inbox.begin() and prev(it)->deliver_at > packet.deliver_at)
+            {
+                --it;
+            }
+
+            _inbox.insert(it, move(packet));
+        }
+
+        PeerId
+            FindPeer(const string& address)
+            const
+        {
+            for (size_t i = 0; i < _peers.size(); i++)
+            {
+                if (_peers[i] == address)
+                {
+                    return (PeerId)(i + 1);
+                }
+            }
+
+            return INVALID_PEER_ID;
+        }
+
+        MemoryNetwork&      _network;
+        string              _address;
+        vector<string>      _peers;
+
+        deque<Packet>       _inbox;
+        vector<Packet>      _handed_out; // moving a Packet keeps its bytes where they are, so this can grow
+    };
+
+    inline void
+        MemoryNetwork::Deliver(const string& from, const string& to, const uint8_t* data, int length)
+    {
+        auto it = _nodes.find(to);
+
+        if (it == _nodes.end())
+        {
+            return; // nobody there, same as udp to a closed port
+        }
+
+        if (_link.loss_percent > 0 and (int)(Random() % 100) < _link.loss_percent)
+        {
+            return;
+        }
+
+        MemoryTransport::Packet packet;
+        packet.from = from;
+        packet.deliver_at = _clock->NowUS() + _link.delay_us + (_link.jitter_us ? Random() % (_link.jitter_us + 1) : 0);
+        packet.bytes.assign(data, data + length);
+
+        it->second->Enqueue(move(packet));
+    }
+}
+
+//==================================================================================== UdpProtocol ============================================================================================//
+
+constexpr int UDP_HEADER_SIZE = 28;     /* Size of IP + UDP headers */
+constexpr int NUM_SYNC_PACKETS = 5;
+constexpr int SYNC_RETRY_INTERVAL = 2000;
+constexpr int SYNC_FIRST_RETRY_INTERVAL = 500;
+constexpr int RUNNING_RETRY_INTERVAL = 200;
+constexpr int KEEP_ALIVE_INTERVAL = 200;
+constexpr int QUALITY_REPORT_INTERVAL = 1000;
+constexpr int NETWORK_STATS_INTERVAL = 1000;
+constexpr int UDP_SHUTDOWN_TIMER = 5000;
+constexpr int MAX_SEQ_DISTANCE = (1 << 15);
+constexpr int EVENT_QUEUE_LENGTH = 64;
+constexpr int MAX_EARLY_INPUTS = 16;     /* input packets held while we wait for the one in front of them, a burst's worth */
+constexpr int SACK_WINDOW = 32;          /* sequence numbers one ack covers, the bits in UdpMsg::hdr.ack_bits */
+constexpr int FAST_RETRANSMIT_THRESHOLD = 3; /* acks for later packets before an input packet counts as lost */
+constexpr int MIN_RETRANSMIT_TIMEOUT = 10;   /* ms, floor on the rtt based resend timer (RUNNING_RETRY_INTERVAL is the ceiling) */
+constexpr int MAX_RETRANSMIT_BACKOFF = 4;    /* resend timer doubles per timeout in a row, up to this many times */
+constexpr int DELAYED_ACK_INTERVAL = 16;     /* ms an ack waits for something else to carry it, about a frame, see AckPolicy */
+constexpr int MAX_SEND_DELAY = 16;           /* ms a SendMsgLater() waits for something more urgent to share a datagram with */
+
+constexpr uint64_t US_PER_MS = 1000; /* the intervals above are in ms, the protocol clock runs in us */
+
+namespace GGPO
+{
+    class UdpProtocol : public IPollSink
+    {
+    private:
+        unique_ptr<Logger> udp_protocol_logger = nullptr;
+
+    public:
+        struct Stats
+        {
+            int                 ping;
+            int                 remote_frame_advantage;
+            int                 local_frame_advantage;
+            int                 send_queue_len;
+            Udp::Stats        udp;
+        };
+
+        struct Event 
+        {
+            enum Type 
+            {
+                Unknown = -1,
+                Connected,
+                Synchronizing,
+                Synchronzied,
+                Input,
+                Disconnected,
+                NetworkInterrupted,
+                NetworkResumed,
+            };
+
+            Type      type;
+            union 
+            {
+                struct 
+                {
+                    GameInput   input;
+                } input;
+                struct 
+                {
+                    int         total;
+                    int         count;
+                } synchronizing;
+                struct 
+                {
+                    int         disconnect_timeout;
+                } network_interrupted;
+            } u;
+
+            Event(Type t = Unknown) : type(t) { }
+        };
+
+    public:
+        virtual bool
+            OnLoopPoll(void* cookie)
+        {
+            if (not _transport)
+            {
+                return true;
+            }
+
+            uint64_t now = _clock->NowUS();
+            unsigned int next_interval;
+            const SentInput* oldest;
+
+            switch (_current_state)
+            {
+            case Syncing:
+                next_interval = (_state.sync.roundtrips_remaining == NUM_SYNC_PACKETS) ? SYNC_FIRST_RETRY_INTERVAL : SYNC_RETRY_INTERVAL;
+                if (_last_send_time and _last_send_time + next_interval * US_PER_MS < now)
+                {
+                    udp_protocol_logger->Info(format("No luck syncing after {} ms... Re-queueing sync packet.", next_interval), "udp_proto.cpp");
+                    SendSyncRequest();
+                }
+                break;
+
+            case Running:
+                // oldest input packet still unacked after a timeout's worth, resend and back off until something gets acked
+                oldest = OldestUnackedInput();
+
+                if (oldest and oldest->send_time + RetransmitTimeout() < now)
+                {
+                    udp_protocol_logger->Info(format("input packet {} unacked after {} us.  Resending from frame {}.", oldest->seq, RetransmitTimeout(), _last_acked_input.frame + 1), "udp_proto.cpp");
+
+                    _unacked_inputs.Clear();
+                    _retransmit_backoff = GGPO_MIN(_retransmit_backoff + 1, MAX_RETRANSMIT_BACKOFF);
+                    _last_retransmit_time = now;
+                    SendPendingOutput();
+                }
+
+                // xxx: rig all this up with a timer wrapper
+                if (not _state.running.last_input_packet_recv_time or _state.running.last_input_packet_recv_time + RUNNING_RETRY_INTERVAL * US_PER_MS < now)
+                {
+                    udp_protocol_logger->Info(format("Haven't exchanged packets in a while (last received:{}  last sent:{}).  Resending.", _last_received_input.frame, _last_sent_input.frame), "udp_proto.cpp");
+                    SendPendingOutput();
+                    _state.running.last_input_packet_recv_time = now;
+                }
+
+                if (not _state.running.last_quality_report_time or _state.running.last_quality_report_time + QUALITY_REPORT_INTERVAL * US_PER_MS < now)
+                {
+                    UdpMsg* msg = new UdpMsg(UdpMsg::QualityReport);
+                    msg->u.quality_report.ping = (uint32_t)_clock->NowUS(); // only the low 32 bits, see OnQualityReply()
+                    msg->u.quality_report.frame_advantage = (uint8_t)_local_frame_advantage;
+                    SendMsgLater(msg);
+                    _state.running.last_quality_report_time = now;
+                }
+
+                if (not _state.running.last_network_stats_interval or _state.running.last_network_stats_interval + NETWORK_STATS_INTERVAL * US_PER_MS < now)
+                {
+                    UpdateNetworkStats();
+                    _state.running.last_network_stats_interval = now;
+                }
+
+                // held an ack a frame and nothing went out to carry it
+                if (_ack_owed_since and _ack_owed_since + DELAYED_ACK_INTERVAL * US_PER_MS <= now)
+                {
+                    SendInputAck();
+                }
+
+                if (_last_send_time and _last_send_time + KEEP_ALIVE_INTERVAL * US_PER_MS < now)
+                {
+                    udp_protocol_logger->Info("Sending keep alive packet", "udp_proto.cpp");
+                    SendMsgLater(new UdpMsg(UdpMsg::KeepAlive));
+                }
+
+                if
+                    (
+                        _disconnect_timeout and
+                        _disconnect_notify_start and
+                        not _disconnect_notify_sent and
+                        (_last_recv_time + _disconnect_notify_start * US_PER_MS < now)
+                        )
+                {
+                    udp_protocol_logger->Info(format("Endpoint has stopped receiving packets for {} ms.  Sending notification.", _disconnect_notify_start), "udp_proto.cpp");
+                    Event e(Event::NetworkInterrupted);
+                    e.u.network_interrupted.disconnect_timeout = _disconnect_timeout - _disconnect_notify_start;
+                    QueueEvent(e);
+                    _disconnect_notify_sent = true;
+                }
+
+                if (_disconnect_timeout and (_last_recv_time + _disconnect_timeout * US_PER_MS < now))
+                {
+                    if (not _disconnect_event_sent)
+                    {
+                        udp_protocol_logger->Info(format("Endpoint has stopped receiving packets for {} ms.  Disconnecting.", _disconnect_timeout), "udp_proto.cpp");
+                        QueueEvent(Event(Event::Disconnected));
+                        _disconnect_event_sent = true;
+                    }
+                }
+                break;
+
+            case Disconnected:
+                if (_shutdown_timeout < now)
+                {
+                    udp_protocol_logger->Info("Shutting down udp connection.", "udp_proto.cpp");
+                    _transport = NULL;
+                    _shutdown_timeout = 0;
+                }
+            }
+
+            return true;
+        }
+
+    public:
+        UdpProtocol() :
+            _transport(NULL),
+            _magic_number(0),
+            _queue(-1),
+            _remote_magic_number(0),
+            _connected(false),
+            _round_trip_time(0),
+            _packets_sent(0),
+            _bytes_sent(0),
+            _stats_start_time(0),
+            _local_frame_advantage(0),
+            _remote_frame_advantage(0),
+            _last_send_time(0),
+            _last_recv_time(0),
+            _recv_time(0),
+            _shutdown_timeout(0),
+            _disconnect_event_sent(false),
+            _disconnect_timeout(0),
+            _disconnect_notify_start(0),
+            _disconnect_notify_sent(false),
+            _next_send_seq(0),
+            _next_recv_seq(0),
+            _clock(&MonotonicClock::Get())
+        {
+            udp_protocol_logger = Logger::CreateUnique("UDPProtocolLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+
+            GGPO_ASSERT(udp_protocol_logger)
+
+            _last_sent_input.init(-1, NULL, 1);
+            _last_received_input.init(-1, NULL, 1);
+            _last_acked_input.init(-1, NULL, 1);
+            _stream_id = 0;
+            _send_burst = PLAYER_SEND_BURST;
+            _max_datagram = MAX_DATAGRAM_SIZE;
+            _ack_policy = AckPolicy::Delayed;
+            _ack_owed_since = 0;
+            _send_now = false;
+            _coalesce = true;
+
+            _recv_seq_high = 0;
+            _recv_seq_bits = 0;
+            _last_retransmit_time = 0;
+            _retransmit_backoff = 0;
+
+            memset(&_state, 0, sizeof _state);
+            memset(_peer_connect_status, 0, sizeof(_peer_connect_status));
+            for (int i = 0; i < GGPO_ARRAY_SIZE(_peer_connect_status); i++) {
+                _peer_connect_status[i].last_frame = -1;
+            }
+            _peer_connect_status_changes = 0;
+            _peer = INVALID_PEER_ID;
+            _oo_packet.msg = NULL;
+
+            _send_latency = Platform::GetConfigInt("ggpo.network.delay");
+            _oop_percent = Platform::GetConfigInt("ggpo.oop.percent");
+
+            _pending_output.Allocate(PENDING_OUTPUT_LENGTH);
+            _event_queue.Allocate(EVENT_QUEUE_LENGTH);
+        }
+
+        virtual 
+            ~UdpProtocol()
+        {
+            ClearSendQueue();
+        }
+
+        /*
+         * False when the transport can't resolve ip/port.  The endpoint stays
+         * uninitialized then (see IsInitialized) and never sends anything.
+         */
+        bool
+            Init
+            (
+                Transport* transport,
+                Poll& poll,
+                int queue,
+                char* ip,
+                uint16_t port,
+                UdpMsg::connect_status* status,
+                int pending_output_length = PENDING_OUTPUT_LENGTH,
+                int send_burst = PLAYER_SEND_BURST
+            )
+        {
+            _transport = transport;
+            _queue = queue;
+            _local_connect_status = status;
+            _send_burst = send_burst;
+
+            if (_pending_output.MaxCapacity() != (size_t)pending_output_length)
+            {
+                _pending_output.Allocate(pending_output_length);
+            }
+
+            if (not _transport->Resolve(ip, port, &_peer))
+            {
+                udp_protocol_logger->Error(format("transport can't resolve peer address {} port {} (the built in ones need a numeric v4 or v6 address, and a dual stack socket for v6).", ip, port), "udp_proto.cpp");
+                _transport = NULL;
+                return false;
+            }
+
+            do {
+                _magic_number = (uint16_t)rand();
+            } while (_magic_number == 0);
+            poll.RegisterLoop(this);
+
+            return true;
+        }
+
+        /*
+         * nullptr goes back to the platform clock.  Set it before Synchronize(), the
+         * timestamps already taken don't get converted.
+         */
+        void
+            SetClock(IClock* clock)
+        {
+            _clock = clock ? clock : &MonotonicClock::Get();
+        }
+
+        /*
+         * How many events can pile up between GetEvent() drains.  Every input frame
+         * we take is one, so this also caps how far one poll can catch us up, the
+         * rest waits in the sender's pending output.  Call it before Synchronize().
+         */
+        void
+            SetEventQueueLength(int length)
+        {
+            _event_queue.Allocate(GGPO_MAX(length, EVENT_QUEUE_LENGTH));
+        }
+
+        void
+            SetAckPolicy(AckPolicy policy)
+        {
+            _ack_policy = policy;
+        }
+
+        // see SessionLimits::coalesce
+        void
+            SetCoalescing(bool on)
+        {
+            _coalesce = on;
+        }
+
+        // see SessionLimits::max_datagram_size
+        void
+            SetMaxDatagramSize(int size)
+        {
+            _max_datagram = GGPO_MIN(GGPO_MAX(size, MIN_DATAGRAM_SIZE), MAX_UDP_PACKET_SIZE);
+        }
+
+        // smallest datagram cap that still fits one frame of input_size bytes with all of them changed
+        static int
+            MinDatagramSizeFor(int input_size)
+        {
+            const int frame_bits = 1 + input_size * (9 + InputCodec_IndexBits(input_size));
+            return ((int)offsetof(UdpMsg, u.input.bits) + (frame_bits + 7) / 8 + 7) & ~7;
+        }
+
+        /*
+         * Sends everything queued since the last one.  The backends call it once at
+         * the end of every DoPoll() and after AddLocalInput(), so whatever one tick
+         * has for this peer (input, acks, resends) goes out as one datagram instead
+         * of one each.  Quality reports and keep alives can wait a frame for the next
+         * input to carry them, see SendMsgLater().
+         */
+        void
+            Flush()
+        {
+            if (not _transport or _send_queue.IsEmpty())
+            {
+                return;
+            }
+
+            // only SendMsgLater()s queued, give them a frame for something to ride with
+            if (_send_now or _send_queue.Front().queue_time + MAX_SEND_DELAY * US_PER_MS <= _clock->NowUS())
+            {
+                PumpSendQueue();
+            }
+        }
+
+        void
+            Synchronize()
+        {
+            if (_transport)
+            {
+                _current_state = Syncing;
+                _state.sync.roundtrips_remaining = NUM_SYNC_PACKETS;
+                SendSyncRequest();
+            }
+        }
+
+        bool
+            GetPeerConnectStatus(int id, int* frame)
+        {
+            *frame = _peer_connect_status[id].last_frame;
+            return !_peer_connect_status[id].disconnected;
+        }
+
+        /*
+         * Bit per queue whose peer connect status moved since the last call, so the
+         * backend only has to look at what an input packet actually changed.
+         */
+        uint32_t
+            TakePeerConnectStatusChanges()
+        {
+            uint32_t changes = _peer_connect_status_changes;
+            _peer_connect_status_changes = 0;
+            return changes;
+        }
+
+        void
+            SendInput(GameInput& input)
+        {
+            if (_transport)
+            {
+                if (_current_state == Running)
+                {
+                    /*
+                     * Check to see if this is a good time to adjust for the rift...
+                     */
+                    _timesync.advance_frame(input, _local_frame_advantage, _remote_frame_advantage);
+
+                    /*
+                     * Save this input packet
+                     *
+                     * XXX: This queue may fill up for spectators who do not ack input packets in a timely
+                     * manner.  When this happens, we can either resize the queue (ug) or disconnect them
+                     * (better, but still ug).  For the meantime, make this queue really big to decrease
+                     * the odds of this happening...
+                     */
+                    if (not _pending_output.TryPush(input))
+                    {
+                        udp_protocol_logger->Error(format("pending output full, dropped input for frame {}.", input.frame), "udp_proto.cpp");
+                    }
+                }
+                SendPendingOutput();
+            }
+        }
+
+        // every message in a bundle goes through OnMsg() like it came on its own, see BundleMessages()
+        void
+            OnBundle(UdpMsg* bundle, int len, uint64_t age_ns, bool answered)
+        {
+            const uint8_t* data = (const uint8_t*)bundle;
+            int offset = (int)((char*)&bundle->u - (char*)bundle);
+            UdpMsg msg(UdpMsg::Invalid);
+
+            while (offset + (int)sizeof(uint16_t) <= len)
+            {
+                uint16_t size;
+                memcpy(&size, data + offset, sizeof(size));
+                offset += (int)sizeof(size);
+
+                if (size > sizeof(UdpMsg) or size > len - offset or size < (int)((char*)&msg.u - (char*)&msg))
+                {
+                    udp_protocol_logger->Error(format("malformed bundle, message of {} bytes at offset {} of {}.", size, offset, len), "udp_proto.cpp");
+                    return;
+                }
+
+                memcpy((void*)&msg, data + offset, size);
+                offset += size;
+
+                if (msg.hdr.type == UdpMsg::Bundle)
+                {
+                    udp_protocol_logger->Error("bundle inside a bundle, dropping the rest.", "udp_proto.cpp");
+                    return;
+                }
+
+                OnMsg(&msg, size, age_ns, answered);
+            }
+        }
+
+        // nothing but the header, see QueueMsg()
+        void
+            SendInputAck()
+        {
+            SendMsg(new UdpMsg(UdpMsg::InputAck));
+        }
+
+        bool
+            HandlesMsg
+            (
+                PeerId from,
+                UdpMsg* msg
+            )
+        {
+            if (not _transport)
+            {
+                return false;
+            }
+
+            return _peer == from;
+        }
+
+        // age_ns and answered: how long ago the transport says it really arrived and whether it replied already, see TransportPacket
+        void
+            OnMsg(UdpMsg* msg, int len, uint64_t age_ns = 0, bool answered = false)
+        {
+            if (msg->hdr.type == UdpMsg::Bundle)
+            {
+                OnBundle(msg, len, age_ns, answered);
+                return;
+            }
+
+            bool handled = false;
+            bool late = false;
+            const uint64_t now = _clock->NowUS();
+
+            _recv_time = now - GGPO_MIN(age_ns / 1000, now);
+            _recv_answered = answered;
+
+            typedef bool (UdpProtocol::* DispatchFn)(UdpMsg* msg, int len);
+
+            static const DispatchFn table[] =
+            {
+               &UdpProtocol::OnInvalid,             /* Invalid */
+               &UdpProtocol::OnSyncRequest,         /* SyncRequest */
+               &UdpProtocol::OnSyncReply,           /* SyncReply */
+               &UdpProtocol::OnInput,               /* Input */
+               &UdpProtocol::OnQualityReport,       /* QualityReport */
+               &UdpProtocol::OnQualityReply,        /* QualityReply */
+               &UdpProtocol::OnKeepAlive,           /* KeepAlive */
+               &UdpProtocol::OnInputAck,            /* InputAck */
+            };
+
+            // filter out messages that don't match what we expect
+            uint16_t seq = msg->hdr.sequence_number;
+
+            if (msg->hdr.type != UdpMsg::SyncRequest and msg->hdr.type != UdpMsg::SyncReply)
+            {
+                if (msg->hdr.magic != _remote_magic_number)
+                {
+                    LogMsg("recv rejecting", msg);
+                    return;
+                }
+
+                // filter out out-of-order packets
+                uint16_t skipped = (uint16_t)((int)seq - (int)_next_recv_seq);
+                // Log("checking sequence number -> next - seq : %d - %d = %d\n", seq, _next_recv_seq, skipped);
+                if (skipped > MAX_SEQ_DISTANCE)
+                {
+                    // except inputs, packets from one burst can pass each other and a late one can still have frames we need (see OnInput)
+                    if (msg->hdr.type != UdpMsg::Input)
+                    {
+                        udp_protocol_logger->Info(format("dropping out of order packet (seq: {}, last seq:{})", seq, _next_recv_seq), "udp_proto.cpp");
+                        return;
+                    }
+
+                    late = true;
+                }
+            }
+
+            if (not late)
+            {
+                _next_recv_seq = seq;
+            }
+
+            LogMsg("recv", msg);
+
+            if (msg->hdr.type >= GGPO_ARRAY_SIZE(table))
+            {
+                OnInvalid(msg, len);
+            }
+            else
+            {
+                handled = (this->*(table[msg->hdr.type]))(msg, len);
+            }
+            if (handled)
+            {
+                _last_recv_time = GGPO_MAX(_last_recv_time, _recv_time);
+
+                // OnInput marks its own, not every input packet it handles got taken in.  Replies can come from
+                // their network thread on the sequence number of the last thing they sent (see ThreadedTransport),
+                // acking that would cover for the real packet if it was lost
+                if (msg->hdr.type != UdpMsg::Input and msg->hdr.type != UdpMsg::QualityReply and msg->hdr.type != UdpMsg::SyncReply)
+                {
+                    MarkReceived(seq);
+                }
+
+                if (msg->hdr.type != UdpMsg::SyncRequest and msg->hdr.type != UdpMsg::SyncReply)
+                {
+                    AckPendingOutput(msg->hdr.ack_frame);
+
+                    if (msg->hdr.ack_bits)
+                    {
+                        OnAcks(msg->hdr.ack_seq, msg->hdr.ack_bits);
+                    }
+                }
+
+                if (_disconnect_notify_sent and _current_state == Running)
+                {
+                    QueueEvent(Event(Event::NetworkResumed));
+                    _disconnect_notify_sent = false;
+                }
+            }
+        }
+
+        void
+            Disconnect()
+        {
+            _current_state = Disconnected;
+            _shutdown_timeout = _clock->NowUS() + UDP_SHUTDOWN_TIMER * US_PER_MS;
+        }
+
+        void
+            GetNetworkStats(struct NetworkStats* s) //wow great variable name tony GOOD FUCKING NAME
+        {
+            s->network.ping = (int)(_round_trip_time / US_PER_MS);
+            s->network.ping_us = _round_trip_time;
+            s->network.jitter_us = _rtt.GetVariance();
+            s->network.send_queue_len = _pending_output.CurrentSize();
+            s->network.kbps_sent = _kbps_sent;
+            s->timesync.remote_frames_behind = _remote_frame_advantage;
+            s->timesync.local_frames_behind = _local_frame_advantage;
+        }
+
+        bool
+            GetEvent(UdpProtocol::Event& e)
+        {
+            if (_event_queue.CurrentSize() == 0)
+            {
+                return false;
+            }
+
+            e = _event_queue.Front();
+            _event_queue.Pop();
+
+            return true;
+        }
+
+        void
+            SetLocalFrameNumber(int localFrame)
+        {
+            /*
+             * Estimate which frame the other guy is one by looking at the
+             * last frame they gave us plus some delta for the one-way packet
+             * trip time.
+             */
+            int remoteFrame = _last_received_input.frame + (int)(_round_trip_time * 60 / 1000000);
+
+            /*
+             * Our frame advantage is how many frames *behind* the other guy
+             * we are.  Counter-intuative, I know.  It's an advantage because
+             * it means they'll have to predict more often and our moves will
+             * pop more frequenetly.
+             */
+            _local_frame_advantage = remoteFrame - localFrame;
+        }
+
+        int
+            RecommendFrameDelay()
+        {
+            // XXX: require idle input should be a configuration parameter
+            return _timesync.recommend_frame_wait_duration(false, udp_protocol_logger.get());
+        }
+
+        float
+            RecommendFrameDilation()
+            const
+        {
+            return _timesync.recommend_frame_dilation();
+        }
+
+        void
+            SetDisconnectTimeout(int timeout)
+        {
+            _disconnect_timeout = timeout;
+        }
+
+        void
+            SetDisconnectNotifyStart(int timeout)
+        {
+            _disconnect_notify_start = timeout;
+        }
+
+        bool IsInitialized()
+        {
+            return _transport != NULL;
+        }
+
+        bool
+            IsSynchronized()
+            const
+        {
+            return _current_state == Running;
+        }
+
+        bool
+            IsRunning()
+            const
+        {
+            return _current_state == Running;
+        }
+
+    protected:
+        enum State
+        {
+            Syncing,
+            Synchronzied,
+            Running,
+            Disconnected
+        };
+
+        struct QueueEntry
+        {
+            uint64_t queue_time = 0;
+            PeerId dest = INVALID_PEER_ID;
+            UdpMsg* msg = nullptr;
+            int length = 0; /* bytes on the wire, PacketSize() when it was queued */
+
+            QueueEntry() {}
+            QueueEntry(uint64_t time, PeerId dst, UdpMsg* m, int len) : queue_time(time), dest(dst), msg(m), length(len) { }
+        };
+
+        // an input packet waiting to show up in their ack bits
+        struct SentInput
+        {
+            uint16_t seq = 0;
+            int start_frame = -1;
+            int last_frame = -1;
+            uint64_t send_time = 0;
+            bool acked = false;
+            bool resent = false;    /* a later packet has all its frames, losing this one doesn't matter anymore */
+        };
+
+        void
+            UpdateNetworkStats(void)
+        {
+            uint64_t now = _clock->NowUS();
+
+            if (_stats_start_time == 0)
+            {
+                _stats_start_time = now;
+            }
+
+            int total_bytes_sent = _bytes_sent + (UDP_HEADER_SIZE * _packets_sent);
+            float seconds = (float)((now - _stats_start_time) / 1000000.0);
+            float Bps = total_bytes_sent / seconds;
+            float udp_overhead = (float)(100.0 * (UDP_HEADER_SIZE * _packets_sent) / _bytes_sent);
+
+            _kbps_sent = int(Bps / 1024);
+
+            udp_protocol_logger->Info
+            (
+                format
+                (
+                    "Network Stats -- Bandwidth: {} KBps   Packets Sent: {} ({} pps)   " "KB Sent: {}    UDP Overhead: {}.",
+                    _kbps_sent,
+                    _packets_sent,
+                    _packets_sent / seconds,
+                    total_bytes_sent / 1024.0,
+                    udp_overhead
+                ),
+                "udp_proto.cpp"
+            );
+        }
+
+        void
+            QueueEvent(const UdpProtocol::Event& evt)
+        {
+            LogEvent("Queuing event", evt);
+            _event_queue.Push(evt);
+        }
+
+        void
+            ClearSendQueue(void)
+        {
+            while (not _send_queue.IsEmpty())
+            {
+                delete _send_queue.Front().msg;
+                _send_queue.Pop();
+            }
+        }
+
+        void
+            LogMsg
+            (
+                const char* prefix,
+                UdpMsg* msg
+            )
+        {
+            switch (msg->hdr.type)
+            {
+            case UdpMsg::SyncRequest:
+                udp_protocol_logger->Info(format("{} sync-request ({}).", prefix, msg->u.sync_request.random_request), "udp_proto.cpp");
+                break;
+
+            case UdpMsg::SyncReply:
+                udp_protocol_logger->Info(format("{} sync-reply ({}).", prefix, msg->u.sync_reply.random_reply), "udp_proto.cpp");
+                break;
+
+            case UdpMsg::QualityReport:
+                udp_protocol_logger->Info(format("{} quality report.", prefix), "udp_proto.cpp");
+                break;
+
+            case UdpMsg::QualityReply:
+                udp_protocol_logger->Info(format("{} quality reply.", prefix), "udp_proto.cpp");
+                break;
+
+            case UdpMsg::KeepAlive:
+                udp_protocol_logger->Info(format("{} keep alive.", prefix), "udp_proto.cpp");
+                break;
+
+            case UdpMsg::Input:
+                udp_protocol_logger->Info(format("{} game-compressed-input {} (+ {} bits).", prefix, msg->u.input.start_frame, msg->u.input.num_bits), "udp_proto.cpp");
+                break;
+
+            case UdpMsg::InputAck:
+                udp_protocol_logger->Info(format("{} input ack.", prefix), "udp_proto.cpp");
+                break;
+
+            default:
+                GGPO_ASSERT(false and "Unknown UdpMsg type.");
+            }
+        }
+
+        void
+            LogEvent
+            (
+                const char* prefix, 
+                const UdpProtocol::Event& evt
+            )
+        {
+            switch (evt.type)
+            {
+            case UdpProtocol::Event::Synchronzied:
+                udp_protocol_logger->Info(format("{} (event: Synchronzied).", prefix), "udp_proto.cpp");
+                break;
+            }
+        }
+
+        void
+            SendSyncRequest()
+        {
+            _state.sync.random = rand() & 0xFFFF;
+            UdpMsg* msg = new UdpMsg(UdpMsg::SyncRequest);
+            msg->u.sync_request.random_request = _state.sync.random;
+            msg->u.sync_request.protocol_version = UDP_PROTOCOL_VERSION;
+            SendMsg(msg);
+        }
+
+        // goes out at the next Flush()
+        void
+            SendMsg(UdpMsg* msg)
+        {
+            QueueMsg(msg);
+        }
+
+        // for the housekeeping (quality reports, keep alives): rides along with the next thing that has to go out, or goes on its own after MAX_SEND_DELAY
+        void
+            SendMsgLater(UdpMsg* msg)
+        {
+            QueueMsg(msg, true);
+        }
+
+        void
+            QueueMsg(UdpMsg* msg, bool later = false)
+        {
+            LogMsg("send", msg);
+
+            const int length = msg->PacketSize();
+
+            _last_send_time = _clock->NowUS();
+
+            msg->hdr.magic = _magic_number;
+            msg->hdr.sequence_number = _next_send_seq++;
+            msg->hdr.ack_seq = _recv_seq_high;
+            msg->hdr.ack_bits = _recv_seq_bits;
+            msg->hdr.ack_frame = _last_received_input.frame;
+
+            _ack_owed_since = 0;
+            _send_now |= not later;
+
+            if (_send_queue.IsFull())
+            {
+                PumpSendQueue();
+            }
+
+            if (_send_queue.IsFull())
+            {
+                // only when simulated latency is holding everything back, lose the oldest rather than leak it
+                delete _send_queue.Front().msg;
+                _send_queue.Pop();
+            }
+
+            _send_queue.Push(QueueEntry(_last_send_time, _peer, msg, length));
+
+            // every message its own datagram, right away
+            if (not _coalesce)
+            {
+                PumpSendQueue();
+            }
+        }
+
+        /*
+         * Anything in the header or the msg that's about when it was sent gets
+         * filled in again as it actually leaves, it could have sat in the queue
+         * for up to MAX_SEND_DELAY.
+         */
+        void
+            StampForSend(QueueEntry& entry)
+        {
+            UdpMsg* msg = entry.msg;
+            const uint64_t now = _clock->NowUS();
+
+            msg->hdr.ack_seq = _recv_seq_high;
+            msg->hdr.ack_bits = _recv_seq_bits;
+            msg->hdr.ack_frame = _last_received_input.frame;
+
+            if (msg->hdr.type == UdpMsg::QualityReport)
+            {
+                msg->u.quality_report.ping = (uint32_t)now;
+            }
+            else if (msg->hdr.type == UdpMsg::QualityReply)
+            {
+                msg->u.quality_reply.hold += (uint32_t)(now - entry.queue_time);
+            }
+        }
+
+        /*
+         * Remember an input packet until its seq shows up in their ack bits (or it's
+         * lost), see OnAcks().  Call it right before QueueMsg(), which hands out the
+         * seq and, with coalescing off, sends and deletes msg on the spot.
+         */
+        void
+            TrackInputMsg(UdpMsg* msg, int last_frame)
+        {
+            if (_transport->IsReliable())
+            {
+                return;
+            }
+
+            SentInput sent;
+            sent.seq = _next_send_seq;
+            sent.start_frame = msg->u.input.start_frame;
+            sent.last_frame = last_frame;
+            sent.send_time = _clock->NowUS();
+
+            // every send starts over from the last ack, so most of the time this one carries what's left of the ones before it
+            for (int i = 0; i < _unacked_inputs.CurrentSize(); i++)
+            {
+                SentInput& older = _unacked_inputs.At(i);
+
+                if (GGPO_MAX(older.start_frame, _last_acked_input.frame + 1) >= sent.start_frame and older.last_frame <= sent.last_frame)
+                {
+                    older.resent = true;
+                }
+            }
+
+            _unacked_inputs.Push(sent);
+        }
+
+        // an unacked input packet nothing since has covered for, and with frames they haven't acked
+        bool
+            NeedsResend(const SentInput& sent)
+        {
+            return not sent.acked and not sent.resent and sent.last_frame > _last_acked_input.frame;
+        }
+
+        // whether entry can go in a bundle, behind its uint16_t length
+        bool
+            CanBundle(const QueueEntry& entry)
+        {
+            const int header = (int)((char*)&entry.msg->u - (char*)entry.msg);
+
+            return header + (int)sizeof(uint16_t) + entry.length <= _max_datagram;
+        }
+
+        /*
+         * Packs queued messages from the front into _bundle until the next one doesn't
+         * fit, returns its length.  Each one keeps its own header (sequence number,
+         * acks), so on the other end they're handled like they came separately, see
+         * OnBundle().
+         */
+        int
+            BundleMessages()
+        {
+            UdpMsg* bundle = (UdpMsg*)_bundle;
+            int length = (int)((char*)&bundle->u - (char*)bundle);
+
+            memset(_bundle, 0, length);
+            bundle->hdr.magic = _magic_number;
+            bundle->hdr.type = UdpMsg::Bundle;
+
+            while (not _send_queue.IsEmpty() and CanBundle(_send_queue.Front()) and length + (int)sizeof(uint16_t) + _send_queue.Front().length <= _max_datagram)
+            {
+                QueueEntry& entry = _send_queue.Front();
+                const uint16_t size = (uint16_t)entry.length;
+
+                StampForSend(entry);
+
+                memcpy(_bundle + length, &size, sizeof(size));
+                memcpy(_bundle + length + sizeof(size), entry.msg, size);
+                length += (int)sizeof(size) + size;
+
+                delete entry.msg;
+                _send_queue.Pop();
+            }
+
+            return length;
+        }
+
+        void
+            PumpSendQueue()
+        {
+            TransportPacket batch[TRANSPORT_BATCH_SIZE];
+            UdpMsg* batch_msgs[TRANSPORT_BATCH_SIZE];
+            int count = 0;
+            bool bundled = false;
+
+            _send_now = false;
+
+            while (not _send_queue.IsEmpty())
+            {
+                QueueEntry& entry = _send_queue.Front();
+
+                if (_send_latency)
+                {
+                    // should really come up with a gaussian distributation based on the configured
+                    // value, but this will do for now.
+                    int jitter = (_send_latency * 2 / 3) + ((rand() % _send_latency) / 3);
+
+                    if (_clock->NowUS() < _send_queue.Front().queue_time + jitter * US_PER_MS)
+                    {
+                        break;
+                    }
+                }
+                if (_oop_percent and not _oo_packet.msg and not _transport->IsReliable() and ((rand() % 100) < _oop_percent))
+                {
+                    int delay = rand() % (_send_latency * 10 + 1000);
+
+                    if (entry.msg) //check for a nullptr dereference
+                    {
+                        udp_protocol_logger->Info(format("creating rogue oop (seq: {}  delay: {})", entry.msg->hdr.sequence_number, delay), "udp_proto.cpp");
+                    }
+                    else
+                    {
+                        //???????????????????????????????????????????????????????? WHY IS THIS HERE TONY ANSWER ME
+                    }
+
+                    _oo_packet.send_time = _clock->NowUS() + delay * US_PER_MS;
+                    _oo_packet.msg = entry.msg;
+                    _oo_packet.dest = entry.dest;
+                }
+                else if (_coalesce and not _send_latency and _send_queue.CurrentSize() > 1 and CanBundle(entry) and CanBundle(_send_queue.At(1)))
+                {
+                    GGPO_ASSERT(entry.dest != INVALID_PEER_ID);
+
+                    // there's only the one _bundle, the last one has to be gone before we reuse it
+                    if (bundled)
+                    {
+                        SendBatch(batch, batch_msgs, count);
+                        count = 0;
+                    }
+
+                    batch[count].peer = entry.dest;
+                    batch[count].data = _bundle;
+                    batch[count].length = BundleMessages();
+                    batch_msgs[count++] = NULL;
+                    bundled = true;
+
+                    if (count == TRANSPORT_BATCH_SIZE)
+                    {
+                        SendBatch(batch, batch_msgs, count);
+                        count = 0;
+                        bundled = false;
+                    }
+
+                    continue; // BundleMessages() popped what it took
+                }
+                else
+                {
+                    GGPO_ASSERT(entry.dest != INVALID_PEER_ID);
+
+                    StampForSend(entry);
+
+                    batch[count].peer = entry.dest;
+                    batch[count].data = (const uint8_t*)entry.msg;
+                    batch[count].length = entry.length;
+                    batch_msgs[count++] = entry.msg;
+
+                    if (count == TRANSPORT_BATCH_SIZE)
+                    {
+                        SendBatch(batch, batch_msgs, count);
+                        count = 0;
+                        bundled = false;
+                    }
+                }
+
+                _send_queue.Pop();
+            }
+
+            SendBatch(batch, batch_msgs, count);
+
+            if (_oo_packet.msg and _oo_packet.send_time < _clock->NowUS())
+            {
+                udp_protocol_logger->Info("sending rogue oop!", "udp_proto.cpp");
+
+                batch[0].peer = _oo_packet.dest;
+                batch[0].data = (const uint8_t*)_oo_packet.msg;
+                batch[0].length = _oo_packet.msg->PacketSize();
+                batch_msgs[0] = _oo_packet.msg;
+
+                SendBatch(batch, batch_msgs, 1);
+                _oo_packet.msg = NULL;
+            }
+        }
+
+        // everything that came due goes to the transport in one call, the msgs are done with after
+        void
+            SendBatch(const TransportPacket* batch, UdpMsg** msgs, int count)
+        {
+            if (count > 0)
+            {
+                _transport->Send(batch, count);
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                _packets_sent++;
+                _bytes_sent += batch[i].length;
+
+                delete msgs[i];
+            }
+        }
+
+        /*
+         * Normally one packet with everything since the last ack.  When that doesn't
+         * fit in a datagram (a spectator catching up after a stall, a long outage) up
+         * to _send_burst packets go out back to back.  The first one still starts at
+         * the ack, the rest only carry frames that haven't gone out yet, so the
+         * newest frames don't sit behind the same old ones going again every send
+         * until the ack comes back.  Whatever gets lost on the way is found by
+         * OnAcks() or the resend timer, which wind _last_sent_input back so it goes
+         * again (after a timeout every send starts over from the ack, until
+         * something gets acked).  Each one goes out at the length of what it
+         * carries, the transport still hands runs that happen to come out the
+         * same size to the kernel in one send (UDP_SEGMENT on linux).
+         *
+         * The receiver holds on to packets that start past what it has for a bit
+         * (StashEarlyInput) and takes them once the gap fills.  A peer that hasn't
+         * acked anything yet takes whatever start frame it sees first though, so it
+         * only gets one packet at a time.
+         */
+        void
+            SendPendingOutput()
+        {
+            UdpMsg* msg = new UdpMsg(UdpMsg::Input);
+            int j, offset = 0, last_frame = -1;
+            GameInput last;
+
+            if (_pending_output.CurrentSize())
+            {
+                last = _last_acked_input;
+                j = 0;
+
+                /*
+                 * Over a reliable transport everything we already sent on the current
+                 * stream is going to get there, only send what's new.  A new stream
+                 * means the old one died with who knows what in flight, so that case
+                 * (and plain udp's first packet) sends everything since the last ack
+                 * like always.
+                 */
+                const uint32_t stream_id = _transport->StreamId(_peer);
+
+                if (_transport->IsReliable() and stream_id == _stream_id)
+                {
+                    SkipSentOutput(j, last);
+                }
+                else if (stream_id != _stream_id)
+                {
+                    _last_sent_input = _last_acked_input;
+                }
+
+                _stream_id = stream_id;
+
+                // nothing acked since the resend timer went off, whatever's in flight is as good as gone
+                if (_retransmit_backoff)
+                {
+                    RewindSentOutput(_last_acked_input.frame);
+                }
+
+                const int burst = _last_acked_input.frame < 0 ? 1 : _send_burst;
+
+                for (int sent = 1; ; sent++)
+                {
+                    offset = EncodePendingOutput(msg, j, last);
+                    last_frame = last.frame;
+
+                    if (sent == 1 and not _transport->IsReliable())
+                    {
+                        SkipSentOutput(j, last);
+                    }
+
+                    if (j == _pending_output.CurrentSize() or sent >= burst)
+                    {
+                        break;
+                    }
+
+                    // queued, not sent, so the whole burst reaches the transport in one batch
+                    FinishInputMsg(msg, offset);
+                    TrackInputMsg(msg, last_frame);
+                    QueueMsg(msg);
+
+                    msg = new UdpMsg(UdpMsg::Input);
+                }
+            }
+            else
+            {
+                msg->u.input.start_frame = 0;
+                msg->u.input.input_size = 0;
+            }
 
-             int res = sendto(_socket, buffer, len, flags, dst, destlen);
+            FinishInputMsg(msg, offset);
 
-             if (res == GGPO_SOCKET_ERROR)
-             {
-                 GGPO_NETWORK_ERROR_CODE err = GGPO_GET_LAST_ERROR();
-                 udp_logger->Error(format("unknown error in sendto (erro: {}  wsaerr: {}).", res, err), "udp.cpp");
-                 GGPO_ASSERT(FALSE && "Unknown error in sendto");
-             }
+            if (offset)
+            {
+                TrackInputMsg(msg, last_frame);
+            }
 
-             char dst_ip[1024];
+            QueueMsg(msg);
+        }
 
-             udp_logger->Error(format("sent packet length {} to {}:{} (ret:{}).", len, inet_ntop(AF_INET, (void*)&to->sin_addr, dst_ip, GGPO_ARRAY_SIZE(dst_ip)), ntohs(to->sin_port), res), "udp.cpp");
-         }
+        // moves j past the pending output that already went out once
+        void
+            SkipSentOutput(int& j, GameInput& last)
+        {
+            while (j < _pending_output.CurrentSize() and _pending_output.At(j).frame <= _last_sent_input.frame)
+            {
+                last = _pending_output.At(j++);
+            }
+        }
 
-         virtual bool
-             OnLoopPoll(void* cookie)
-         {
-             uint8_t recv_buf[MAX_UDP_PACKET_SIZE];
-             sockaddr_in recv_addr;
-             int recv_addr_len;
+        // the next send goes over everything after frame again, see SendPendingOutput
+        void
+            RewindSentOutput(int frame)
+        {
+            if (frame >= _last_sent_input.frame)
+            {
+                return;
+            }
 
-             for (;;) //tf is this C style shiznit
-             {
-                 recv_addr_len = sizeof(recv_addr);
-                 int len = recvfrom(_socket, (char*)recv_buf, MAX_UDP_PACKET_SIZE, 0, (struct sockaddr*)&recv_addr, &recv_addr_len);
+            if (not _pending_output.CurrentSize() or frame < _pending_output.Front().frame)
+            {
+                _last_sent_input = _last_acked_input;
+            }
+            else
+            {
+                _last_sent_input = _pending_output.At(frame - _pending_output.Front().frame);
+            }
+        }
 
-                 // TODO: handle len == 0... indicates a disconnect.
+        // compressed input bits that fit in one datagram next to the rest of an input msg
+        int
+            InputBitsBudget(UdpMsg* msg)
+        {
+            return ((_max_datagram & ~7) - (int)((char*)&msg->u.input.bits - (char*)msg)) * 8;
+        }
 
-                 if (len == -1)
-                 {
-                     int error = GGPO_GET_LAST_ERROR();
+        // packs pending output from j on into msg until the datagram is full, returns the bits used
+        int
+            EncodePendingOutput(UdpMsg* msg, int& j, GameInput& last)
+        {
+            uint8_t* bits = msg->u.input.bits;
+            const int budget = InputBitsBudget(msg);
+            int offset = 0;
 
-                     if (error != GGPO_SOCKET_ERROR_CODE)
-                     {
-                         udp_logger->Error(format("recvfrom GGPO_GET_LAST_ERROR returned {} ({}).", error, error), "udp.cpp");
-                     }
+            msg->u.input.start_frame = j ? last.frame + 1 : _pending_output.Front().frame;
+            msg->u.input.input_size = (uint16_t)_pending_output.Front().size;
 
-                     break;
-                 }
-                 else if (len > 0)
-                 {
-                     char src_ip[1024];
-                     udp_logger->Error(format("recvfrom returned (len:{}  from:{}:{}).", len, inet_ntop(AF_INET, (void*)&recv_addr.sin_addr, src_ip, GGPO_ARRAY_SIZE(src_ip)), ntohs(recv_addr.sin_port)), "udp.cpp");
-                     UdpMsg* msg = (UdpMsg*)recv_buf;
-                     _callbacks->OnMsg(recv_addr, msg, len);
-                 }
-             }
-             return true;
-         }
+            GGPO_ASSERT(last.frame == -1 || last.frame + 1 == msg->u.input.start_frame);
 
-     public:
-         ~Udp(void)
-         {
-             if (_socket != GGPO_INVALID_SOCKET)
-             {
-                 GGPO_CLOSE_SOCKET(_socket);
-                 _socket = GGPO_INVALID_SOCKET;
-             }
-         }
+            for (int first = j; j < _pending_output.CurrentSize(); j++)
+            {
+                GameInput& current = _pending_output.At(j);
+                int frame_start = offset;
 
-     protected:
-         // Network transmission information
-         GGPO_SOCKET _socket = GGPO_INVALID_SOCKET;
+                InputCodec_EncodeFrame(bits, last.bits, current.bits, current.size, &offset);
 
-         // state management
-         Callbacks* _callbacks = NULL;
-         Poll* _poll = NULL;
+                /*
+                 * Leave whatever doesn't fit the datagram for the next packet (it
+                 * stays queued until acked anyway).  The first frame always goes out
+                 * so we make progress, and the session makes sure the cap fits one
+                 * (see MinDatagramSizeFor) so that never runs over.
+                 */
+                if (offset > budget and j > first)
+                {
+                    offset = frame_start;
+                    break;
+                }
 
-         unique_ptr<Logger> udp_logger = nullptr;
+                last = current;
 
-     };
-}
+                if (current.frame > _last_sent_input.frame)
+                {
+                    _last_sent_input = current;
+                }
+            }
 
-//==================================================================================== UdpMsg ============================================================================================//
+            return offset;
+        }
 
-constexpr int MAX_COMPRESSED_BITS = 4096;
-constexpr int UDP_MSG_MAX_PLAYERS = 4;
+        void
+            FinishInputMsg(UdpMsg* msg, int offset)
+        {
+            msg->u.input.num_bits = (uint16_t)offset;
 
-//#pragma pack(push, 1)
+            msg->u.input.disconnect_requested = _current_state == Disconnected;
 
-struct UdpMsg
-{
-    enum MsgType
-    {
-        Invalid = 0,
-        SyncRequest = 1,
-        SyncReply = 2,
-        Input = 3,
-        QualityReport = 4,
-        QualityReply = 5,
-        KeepAlive = 6,
-        InputAck = 7,
-    };
+            if (_local_connect_status)
+            {
+                memcpy(msg->u.input.peer_connect_status, _local_connect_status, sizeof(UdpMsg::connect_status) * UDP_MSG_MAX_PLAYERS);
+            }
+            else
+            {
+                memset(msg->u.input.peer_connect_status, 0, sizeof(UdpMsg::connect_status) * UDP_MSG_MAX_PLAYERS);
+            }
 
-    struct connect_status
-    {
-        bool disconnected; //= false; THESE initialized values cause a deleted function error ill change this later i want deafult initialized values for memory safety
-        int last_frame; //= -1;
-    };
+            GGPO_ASSERT(offset < MAX_COMPRESSED_BITS * 8);
+        }
 
-    struct
-    {
-        uint16_t         magic;
-        uint16_t         sequence_number;
-        uint8_t          type;            /* packet type */
-    } hdr;
-    union
-    {
-        struct
+        bool
+            OnInvalid(UdpMsg* msg, int len)
         {
-            uint32_t      random_request;  /* please reply back with this random data */
-            uint16_t      remote_magic;
-            uint8_t       remote_endpoint;
-        } sync_request;
+            GGPO_ASSERT(false and "Invalid msg in UdpProtocol");
+            return false;
+        }
 
-        struct
+        bool
+            OnSyncRequest(UdpMsg* msg, int len)
         {
-            uint32_t      random_reply;    /* OK, here's your random data back */
-        } sync_reply;
+            if (_remote_magic_number != 0 and msg->hdr.magic != _remote_magic_number)
+            {
+                udp_protocol_logger->Error(format("Ignoring sync request from unknown endpoint ({} != {}).", msg->hdr.magic, _remote_magic_number), "udp_proto.cpp");
+                return false;
+            }
 
-        struct
-        {
-            int8_t        frame_advantage; /* what's the other guy's frame advantage? */
-            uint32_t      ping;
-        } quality_report;
+            if (msg->u.sync_request.protocol_version != UDP_PROTOCOL_VERSION)
+            {
+                udp_protocol_logger->Error(format("Ignoring sync request, they speak protocol version {} and we speak {}.", msg->u.sync_request.protocol_version, UDP_PROTOCOL_VERSION), "udp_proto.cpp");
+                return false;
+            }
 
-        struct
-        {
-            uint32_t      pong;
-        } quality_reply;
+            // the transport's network thread already sent it
+            if (not _recv_answered)
+            {
+                UdpMsg* reply = new UdpMsg(UdpMsg::SyncReply);
+                reply->u.sync_reply.random_reply = msg->u.sync_request.random_request;
+                reply->u.sync_reply.protocol_version = UDP_PROTOCOL_VERSION;
+                SendMsg(reply);
+            }
 
-        struct
+            return true;
+        }
+
+        bool
+            OnSyncReply(UdpMsg* msg, int len)
         {
-            connect_status    peer_connect_status[UDP_MSG_MAX_PLAYERS];
+            if (_current_state != Syncing)
+            {
+                udp_protocol_logger->Info("Ignoring SyncReply while not synching.", "udp_proto.cpp");
+                return msg->hdr.magic == _remote_magic_number;
+            }
 
-            uint32_t            start_frame;
+            if (msg->u.sync_reply.protocol_version != UDP_PROTOCOL_VERSION)
+            {
+                udp_protocol_logger->Error(format("Ignoring sync reply, they speak protocol version {} and we speak {}.", msg->u.sync_reply.protocol_version, UDP_PROTOCOL_VERSION), "udp_proto.cpp");
+                return false;
+            }
 
-            int               disconnect_requested : 1;
-            int               ack_frame : 31;
+            if (msg->u.sync_reply.random_reply != _state.sync.random)
+            {
+                udp_protocol_logger->Info(format("sync reply {} != {}.  Keep looking...", msg->u.sync_reply.random_reply, _state.sync.random), "udp_proto.cpp");
+                return false;
+            }
 
-            uint16_t            num_bits;
-            uint8_t             input_size; // XXX: shouldn't be in every single packet!
-            uint8_t             bits[MAX_COMPRESSED_BITS]; /* must be last */
-        } input;
+            if (not _connected)
+            {
+                QueueEvent(Event(Event::Connected));
+                _connected = true;
+            }
 
-        struct
-        {
-            int               ack_frame : 31;
-        } input_ack;
+            udp_protocol_logger->Info(format("Checking sync state ({} round trips remaining).", _state.sync.roundtrips_remaining), "udp_proto.cpp");
 
-    } u;
+            if (--_state.sync.roundtrips_remaining == 0)
+            {
+                udp_protocol_logger->Info("Synchronized!", "udp_proto.cpp");
+                QueueEvent(UdpProtocol::Event(UdpProtocol::Event::Synchronzied));
+                _current_state = Running;
+                _last_received_input.frame = -1;
+                _remote_magic_number = msg->hdr.magic;
 
-public:
-    int PacketSize()
-    {
-        return sizeof(hdr) + PayloadSize();
-    }
+                // _state is a union, the running timers still hold whatever sync left in there
+                _state.running.last_quality_report_time = 0;
+                _state.running.last_network_stats_interval = 0;
+                _state.running.last_input_packet_recv_time = 0;
+            }
+            else
+            {
+                UdpProtocol::Event evt(UdpProtocol::Event::Synchronizing);
+                evt.u.synchronizing.total = NUM_SYNC_PACKETS;
+                evt.u.synchronizing.count = NUM_SYNC_PACKETS - _state.sync.roundtrips_remaining;
+                QueueEvent(evt);
+                SendSyncRequest();
+            }
 
-    int PayloadSize()
-    {
-        int size;
+            return true;
+        }
 
-        switch (hdr.type)
+        bool
+            OnInput(UdpMsg* msg, int len)
         {
-        case SyncRequest:   return sizeof(u.sync_request);
-        case SyncReply:     return sizeof(u.sync_reply);
-        case QualityReport: return sizeof(u.quality_report);
-        case QualityReply:  return sizeof(u.quality_reply);
-        case InputAck:      return sizeof(u.input_ack);
-        case KeepAlive:     return 0;
-        case Input:
-            size = (int)((char*)&u.input.bits - (char*)&u.input);
-            size += (u.input.num_bits + 7) / 8;
-            return size;
-        }
+            /*
+             * If a disconnect is requested, go ahead and disconnect now.
+             */
+            bool disconnect_requested = msg->u.input.disconnect_requested;
 
-        GGPO_ASSERT(false); // ??????????
+            // a late packet (see OnMsg) is only still good for its frames, the connect status in it is older than ours
+            const bool late = (uint16_t)((int)msg->hdr.sequence_number - (int)_next_recv_seq) > MAX_SEQ_DISTANCE;
 
-        return 0;
-    }
+            if (disconnect_requested)
+            {
+                if (_current_state != Disconnected and not _disconnect_event_sent)
+                {
+                    udp_protocol_logger->Info("Disconnecting endpoint on remote request.", "udp_proto.cpp");
+                    QueueEvent(Event(Event::Disconnected));
+                    _disconnect_event_sent = true;
+                }
+            }
+            else if (not late)
+            {
+                /*
+                 * Update the peer connection status if this peer is still considered to be part
+                 * of the network.
+                 */
+                UdpMsg::connect_status* remote_status = msg->u.input.peer_connect_status;
 
-    UdpMsg(MsgType t) { hdr.type = (uint8_t)t; }
-};
+                for (int i = 0; i < GGPO_ARRAY_SIZE(_peer_connect_status); i++)
+                {
+                    GGPO_ASSERT(remote_status[i].last_frame >= _peer_connect_status[i].last_frame);
+
+                    const bool disconnected = _peer_connect_status[i].disconnected || remote_status[i].disconnected;
+                    const int last_frame = GGPO_MAX(_peer_connect_status[i].last_frame, remote_status[i].last_frame);
+
+                    if (disconnected != (bool)_peer_connect_status[i].disconnected or last_frame != _peer_connect_status[i].last_frame)
+                    {
+                        _peer_connect_status[i].disconnected = disconnected;
+                        _peer_connect_status[i].last_frame = last_frame;
+                        _peer_connect_status_changes |= (1u << i);
+                    }
+                }
+            }
 
-//#pragma pack(pop) 
-//==================================================================================== UdpProtocol ============================================================================================//
+            /*
+             * Decompress the input.
+             */
+            int last_received_frame_number = _last_received_input.frame;
+            bool taken = false;
+            bool gap = false;
 
-constexpr int UDP_HEADER_SIZE = 28;     /* Size of IP + UDP headers */
-constexpr int NUM_SYNC_PACKETS = 5;
-constexpr int SYNC_RETRY_INTERVAL = 2000;
-constexpr int SYNC_FIRST_RETRY_INTERVAL = 500;
-constexpr int RUNNING_RETRY_INTERVAL = 200;
-constexpr int KEEP_ALIVE_INTERVAL = 200;
-constexpr int QUALITY_REPORT_INTERVAL = 1000;
-constexpr int NETWORK_STATS_INTERVAL = 1000;
-constexpr int UDP_SHUTDOWN_TIMER = 5000;
-constexpr int MAX_SEQ_DISTANCE = (1 << 15);
+            if (msg->u.input.num_bits and _last_received_input.frame >= 0 and (int)msg->u.input.start_frame > _last_received_input.frame + 1)
+            {
+                // got here ahead of the packet before it in its burst (or that one's lost), hang on to it for a bit
+                if (StashEarlyInput(msg, len))
+                {
+                    MarkReceived(msg->hdr.sequence_number);
+                    taken = gap = true;
+                }
+            }
+            else if (msg->u.input.num_bits)
+            {
+                bool complete;
 
-namespace GGPO
-{
-    class UdpProtocol
-    {
-    private:
-        unique_ptr<Logger> udp_protocol_logger = nullptr;
+                if (not DecodeInputs(msg, &complete))
+                {
+                    return false;
+                }
 
-    public:
-        struct Stats
-        {
-            int                 ping;
-            int                 remote_frame_advantage;
-            int                 local_frame_advantage;
-            int                 send_queue_len;
-            Udp::Stats        udp;
-        };
+                if (complete)
+                {
+                    MarkReceived(msg->hdr.sequence_number);
+                }
 
-        struct Event 
-        {
-            enum Type 
+                ReplayEarlyInputs();
+                taken = true;
+            }
+            else
             {
-                Unknown = -1,
-                Connected,
-                Synchronizing,
-                Synchronzied,
-                Input,
-                Disconnected,
-                NetworkInterrupted,
-                NetworkResumed,
-            };
+                MarkReceived(msg->hdr.sequence_number);
+            }
 
-            Type      type;
-            union 
+            GGPO_ASSERT(_last_received_input.frame >= last_received_frame_number);
+
+            /*
+             * Ack it, see AckPolicy.  Every packet that lands behind a gap gets acked
+             * right away so the sender sees the hole in ack_bits (OnAcks) without
+             * waiting on our frame.
+             */
+            if (taken)
             {
-                struct 
-                {
-                    GameInput   input;
-                } input;
-                struct 
+                if (gap or _ack_policy == AckPolicy::Immediate)
                 {
-                    int         total;
-                    int         count;
-                } synchronizing;
-                struct 
+                    SendInputAck();
+                }
+                else if (not _ack_owed_since)
                 {
-                    int         disconnect_timeout;
-                } network_interrupted;
-            } u;
+                    _ack_owed_since = _recv_time;
+                }
+            }
 
-            UdpProtocol::Event(Type t = Unknown) : type(t) { }
-        };
+            return true;
+        }
 
-    public:
-        virtual bool
-            OnLoopPoll(void* cookie)
+        // walks the frames in an input packet and queues an event for each one we didn't have yet.
+        // complete says whether it got to the end of the packet, it doesn't when the event queue fills up
+        bool
+            DecodeInputs(UdpMsg* msg, bool* complete = NULL)
         {
-            if (not _udp)
+            int offset = 0;
+            uint8_t* bits = (uint8_t*)msg->u.input.bits;
+            int numBits = msg->u.input.num_bits;
+            int currentFrame = msg->u.input.start_frame;
+
+            if (msg->u.input.input_size == 0 or msg->u.input.input_size > sizeof(_last_received_input.bits))
             {
-                return true;
+                udp_protocol_logger->Error(format("bad input size {} in input packet, dropping it.", msg->u.input.input_size), "udp_proto.cpp");
+                return false;
             }
 
-            unsigned int now = Platform::GetMonotonicTimeMS();
-            unsigned int next_interval;
+            _last_received_input.size = msg->u.input.input_size;
 
-            PumpSendQueue();
+            if (complete)
+            {
+                *complete = false;
+            }
 
-            switch (_current_state)
+            if (_last_received_input.frame < 0)
             {
-            case Syncing:
-                next_interval = (_state.sync.roundtrips_remaining == NUM_SYNC_PACKETS) ? SYNC_FIRST_RETRY_INTERVAL : SYNC_RETRY_INTERVAL;
-                if (_last_send_time and _last_send_time + next_interval < now)
-                {
-                    udp_protocol_logger->Info(format("No luck syncing after {} ms... Re-queueing sync packet.", next_interval), "udp_proto.cpp");
-                    SendSyncRequest();
-                }
-                break;
+                _last_received_input.frame = msg->u.input.start_frame - 1;
+            }
 
-            case Running:
-                // xxx: rig all this up with a timer wrapper
-                if (not _state.running.last_input_packet_recv_time or _state.running.last_input_packet_recv_time + RUNNING_RETRY_INTERVAL < now)
-                {
-                    udp_protocol_logger->Info(format("Haven't exchanged packets in a while (last received:{}  last sent:{}).  Resending.", _last_received_input.frame, _last_sent_input.frame), "udp_proto.cpp");
-                    SendPendingOutput();
-                    _state.running.last_input_packet_recv_time = now;
-                }
+            while (offset < numBits)
+            {
+                /*
+                 * Keep walking through the frames (parsing bits) until we reach
+                 * the inputs for the frame right after the one we're on.
+                 */
+                GGPO_ASSERT(currentFrame <= (_last_received_input.frame + 1));
+                bool useInputs = currentFrame == _last_received_input.frame + 1;
 
-                if (not _state.running.last_quality_report_time or _state.running.last_quality_report_time + QUALITY_REPORT_INTERVAL < now)
+                // no room for another input event, leave the rest unacked so it comes again
+                if (useInputs and _event_queue.IsFull())
                 {
-                    UdpMsg* msg = new UdpMsg(UdpMsg::QualityReport);
-                    msg->u.quality_report.ping = Platform::GetMonotonicTimeMS();
-                    msg->u.quality_report.frame_advantage = (uint8_t)_local_frame_advantage;
-                    SendMsg(msg);
-                    _state.running.last_quality_report_time = now;
+                    break;
                 }
 
-                if (not _state.running.last_network_stats_interval or _state.running.last_network_stats_interval + NETWORK_STATS_INTERVAL < now)
-                {
-                    UpdateNetworkStats();
-                    _state.running.last_network_stats_interval = now;
-                }
+                /*
+                 * Decode into a copy so a truncated frame can't leave half its
+                 * changes in _last_received_input, the next packet deltas off it.
+                 */
+                char decoded[sizeof(_last_received_input.bits)];
 
-                if (_last_send_time and _last_send_time + KEEP_ALIVE_INTERVAL < now)
+                if (useInputs)
                 {
-                    udp_protocol_logger->Info("Sending keep alive packet", "udp_proto.cpp");
-                    SendMsg(new UdpMsg(UdpMsg::KeepAlive));
+                    memcpy(decoded, _last_received_input.bits, _last_received_input.size);
                 }
 
-                if
-                    (
-                        _disconnect_timeout and
-                        _disconnect_notify_start and
-                        not _disconnect_notify_sent and
-                        (_last_recv_time + _disconnect_notify_start < now)
-                        )
+                if (not InputCodec_DecodeFrame(bits, numBits, useInputs ? decoded : NULL, _last_received_input.size, &offset))
                 {
-                    udp_protocol_logger->Info(format("Endpoint has stopped receiving packets for {} ms.  Sending notification.", _disconnect_notify_start), "udp_proto.cpp");
-                    Event e(Event::NetworkInterrupted);
-                    e.u.network_interrupted.disconnect_timeout = _disconnect_timeout - _disconnect_notify_start;
-                    QueueEvent(e);
-                    _disconnect_notify_sent = true;
+                    udp_protocol_logger->Error(format("malformed input stream at frame {}, dropping the rest of the packet.", currentFrame), "udp_proto.cpp");
+                    break;
                 }
 
-                if (_disconnect_timeout and (_last_recv_time + _disconnect_timeout < now))
+                if (useInputs)
                 {
-                    if (not _disconnect_event_sent)
-                    {
-                        udp_protocol_logger->Info(format("Endpoint has stopped receiving packets for {} ms.  Disconnecting.", _disconnect_timeout), "udp_proto.cpp");
-                        QueueEvent(Event(Event::Disconnected));
-                        _disconnect_event_sent = true;
-                    }
+                    memcpy(_last_received_input.bits, decoded, _last_received_input.size);
                 }
-                break;
 
-            case Disconnected:
-                if (_shutdown_timeout < now)
+                /*
+                 * Now if we want to use these inputs, go ahead and send them to
+                 * the emulator.
+                 */
+                if (useInputs)
                 {
-                    udp_protocol_logger->Info("Shutting down udp connection.", "udp_proto.cpp");
-                    _udp = NULL;
-                    _shutdown_timeout = 0;
-                }
-            }
+                    /*
+                     * Move forward 1 frame in the stream.
+                     */
+                    char desc[1024];
+                    GGPO_ASSERT(currentFrame == _last_received_input.frame + 1);
+                    _last_received_input.frame = currentFrame;
 
-            return true;
-        }
+                    /*
+                     * Send the event to the emualtor
+                     */
+                    UdpProtocol::Event evt(UdpProtocol::Event::Input);
+                    evt.u.input.input = _last_received_input;
 
-    public:
-        UdpProtocol() :
-            _local_frame_advantage(0),
-            _remote_frame_advantage(0),
-            _queue(-1),
-            _magic_number(0),
-            _remote_magic_number(0),
-            _packets_sent(0),
-            _bytes_sent(0),
-            _stats_start_time(0),
-            _last_send_time(0),
-            _shutdown_timeout(0),
-            _disconnect_timeout(0),
-            _disconnect_notify_start(0),
-            _disconnect_notify_sent(false),
-            _disconnect_event_sent(false),
-            _connected(false),
-            _next_send_seq(0),
-            _next_recv_seq(0),
-            _udp(NULL)
-        {
-            udp_protocol_logger = Logger::CreateUnique("UDPProtocolLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+                    _last_received_input.Description(desc);
 
-            GGPO_ASSERT(udp_protocol_logger)
+                    _state.running.last_input_packet_recv_time = _recv_time;
 
-            _last_sent_input.init(-1, NULL, 1);
-            _last_received_input.init(-1, NULL, 1);
-            _last_acked_input.init(-1, NULL, 1);
+                    udp_protocol_logger->Info(format("Sending frame {} to emu queue {} ({}).", _last_received_input.frame, _queue, desc), "udp_proto.cpp");
+                    QueueEvent(evt);
 
-            memset(&_state, 0, sizeof _state);
-            memset(_peer_connect_status, 0, sizeof(_peer_connect_status));
-            for (int i = 0; i < GGPO_ARRAY_SIZE(_peer_connect_status); i++) {
-                _peer_connect_status[i].last_frame = -1;
+                }
+                else
+                {
+                    udp_protocol_logger->Info(format("Skipping past frame:({}) current is {}.", currentFrame, _last_received_input.frame), "udp_proto.cpp");
+                }
+
+                /*
+                 * Move forward 1 frame in the input stream.
+                 */
+                currentFrame++;
             }
-            memset(&_peer_addr, 0, sizeof _peer_addr);
-            _oo_packet.msg = NULL;
 
-            _send_latency = Platform::GetConfigInt("ggpo.network.delay");
-            _oop_percent = Platform::GetConfigInt("ggpo.oop.percent");
-        }
+            if (complete)
+            {
+                *complete = offset >= numBits;
+            }
 
-        virtual 
-            ~UdpProtocol()
-        {
-            ClearSendQueue();
+            return true;
         }
 
-        void
-            Init
-            (
-                Udp* udp,
-                Poll& poll,
-                int queue,
-                char* ip,
-                uint16_t port,
-                UdpMsg::connect_status* status
-            )
+        bool
+            StashEarlyInput(UdpMsg* msg, int len)
         {
-            _udp = udp;
-            _queue = queue;
-            _local_connect_status = status;
-
-            _peer_addr.sin_family = AF_INET;
-            _peer_addr.sin_port = htons(port);
-            inet_pton(AF_INET, ip, &_peer_addr.sin_addr.s_addr);
+            // the same frames again (a resend after a loss), keep whichever has more of them
+            for (unique_ptr<UdpMsg>& early : _early_inputs)
+            {
+                if (early->u.input.start_frame == msg->u.input.start_frame)
+                {
+                    if (msg->u.input.num_bits > early->u.input.num_bits)
+                    {
+                        memcpy((void*)early.get(), msg, GGPO_MIN(len, (int)sizeof(UdpMsg)));
+                    }
 
-            do {
-                _magic_number = (uint16_t)rand();
-            } while (_magic_number == 0);
-            poll.RegisterLoop(this);
-        }
+                    return true;
+                }
+            }
 
-        void
-            Synchronize()
-        {
-            if (_udp)
+            if ((int)_early_inputs.size() == MAX_EARLY_INPUTS)
             {
-                _current_state = Syncing;
-                _state.sync.roundtrips_remaining = NUM_SYNC_PACKETS;
-                SendSyncRequest();
+                udp_protocol_logger->Info(format("input packet starts at frame {} but we only have up to {}, dropping it.", msg->u.input.start_frame, _last_received_input.frame), "udp_proto.cpp");
+                return false;
             }
-        }
 
-        bool
-            GetPeerConnectStatus(int id, int* frame)
-        {
-            *frame = _peer_connect_status[id].last_frame;
-            return !_peer_connect_status[id].disconnected;
+            UdpMsg* copy = new UdpMsg(UdpMsg::Input);
+            memcpy((void*)copy, msg, GGPO_MIN(len, (int)sizeof(UdpMsg)));
+
+            _early_inputs.emplace_back(copy);
+            return true;
         }
 
+        // anything stashed that lines up with what we have now, until nothing else does
         void
-            SendInput(GameInput& input)
+            ReplayEarlyInputs()
         {
-            if (_udp)
+            for (bool progress = true; progress; )
             {
-                if (_current_state == Running)
+                progress = false;
+
+                for (size_t i = 0; i < _early_inputs.size(); )
                 {
-                    /*
-                     * Check to see if this is a good time to adjust for the rift...
-                     */
-                    _timesync.advance_frame(input, _local_frame_advantage, _remote_frame_advantage);
+                    UdpMsg* early = _early_inputs[i].get();
 
-                    /*
-                     * Save this input packet
-                     *
-                     * XXX: This queue may fill up for spectators who do not ack input packets in a timely
-                     * manner.  When this happens, we can either resize the queue (ug) or disconnect them
-                     * (better, but still ug).  For the meantime, make this queue really big to decrease
-                     * the odds of this happening...
-                     */
-                    _pending_output.TryPush(input);
+                    if ((int)early->u.input.start_frame > _last_received_input.frame + 1)
+                    {
+                        i++;
+                        continue;
+                    }
+
+                    const int before = _last_received_input.frame;
+
+                    DecodeInputs(early);
+                    progress |= _last_received_input.frame != before;
+
+                    _early_inputs.erase(_early_inputs.begin() + i);
                 }
-                SendPendingOutput();
             }
         }
 
-        void
-            SendInputAck()
+        // the ack is in the header, OnMsg already took it
+        bool
+            OnInputAck(UdpMsg* msg, int len)
         {
-            UdpMsg* msg = new UdpMsg(UdpMsg::InputAck);
-            msg->u.input_ack.ack_frame = _last_received_input.frame;
-            SendMsg(msg);
+            return true;
         }
 
-        bool
-            HandlesMsg
-            (
-                sockaddr_in& from,
-                UdpMsg* msg
-            )
+        void
+            AckPendingOutput(int ack_frame)
         {
-            if (not _udp)
+            /*
+             * Get rid of our buffered input
+             */
+            while (_pending_output.CurrentSize() and _pending_output.Front().frame < ack_frame)
             {
-                return false;
+                udp_protocol_logger->Info(format("Throwing away pending output frame {}", _pending_output.Front().frame), "udp_proto.cpp");
+                _last_acked_input = _pending_output.Front();
+                _pending_output.Pop();
             }
-
-            return _peer_addr.sin_addr.S_un.S_addr == from.sin_addr.S_un.S_addr and
-                _peer_addr.sin_port == from.sin_port;
         }
 
+        // seq is in, fold it into what we ack back on everything we send
         void
-            OnMsg(UdpMsg* msg, int len)
+            MarkReceived(uint16_t seq)
         {
-            bool handled = false;
-
-            typedef bool (UdpProtocol::* DispatchFn)(UdpMsg* msg, int len);
+            const uint16_t ahead = (uint16_t)((int)seq - (int)_recv_seq_high);
 
-            static const DispatchFn table[] =
+            if (not _recv_seq_bits)
             {
-               &UdpProtocol::OnInvalid,             /* Invalid */
-               &UdpProtocol::OnSyncRequest,         /* SyncRequest */
-               &UdpProtocol::OnSyncReply,           /* SyncReply */
-               &UdpProtocol::OnInput,               /* Input */
-               &UdpProtocol::OnQualityReport,       /* QualityReport */
-               &UdpProtocol::OnQualityReply,        /* QualityReply */
-               &UdpProtocol::OnKeepAlive,           /* KeepAlive */
-               &UdpProtocol::OnInputAck,            /* InputAck */
-            };
+                _recv_seq_high = seq;
+                _recv_seq_bits = 1;
+            }
+            else if (ahead and ahead <= MAX_SEQ_DISTANCE)
+            {
+                _recv_seq_bits = ahead < SACK_WINDOW ? (_recv_seq_bits << ahead) | 1 : 1;
+                _recv_seq_high = seq;
+            }
+            else
+            {
+                const uint16_t behind = (uint16_t)((int)_recv_seq_high - (int)seq);
 
-            // filter out messages that don't match what we expect
-            uint16_t seq = msg->hdr.sequence_number;
+                if (behind < SACK_WINDOW)
+                {
+                    _recv_seq_bits |= 1u << behind;
+                }
+            }
+        }
 
-            if (msg->hdr.type != UdpMsg::SyncRequest and msg->hdr.type != UdpMsg::SyncReply)
+        /*
+         * Every packet they send says which of our last SACK_WINDOW packets they've
+         * taken in (decoded, or stashed until the gap in front of it fills, see
+         * OnInput).  That's only about packets, the frames still get acked by
+         * ack_frame like always.  What it buys us is knowing when one didn't make
+         * it: an input packet still missing after FAST_RETRANSMIT_THRESHOLD later
+         * packets did is lost, so resend from the last ack right away instead of
+         * sitting on the timer.  Not if something since already carried its frames
+         * again (the usual case while we're sending every frame), and no more than
+         * once per round trip, or one lost packet turns into a resend per ack.
+         */
+        void
+            OnAcks(uint16_t ack_seq, uint32_t ack_bits)
+        {
+            const uint64_t now = _clock->NowUS();
+            bool acked = false;
+            int lost = 0;
+            int lost_from = INT_MAX;
+
+            for (int i = 0; i < _unacked_inputs.CurrentSize(); i++)
             {
-                if (msg->hdr.magic != _remote_magic_number)
+                SentInput& sent = _unacked_inputs.At(i);
+                const uint16_t behind = (uint16_t)((int)ack_seq - (int)sent.seq);
+
+                if (sent.acked or behind >= SACK_WINDOW or not (ack_bits & (1u << behind)))
                 {
-                    LogMsg("recv rejecting", msg);
-                    return;
+                    continue;
                 }
 
-                // filter out out-of-order packets
-                uint16_t skipped = (uint16_t)((int)seq - (int)_next_recv_seq);
-                // Log("checking sequence number -> next - seq : %d - %d = %d\n", seq, _next_recv_seq, skipped);
-                if (skipped > MAX_SEQ_DISTANCE)
+                sent.acked = acked = true;
+
+                (void)_ack_rtt.AddSample(_recv_time - GGPO_MIN(sent.send_time, _recv_time));
+            }
+
+            while (not _unacked_inputs.IsEmpty())
+            {
+                const SentInput& front = _unacked_inputs.Front();
+                const uint16_t behind = (uint16_t)((int)ack_seq - (int)front.seq);
+
+                if (not front.acked)
                 {
-                    udp_protocol_logger->Info(format("dropping out of order packet (seq: {}, last seq:{})", seq, _next_recv_seq), "udp_proto.cpp");
-                    return;
+                    if (behind < FAST_RETRANSMIT_THRESHOLD or behind > MAX_SEQ_DISTANCE)
+                    {
+                        break;
+                    }
+
+                    if (NeedsResend(front))
+                    {
+                        lost_from = GGPO_MIN(lost_from, front.start_frame);
+                        lost++;
+                    }
                 }
-            }
 
-            _next_recv_seq = seq;
-            LogMsg("recv", msg);
+                _unacked_inputs.Pop();
+            }
 
-            if (msg->hdr.type >= GGPO_ARRAY_SIZE(table))
+            if (acked)
             {
-                OnInvalid(msg, len);
+                _retransmit_backoff = 0;
             }
-            else
+
+            // whatever goes out next covers it again, even if it isn't right now
+            if (lost)
             {
-                handled = (this->*(table[msg->hdr.type]))(msg, len);
+                RewindSentOutput(lost_from - 1);
             }
-            if (handled)
+
+            if (lost and _current_state == Running and _last_retransmit_time + _ack_rtt.GetSmoothed() <= now)
             {
-                _last_recv_time = Platform::GetMonotonicTimeMS();
+                udp_protocol_logger->Info(format("{} input packets lost (ack seq {}, bits {:x}), resending from frame {}.", lost, ack_seq, ack_bits, _last_acked_input.frame + 1), "udp_proto.cpp");
 
-                if (_disconnect_notify_sent and _current_state == Running)
-                {
-                    QueueEvent(Event(Event::NetworkResumed));
-                    _disconnect_notify_sent = false;
-                }
+                _last_retransmit_time = now;
+                SendPendingOutput();
             }
         }
 
-        void
-            Disconnect()
+        // oldest packet still waiting on a resend, NULL if there isn't one
+        const SentInput*
+            OldestUnackedInput()
         {
-            _current_state = Disconnected;
-            _shutdown_timeout = Platform::GetMonotonicTimeMS() + UDP_SHUTDOWN_TIMER;
+            for (int i = 0; i < _unacked_inputs.CurrentSize(); i++)
+            {
+                if (NeedsResend(_unacked_inputs.At(i)))
+                {
+                    return &_unacked_inputs.At(i);
+                }
+            }
+
+            return NULL;
         }
 
-        void
-            GetNetworkStats(struct NetworkStats* s) //wow great variable name tony GOOD FUCKING NAME
+        // how long an input packet goes unacked before we resend, rtt based once there's a sample
+        uint64_t
+            RetransmitTimeout()
         {
-            s->network.ping = _round_trip_time;
-            s->network.send_queue_len = _pending_output.CurrentSize();
-            s->network.kbps_sent = _kbps_sent;
-            s->timesync.remote_frames_behind = _remote_frame_advantage;
-            s->timesync.local_frames_behind = _local_frame_advantage;
+            if (not _ack_rtt.HasSample())
+            {
+                return RUNNING_RETRY_INTERVAL * US_PER_MS;
+            }
+
+            const uint64_t timeout = GGPO_MAX(_ack_rtt.GetSmoothed() + 4 * _ack_rtt.GetVariance(), (uint64_t)MIN_RETRANSMIT_TIMEOUT * US_PER_MS);
+
+            return GGPO_MIN(timeout << _retransmit_backoff, (uint64_t)RUNNING_RETRY_INTERVAL * US_PER_MS);
         }
 
         bool
-            GetEvent(UdpProtocol::Event& e)
+            OnQualityReport(UdpMsg* msg, int len)
         {
-            if (_event_queue.CurrentSize() == 0)
+            // send a reply so the other side can compute the round trip transmit time, unless the transport's network thread already did.
+            // hold is however long it waited on us for a poll (and in the send queue, see StampForSend()), so their rtt doesn't count our frame rate
+            if (not _recv_answered)
             {
-                return false;
+                UdpMsg* reply = new UdpMsg(UdpMsg::QualityReply);
+                reply->u.quality_reply.pong = msg->u.quality_report.ping;
+                reply->u.quality_reply.hold = (uint32_t)(_clock->NowUS() - _recv_time);
+                SendMsgLater(reply);
             }
 
-            e = _event_queue.Front();
-            _event_queue.Pop();
-
+            _remote_frame_advantage = msg->u.quality_report.frame_advantage;
             return true;
         }
 
-        void
-            SetLocalFrameNumber(int localFrame)
+        bool
+            OnQualityReply(UdpMsg* msg, int len)
         {
             /*
-             * Estimate which frame the other guy is one by looking at the
-             * last frame they gave us plus some delta for the one-way packet
-             * trip time.
-             */
-            int remoteFrame = _last_received_input.frame + (_round_trip_time * 60 / 1000);
-
-            /*
-             * Our frame advantage is how many frames *behind* the other guy
-             * we are.  Counter-intuative, I know.  It's an advantage because
-             * it means they'll have to predict more often and our moves will
-             * pop more frequenetly.
+             * The ping only carries the low 32 bits of our microsecond clock, the
+             * unsigned subtraction stays right as long as the round trip is under
+             * ~71 minutes.  Taken at arrival rather than now, and minus the time
+             * the other side held onto it, so what's left is the wire.
              */
-            _local_frame_advantage = remoteFrame - localFrame;
-        }
+            const uint32_t round_trip = (uint32_t)_recv_time - msg->u.quality_reply.pong;
+            const uint64_t sample = round_trip - GGPO_MIN(msg->u.quality_reply.hold, round_trip);
 
-        int
-            RecommendFrameDelay()
-        {
-            // XXX: require idle input should be a configuration parameter
-            return _timesync.recommend_frame_wait_duration(false, udp_protocol_logger.get());
-        }
+            if (not _rtt.AddSample(sample))
+            {
+                udp_protocol_logger->Info(format("ignoring rtt spike of {} us (smoothed {} us, variance {} us).", sample, _rtt.GetSmoothed(), _rtt.GetVariance()), "udp_proto.cpp");
+            }
 
-        void
-            SetDisconnectTimeout(int timeout)
-        {
-            _disconnect_timeout = timeout;
+            _round_trip_time = _rtt.GetSmoothed();
+            return true;
         }
 
-        void
-            SetDisconnectNotifyStart(int timeout)
+        bool
+           OnKeepAlive(UdpMsg* msg, int len) //wtf?
         {
-            _disconnect_notify_start = timeout;
+            return true;
         }
 
-        bool IsInitialized()
+    protected:
+        /*
+        * Network transmission information
+        */
+        Transport* _transport;
+        PeerId         _peer;
+        uint16_t         _magic_number;
+        int            _queue;
+        uint16_t         _remote_magic_number;
+        bool           _connected;
+        int            _send_latency;
+        int            _oop_percent;
+        struct 
         {
-            return _udp != NULL;
-        }
+            uint64_t    send_time = 0;
+            PeerId      dest = INVALID_PEER_ID;
+            UdpMsg* msg = nullptr;
+        } _oo_packet;
+        RingBuffer<QueueEntry, 64> _send_queue;
+        alignas(UdpMsg) uint8_t _bundle[MAX_UDP_PACKET_SIZE]; /* see BundleMessages(), only lives until the transport's Send() */
+        bool                       _send_now;         /* something besides SendMsgLater()s is queued, see Flush() */
+        bool                       _coalesce;         /* a tick's messages go out together at Flush(), see SetCoalescing() */
 
-        bool
-            IsSynchronized()
-            const
-        {
-            return _current_state == Running;
-        }
+        /*
+        * Stats
+        */
+        uint64_t       _round_trip_time; /* us, smoothed by _rtt */
+        RttEstimator   _rtt;
+        int            _packets_sent;
+        int            _bytes_sent;
+        int            _kbps_sent;
+        uint64_t       _stats_start_time;
 
-        bool
-            IsRunning()
-            const
-        {
-            return _current_state == Running;
-        }
+        /*
+        * The state machine
+        */
+        UdpMsg::connect_status* _local_connect_status;
+        UdpMsg::connect_status _peer_connect_status[UDP_MSG_MAX_PLAYERS];
+        uint32_t               _peer_connect_status_changes = 0; /* see TakePeerConnectStatusChanges */
 
-    protected:
-        enum State
-        {
-            Syncing,
-            Synchronzied,
-            Running,
-            Disconnected
-        };
+        State          _current_state;
 
-        struct QueueEntry
+        union 
         {
-            int queue_time = -1;
-            sockaddr_in dest_addr;
-            UdpMsg* msg = nullptr;
+            struct 
+            {
+                uint32_t   roundtrips_remaining;
+                uint32_t   random;
+            } sync;
+            struct 
+            {
+                uint64_t   last_quality_report_time;
+                uint64_t   last_network_stats_interval;
+                uint64_t   last_input_packet_recv_time;
+            } running;
+        } _state;
 
-            QueueEntry() {}
-            QueueEntry(int time, sockaddr_in& dst, UdpMsg* m) : queue_time(time), dest_addr(dst), msg(m) { }
-        };
+        /*
+        * Fairness.
+        */
+        int               _local_frame_advantage;
+        int               _remote_frame_advantage;
 
-        void
-            UpdateNetworkStats(void)
-        {
-            int now = Platform::GetMonotonicTimeMS();
+        /*
+        * Packet loss...
+        */
+        DynamicRingBuffer<GameInput> _pending_output;
+        GameInput                  _last_received_input;
+        GameInput                  _last_sent_input;
+        GameInput                  _last_acked_input;
+        vector<unique_ptr<UdpMsg>> _early_inputs;     /* got here before the packet in front of them, see OnInput */
 
-            if (_stats_start_time == 0)
-            {
-                _stats_start_time = now;
-            }
+        /*
+        * Selective acks, see OnAcks().
+        */
+        RingBuffer<SentInput, SACK_WINDOW> _unacked_inputs;
+        RttEstimator               _ack_rtt;          /* send to ack, counts their frame time unlike _rtt, which is what the resend timer wants */
+        uint16_t                   _recv_seq_high;    /* what goes out in hdr.ack_seq and ack_bits */
+        uint32_t                   _recv_seq_bits;
+        uint64_t                   _last_retransmit_time;
+        int                        _retransmit_backoff;
+        uint32_t                   _stream_id;        /* transport stream _last_sent_input went out on, see SendPendingOutput */
+        int                        _send_burst;       /* most input packets per send while catching up, see SendPendingOutput */
+        int                        _max_datagram;     /* bytes, see SessionLimits::max_datagram_size */
+        AckPolicy                  _ack_policy;
+        uint64_t                   _ack_owed_since;   /* when we took in input we haven't acked yet, 0 if we're square */
+        uint64_t                   _last_send_time;   /* us, like every other timestamp in here */
+        uint64_t                   _last_recv_time;
+        uint64_t                   _recv_time;        /* when the message OnMsg() is on actually arrived */
+        bool                       _recv_answered = false; /* and the transport already replied to it */
+        uint64_t                   _shutdown_timeout;
+        unsigned int               _disconnect_event_sent;
+        unsigned int               _disconnect_timeout;       /* ms */
+        unsigned int               _disconnect_notify_start;  /* ms */
+        bool                       _disconnect_notify_sent;
 
-            int total_bytes_sent = _bytes_sent + (UDP_HEADER_SIZE * _packets_sent);
-            float seconds = (float)((now - _stats_start_time) / 1000.0);
-            float Bps = total_bytes_sent / seconds;
-            float udp_overhead = (float)(100.0 * (UDP_HEADER_SIZE * _packets_sent) / _bytes_sent);
+        uint16_t                     _next_send_seq;
+        uint16_t                     _next_recv_seq;
 
-            _kbps_sent = int(Bps / 1024);
+        /*
+        * Rift synchronization.
+        */
+        TimeSync                   _timesync;
 
-            udp_protocol_logger->Info
-            (
-                format
-                (
-                    "Network Stats -- Bandwidth: {} KBps   Packets Sent: {} ({} pps)   " "KB Sent: {}    UDP Overhead: {}.",
-                    _kbps_sent,
-                    _packets_sent,
-                    (float)_packets_sent * 1000 / (now - _stats_start_time),
-                    total_bytes_sent / 1024.0,
-                    udp_overhead
-                ),
-                "udp_proto.cpp"
-            );
-        }
+        /*
+        * Event queue
+        */
+        DynamicRingBuffer<UdpProtocol::Event> _event_queue;
 
-        void
-            QueueEvent(const UdpProtocol::Event& evt)
+        IClock*                    _clock;
+    };
+
+    inline bool
+        SessionLimits::IsValid(int num_players, int input_size)
+        const
+    {
+        return IsValid()
+            and num_players > 0
+            and input_size > 0
+            and max_datagram_size >= UdpProtocol::MinDatagramSizeFor(num_players * input_size); // spectators get everyone's input in one frame
+    }
+}
+ 
+//==================================================================================== SyncTest Backend ============================================================================================//
+
+namespace GGPO
+{
+    /*
+     * The states a sync test still has to verify, packed back to back in a single
+     * buffer.  Clear() keeps the memory, so once the arena has grown to hold
+     * check_distance frames worth of state it stops allocating no matter how long
+     * the test keeps running.
+     */
+    class SyncTestStateArena
+    {
+    public:
+        struct Slot
         {
-            LogEvent("Queuing event", evt);
-            _event_queue.SafePush(evt);
-        }
+            int         frame;
+            int         checksum;
+            size_t      offset;
+            size_t      size;
+            GameInput   input; /* the input that advanced the previous frame into this one */
+        };
 
         void
-            ClearSendQueue(void)
+            Clear()
         {
-            while (not _send_queue.IsEmpty())
-            {
-                delete _send_queue.Front().msg;
-                _send_queue.Pop();
-            }
+            _buffer.clear();
+            _slots.clear();
         }
 
         void
-            LogMsg
+            Store
             (
-                const char* prefix,
-                UdpMsg* msg
+                int frame,
+                int checksum,
+                const GameInput& input,
+                const string& state
             )
         {
-            switch (msg->hdr.type)
-            {
-            case UdpMsg::SyncRequest:
-                udp_protocol_logger->Info(format("{} sync-request ({}).", prefix, msg->u.sync_request.random_request), "udp_proto.cpp");
-                break;
-
-            case UdpMsg::SyncReply:
-                udp_protocol_logger->Info(format("{} sync-reply ({}).", prefix, msg->u.sync_reply.random_reply), "udp_proto.cpp");
-                break;
-
-            case UdpMsg::QualityReport:
-                udp_protocol_logger->Info(format("{} quality report.", prefix), "udp_proto.cpp");
-                break;
-
-            case UdpMsg::QualityReply:
-                udp_protocol_logger->Info(format("{} quality reply.", prefix), "udp_proto.cpp");
-                break;
+            Slot slot;
 
-            case UdpMsg::KeepAlive:
-                udp_protocol_logger->Info(format("{} keep alive.", prefix), "udp_proto.cpp");
-                break;
-
-            case UdpMsg::Input:
-                udp_protocol_logger->Info(format("{} game-compressed-input {} (+ {} bits).", prefix, msg->u.input.start_frame, msg->u.input.num_bits), "udp_proto.cpp");
-                break;
+            slot.frame = frame;
+            slot.checksum = checksum;
+            slot.offset = _buffer.size();
+            slot.size = state.size();
+            slot.input = input;
 
-            case UdpMsg::InputAck:
-                udp_protocol_logger->Info(format("{} input ack.", prefix), "udp_proto.cpp");
-                break;
+            _buffer.insert(_buffer.end(), state.begin(), state.end());
+            _slots.push_back(slot);
+        }
 
-            default:
-                GGPO_ASSERT(false and "Unknown UdpMsg type.");
-            }
+        int
+            Count()
+            const
+        {
+            return (int)_slots.size();
         }
 
-        void
-            LogEvent
-            (
-                const char* prefix, 
-                const UdpProtocol::Event& evt
-            )
+        const Slot&
+            GetSlot(int index)
+            const
         {
-            switch (evt.type)
-            {
-            case UdpProtocol::Event::Synchronzied:
-                udp_protocol_logger->Info(format("{} (event: Synchronzied).", prefix), "udp_proto.cpp");
-                break;
-            }
+            return _slots[index];
         }
 
-        void
-            SendSyncRequest()
+        string_view
+            GetState(int index)
+            const
         {
-            _state.sync.random = rand() & 0xFFFF;
-            UdpMsg* msg = new UdpMsg(UdpMsg::SyncRequest);
-            msg->u.sync_request.random_request = _state.sync.random;
-            SendMsg(msg);
+            const Slot& slot = _slots[index];
+            return string_view(_buffer.data() + slot.offset, slot.size);
         }
 
-        void
-            SendMsg(UdpMsg* msg)
+        size_t
+            GetCapacityBytes()
+            const
         {
-            LogMsg("send", msg);
+            return _buffer.capacity() + (_slots.capacity() * sizeof(Slot));
+        }
 
-            _packets_sent++;
-            _last_send_time = Platform::GetMonotonicTimeMS();
-            _bytes_sent += msg->PacketSize();
+    private:
+        vector<char>    _buffer;
+        vector<Slot>    _slots;
+    };
 
-            msg->hdr.magic = _magic_number;
-            msg->hdr.sequence_number = _next_send_seq++;
+    class SyncTestBackend
+    {
+    private:
+        unique_ptr<Logger> sync_test_backend_logger = nullptr;
 
-            _send_queue.SafePush(QueueEntry(Platform::GetMonotonicTimeMS(), _peer_addr, msg));
-            PumpSendQueue();
-        }
+     public:
+         SyncTestBackend
+         (
+             string gamename,
+             IReplayGame* game,
+             const int frames,
+             const int num_players
+         ) :
+             _sync(NULL)
+         {
+             sync_test_backend_logger = Logger::CreateUnique("SyncTestBackendLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+             
+             GGPO_ASSERT(sync_test_backend_logger)
+             GGPO_ASSERT(game)
 
-        void
-            PumpSendQueue()
-        {
-            while (not _send_queue.IsEmpty())
-            {
-                QueueEntry& entry = _send_queue.Front();
+             _game = game;
+             _num_players = num_players;
+             _check_distance = GGPO_MAX(frames, 1);
+             _last_verified = 0;
+             _rollingback = false;
+             _running = false;
+             _continuous = false;
+             _desynced = false;
+             _desync_count = 0;
+             _frames_verified = 0;
+             _current_input.erase();
+             _last_input.erase();
+             _last_input.frame = GameInput::NullFrame;
+             _last_input.size = 0;
+             pm_GameName = gamename;
 
-                if (_send_latency)
-                {
-                    // should really come up with a gaussian distributation based on the configured
-                    // value, but this will do for now.
-                    int jitter = (_send_latency * 2 / 3) + ((rand() % _send_latency) / 3);
+             /*
+              * Initialize the synchronziation layer
+              */
+             Sync::Config config = { };
+             config.num_prediction_frames = MAX_PREDICTION_FRAMES;
+             _sync.Init(config);
+         }
 
-                    if (Platform::GetMonotonicTimeMS() < _send_queue.Front().queue_time + jitter)
-                    {
-                        break;
-                    }
-                }
-                if (_oop_percent and not _oo_packet.msg and ((rand() % 100) < _oop_percent))
-                {
-                    int delay = rand() % (_send_latency * 10 + 1000);
+         virtual ~SyncTestBackend() = default;
 
-                    if (entry.msg) //check for a nullptr dereference
-                    {
-                        udp_protocol_logger->Info(format("creating rogue oop (seq: {}  delay: {})", entry.msg->hdr.sequence_number, delay), "udp_proto.cpp");
-                    }
-                    else
-                    {
-                        //???????????????????????????????????????????????????????? WHY IS THIS HERE TONY ANSWER ME
-                    }
+         virtual ErrorCode
+             DoPoll()
+         {
+             if (not _running)
+             {
+                 Event info;
 
-                    _oo_packet.send_time = Platform::GetMonotonicTimeMS() + delay;
-                    _oo_packet.msg = entry.msg;
-                    _oo_packet.dest_addr = entry.dest_addr;
-                }
-                else
-                {
-                    GGPO_ASSERT(entry.dest_addr.sin_addr.s_addr);
+                 info.code = EventCode::Running;
+                 _event_queue.Push(info);
+                 _running = true;
+             }
 
-                    _udp->SendTo((char*)entry.msg, entry.msg->PacketSize(), 0, (struct sockaddr*)&entry.dest_addr, sizeof entry.dest_addr);
+             return ErrorCode::OK;
+         }
 
-                    delete entry.msg;
-                }
+         bool
+             GetEvent(Event& e)
+         {
+             if (_event_queue.CurrentSize())
+             {
+                 e = _event_queue.Front();
+                 _event_queue.Pop();
+                 return true;
+             }
 
-                _send_queue.Pop();
-            }
-            if (_oo_packet.msg and _oo_packet.send_time < Platform::GetMonotonicTimeMS())
-            {
-                udp_protocol_logger->Info("sending rogue oop!", "udp_proto.cpp");
+             return false;
+         }
+
+         virtual ErrorCode
+             AddPlayer
+             (
+                 Player* player, 
+                 PlayerHandle* handle
+             )
+         {
+             if (player->player_num < 1 || player->player_num > _num_players)
+             {
+                 return ErrorCode::PLAYER_OUT_OF_RANGE;
+             }
+
+             *handle = (PlayerHandle)(player->player_num - 1);
+             return ErrorCode::OK;
+         }
+
+         virtual ErrorCode
+             AddLocalInput(PlayerHandle player, void* values, int size)
+         {
+             if (not _running)
+             {
+                 return ErrorCode::NOT_SYNCHRONIZED;
+             }
+
+             int index = (int)player;
+
+             for (int i = 0; i < size; i++)
+             {
+                 _current_input.bits[(index * size) + i] |= ((char*)values)[i];
+             }
+
+             return ErrorCode::OK;
+         }
+
+         virtual ErrorCode
+             SyncInput
+             (
+                 void* values,
+                 int size,
+                 int* disconnect_flags
+             )
+         {
+             if (_rollingback)
+             {
+                 // IReplayGame::AdvanceFrame gets its inputs handed to it, it must not call back in here
+                 return ErrorCode::IN_ROLLBACK;
+             }
+
+             if (_sync.GetFrameCount() == 0 and _state_arena.Count() == 0)
+             {
+                 SaveCurrentFrame(_last_input); // the state every verification pass starts from
+             }
+
+             _last_input = _current_input;
+             _last_input.frame = _sync.GetFrameCount();
+             _last_input.size = size;
+
+             memcpy(values, _last_input.bits, size);
+
+             if (disconnect_flags)
+             {
+                 *disconnect_flags = 0;
+             }
+
+             return ErrorCode::OK;
+         }
+
+         /*
+          * Returns FATAL_DESYNC once a desync has been found, unless the backend is
+          * in continuous mode, in which case desyncs only show up as SyncTestDesync
+          * events (see GetEvent()) and the test carries on from the original state.
+          */
+         virtual ErrorCode
+             IncrementFrame(void)
+         {
+             if (_rollingback)
+             {
+                 return ErrorCode::IN_ROLLBACK;
+             }
+
+             if (_desynced and not _continuous)
+             {
+                 return ErrorCode::FATAL_DESYNC;
+             }
+
+             _sync.IncrementFrame();
+             _current_input.erase();
+
+             sync_test_backend_logger->Info(format("End of frame({})...", _sync.GetFrameCount()), "synctest.cpp");
+
+             // Hold onto the current frame in our arena of saved states.  We'll need
+             // the checksum and the bytes later to verify that our replay of the same
+             // frame got the same results.
+             SaveCurrentFrame(_last_input);
 
-                _udp->SendTo((char*)_oo_packet.msg, _oo_packet.msg->PacketSize(), 0, (struct sockaddr*)&_oo_packet.dest_addr, sizeof _oo_packet.dest_addr);
+             if (_sync.GetFrameCount() - _last_verified >= _check_distance)
+             {
+                 VerifySavedFrames();
+             }
 
-                delete _oo_packet.msg;
-                _oo_packet.msg = NULL;
-            }
-        }
+             return (_desynced and not _continuous) ? ErrorCode::FATAL_DESYNC : ErrorCode::OK;
+         }
 
-        void
-            SendPendingOutput()
-        {
-            UdpMsg* msg = new UdpMsg(UdpMsg::Input);
-            int i, j, offset = 0;
-            uint8_t* bits;
-            GameInput last;
+         /*
+          * How many frames to run ahead before going back and resimulating them.  Not
+          * tied to any fixed buffer, the arena just grows to fit the largest distance
+          * used.  Takes effect on the next frame.
+          */
+         ErrorCode
+             SetCheckDistance(int frames)
+         {
+             if (frames < 1)
+             {
+                 return ErrorCode::INVALID_REQUEST;
+             }
 
-            if (_pending_output.CurrentSize())
-            {
-                last = _last_acked_input;
-                bits = msg->u.input.bits;
+             _check_distance = frames;
+             return ErrorCode::OK;
+         }
 
-                msg->u.input.start_frame = _pending_output.Front().frame;
-                msg->u.input.input_size = (uint8_t)_pending_output.Front().size;
+         void
+             SetContinuous(bool continuous)
+         {
+             _continuous = continuous;
+         }
 
-                GGPO_ASSERT(last.frame == -1 || last.frame + 1 == msg->u.input.start_frame);
+         int
+             GetDesyncCount()
+             const
+         {
+             return _desync_count;
+         }
 
-                for (j = 0; j < _pending_output.CurrentSize(); j++)
-                {
-                    GameInput& current = _pending_output.At(j);
+         int64_t
+             GetFramesVerified()
+             const
+         {
+             return _frames_verified;
+         }
 
-                    if (memcmp(current.bits, last.bits, current.size) != 0)
-                    {
-                        GGPO_ASSERT((GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8) < (1 << GGPO_BITVECTOR_NIBBLE_SIZE));
+         size_t
+             GetArenaCapacityBytes()
+             const
+         {
+             return _state_arena.GetCapacityBytes();
+         }
 
-                        for (i = 0; i < current.size * 8; i++)
-                        {
-                            GGPO_ASSERT(i < (1 << GGPO_BITVECTOR_NIBBLE_SIZE));
-
-                            if (current.value(i) != last.value(i))
-                            {
-                                BitVector_SetBit(msg->u.input.bits, &offset);
-                                (current.value(i) ? BitVector_SetBit : BitVector_ClearBit)(bits, &offset);
-                                BitVector_WriteNibblet(bits, i, &offset);
-                            }
-                        }
-                    }
-                    BitVector_ClearBit(msg->u.input.bits, &offset);
-                    last = _last_sent_input = current;
-                }
-            }
-            else
-            {
-                msg->u.input.start_frame = 0;
-                msg->u.input.input_size = 0;
-            }
+     protected:
+         void
+             SaveCurrentFrame(const GameInput& input)
+         {
+             int checksum = 0;
 
-            msg->u.input.ack_frame = _last_received_input.frame;
-            msg->u.input.num_bits = (uint16_t)offset;
+             _game->SaveState(_scratch_state, &checksum);
+             _state_arena.Store(_sync.GetFrameCount(), checksum, input, _scratch_state);
+         }
 
-            msg->u.input.disconnect_requested = _current_state == Disconnected;
+         void
+             VerifySavedFrames()
+         {
+             // We've gone far enough ahead and should now start replaying frames.
+             // Load the last verified frame and set the rollback flag to true.
+             _rollingback = true;
 
-            if (_local_connect_status)
-            {
-                memcpy(msg->u.input.peer_connect_status, _local_connect_status, sizeof(UdpMsg::connect_status) * UDP_MSG_MAX_PLAYERS);
-            }
-            else
-            {
-                memset(msg->u.input.peer_connect_status, 0, sizeof(UdpMsg::connect_status) * UDP_MSG_MAX_PLAYERS);
-            }
+             _scratch_state.assign(_state_arena.GetState(0));
+             _game->LoadState(_scratch_state);
 
-            GGPO_ASSERT(offset < MAX_COMPRESSED_BITS);
+             bool desynced = false;
 
-            SendMsg(msg);
-        }
+             for (int i = 1; i < _state_arena.Count(); i++)
+             {
+                 const SyncTestStateArena::Slot& saved = _state_arena.GetSlot(i);
 
-        bool
-            OnInvalid(UdpMsg* msg, int len)
-        {
-            GGPO_ASSERT(false and "Invalid msg in UdpProtocol");
-            return false;
-        }
+                 _game->AdvanceFrame(saved.input.bits, saved.input.size);
 
-        bool
-            OnSyncRequest(UdpMsg* msg, int len)
-        {
-            if (_remote_magic_number != 0 and msg->hdr.magic != _remote_magic_number)
-            {
-                udp_protocol_logger->Error(format("Ignoring sync request from unknown endpoint ({} != {}).", msg->hdr.magic, _remote_magic_number), "udp_proto.cpp");
-                return false;
-            }
+                 int checksum = 0;
+                 _game->SaveState(_scratch_state, &checksum);
 
-            UdpMsg* reply = new UdpMsg(UdpMsg::SyncReply);
-            reply->u.sync_reply.random_reply = msg->u.sync_request.random_request;
-            SendMsg(reply);
+                 const int offset = FindFirstDifference(_state_arena.GetState(i), _scratch_state);
 
-            return true;
-        }
+                 if (checksum != saved.checksum or offset != -1)
+                 {
+                     ReportDesync(saved, checksum, offset);
+                     desynced = true;
+                     break; // every frame after the first bad one is garbage anyway
+                 }
 
-        bool
-            OnSyncReply(UdpMsg* msg, int len)
-        {
-            if (_current_state != Syncing)
-            {
-                udp_protocol_logger->Info("Ignoring SyncReply while not synching.", "udp_proto.cpp");
-                return msg->hdr.magic == _remote_magic_number;
-            }
+                 sync_test_backend_logger->Info(format("Checksum {} for frame {} matches.", checksum, saved.frame), "synctest.cpp");
+                 _frames_verified++;
+             }
 
-            if (msg->u.sync_reply.random_reply != _state.sync.random)
-            {
-                udp_protocol_logger->Info(format("sync reply {} != {}.  Keep looking...", msg->u.sync_reply.random_reply, _state.sync.random), "udp_proto.cpp");
-                return false;
-            }
+             /*
+              * The newest original state becomes the start of the next pass.  If we
+              * bailed out early the game is sitting on a resimulated (and wrong)
+              * frame, so put it back on the timeline it was on before we poked it.
+              */
+             const SyncTestStateArena::Slot newest = _state_arena.GetSlot(_state_arena.Count() - 1);
 
-            if (not _connected)
-            {
-                QueueEvent(Event(Event::Connected));
-                _connected = true;
-            }
+             _scratch_state.assign(_state_arena.GetState(_state_arena.Count() - 1));
 
-            udp_protocol_logger->Info(format("Checking sync state ({} round trips remaining).", _state.sync.roundtrips_remaining), "udp_proto.cpp");
+             if (desynced)
+             {
+                 _game->LoadState(_scratch_state);
+             }
 
-            if (--_state.sync.roundtrips_remaining == 0)
-            {
-                udp_protocol_logger->Info("Synchronized!", "udp_proto.cpp");
-                QueueEvent(UdpProtocol::Event(UdpProtocol::Event::Synchronzied));
-                _current_state = Running;
-                _last_received_input.frame = -1;
-                _remote_magic_number = msg->hdr.magic;
-            }
-            else
-            {
-                UdpProtocol::Event evt(UdpProtocol::Event::Synchronizing);
-                evt.u.synchronizing.total = NUM_SYNC_PACKETS;
-                evt.u.synchronizing.count = NUM_SYNC_PACKETS - _state.sync.roundtrips_remaining;
-                QueueEvent(evt);
-                SendSyncRequest();
-            }
+             _state_arena.Clear();
+             _state_arena.Store(newest.frame, newest.checksum, newest.input, _scratch_state);
 
-            return true;
-        }
+             _last_verified = newest.frame;
+             _rollingback = false;
+         }
 
-        bool
-            OnInput(UdpMsg* msg, int len)
-        {
-            /*
-             * If a disconnect is requested, go ahead and disconnect now.
-             */
-            bool disconnect_requested = msg->u.input.disconnect_requested;
+         void
+             ReportDesync
+             (
+                 const SyncTestStateArena::Slot& saved,
+                 int checksum,
+                 int offset
+             )
+         {
+             _desynced = true;
+             _desync_count++;
 
-            if (disconnect_requested)
-            {
-                if (_current_state != Disconnected and not _disconnect_event_sent)
-                {
-                    udp_protocol_logger->Info("Disconnecting endpoint on remote request.", "udp_proto.cpp");
-                    QueueEvent(Event(Event::Disconnected));
-                    _disconnect_event_sent = true;
-                }
-            }
-            else
-            {
-                /*
-                 * Update the peer connection status if this peer is still considered to be part
-                 * of the network.
-                 */
-                UdpMsg::connect_status* remote_status = msg->u.input.peer_connect_status;
+             sync_test_backend_logger->Error(format("Checksum for frame {} does not match saved ({} != {}), first differing byte at offset {}", saved.frame, checksum, saved.checksum, offset), "synctest.cpp");
 
-                for (int i = 0; i < GGPO_ARRAY_SIZE(_peer_connect_status); i++)
-                {
-                    GGPO_ASSERT(remote_status[i].last_frame >= _peer_connect_status[i].last_frame);
+             if (not _continuous)
+             {
+                 sync_test_backend_logger->Error(format("Sync test will now stop with error: {}", ErrorToString(ErrorCode::FATAL_DESYNC)), "synctest.cpp");
+             }
 
-                    _peer_connect_status[i].disconnected = _peer_connect_status[i].disconnected || remote_status[i].disconnected;
-                    _peer_connect_status[i].last_frame = GGPO_MAX(_peer_connect_status[i].last_frame, remote_status[i].last_frame);
-                }
-            }
+             Event info;
 
-            /*
-             * Decompress the input.
-             */
-            int last_received_frame_number = _last_received_input.frame;
+             info.code = EventCode::SyncTestDesync;
+             info.u.synctest_desync.frame = saved.frame;
+             info.u.synctest_desync.checksum = checksum;
+             info.u.synctest_desync.expected_checksum = saved.checksum;
+             info.u.synctest_desync.first_diff_offset = offset;
 
-            if (msg->u.input.num_bits)
-            {
-                int offset = 0;
-                uint8_t* bits = (uint8_t*)msg->u.input.bits;
-                int numBits = msg->u.input.num_bits;
-                int currentFrame = msg->u.input.start_frame;
+             _event_queue.Push(info); // oldest events get overwritten if nobody drains the queue
+         }
 
-                _last_received_input.size = msg->u.input.input_size;
+         static int
+             FindFirstDifference(string_view original, const string& replay)
+         {
+             const size_t count = GGPO_MIN(original.size(), replay.size());
 
-                if (_last_received_input.frame < 0)
-                {
-                    _last_received_input.frame = msg->u.input.start_frame - 1;
-                }
+             for (size_t i = 0; i < count; i++)
+             {
+                 if (original[i] != replay[i])
+                 {
+                     return (int)i;
+                 }
+             }
 
-                while (offset < numBits)
-                {
-                    /*
-                     * Keep walking through the frames (parsing bits) until we reach
-                     * the inputs for the frame right after the one we're on.
-                     */
-                    GGPO_ASSERT(currentFrame <= (_last_received_input.frame + 1));
-                    bool useInputs = currentFrame == _last_received_input.frame + 1;
+             return original.size() == replay.size() ? -1 : (int)count;
+         }
 
-                    while (BitVector_ReadBit(bits, &offset))
-                    {
-                        int on = BitVector_ReadBit(bits, &offset);
-                        int button = BitVector_ReadNibblet(bits, &offset);
+     protected:
+         Sync                   _sync;
+         IReplayGame*           _game;
+         int                    _num_players;
+         int                    _check_distance;
+         int                    _last_verified;
+         bool                   _rollingback;
+         bool                   _running;
+         bool                   _continuous;
+         bool                   _desynced;
+         int                    _desync_count;
+         int64_t                _frames_verified;
+         string                   pm_GameName;
 
-                        if (useInputs)
-                        {
-                            if (on)
-                            {
-                                _last_received_input.set(button);
-                            }
-                            else
-                            {
-                                _last_received_input.clear(button);
-                            }
-                        }
-                    }
-                    GGPO_ASSERT(offset <= numBits);
+         GameInput                  _current_input;
+         GameInput                  _last_input;
+         SyncTestStateArena         _state_arena;
+         string                     _scratch_state;
+         RingBuffer<Event, 32>      _event_queue;
+     };
+}
+ 
+//==================================================================================== Replay Verifier ============================================================================================//
 
-                    /*
-                     * Now if we want to use these inputs, go ahead and send them to
-                     * the emulator.
-                     */
-                    if (useInputs)
-                    {
-                        /*
-                         * Move forward 1 frame in the stream.
-                         */
-                        char desc[1024];
-                        GGPO_ASSERT(currentFrame == _last_received_input.frame + 1);
-                        _last_received_input.frame = currentFrame;
+namespace GGPO
+{
+    /*
+     * Every confirmed input of a match, one frame after another.  Each frame is
+     * num_players * input_size bytes laid out exactly like the buffer SyncInput()
+     * hands back to the game, so a recording can be fed straight into a replay.
+     */
+    struct ReplayRecording
+    {
+        int             num_players = 0;
+        int             input_size = 0;
+        vector<char>    inputs;
 
-                        /*
-                         * Send the event to the emualtor
-                         */
-                        UdpProtocol::Event evt(UdpProtocol::Event::Input);
-                        evt.u.input.input = _last_received_input;
+        int
+            FrameSize()
+            const
+        {
+            return num_players * input_size;
+        }
 
-                        _last_received_input.Description(desc);
+        int
+            FrameCount()
+            const
+        {
+            return FrameSize() ? (int)(inputs.size() / FrameSize()) : 0;
+        }
 
-                        _state.running.last_input_packet_recv_time = Platform::GetMonotonicTimeMS();
+        const char*
+            GetFrame(int frame)
+            const
+        {
+            return inputs.data() + ((size_t)frame * FrameSize());
+        }
 
-                        udp_protocol_logger->Info(format("Sending frame {} to emu queue {} ({}).", _last_received_input.frame, _queue, desc), "udp_proto.cpp");
-                        QueueEvent(evt);
+        void
+            AddFrame(const char* values)
+        {
+            inputs.insert(inputs.end(), values, values + FrameSize());
+        }
+    };
 
-                    }
-                    else
-                    {
-                        udp_protocol_logger->Info(format("Skipping past frame:({}) current is {}.", currentFrame, _last_received_input.frame), "udp_proto.cpp");
-                    }
+    /*
+     * How a worker perturbs its replay.
+     *
+     * rollback_distance: remote inputs are handed to the input queues this many
+     *       frames late, so the worker predicts and rolls back just like a real
+     *       session with that much latency.  Clamped to MAX_PREDICTION_FRAMES.
+     *
+     * misprediction_interval: every n frames the prediction is forced to be wrong
+     *       (see InputQueue::SetForcedMispredictionInterval).  0 turns it off.
+     *       Needs a rollback_distance of at least 1 to have anything to predict.
+     */
+    struct ReplayWorkerConfig
+    {
+        int rollback_distance = 0;
+        int misprediction_interval = 0;
+    };
 
-                    /*
-                     * Move forward 1 frame in the input stream.
-                     */
-                    currentFrame++;
-                }
-            }
+    struct ReplayReport
+    {
+        int       num_workers;
+        int       num_frames;
+        int64_t   frames_simulated;     /* including resimulated frames, across all workers */
+        int       first_desync_frame;   /* -1 when every worker agrees with worker 0 */
+        int       desync_worker;
+        double    seconds;
+        double    frames_verified_per_second_per_core;
+    };
 
-            GGPO_ASSERT(_last_received_input.frame >= last_received_frame_number);
+    class ReplayWorker
+    {
+    public:
+        ReplayWorker
+        (
+            const ReplayRecording& recording,
+            IReplayGame* game,
+            const ReplayWorkerConfig& config
+        ) :
+            _recording(recording),
+            _game(game),
+            _framecount(0),
+            _next_frame_to_deliver(0),
+            _frames_simulated(0)
+        {
+            _rollback_distance = GGPO_MIN(GGPO_MAX(config.rollback_distance, 0), MAX_PREDICTION_FRAMES);
 
-            /*
-             * Get rid of our buffered input
-             */
-            while (_pending_output.CurrentSize() and _pending_output.Front().frame < msg->u.input.ack_frame)
+            if (config.misprediction_interval > 0)
             {
-                udp_protocol_logger->Info(format("Throwing away pending output frame {}", _pending_output.Front().frame), "udp_proto.cpp");
-                _last_acked_input = _pending_output.Front();
-                _pending_output.Pop();
+                _rollback_distance = GGPO_MAX(_rollback_distance, 1);
             }
-            return true;
+
+            _misprediction_interval = config.misprediction_interval;
         }
 
-        bool
-            OnInputAck(UdpMsg* msg, int len)
+        /*
+         * Must be called from the thread doing the work since the input queues
+         * create their loggers (which are owned by the creating thread) in here.
+         */
+        void
+            Run()
         {
-            /*
-             * Get rid of our buffered input
-             */
-            while (_pending_output.CurrentSize() and _pending_output.Front().frame < msg->u.input_ack.ack_frame)
+            const int num_frames = _recording.FrameCount();
+            const int num_players = _recording.num_players;
+
+            _input_queues = make_unique<InputQueue[]>(num_players);
+
+            for (int i = 0; i < num_players; i++)
             {
-                udp_protocol_logger->Info(format("Throwing away pending output frame {}", _pending_output.Front().frame), "udp_proto.cpp");
-                _last_acked_input = _pending_output.Front();
-                _pending_output.Pop();
+                _input_queues[i].Init(i, _recording.input_size, INPUT_QUEUE_LENGTH);
+                _input_queues[i].SetForcedMispredictionInterval(_misprediction_interval);
             }
 
-            return true;
-        }
+            _states.assign(_rollback_distance + 2, string());
+            _frame_inputs.assign(_recording.FrameSize(), 0);
+            _checksums.assign(num_frames + 1, 0);
 
-        bool
-            OnQualityReport(UdpMsg* msg, int len)
-        {
-            // send a reply so the other side can compute the round trip transmit time.
-            UdpMsg* reply = new UdpMsg(UdpMsg::QualityReply);
-            reply->u.quality_reply.pong = msg->u.quality_report.ping;
-            SendMsg(reply);
+            while (_framecount < num_frames)
+            {
+                DeliverInputs(_framecount - _rollback_distance);
+                ResolveMispredictions();
+                SimulateFrame();
+            }
 
-            _remote_frame_advantage = msg->u.quality_report.frame_advantage;
-            return true;
+            DeliverInputs(num_frames - 1);
+            ResolveMispredictions();
+
+            SaveCurrentFrame(); // checksum of the final state
         }
 
-        bool
-            OnQualityReply(UdpMsg* msg, int len)
+        const vector<int>&
+            GetChecksums()
+            const
         {
-            _round_trip_time = Platform::GetMonotonicTimeMS() - msg->u.quality_reply.pong;
-            return true;
+            return _checksums;
         }
 
-        bool
-           OnKeepAlive(UdpMsg* msg, int len) //wtf?
+        int64_t
+            GetFramesSimulated()
+            const
         {
-            return true;
+            return _frames_simulated;
         }
 
     protected:
-        /*
-        * Network transmission information
-        */
-        Udp* _udp;
-        sockaddr_in    _peer_addr;
-        uint16_t         _magic_number;
-        int            _queue;
-        uint16_t         _remote_magic_number;
-        bool           _connected;
-        int            _send_latency;
-        int            _oop_percent;
-        struct 
+        void
+            DeliverInputs(int last_frame)
         {
-            int         send_time = -1;
-            sockaddr_in dest_addr;
-            UdpMsg* msg = nullptr;
-        } _oo_packet;
-        RingBuffer<QueueEntry, 64> _send_queue;
-
-        /*
-        * Stats
-        */
-        int            _round_trip_time;
-        int            _packets_sent;
-        int            _bytes_sent;
-        int            _kbps_sent;
-        int            _stats_start_time;
-
-        /*
-        * The state machine
-        */
-        UdpMsg::connect_status* _local_connect_status;
-        UdpMsg::connect_status _peer_connect_status[UDP_MSG_MAX_PLAYERS];
-
-        State          _current_state;
+            const int input_size = _recording.input_size;
 
-        union 
-        {
-            struct 
-            {
-                uint32_t   roundtrips_remaining;
-                uint32_t   random;
-            } sync;
-            struct 
+            while (_next_frame_to_deliver <= last_frame and _next_frame_to_deliver < _recording.FrameCount())
             {
-                uint32_t   last_quality_report_time;
-                uint32_t   last_network_stats_interval;
-                uint32_t   last_input_packet_recv_time;
-            } running;
-        } _state;
+                char* frame_bits = const_cast<char*>(_recording.GetFrame(_next_frame_to_deliver));
 
-        /*
-        * Fairness.
-        */
-        int               _local_frame_advantage;
-        int               _remote_frame_advantage;
+                for (int i = 0; i < _recording.num_players; i++)
+                {
+                    GameInput input;
+                    input.init(_next_frame_to_deliver, frame_bits + (i * input_size), input_size);
+                    _input_queues[i].AddInput(input);
+                }
 
-        /*
-        * Packet loss...
-        */
-        RingBuffer<GameInput, 64>  _pending_output;
-        GameInput                  _last_received_input;
-        GameInput                  _last_sent_input;
-        GameInput                  _last_acked_input;
-        unsigned int               _last_send_time;
-        unsigned int               _last_recv_time;
-        unsigned int               _shutdown_timeout;
-        unsigned int               _disconnect_event_sent;
-        unsigned int               _disconnect_timeout;
-        unsigned int               _disconnect_notify_start;
-        bool                       _disconnect_notify_sent;
+                _next_frame_to_deliver++;
+            }
+        }
 
-        uint16_t                     _next_send_seq;
-        uint16_t                     _next_recv_seq;
+        void
+            ResolveMispredictions()
+        {
+            int seek_to = GameInput::NullFrame;
 
-        /*
-        * Rift synchronization.
-        */
-        TimeSync                   _timesync;
+            for (int i = 0; i < _recording.num_players; i++)
+            {
+                int incorrect = _input_queues[i].GetFirstIncorrectFrame();
 
-        /*
-        * Event queue
-        */
-        RingBuffer<UdpProtocol::Event, 64>  _event_queue;
-    };
-}
- 
-//==================================================================================== SyncTest Backend ============================================================================================//
+                if (incorrect != GameInput::NullFrame and (seek_to == GameInput::NullFrame or incorrect < seek_to))
+                {
+                    seek_to = incorrect;
+                }
+            }
 
-namespace GGPO
-{
-    class SyncTestBackend
-    {
-    private:
-        unique_ptr<Logger> sync_test_backend_logger = nullptr;
+            if (seek_to != GameInput::NullFrame)
+            {
+                /*
+                 * Same dance as a real rollback: load the first bad frame, forget the
+                 * predictions and resimulate up to where we were.
+                 */
+                const int resume_frame = _framecount;
 
-     public:
-         SyncTestBackend
-         (
-             string gamename,
-             const int frames,
-             const int num_players
-         ) :
-             _sync(NULL)
-         {
-             sync_test_backend_logger = Logger::CreateUnique("SyncTestBackendLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
-             
-             GGPO_ASSERT(sync_test_backend_logger)
+                GGPO_ASSERT(resume_frame - seek_to < (int)_states.size());
 
-             _num_players = num_players;
-             _check_distance = frames;
-             _last_verified = 0;
-             _rollingback = false;
-             _running = false;
-             _current_input.erase();
-             pm_GameName = gamename;
+                _game->LoadState(_states[seek_to % _states.size()]);
+                _framecount = seek_to;
 
-             /*
-              * Initialize the synchronziation layer
-              */
-             Sync::Config config = { 0 };
-             config.num_prediction_frames = MAX_PREDICTION_FRAMES;
-             _sync.Init(config);
+                for (int i = 0; i < _recording.num_players; i++)
+                {
+                    _input_queues[i].ResetPrediction(_framecount);
+                }
 
-             /*
-              * Preload the ROM
-              */
-              //_callbacks.begin_game(gamename); ?????????????????????????????
-         }
+                while (_framecount < resume_frame)
+                {
+                    SimulateFrame();
+                }
+            }
 
-         virtual ~SyncTestBackend() = default;
+            const int last_confirmed = _next_frame_to_deliver - 1;
 
-         virtual ErrorCode
-             DoPoll()
-         {
-             if (not _running)
-             {
-                 Event info;
+            if (last_confirmed > 0)
+            {
+                for (int i = 0; i < _recording.num_players; i++)
+                {
+                    _input_queues[i].DiscardConfirmedFrames(last_confirmed - 1);
+                }
+            }
+        }
 
-                 info.code = EventCode::Running;
-                 _callbacks.on_event(&info);
-                 _running = true;
-             }
+        void
+            SimulateFrame()
+        {
+            const int input_size = _recording.input_size;
 
-             return ErrorCode::OK;
-         }
+            SaveCurrentFrame();
 
-         virtual ErrorCode
-             AddPlayer
-             (
-                 Player* player, 
-                 PlayerHandle* handle
-             )
-         {
-             if (player->player_num < 1 || player->player_num > _num_players)
-             {
-                 return ErrorCode::PLAYER_OUT_OF_RANGE;
-             }
+            for (int i = 0; i < _recording.num_players; i++)
+            {
+                _input_queues[i].GetInput(_framecount, _frame_inputs.data() + (i * input_size));
+            }
 
-             *handle = (PlayerHandle)(player->player_num - 1);
-             return ErrorCode::OK;
-         }
+            _game->AdvanceFrame(_frame_inputs.data(), (int)_frame_inputs.size());
 
-         virtual ErrorCode
-             AddLocalInput(PlayerHandle player, void* values, int size)
-         {
-             if (not _running)
-             {
-                 return ErrorCode::NOT_SYNCHRONIZED;
-             }
+            _framecount++;
+            _frames_simulated++;
+        }
 
-             int index = (int)player;
+        void
+            SaveCurrentFrame()
+        {
+            // resimulated frames overwrite their checksum so only the corrected timeline is compared
+            _game->SaveState(_states[_framecount % _states.size()], &_checksums[_framecount]);
+        }
 
-             for (int i = 0; i < size; i++)
-             {
-                 _current_input.bits[(index * size) + i] |= ((char*)values)[i];
-             }
+    protected:
+        const ReplayRecording&      _recording;
+        IReplayGame*                _game;
 
-             return ErrorCode::OK;
-         }
+        int                         _rollback_distance;
+        int                         _misprediction_interval;
 
-         virtual ErrorCode
-             SyncInput
-             (
-                 void* values,
-                 int size,
-                 int* disconnect_flags
-             )
-         {
-             if (_rollingback) //HERES THE THING
-             {
-                 _last_input = _saved_frames.Front().input;
-             }
-             else
-             {
-                 if (_sync.GetFrameCount() == 0)
-                 {
-                     _sync.SaveCurrentFrame();
-                 }
-                 _last_input = _current_input;
-             }
+        int                         _framecount;
+        int                         _next_frame_to_deliver;
+        int64_t                     _frames_simulated;
 
-             memcpy(values, _last_input.bits, size);
+        unique_ptr<InputQueue[]>    _input_queues;
+        vector<string>              _states;
+        vector<char>                _frame_inputs;
+        vector<int>                 _checksums;
+    };
 
-             if (disconnect_flags)
-             {
-                 *disconnect_flags = 0;
-             }
+    /*
+     * Headless desync hunting.  Replays a recorded match on N worker threads, each
+     * with its own perturbation, and compares the per-frame checksums of every
+     * worker against worker 0.  A deterministic game produces the same checksum
+     * for a frame no matter how many times (or with which wrong inputs) it was
+     * simulated before being corrected, so any disagreement is a desync.
+     */
+    class ReplayVerifier
+    {
+    private:
+        unique_ptr<Logger> replay_verifier_logger = nullptr;
 
-             return ErrorCode::OK;
-         }
+    public:
+        ReplayVerifier()
+        {
+            replay_verifier_logger = Logger::CreateUnique("ReplayVerifierLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
 
-         virtual ErrorCode
-             IncrementFrame(void)
-         {
-             _sync.IncrementFrame();
-             _current_input.erase();
+            GGPO_ASSERT(replay_verifier_logger)
+        }
 
-             sync_test_backend_logger->Info(format("End of frame({})...", _sync.GetFrameCount()), "synctest.cpp");
+        ErrorCode
+            Run
+            (
+                const ReplayRecording& recording,
+                IReplayGame** games,
+                const ReplayWorkerConfig* configs,
+                int num_workers,
+                ReplayReport* report
+            )
+        {
+            if (not games or not configs or not report)
+            {
+                replay_verifier_logger->Error("Tried to pass nullptr ref to Run()", "replay_verifier.cpp");
+                return ErrorCode::NULLPTR_PASSED_AS_VALUE;
+            }
 
-             if (_rollingback)
-             {
-                 return ErrorCode::OK;
-             }
+            if (num_workers < 1 or recording.FrameCount() == 0)
+            {
+                return ErrorCode::INVALID_REQUEST;
+            }
 
-             int frame = _sync.GetFrameCount();
-             // Hold onto the current frame in our queue of saved states.  We'll need
-             // the checksum later to verify that our replay of the same frame got the
-             // same results.
-             SavedInfo info;
+            vector<unique_ptr<ReplayWorker>> workers;
+            vector<thread> threads;
 
-             info.frame = frame;
-             info.input = _last_input;
-             info.buf = (_sync.GetLastSavedFrame().buf);
-             info.checksum = _sync.GetLastSavedFrame().checksum;
+            for (int i = 0; i < num_workers; i++)
+            {
+                workers.push_back(make_unique<ReplayWorker>(recording, games[i], configs[i]));
+            }
 
-             _saved_frames.SafePush(info);
+            const auto start_time = chrono::steady_clock::now();
 
-             if (frame - _last_verified == _check_distance)
-             {
-                 // We've gone far enough ahead and should now start replaying frames.
-                 // Load the last verified frame and set the rollback flag to true.
-                 _sync.LoadFrame(_last_verified);
+            for (int i = 0; i < num_workers; i++)
+            {
+                threads.emplace_back(&ReplayWorker::Run, workers[i].get());
+            }
 
-                 _rollingback = true;
+            for (thread& lv_Thread : threads)
+            {
+                lv_Thread.join();
+            }
 
-                 while (not _saved_frames.IsEmpty())
-                 {
-                     _callbacks.advance_frame(0);
+            const chrono::duration<double> elapsed = chrono::steady_clock::now() - start_time;
 
-                     // Verify that the checksumn of this frame is the same as the one in our
-                     // list.
-                     info = _saved_frames.Front();
-                     _saved_frames.Pop();
+            memset(report, 0, sizeof * report);
 
-                     if (info.frame != _sync.GetFrameCount()) //REPLACE THIS WITH AN IMMEDIATE END SESSION CALL INSTEAD OF CRASHING THE ENTIRE PROGRAM LMFAO
-                     {
-                         sync_test_backend_logger->Error(format("Frame number {} does not match saved frame number {}", info.frame, frame), "synctest.cpp");
-                         sync_test_backend_logger->Error(format("Program will now exit with error: {}", ErrorToString(ErrorCode::FATAL_DESYNC)), "synctest.cpp");
-                         exit(static_cast<int>(ErrorCode::FATAL_DESYNC)); //RAISESYNC ERRROR WAS HERE
-                     }
+            report->num_workers = num_workers;
+            report->num_frames = recording.FrameCount();
+            report->first_desync_frame = -1;
+            report->desync_worker = -1;
+            report->seconds = elapsed.count();
 
-                     int checksum = _sync.GetLastSavedFrame().checksum;
+            const vector<int>& reference = workers[0]->GetChecksums();
 
-                     if (info.checksum != checksum)
-                     {
-                         sync_test_backend_logger->Error(format("Checksum for frame {} does not match saved ({} != {})", frame, checksum, info.checksum), "synctest.cpp");
-                         sync_test_backend_logger->Error(format("Program will now exit with error: {}", ErrorToString(ErrorCode::FATAL_DESYNC)), "synctest.cpp");
-                         exit(static_cast<int>(ErrorCode::FATAL_DESYNC)); //RAISESYNC ERRROR WAS HERE
-                     }
+            for (int i = 0; i < num_workers; i++)
+            {
+                report->frames_simulated += workers[i]->GetFramesSimulated();
 
-                     sync_test_backend_logger->Info(format("Checksum {} for frame {} matches.", checksum, info.frame), "synctest.cpp");
-                 }
+                const vector<int>& checksums = workers[i]->GetChecksums();
+                const int compared = (int)GGPO_MIN(checksums.size(), reference.size());
 
-                 _last_verified = frame;
-                 _rollingback = false;
-             }
+                // a worker that stopped short of worker 0 (or ran past it) is off from the first frame only one of them has
+                int desync_frame = checksums.size() == reference.size() ? -1 : compared;
 
-             return ErrorCode::OK;
-         }
+                for (int frame = 0; frame < compared; frame++)
+                {
+                    if (checksums[frame] != reference[frame])
+                    {
+                        replay_verifier_logger->Error(format("Worker {} desynced from worker 0 at frame {} ({} != {}).", i, frame, checksums[frame], reference[frame]), "replay_verifier.cpp");
+                        desync_frame = frame;
+                        break;
+                    }
+                }
 
-     protected:
-         struct SavedInfo
-         {
-             int frame;
-             int checksum;
-             string buf;
-             GameInput input;
-         };
+                if (desync_frame != -1 and (report->first_desync_frame == -1 or desync_frame < report->first_desync_frame))
+                {
+                    report->first_desync_frame = desync_frame;
+                    report->desync_worker = i;
+                }
+            }
 
-         void
-             LogSaveStates(SavedInfo& info)
-         {
-             sync_test_backend_logger->Info(format("state-{}-original and {}", _sync.GetFrameCount(), info.buf), "synctest.cpp");
+            const int cores = GGPO_MAX(1, GGPO_MIN(num_workers, (int)thread::hardware_concurrency()));
 
-             sync_test_backend_logger->Info(format("state-{}-replay and {}", _sync.GetFrameCount(), _sync.GetLastSavedFrame().buf), "synctest.cpp");
-         }
+            // verified frames, not simulated ones, or a deeper rollback would look faster
+            if (report->seconds > 0.0)
+            {
+                report->frames_verified_per_second_per_core = (double)report->num_frames * num_workers / report->seconds / cores;
+            }
 
-     protected:
-         Sync                   _sync;
-         int                    _num_players;
-         int                    _check_distance;
-         int                    _last_verified;
-         bool                   _rollingback;
-         bool                   _running;
-         string                   pm_GameName;
+            replay_verifier_logger->Info(format("Verified {} frames on {} workers in {} s ({} frames/s/core).", report->num_frames, num_workers, report->seconds, report->frames_verified_per_second_per_core), "replay_verifier.cpp");
 
-         GameInput                  _current_input;
-         GameInput                  _last_input;
-         RingBuffer<SavedInfo, 32>  _saved_frames;
-     };
+            return report->first_desync_frame == -1 ? ErrorCode::OK : ErrorCode::FATAL_DESYNC;
+        }
+    };
 }
- 
+
 //==================================================================================== Spectator Backend ============================================================================================//
  
- constexpr int SPECTATOR_FRAME_BUFFER_SIZE = 64;
- 
  namespace GGPO
  {
     class SpectatorBackend
@@ -4512,8 +10954,43 @@ namespace GGPO
             int num_players,
             int input_size,
             char* hostip,
-            uint16_t hostport
+            uint16_t hostport,
+            const SessionLimits& limits = SessionLimits(),
+            TransportType transport = TransportType::Udp
+        ) :
+            SpectatorBackend(gamename, CreateTransport(transport, localport), nullptr, num_players, input_size, hostip, hostport, limits)
+        {
+        }
+
+        // over your own transport instead of one of our sockets, it has to outlive the session
+        SpectatorBackend
+        (
+            const char* gamename,
+            Transport* transport,
+            int num_players,
+            int input_size,
+            char* hostip,
+            uint16_t hostport,
+            const SessionLimits& limits = SessionLimits()
+        ) :
+            SpectatorBackend(gamename, unique_ptr<Transport>(), transport, num_players, input_size, hostip, hostport, limits)
+        {
+        }
+
+    protected:
+        SpectatorBackend
+        (
+            const char* gamename,
+            unique_ptr<Transport> owned_transport,
+            Transport* transport,
+            int num_players,
+            int input_size,
+            char* hostip,
+            uint16_t hostport,
+            const SessionLimits& limits
         ) :
+            _owned_transport(move(owned_transport)),
+            _transport(transport ? transport : _owned_transport.get()),
             _num_players(num_players),
             _input_size(input_size),
             _next_input_to_send(0)
@@ -4522,22 +10999,30 @@ namespace GGPO
              
             GGPO_ASSERT(spectator_backend_logger)
 
+            GGPO_ASSERT(limits.IsValid());
+
             _synchronizing = true;
 
-            for (int i = 0; i < GGPO_ARRAY_SIZE(_inputs); i++)
+            _inputs.resize(limits.spectator_frame_buffer);
+
+            for (int i = 0; i < (int)_inputs.size(); i++)
             {
                 _inputs[i].frame = -1;
             }
 
-            /*
-            * Initialize the UDP port
-            */
-            _udp.Init(localport, &_poll, this);
+            GGPO_ASSERT(_transport);
 
             /*
             * Init the host endpoint
             */
-            _host.Init(&_udp, _poll, 0, hostip, hostport, NULL);
+            if (not _host.Init(_transport, _poll, 0, hostip, hostport, NULL))
+            {
+                spectator_backend_logger->Error(format("can't reach host {} port {}, this session will never synchronize.", hostip, hostport), "spectator.cpp");
+            }
+            _host.SetEventQueueLength(limits.spectator_frame_buffer); // we can't hold more than that anyway
+            _host.SetAckPolicy(limits.ack_policy);
+            _host.SetMaxDatagramSize(limits.max_datagram_size);
+            _host.SetCoalescing(limits.coalesce);
             _host.Synchronize();
 
             /*
@@ -4546,15 +11031,21 @@ namespace GGPO
             //_callbacks.begin_game(gamename); //?????????????????????????????????
         }
 
+    public:
         ~SpectatorBackend() = default;
  
       public:
           ErrorCode
               DoPoll(int timeout)
           {
-              _poll.Pump(0);
+              ReceiveMessages();
+
+              _poll.Pump(timeout);
 
-              PollUdpProtocolEvents();
+              PollUdpProtocolEvents(_event_queue);
+
+              _host.Flush();
+              _transport->Flush();
               return ErrorCode::OK;
           }
 
@@ -4572,7 +11063,7 @@ namespace GGPO
                   return ErrorCode::NOT_SYNCHRONIZED;
               }
 
-              GameInput& input = _inputs[_next_input_to_send % SPECTATOR_FRAME_BUFFER_SIZE];
+              GameInput& input = _inputs[_next_input_to_send % _inputs.size()];
 
               if (input.frame < _next_input_to_send)
               {
@@ -4604,7 +11095,7 @@ namespace GGPO
           {
               spectator_backend_logger->Info(format("End of frame ({})...", _next_input_to_send - 1), "spectator.cpp");
               DoPoll(0);
-              PollUdpProtocolEvents();
+              PollUdpProtocolEvents(_event_queue);
 
               return ErrorCode::OK;
           }
@@ -4613,16 +11104,36 @@ namespace GGPO
           void
               OnMsg
               (
-                  sockaddr_in& from,
+                  PeerId from,
                   UdpMsg* msg,
-                  int len
+                  int len,
+                  uint64_t age_ns = 0,
+                  bool answered = false
               )
           {
               if (_host.HandlesMsg(from, msg))
               {
-                  _host.OnMsg(msg, len);
+                  _host.OnMsg(msg, len, age_ns, answered);
               }
           }
+
+          // everything the transport has for us, read in place
+          void
+              ReceiveMessages()
+          {
+              TransportPacket packets[TRANSPORT_BATCH_SIZE];
+              int count;
+
+              do
+              {
+                  count = _transport->Receive(packets, TRANSPORT_BATCH_SIZE);
+
+                  for (int i = 0; i < count; i++)
+                  {
+                      OnMsg(packets[i].peer, ReceivedMsg(packets[i], &_recv_scratch), packets[i].length, packets[i].age_ns, packets[i].answered);
+                  }
+              } while (count == TRANSPORT_BATCH_SIZE);
+          }
  
       protected:
           ErrorCode
@@ -4634,6 +11145,8 @@ namespace GGPO
               {
                   OnUdpProtocolEvent(evt, fp_EventQueue);
               }
+
+              return ErrorCode::OK;
           }
  
           ErrorCode
@@ -4645,75 +11158,434 @@ namespace GGPO
           {
               Event info;
 
-              switch (evt.type)
-              {
-              case UdpProtocol::Event::Connected:
-                  info.code = EventCode::ConnectedToPeer;
-                  info.u.connected.player = 0;
-                  fp_EventQueue.Push(info);
-                  break;
+              switch (evt.type)
+              {
+              case UdpProtocol::Event::Connected:
+                  info.code = EventCode::ConnectedToPeer;
+                  info.u.connected.player = 0;
+                  fp_EventQueue.Push(info);
+                  break;
+
+              case UdpProtocol::Event::Synchronizing:
+                  info.code = EventCode::SynchronizingWithPeer;
+                  info.u.synchronizing.player = 0;
+                  info.u.synchronizing.count = evt.u.synchronizing.count;
+                  info.u.synchronizing.total = evt.u.synchronizing.total;
+                  fp_EventQueue.Push(info);
+                  break;
+
+              case UdpProtocol::Event::Synchronzied:
+                  if (_synchronizing)
+                  {
+                      info.code = EventCode::SynchronizedWithPeer;
+                      info.u.synchronized.player = 0;
+                      fp_EventQueue.Push(info);
+
+                      info.code = EventCode::Running;
+                      fp_EventQueue.Push(info);
+                      _synchronizing = false;
+                  }
+                  break;
+
+              case UdpProtocol::Event::NetworkInterrupted:
+                  info.code = EventCode::ConnectionInterrupted;
+                  info.u.connection_interrupted.player = 0;
+                  info.u.connection_interrupted.disconnect_timeout = evt.u.network_interrupted.disconnect_timeout;
+                  fp_EventQueue.Push(info);
+                  break;
+
+              case UdpProtocol::Event::NetworkResumed:
+                  info.code = EventCode::ConnectionResumed;
+                  info.u.connection_resumed.player = 0;
+                  fp_EventQueue.Push(info);
+                  break;
+
+              case UdpProtocol::Event::Disconnected:
+                  info.code = EventCode::DisconnectedFromPeer;
+                  info.u.disconnected.player = 0;
+                  fp_EventQueue.Push(info);
+                  break;
+
+              case UdpProtocol::Event::Input:
+                  GameInput& input = evt.u.input.input;
+
+                  _host.SetLocalFrameNumber(input.frame);
+                  _inputs[input.frame % _inputs.size()] = input;
+                  break;
+              }
+
+              return ErrorCode::OK;
+          }
+ 
+      protected:
+          Poll                  _poll;
+          unique_ptr<Transport> _owned_transport;
+          Transport*            _transport;
+          UdpMsg                _recv_scratch = UdpMsg(UdpMsg::Invalid);
+          UdpProtocol           _host;
+          bool                  _synchronizing;
+          int                   _input_size;
+          int                   _num_players;
+          int                   _next_input_to_send;
+          vector<GameInput>     _inputs; /* SessionLimits::spectator_frame_buffer frames, sized once */
+
+          RingBuffer<Event, GGPO_DEFAULT_RINGBUFFER_SIZE> _event_queue;
+      };
+ }
+
+//==================================================================================== Frame Delay Policy ============================================================================================//
+
+static constexpr int FRAME_DELAY_HISTORY = 8;
+static constexpr float FRAME_DELAY_HYSTERESIS = 0.5f; /* how far past the next frame down the rtt has to drop before we lower the delay */
+
+ namespace GGPO
+ {
+     /*
+      * Manual - SetFrameDelay() is all there is, same as always.
+      *
+      * Automatic - FrameDelayPolicy picks the delay for every local player from the
+      * smoothed round trip time and how deep the rollbacks have been, see below.
+      * SetFrameDelay() still works, the policy just carries on from there.
+      */
+     enum class FrameDelayMode
+     {
+         Manual,
+         Automatic
+     };
+
+     enum class FrameDelayReason
+     {
+         None,
+         Manual,
+         RoundTripIncreased,
+         RoundTripDecreased,
+         RollbackBudget
+     };
+
+     constexpr string_view
+         FrameDelayReasonToString(FrameDelayReason fp_Reason)
+     {
+         switch (fp_Reason)
+         {
+         case FrameDelayReason::None:                return "None";
+         case FrameDelayReason::Manual:              return "Manual";
+         case FrameDelayReason::RoundTripIncreased:  return "RoundTripIncreased";
+         case FrameDelayReason::RoundTripDecreased:  return "RoundTripDecreased";
+         case FrameDelayReason::RollbackBudget:      return "RollbackBudget";
+         default:                                    return "UnknownReason";
+         }
+     }
+
+     /*
+      * min_delay, max_delay - The policy never goes outside of these.
+      *
+      * rollback_budget - How many frames deep we're willing to roll back, i.e. what
+      * the CPU can resimulate in one frame.  Latency past this gets covered with
+      * input delay instead.
+      *
+      * evaluation_interval - Frames between two looks at the numbers.
+      *
+      * lower_after - Frames the delay has to sit still before we dare lower it
+      * again.  Raising is allowed every evaluation, a rollback storm hurts more
+      * than one extra frame of delay.
+      */
+     struct FrameDelayPolicyConfig
+     {
+         int   min_delay = 0;
+         int   max_delay = 8;
+         int   rollback_budget = 4;
+         int   evaluation_interval = 60;
+         int   lower_after = 300;
+     };
+
+     struct FrameDelayChange
+     {
+         int                frame;
+         PlayerHandle       player;
+         int                from;
+         int                to;
+         FrameDelayReason   reason;
+     };
+
+     /*
+      * current_delay is what the local players are running with right now,
+      * target_delay what the policy wants (they differ until the next safe point).
+      * history holds the last history_count changes, oldest first.
+      */
+     struct FrameDelayStats
+     {
+         FrameDelayMode     mode;
+         int                current_delay;
+         int                target_delay;
+         FrameDelayReason   last_reason;
+         int                changes;
+         int                history_count;
+         FrameDelayChange   history[FRAME_DELAY_HISTORY];
+     };
+
+     /*
+      * Trades one frame of input delay against rollback cost.  Every
+      * evaluation_interval frames it works out how many frames a remote input is in
+      * flight (half the smoothed rtt plus rttvar), and anything past the rollback
+      * budget becomes delay.  On top of that, if the rollbacks we actually saw
+      * averaged deeper than the budget we go up a frame regardless.
+      *
+      * One frame at a time, up right away, down only once one frame less would
+      * still cover the rtt with FRAME_DELAY_HYSTERESIS to spare, the delay has held for lower_after
+      * frames and the deepest recent rollback leaves room for one more frame.
+      * Otherwise a jittery link would have us flapping back and forth.
+      */
+     class FrameDelayPolicy
+     {
+     public:
+         void
+             SetConfig(const FrameDelayPolicyConfig& config)
+         {
+             _config = config;
+             _target = GGPO_MAX(_config.min_delay, GGPO_MIN(_target, _config.max_delay));
+         }
+
+         const FrameDelayPolicyConfig&
+             GetConfig()
+             const
+         {
+             return _config;
+         }
+
+         /*
+          * The game (or the backend on its behalf) changed the delay by hand.
+          */
+         void
+             Reset(int frame, int delay)
+         {
+             _target = delay;
+             _last_change_frame = frame;
+             _next_evaluation = frame + _config.evaluation_interval;
+         }
+
+         bool
+             IsDue(int frame)
+             const
+         {
+             return frame >= _next_evaluation;
+         }
+
+         /*
+          * Returns the new target delay and why, FrameDelayReason::None if it stays.
+          */
+         FrameDelayReason
+             Evaluate
+             (
+                 int frame,
+                 uint64_t rtt_us,
+                 uint64_t rttvar_us,
+                 int rollbacks,
+                 int rollback_frames,
+                 int deepest_rollback
+             )
+         {
+             _next_evaluation = frame + _config.evaluation_interval;
+
+             // frames of delay the rtt alone asks for, not rounded so the hysteresis means something
+             const float in_flight = (rtt_us / 2 + rttvar_us) * 60 / 1000000.0f;
+             const float needed = in_flight - _config.rollback_budget;
+
+             FrameDelayReason reason = FrameDelayReason::None;
+
+             if (_target < _config.max_delay and needed > _target)
+             {
+                 reason = FrameDelayReason::RoundTripIncreased;
+             }
+             else if (_target < _config.max_delay and rollbacks > 0 and rollback_frames > rollbacks * _config.rollback_budget)
+             {
+                 reason = FrameDelayReason::RollbackBudget;
+             }
+             else if (_target > _config.min_delay
+                 and needed < _target - 1 - FRAME_DELAY_HYSTERESIS
+                 and frame - _last_change_frame >= _config.lower_after
+                 and deepest_rollback + 1 <= _config.rollback_budget)
+             {
+                 reason = FrameDelayReason::RoundTripDecreased;
+             }
+
+             if (reason == FrameDelayReason::None)
+             {
+                 return reason;
+             }
+
+             _target += reason == FrameDelayReason::RoundTripDecreased ? -1 : 1;
+             _last_change_frame = frame;
+
+             return reason;
+         }
+
+         int
+             GetTarget()
+             const
+         {
+             return _target;
+         }
+
+     protected:
+         FrameDelayPolicyConfig   _config;
+         int                      _target = 0;
+         int                      _last_change_frame = 0;
+         int                      _next_evaluation = 0;
+     };
+ }
+
+//==================================================================================== Confirmed Frame Tracker ============================================================================================//
+
+namespace GGPO
+{
+    /*
+     * Everyone's view of everyone's confirmed frame, kept as a queue x endpoint
+     * matrix for PollNPlayers so DoPoll doesn't rewalk all N*N of it every call.
+     *
+     * Each queue caches its minimum over the running endpoints.  Between endpoint
+     * (re)starts a cell only ever moves forward (last_frame goes up, connected goes
+     * true -> false), so a cell moving can only change the minimum if it was sitting
+     * on it.  Those columns get marked and rescanned once in Refresh(), no matter how
+     * many of their cells moved.  A poll with no new packets is O(N), reading a
+     * queue is O(1).
+     */
+    class ConfirmedFrameTracker
+    {
+    public:
+        void
+            Init(int num_players)
+        {
+            GGPO_ASSERT(num_players > 0);
+
+            _num_players = num_players;
+            _cells.assign((size_t)num_players * num_players, Cell());
+            _running.assign(num_players, 0);
+            _min_frame.assign(num_players, INT_MAX);
+            _connected.assign(num_players, 1);
+            _dirty.assign(num_players, 0);
+        }
+
+        bool
+            IsEndpointRunning(int endpoint)
+            const
+        {
+            return _running[endpoint];
+        }
+
+        /*
+         * Flips an endpoint in or out of the minimum, load its row with
+         * UpdateStatus first when it starts running.
+         */
+        void
+            SetEndpointRunning(int endpoint, bool running)
+        {
+            if ((bool)_running[endpoint] == running)
+            {
+                return;
+            }
+
+            _running[endpoint] = running;
+
+            for (int queue = 0; queue < _num_players; queue++)
+            {
+                _dirty[queue] = 1;
+            }
+        }
+
+        void
+            UpdateStatus
+            (
+                int endpoint,
+                int queue,
+                bool connected,
+                int last_frame
+            )
+        {
+            GGPO_ASSERT(queue >= 0 and queue < _num_players and endpoint >= 0 and endpoint < _num_players);
+
+            Cell& cell = _cells[(size_t)queue * _num_players + endpoint];
+
+            if (_running[endpoint] and (cell.last_frame == _min_frame[queue] or last_frame < _min_frame[queue] or connected != cell.connected))
+            {
+                _dirty[queue] = 1;
+            }
+
+            cell.connected = connected;
+            cell.last_frame = last_frame;
+        }
+
+        // rescans the queues whose minimum might have moved since the last call
+        void
+            Refresh()
+        {
+            for (int queue = 0; queue < _num_players; queue++)
+            {
+                if (_dirty[queue])
+                {
+                    Rescan(queue);
+                }
+            }
+        }
+
+        /*
+         * Lowest last_frame any running endpoint has for this queue, INT_MAX if
+         * none are running.
+         */
+        int
+            QueueMinConfirmed(int queue)
+            const
+        {
+            GGPO_ASSERT(not _dirty[queue]);
+            return _min_frame[queue];
+        }
 
-              case UdpProtocol::Event::Synchronizing:
-                  info.code = EventCode::SynchronizingWithPeer;
-                  info.u.synchronizing.player = 0;
-                  info.u.synchronizing.count = evt.u.synchronizing.count;
-                  info.u.synchronizing.total = evt.u.synchronizing.total;
-                  fp_EventQueue.Push(info);
-                  break;
+        // false once any running endpoint says this queue disconnected
+        bool
+            IsQueueConnected(int queue)
+            const
+        {
+            GGPO_ASSERT(not _dirty[queue]);
+            return _connected[queue];
+        }
 
-              case UdpProtocol::Event::Synchronzied:
-                  if (_synchronizing)
-                  {
-                      info.code = EventCode::SynchronizedWithPeer;
-                      info.u.synchronized.player = 0;
-                      fp_EventQueue.Push(info);
+    protected:
+        struct Cell
+        {
+            bool    connected = true;
+            int     last_frame = -1;
+        };
 
-                      info.code = EventCode::Running;
-                      fp_EventQueue.Push(info);
-                      _synchronizing = false;
-                  }
-                  break;
+        void
+            Rescan(int queue)
+        {
+            const Cell* column = &_cells[(size_t)queue * _num_players];
 
-              case UdpProtocol::Event::NetworkInterrupted:
-                  info.code = EventCode::ConnectionInterrupted;
-                  info.u.connection_interrupted.player = 0;
-                  info.u.connection_interrupted.disconnect_timeout = evt.u.network_interrupted.disconnect_timeout;
-                  fp_EventQueue.Push(info);
-                  break;
+            int min_frame = INT_MAX;
+            bool connected = true;
 
-              case UdpProtocol::Event::NetworkResumed:
-                  info.code = EventCode::ConnectionResumed;
-                  info.u.connection_resumed.player = 0;
-                  fp_EventQueue.Push(info);
-                  break;
+            for (int endpoint = 0; endpoint < _num_players; endpoint++)
+            {
+                if (_running[endpoint])
+                {
+                    min_frame = GGPO_MIN(min_frame, column[endpoint].last_frame);
+                    connected = connected and column[endpoint].connected;
+                }
+            }
 
-              case UdpProtocol::Event::Disconnected:
-                  info.code = EventCode::DisconnectedFromPeer;
-                  info.u.disconnected.player = 0;
-                  fp_EventQueue.Push(info);
-                  break;
+            _min_frame[queue] = min_frame;
+            _connected[queue] = connected;
+            _dirty[queue] = 0;
+        }
 
-              case UdpProtocol::Event::Input:
-                  GameInput& input = evt.u.input.input;
+        int             _num_players = 0;
 
-                  _host.SetLocalFrameNumber(input.frame);
-                  _host.SendInputAck();
-                  _inputs[input.frame % SPECTATOR_FRAME_BUFFER_SIZE] = input;
-                  break;
-              }
-          }
- 
-      protected:
-          Poll                  _poll;
-          Udp                   _udp;
-          UdpProtocol           _host;
-          bool                  _synchronizing;
-          int                   _input_size;
-          int                   _num_players;
-          int                   _next_input_to_send;
-          GameInput             _inputs[SPECTATOR_FRAME_BUFFER_SIZE];
-      };
- }
+        vector<Cell>    _cells;     /* [queue * _num_players + endpoint], a queue's column is contiguous */
+        vector<uint8_t> _running;
+        vector<int>     _min_frame;
+        vector<uint8_t> _connected;
+        vector<uint8_t> _dirty;
+    };
+}
 
 //==================================================================================== P2P Backend ============================================================================================//
 
@@ -4734,11 +11606,69 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               const char* gamename,
               uint16_t localport,
               int num_players,
-              int input_size
+              int input_size,
+              const SessionLimits& limits = SessionLimits(),
+              TransportType transport = TransportType::Udp
+          ) :
+              Peer2PeerBackend(gamename, CreateTransport(transport, localport), nullptr, num_players, input_size, limits)
+          {
+          }
+
+          // over your own transport instead of one of our sockets, it has to outlive the session
+          Peer2PeerBackend
+          (
+              const char* gamename,
+              Transport* transport,
+              int num_players,
+              int input_size,
+              const SessionLimits& limits = SessionLimits()
+          ) :
+              Peer2PeerBackend(gamename, unique_ptr<Transport>(), transport, num_players, input_size, limits)
+          {
+          }
+
+      protected:
+          /*
+           * Everything SyncInput() does around the actual synchronize call, which
+           * returns the disconnect flags.  FixedSession passes its fixed size one.
+           */
+          template <typename Synchronize>
+          ErrorCode
+              SyncInputWith(int* disconnect_flags, Synchronize synchronize)
+          {
+              // Wait until we've started to return inputs.
+              if (_synchronizing)
+              {
+                  return ErrorCode::NOT_SYNCHRONIZED;
+              }
+              int flags = synchronize();
+
+              if (not disconnect_flags)
+              {
+                  p2p_backend_logger->Error("Tried to pass nullptr ref to SyncInput(), nothing was done with disconnect_flags arg", "P2P");
+                  return ErrorCode::NULLPTR_PASSED_AS_VALUE;
+              }
+
+              *disconnect_flags = flags;
+
+              return ErrorCode::OK;
+          }
+
+          Peer2PeerBackend
+          (
+              const char* gamename,
+              unique_ptr<Transport> owned_transport,
+              Transport* transport,
+              int num_players,
+              int input_size,
+              const SessionLimits& limits
           ) :
+              _owned_transport(move(owned_transport)),
+              _transport(transport ? transport : _owned_transport.get()),
               _num_players(num_players),
               _input_size(input_size),
-              _sync(_local_connect_status),
+              _limits(limits),
+              _sync(_local_connect_status.data()),
               _disconnect_timeout(DEFAULT_DISCONNECT_TIMEOUT),
               _disconnect_notify_start(DEFAULT_DISCONNECT_NOTIFY_START),
               _num_spectators(0),
@@ -4747,6 +11677,10 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               p2p_backend_logger = Logger::CreateUnique("Peer2PeerBackendLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
 
               GGPO_ASSERT(p2p_backend_logger) //check for successful creation uwu
+              GGPO_ASSERT(num_players > 0 and num_players <= GAMEINPUT_MAX_PLAYERS);
+              GGPO_ASSERT(input_size > 0 and input_size <= GAMEINPUT_MAX_BYTES);
+              GGPO_ASSERT(_limits.IsValid(num_players, input_size));
+              GGPO_ASSERT(_transport);
 
               _synchronizing = true;
               _next_recommended_sleep = 0;
@@ -4754,19 +11688,16 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               /*
                * Initialize the synchronziation layer
                */
-              Sync::Config config = { 0 };
+              Sync::Config config = { };
               config.num_players = num_players;
               config.input_size = input_size;
-              config.num_prediction_frames = MAX_PREDICTION_FRAMES;
+              config.num_prediction_frames = _limits.prediction_frames;
+              config.input_queue_length = _limits.input_queue_length;
               _sync.Init(config);
 
-              /*
-               * Initialize the UDP port
-               */
-              _udp.Init(localport, &_poll, this);
-
               _endpoints = new UdpProtocol[_num_players];
-              memset(_local_connect_status, 0, sizeof(_local_connect_status));
+              _confirmed_frames.Init(_num_players);
+              memset(_local_connect_status.data(), 0, sizeof(_local_connect_status));
 
               for (int i = 0; i < _local_connect_status.size(); i++)
               {
@@ -4778,24 +11709,42 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                */
           }
 
+      public:
           virtual ~Peer2PeerBackend()
           {
               delete[] _endpoints;
           }
  
       public:
+          // events for the game, drain them after every DoPoll()
+          bool
+              GetEvent(Event& e)
+          {
+              if (_event_queue.CurrentSize())
+              {
+                  e = _event_queue.Front();
+                  _event_queue.Pop();
+                  return true;
+              }
+
+              return false;
+          }
+
           virtual ErrorCode
               DoPoll(const int fp_Timeout)
           {
               if (not _sync.InRollback())
               {
-                  _poll.Pump(0);
+                  ReceiveMessages();
+
+                  // the game can hand us whatever's left of its frame to sleep in the socket wait
+                  _poll.Pump(fp_Timeout);
 
                   PollUdpProtocolEvents();
 
                   if (not _synchronizing)
                   {
-                      _sync.CheckSimulation(fp_Timeout);
+                      _sync.CheckSimulation();
 
                       // notify all of our endpoints of their local frame number for their
                       // next connection quality report
@@ -4822,7 +11771,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                       {
                           GGPO_ASSERT(total_min_confirmed != INT_MAX);
 
-                          if (_num_spectators > 0)
+                          if (_num_spectators > 0 or _replay_recording)
                           {
                               while (_next_spectator_frame <= total_min_confirmed)
                               {
@@ -4834,6 +11783,11 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
                                   _sync.GetConfirmedInputs(input.bits, _input_size * _num_players, _next_spectator_frame);
 
+                                  if (_replay_recording)
+                                  {
+                                      _replay_recording->AddFrame(input.bits);
+                                  }
+
                                   for (int i = 0; i < _num_spectators; i++)
                                   {
                                       _spectators[i].SendInput(input);
@@ -4846,8 +11800,17 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                           _sync.SetLastConfirmedFrame(total_min_confirmed);
                       }
 
+                      if (_frame_delay_mode == FrameDelayMode::Automatic and _frame_delay_policy.IsDue(current_frame))
+                      {
+                          UpdateFrameDelay(current_frame);
+                      }
+
+                      if (_timesync_mode == TimeSyncMode::Continuous)
+                      {
+                          UpdateFrameDilation();
+                      }
                       // send timesync notifications if now is the proper time
-                      if (current_frame > _next_recommended_sleep)
+                      else if (current_frame > _next_recommended_sleep)
                       {
                           int interval = 0;
 
@@ -4861,12 +11824,16 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                               Event info;
                               info.code = EventCode::TimeSync;
                               info.u.timesync.frames_ahead = interval;
-                              _callbacks.on_event(&info);
+                              _event_queue.Push(info);
                               _next_recommended_sleep = current_frame + RECOMMENDATION_INTERVAL;
                           }
                       }
                   }
               }
+
+              // everything this poll queued up goes out together
+              FlushEndpoints();
+
               return ErrorCode::OK;
           }
 
@@ -4893,7 +11860,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
               if (player->type == PlayerType::Remote)
               {
-                  AddRemotePlayer(player->u.remote.ip_address, player->u.remote.port, queue);
+                  return AddRemotePlayer(player->u.remote.ip_address, player->u.remote.port, queue);
               }
               return ErrorCode::OK;
           }
@@ -4928,12 +11895,20 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
               input.init(-1, (char*)values, size);
 
+              const int delay_before = _sync.GetFrameDelay(queue);
+              int first_frame;
+
               // Feed the input for the current frame into the synchronzation layer.
-              if (not _sync.AddLocalInput(queue, input))
+              if (not _sync.AddLocalInput(queue, input, &first_frame))
               {
                   return ErrorCode::PREDICTION_THRESHOLD;
               }
 
+              if (_sync.GetFrameDelay(queue) != delay_before)
+              {
+                  RecordFrameDelayChange(player, delay_before, _sync.GetFrameDelay(queue), _frame_delay_reason);
+              }
+
               if (input.frame != GameInput::NullFrame)
               {  // xxx: <- comment why this is the case
                  // Update the local connect status state to indicate that we've got a
@@ -4943,7 +11918,27 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   p2p_backend_logger->Info(format("setting local connect status for local queue {} to {}", queue, input.frame), "p2p.cpp");
                   _local_connect_status[queue].last_frame = input.frame;
 
-                  // Send the input to all the remote players.
+                  /*
+                   * Send the input to all the remote players.  A raised frame delay
+                   * padded the queue in front of it, those frames go first so the
+                   * endpoints only ever see consecutive frames.  Spectators get
+                   * confirmed frames straight out of the queues, padding included.
+                   */
+                  for (int frame = first_frame; frame < input.frame; frame++)
+                  {
+                      GameInput padding;
+                      const bool queued = _sync.GetLocalInput(queue, frame, &padding);
+                      GGPO_ASSERT(queued);
+
+                      for (int i = 0; i < _num_players; i++)
+                      {
+                          if (_endpoints[i].IsInitialized())
+                          {
+                              _endpoints[i].SendInput(padding);
+                          }
+                      }
+                  }
+
                   for (int i = 0; i < _num_players; i++)
                   {
                       if (_endpoints[i].IsInitialized())
@@ -4951,6 +11946,8 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                           _endpoints[i].SendInput(input);
                       }
                   }
+
+                  FlushEndpoints();
               }
 
               return ErrorCode::OK;
@@ -4964,24 +11961,24 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   int* disconnect_flags
               )
           {
-              int flags;
+              return SyncInputWith(disconnect_flags, [&] { return _sync.SynchronizeInputs(values, size); });
+          }
 
-              // Wait until we've started to return inputs.
-              if (_synchronizing)
+          // a datagram per endpoint with whatever it queued, see UdpProtocol::Flush()
+          void
+              FlushEndpoints()
+          {
+              for (int i = 0; i < _num_players; i++)
               {
-                  return ErrorCode::NOT_SYNCHRONIZED;
+                  _endpoints[i].Flush();
               }
-              flags = _sync.SynchronizeInputs(values, size);
 
-              if (not disconnect_flags)
+              for (int i = 0; i < _num_spectators; i++)
               {
-                  p2p_backend_logger->Error("Tried to pass nullptr ref to SyncInput(), nothing was done with disconnect_flags arg", "P2P");
-                  return ErrorCode::NULLPTR_PASSED_AS_VALUE;
+                  _spectators[i].Flush();
               }
 
-              *disconnect_flags = flags;
-
-              return ErrorCode::OK;
+              _transport->Flush();
           }
 
           virtual ErrorCode
@@ -5034,14 +12031,124 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               }
               else
               {
-                  p2p_backend_logger->Info(format("Disconnecting queue {} at frame {} by user request.", queue, _local_connect_status[queue].last_frame), "p2p.cpp");
-                  DisconnectPlayerQueue(queue, _local_connect_status[queue].last_frame);
+                  p2p_backend_logger->Info(format("Disconnecting queue {} at frame {} by user request.", queue, _local_connect_status[queue].last_frame), "p2p.cpp");
+                  DisconnectPlayerQueue(queue, _local_connect_status[queue].last_frame);
+              }
+              return ErrorCode::OK;
+          }
+
+          virtual ErrorCode
+              GetNetworkStats(NetworkStats* stats, PlayerHandle player)
+          {
+              int queue;
+              ErrorCode result;
+
+              result = PlayerHandleToQueue(player, &queue);
+
+              if (not Succeeded(result))
+              {
+                  return result;
+              }
+
+              memset(stats, 0, sizeof * stats);
+              _endpoints[queue].GetNetworkStats(stats);
+
+              return ErrorCode::OK;
+          }
+
+          virtual ErrorCode
+              SetFrameDelay(PlayerHandle player, int delay)
+          {
+              int queue;
+              ErrorCode result;
+
+              result = PlayerHandleToQueue(player, &queue);
+
+              if (not Succeeded(result))
+              {
+                  return result;
+              }
+
+              const int delay_before = _sync.GetFrameDelay(queue);
+
+              _sync.SetFrameDelay(queue, delay);
+              _frame_delay_reason = FrameDelayReason::Manual;
+              _frame_delay_policy.Reset(_sync.GetFrameCount(), delay);
+
+              if (delay != delay_before)
+              {
+                  RecordFrameDelayChange(player, delay_before, delay, FrameDelayReason::Manual);
+              }
+              return ErrorCode::OK;
+          }
+
+          /*
+           * See FrameDelayMode.  config can be nullptr to keep the current one.
+           */
+          virtual ErrorCode
+              SetFrameDelayMode(FrameDelayMode mode, const FrameDelayPolicyConfig* config = nullptr)
+          {
+              if (config)
+              {
+                  if (config->min_delay < 0 or config->max_delay < config->min_delay or config->evaluation_interval <= 0)
+                  {
+                      return ErrorCode::INVALID_REQUEST;
+                  }
+                  _frame_delay_policy.SetConfig(*config);
+              }
+
+              _frame_delay_mode = mode;
+              _frame_delay_policy.Reset(_sync.GetFrameCount(), GetLocalFrameDelay());
+
+              return ErrorCode::OK;
+          }
+
+          virtual ErrorCode
+              GetFrameDelayStats(FrameDelayStats* stats)
+          {
+              if (not stats)
+              {
+                  return ErrorCode::NULLPTR_PASSED_AS_VALUE;
+              }
+
+              stats->mode = _frame_delay_mode;
+              stats->current_delay = GetLocalFrameDelay();
+              stats->target_delay = _frame_delay_mode == FrameDelayMode::Automatic ? _frame_delay_policy.GetTarget() : stats->current_delay;
+              stats->last_reason = _frame_delay_reason;
+              stats->changes = _frame_delay_changes;
+              stats->history_count = (int)_frame_delay_history.CurrentSize();
+
+              for (int i = 0; i < stats->history_count; i++)
+              {
+                  stats->history[i] = _frame_delay_history.At(i);
+              }
+
+              return ErrorCode::OK;
+          }
+
+          /*
+           * Swaps out how the inputs of this player get predicted, see IInputPredictor.
+           * The predictor has to outlive the session, pass nullptr to go back to
+           * hold-last.
+           */
+          virtual ErrorCode
+              SetPredictor(PlayerHandle player, IInputPredictor* predictor)
+          {
+              int queue;
+              ErrorCode result;
+
+              result = PlayerHandleToQueue(player, &queue);
+
+              if (not Succeeded(result))
+              {
+                  return result;
               }
+              _sync.SetPredictor(queue, predictor);
               return ErrorCode::OK;
           }
 
           virtual ErrorCode
-              GetNetworkStats(NetworkStats* stats, PlayerHandle player)
+              GetPredictionStats(PredictionStats* stats, PlayerHandle player)
           {
               int queue;
               ErrorCode result;
@@ -5053,25 +12160,53 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   return result;
               }
 
-              memset(stats, 0, sizeof * stats);
-              _endpoints[queue].GetNetworkStats(stats);
+              *stats = _sync.GetPredictionStats(queue);
 
               return ErrorCode::OK;
           }
 
-          virtual ErrorCode
-              SetFrameDelay(PlayerHandle player, int delay)
+          /*
+           * The game that gets saved, loaded and resimulated when we roll back.
+           */
+          void
+              SetGame(IReplayGame* game)
           {
-              int queue;
-              ErrorCode result;
+              _sync.SetGame(game);
+          }
 
-              result = PlayerHandleToQueue(player, &queue);
+          /*
+           * Rollback depth, resimulation and save/load/advance timings, see
+           * RollbackTelemetry.  Safe to read from another thread while the session
+           * runs, it has to outlive the session though.
+           */
+          void
+              SetTelemetry(RollbackTelemetry* telemetry)
+          {
+              _sync.SetTelemetry(telemetry);
+          }
 
-              if (not Succeeded(result))
+          /*
+           * Records every confirmed frame into fp_Recording so the match can be
+           * replayed later by a ReplayVerifier.  Has to be set before the first
+           * frame gets confirmed, pass nullptr to stop recording.
+           */
+          ErrorCode
+              SetReplayRecording(ReplayRecording* fp_Recording)
+          {
+              if (fp_Recording and _next_spectator_frame != 0)
               {
-                  return result;
+                  return ErrorCode::INVALID_REQUEST;
               }
-              _sync.SetFrameDelay(queue, delay);
+
+              if (fp_Recording)
+              {
+                  fp_Recording->num_players = _num_players;
+                  fp_Recording->input_size = _input_size;
+                  fp_Recording->inputs.clear();
+              }
+
+              _replay_recording = fp_Recording;
+
               return ErrorCode::OK;
           }
 
@@ -5103,16 +12238,85 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               }
               return ErrorCode::OK;
           }
+
+          /*
+           * The time source for every endpoint, nullptr for the platform clock.
+           * Best set before adding players.
+           */
+          void
+              SetClock(IClock* clock)
+          {
+              _clock = clock;
+
+              for (int i = 0; i < _num_players; i++)
+              {
+                  if (_endpoints[i].IsInitialized())
+                  {
+                      _endpoints[i].SetClock(_clock);
+                  }
+              }
+
+              for (int i = 0; i < _num_spectators; i++)
+              {
+                  _spectators[i].SetClock(_clock);
+              }
+          }
+
+          /*
+           * Switching modes starts pacing over from 1.0, there's no sense in
+           * carrying a dilation across into discrete mode or the other way around.
+           */
+          virtual ErrorCode
+              SetTimeSyncMode(TimeSyncMode mode)
+          {
+              _timesync_mode = mode;
+              _frame_dilation = 1.0f;
+              return ErrorCode::OK;
+          }
+
+          /*
+           * Only meaningful in TimeSyncMode::Continuous, always 1.0 otherwise.
+           * Multiply the frame period by it, e.g. 16.67 ms * 1.015 = 16.92 ms.
+           */
+          virtual ErrorCode
+              GetFrameDilation(float* dilation)
+          {
+              if (not dilation)
+              {
+                  return ErrorCode::NULLPTR_PASSED_AS_VALUE;
+              }
+
+              *dilation = _frame_dilation;
+              return ErrorCode::OK;
+          }
  
       public:
+          // everything the transport has for us, read in place
+          void
+              ReceiveMessages()
+          {
+              TransportPacket packets[TRANSPORT_BATCH_SIZE];
+              int count;
+
+              do
+              {
+                  count = _transport->Receive(packets, TRANSPORT_BATCH_SIZE);
+
+                  for (int i = 0; i < count; i++)
+                  {
+                      OnMsg(packets[i].peer, ReceivedMsg(packets[i], &_recv_scratch), packets[i].length, packets[i].age_ns, packets[i].answered);
+                  }
+              } while (count == TRANSPORT_BATCH_SIZE);
+          }
+
           virtual void
-              OnMsg(sockaddr_in& from, UdpMsg* msg, int len)
+              OnMsg(PeerId from, UdpMsg* msg, int len, uint64_t age_ns = 0, bool answered = false)
           {
               for (int i = 0; i < _num_players; i++)
               {
                   if (_endpoints[i].HandlesMsg(from, msg))
                   {
-                      _endpoints[i].OnMsg(msg, len);
+                      _endpoints[i].OnMsg(msg, len, age_ns, answered);
                       return;
                   }
               }
@@ -5120,13 +12324,114 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               {
                   if (_spectators[i].HandlesMsg(from, msg))
                   {
-                      _spectators[i].OnMsg(msg, len);
+                      _spectators[i].OnMsg(msg, len, age_ns, answered);
                       return;
                   }
               }
           }
  
       protected:
+          /*
+           * Plays it safe and sizes the delay for the worst remote peer.  The new
+           * target only reaches the input queues at the next safe point, see
+           * Sync::RequestFrameDelay().
+           */
+          void
+              UpdateFrameDelay(int current_frame)
+          {
+              int rollbacks, rollback_frames, deepest_rollback;
+              _sync.TakeRollbackCounts(&rollbacks, &rollback_frames, &deepest_rollback);
+
+              uint64_t rtt = 0;
+              uint64_t rttvar = 0;
+              bool have_peer = false;
+
+              for (int i = 0; i < _num_players; i++)
+              {
+                  if (_endpoints[i].IsInitialized() and _endpoints[i].IsRunning())
+                  {
+                      NetworkStats stats;
+                      _endpoints[i].GetNetworkStats(&stats);
+
+                      if (not have_peer or (uint64_t)stats.network.ping_us + stats.network.jitter_us > rtt + rttvar)
+                      {
+                          rtt = (uint64_t)stats.network.ping_us;
+                          rttvar = (uint64_t)stats.network.jitter_us;
+                      }
+                      have_peer = true;
+                  }
+              }
+
+              if (not have_peer)
+              {
+                  return;
+              }
+
+              const FrameDelayReason reason = _frame_delay_policy.Evaluate(current_frame, rtt, rttvar, rollbacks, rollback_frames, deepest_rollback);
+
+              if (reason == FrameDelayReason::None)
+              {
+                  return;
+              }
+
+              p2p_backend_logger->Info(format("frame delay policy wants {} frames ({}, rtt {} us, rttvar {} us, {} rollbacks over {} frames, deepest {}).",
+                  _frame_delay_policy.GetTarget(), FrameDelayReasonToString(reason), rtt, rttvar, rollbacks, rollback_frames, deepest_rollback), "p2p.cpp");
+
+              _frame_delay_reason = reason;
+
+              for (int i = 0; i < _num_players; i++)
+              {
+                  // xxx: not initialized == local player, see the note in PollNPlayers
+                  if (not _endpoints[i].IsInitialized())
+                  {
+                      _sync.RequestFrameDelay(i, _frame_delay_policy.GetTarget());
+                  }
+              }
+          }
+
+          void
+              RecordFrameDelayChange(PlayerHandle player, int from, int to, FrameDelayReason reason)
+          {
+              p2p_backend_logger->Info(format("frame delay of player {} went from {} to {} ({}).", (int)player, from, to, FrameDelayReasonToString(reason)), "p2p.cpp");
+
+              _frame_delay_history.Push(FrameDelayChange{ _sync.GetFrameCount(), player, from, to, reason });
+              _frame_delay_changes++;
+          }
+
+          int
+              GetLocalFrameDelay()
+              const
+          {
+              for (int i = 0; i < _num_players; i++)
+              {
+                  if (not _endpoints[i].IsInitialized())
+                  {
+                      return _sync.GetFrameDelay(i);
+                  }
+              }
+              return 0;
+          }
+
+          /*
+           * Whoever needs us to slow down the most wins.  Never below 1.0, the
+           * peers that are behind wait for nobody, the ones ahead wait for them.
+           */
+          void
+              UpdateFrameDilation()
+          {
+              float dilation = 1.0f;
+
+              for (int i = 0; i < _num_players; i++)
+              {
+                  if (_endpoints[i].IsInitialized() and _endpoints[i].IsRunning())
+                  {
+                      dilation = GGPO_MAX(dilation, _endpoints[i].RecommendFrameDilation());
+                  }
+              }
+
+              _frame_dilation = dilation;
+          }
+
         ErrorCode
             PlayerHandleToQueue
             (
@@ -5183,7 +12488,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
               info.code = EventCode::DisconnectedFromPeer;
               info.u.disconnected.player = QueueToPlayerHandle(queue);
-              _callbacks.on_event(&info);
+              _event_queue.Push(info);
 
               CheckInitialSync();
           }
@@ -5249,7 +12554,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
                   Event info;
                   info.code = EventCode::Running;
-                  _callbacks.on_event(&info);
+                  _event_queue.Push(info);
                   _synchronizing = false;
               }
           }
@@ -5258,7 +12563,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               Poll2Players(int current_frame)
           {
               // discard confirmed frames as appropriate
-              int total_min_confirmed = GGPO_MAX_INT;
+              int total_min_confirmed = INT_MAX;
 
               for (int i = 0; i < _num_players; i++)
               {
@@ -5288,47 +12593,62 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               return total_min_confirmed;
           }
 
-          int 
-              PollNPlayers(int current_frame)
+          /*
+           * Folds whatever the endpoints learned since the last poll into
+           * _confirmed_frames.  O(N) plus the queues that actually changed.
+           */
+          void
+              UpdateConfirmedFrames()
           {
-              int i, queue, last_received;
-
-              // discard confirmed frames as appropriate
-              int total_min_confirmed = GGPO_MAX_INT;
+              const uint32_t all_queues = (1u << _num_players) - 1;
 
-              for (queue = 0; queue < _num_players; queue++)
+              for (int i = 0; i < _num_players; i++)
               {
-                  bool queue_connected = true;
-                  int queue_min_confirmed = GGPO_MAX_INT;
+                  const bool running = _endpoints[i].IsRunning();
+                  // the wire carries UDP_MSG_MAX_PLAYERS statuses, whatever the peer sends past our player count isn't ours to track
+                  uint32_t changes = _endpoints[i].TakePeerConnectStatusChanges() & all_queues;
+                  int last_received;
 
-                  p2p_backend_logger->Info(format("considering queue {}.", queue), "p2p.cpp");
+                  if (running != _confirmed_frames.IsEndpointRunning(i))
+                  {
+                      changes = all_queues; // (re)load the whole row
+                  }
 
-                  for (i = 0; i < _num_players; i++)
+                  for (int queue = 0; changes; queue++, changes >>= 1)
                   {
-                      // we're going to do a lot of logic here in consideration of endpoint i.
-                      // keep accumulating the minimum confirmed point for all n*n packets and
-                      // throw away the rest.
-                      if (_endpoints[i].IsRunning())
+                      if (changes & 1)
                       {
                           bool connected = _endpoints[i].GetPeerConnectStatus(queue, &last_received);
-
-                          queue_connected = queue_connected && connected;
-                          queue_min_confirmed = GGPO_MIN(last_received, queue_min_confirmed);
-                          p2p_backend_logger->Info(format("  endpoint {}: connected = {}, last_received = {}, queue_min_confirmed = {}.", i, connected, last_received, queue_min_confirmed), "p2p.cpp");
-                      }
-                      else
-                      {
-                          p2p_backend_logger->Info(format("  endpoint {}: ignoring... not running.", i), "p2p.cpp");
+                          _confirmed_frames.UpdateStatus(i, queue, connected, last_received);
                       }
                   }
+
+                  _confirmed_frames.SetEndpointRunning(i, running);
+              }
+
+              _confirmed_frames.Refresh();
+          }
+
+          int 
+              PollNPlayers(int current_frame)
+          {
+              // discard confirmed frames as appropriate
+              int total_min_confirmed = INT_MAX;
+
+              UpdateConfirmedFrames();
+
+              for (int queue = 0; queue < _num_players; queue++)
+              {
+                  // minimum confirmed point over every running endpoint's view of this queue
+                  bool queue_connected = _confirmed_frames.IsQueueConnected(queue);
+                  int queue_min_confirmed = _confirmed_frames.QueueMinConfirmed(queue);
+
                   // merge in our local status only if we're still connected!
                   if (not _local_connect_status[queue].disconnected)
                   {
                       queue_min_confirmed = GGPO_MIN(_local_connect_status[queue].last_frame, queue_min_confirmed);
                   }
 
-                  p2p_backend_logger->Info(format("  local endp: connected = {}, last_received = {}, queue_min_confirmed = {}.", not _local_connect_status[queue].disconnected, _local_connect_status[queue].last_frame, queue_min_confirmed), "p2p.cpp");
-
                   if (queue_connected)
                   {
                       total_min_confirmed = GGPO_MIN(queue_min_confirmed, total_min_confirmed);
@@ -5344,13 +12664,11 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                           DisconnectPlayerQueue(queue, queue_min_confirmed);
                       }
                   }
-
-                  p2p_backend_logger->Info(format("  total_min_confirmed = {}.", total_min_confirmed), "p2p.cpp");
               }
               return total_min_confirmed;
           }
 
-          void
+          ErrorCode
               AddRemotePlayer
               (
                   char* ip,
@@ -5358,15 +12676,25 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   int queue
               )
           {
+              if (not _endpoints[queue].Init(_transport, _poll, queue, ip, port, _local_connect_status.data(), _limits.pending_output_length))
+              {
+                  return ErrorCode::INVALID_REQUEST;
+              }
+
               /*
                * Start the state machine (xxx: no)
                */
               _synchronizing = true;
 
-              _endpoints[queue].Init(&_udp, _poll, queue, ip, port, _local_connect_status);
+              _endpoints[queue].SetAckPolicy(_limits.ack_policy);
+              _endpoints[queue].SetMaxDatagramSize(_limits.max_datagram_size);
+              _endpoints[queue].SetCoalescing(_limits.coalesce);
               _endpoints[queue].SetDisconnectTimeout(_disconnect_timeout);
               _endpoints[queue].SetDisconnectNotifyStart(_disconnect_notify_start);
+              _endpoints[queue].SetClock(_clock);
               _endpoints[queue].Synchronize();
+
+              return ErrorCode::OK;
           }
 
           ErrorCode 
@@ -5388,11 +12716,21 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   return ErrorCode::INVALID_REQUEST;
               }
 
-              int queue = _num_spectators++;
+              int queue = _num_spectators;
 
-              _spectators[queue].Init(&_udp, _poll, queue + 1000, ip, port, _local_connect_status);
+              if (not _spectators[queue].Init(_transport, _poll, queue + 1000, ip, port, _local_connect_status.data(), _limits.pending_output_length, _limits.spectator_send_burst))
+              {
+                  return ErrorCode::INVALID_REQUEST;
+              }
+
+              _num_spectators++;
+
+              _spectators[queue].SetAckPolicy(_limits.ack_policy);
+              _spectators[queue].SetMaxDatagramSize(_limits.max_datagram_size);
+              _spectators[queue].SetCoalescing(_limits.coalesce);
               _spectators[queue].SetDisconnectTimeout(_disconnect_timeout);
               _spectators[queue].SetDisconnectNotifyStart(_disconnect_notify_start);
+              _spectators[queue].SetClock(_clock);
               _spectators[queue].Synchronize();
 
               return ErrorCode::OK;
@@ -5403,7 +12741,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
           virtual Event
               OnUdpProtocolEvent(UdpProtocol::Event& evt, PlayerHandle handle)
           {
-              Event info;
+              Event info = { };
 
               switch (evt.type)
               {
@@ -5427,8 +12765,6 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   info.code = EventCode::SynchronizedWithPeer;
                   info.u.synchronized.player = handle;
                   return info;
-
-                  CheckInitialSync();
                   break;
 
               case UdpProtocol::Event::NetworkInterrupted:
@@ -5444,15 +12780,26 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                   return info;
                   break;
               }
+
+              return info; // inputs go straight to the sync layer, nothing for the game to see here
           }
 
           virtual void
               OnUdpProtocolPeerEvent(UdpProtocol::Event& evt, int queue)
           {
-              OnUdpProtocolEvent(evt, QueueToPlayerHandle(queue));
+              Event info = OnUdpProtocolEvent(evt, QueueToPlayerHandle(queue));
+
+              if ((int)info.code)
+              {
+                  _event_queue.Push(info);
+              }
 
               switch (evt.type)
               {
+              case UdpProtocol::Event::Synchronzied:
+                  CheckInitialSync(); // after SynchronizedWithPeer so Running comes out last
+                  break;
+
               case UdpProtocol::Event::Input:
                   if (not _local_connect_status[queue].disconnected)
                   {
@@ -5481,18 +12828,25 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
               )
           {
               PlayerHandle handle = QueueToSpectatorHandle(queue);
-              OnUdpProtocolEvent(evt, handle);
+              Event info = OnUdpProtocolEvent(evt, handle);
 
-              Event info;
+              if ((int)info.code)
+              {
+                  _event_queue.Push(info);
+              }
 
               switch (evt.type) //why tf is this a switch statement LMFAO
               {
+              case UdpProtocol::Event::Synchronzied:
+                  CheckInitialSync();
+                  break;
+
               case UdpProtocol::Event::Disconnected:
                   _spectators[queue].Disconnect();
 
                   info.code = EventCode::DisconnectedFromPeer;
                   info.u.disconnected.player = handle;
-                  _callbacks.on_event(&info);
+                  _event_queue.Push(info);
 
                   break;
               }
@@ -5501,13 +12855,16 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
       protected:
           Poll                  _poll;
           Sync                  _sync;
-          Udp                   _udp;
+          unique_ptr<Transport> _owned_transport;
+          Transport*            _transport;
+          UdpMsg                _recv_scratch = UdpMsg(UdpMsg::Invalid);
           UdpProtocol* _endpoints;
 
           array <UdpProtocol, MAX_SPECTATORS> _spectators = {};
 
           int                   _num_spectators;
           int                   _input_size;
+          SessionLimits         _limits;
  
           bool                  _synchronizing;
           int                   _num_players;
@@ -5516,8 +12873,104 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
           int                   _next_spectator_frame;
           int                   _disconnect_timeout;
           int                   _disconnect_notify_start;
+
+          ReplayRecording*      _replay_recording = nullptr;
+          IClock*               _clock = nullptr;
+
+          TimeSyncMode          _timesync_mode = TimeSyncMode::Discrete;
+          float                 _frame_dilation = 1.0f;
+
+          FrameDelayMode        _frame_delay_mode = FrameDelayMode::Manual;
+          FrameDelayPolicy      _frame_delay_policy;
+          FrameDelayReason      _frame_delay_reason = FrameDelayReason::None;
+          int                   _frame_delay_changes = 0;
+          RingBuffer<FrameDelayChange, FRAME_DELAY_HISTORY> _frame_delay_history;
  
           array<UdpMsg::connect_status, UDP_MSG_MAX_PLAYERS> _local_connect_status = {};
+
+          ConfirmedFrameTracker _confirmed_frames;
+          RingBuffer<Event, 32> _event_queue; /* oldest events get overwritten if nobody drains the queue */
+      };
+
+      /*
+       * Peer2PeerBackend for games that know their player count and input size at
+       * compile time (most of them).  The per frame input path (SyncInput down
+       * through Sync::SynchronizeInputs and InputQueue::GetInput) gets instantiated
+       * with constexpr sizes so the player loop unrolls and every copy is a fixed
+       * size move, and inputs are typed so a wrong size is a compile error instead
+       * of an assert.
+       *
+       * It's still a Peer2PeerBackend, anything holding a base pointer (the C API)
+       * keeps working and gets the fixed path through the SyncInput override.
+       * Rollback resimulation and the wire codec stay on the runtime sizes, the
+       * codec is shared with spectator endpoints that carry the combined input.
+       */
+      template <int Players, int InputBytes>
+      class FixedSession : public Peer2PeerBackend
+      {
+          static_assert(Players > 0 and Players <= GAMEINPUT_MAX_PLAYERS, "FixedSession: player count out of range");
+          static_assert(InputBytes > 0 and InputBytes <= GAMEINPUT_MAX_BYTES, "FixedSession: input size out of range");
+
+      public:
+          typedef array<char, InputBytes> Input;
+          typedef array<Input, Players> Inputs;
+
+          static_assert(sizeof(Inputs) == Players * InputBytes, "FixedSession: Inputs must be tightly packed");
+
+          FixedSession
+          (
+              const char* gamename,
+              uint16_t localport,
+              const SessionLimits& limits = SessionLimits(),
+              TransportType transport = TransportType::Udp
+          ) :
+              Peer2PeerBackend(gamename, localport, Players, InputBytes, limits, transport)
+          {
+          }
+
+          FixedSession
+          (
+              const char* gamename,
+              Transport* transport,
+              const SessionLimits& limits = SessionLimits()
+          ) :
+              Peer2PeerBackend(gamename, transport, Players, InputBytes, limits)
+          {
+          }
+
+          using Peer2PeerBackend::AddLocalInput;
+
+          ErrorCode
+              AddLocalInput
+              (
+                  PlayerHandle player,
+                  const Input& input
+              )
+          {
+              return Peer2PeerBackend::AddLocalInput(player, (void*)input.data(), InputBytes);
+          }
+
+          ErrorCode
+              SyncInput
+              (
+                  Inputs* values,
+                  int* disconnect_flags
+              )
+          {
+              return SyncInput(values->data(), sizeof(Inputs), disconnect_flags);
+          }
+
+          ErrorCode
+              SyncInput
+              (
+                  void* values,
+                  int size,
+                  int* disconnect_flags
+              )
+              override
+          {
+              return SyncInputWith(disconnect_flags, [&] { return _sync.template SynchronizeInputs<Players, InputBytes>(values, size); });
+          }
       };
  }
 
@@ -5528,7 +12981,8 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
      enum class SessionType
      {
          P2P,
-         Spectator
+         Spectator,
+         SyncTest
      };
 
      struct Session
@@ -5556,11 +13010,11 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
          }
 
          ErrorCode 
-             StartSession(SessionMode mode) 
+             StartSession(SessionType fp_Type) 
          {
-             pm_Mode = mode;
-             pm_Sync.Init(config);
-             if (pm_Mode == SessionMode::SyncTest) {
+             pm_Type = fp_Type;
+             pm_Sync.Init(pm_SyncConfig);
+             if (pm_Type == SessionType::SyncTest) {
                  pm_CheckDistance = 60; // e.g. every 60 frames, run verification
              }
              return ErrorCode::OK;
@@ -5626,7 +13080,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                  pm_Sync.GetLastSavedFrame().checksum,
                  pm_Sync.GetLastSavedFrame().buf
              };
-             pm_SavedFrames.SafePush(info);
+             pm_SavedFrames.Push(info);
 
              if (frame - pm_LastVerified >= pm_CheckDistance) {
                  pm_Sync.LoadFrame(pm_LastVerified);
@@ -5639,7 +13093,7 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
                      // Re-run frame and compare checksums
                      int newChecksum = pm_Sync.GetLastSavedFrame().checksum;
                      if (info.checksum != newChecksum) {
-                         logger->Error("Desync detected!");
+                         logger->Error(format("Desync detected at frame {}!", info.frame), "Session");
                          return ErrorCode::FATAL_DESYNC;
                      }
                  }
@@ -5718,9 +13172,24 @@ static constexpr int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
 
      protected:
+         struct SavedInfo
+         {
+             int      frame;
+             int      checksum;
+             string   buf;
+         };
+
          bool pm_IsHost = false;
          bool pm_IsInRollback = false;
 
+         SessionType pm_Type = SessionType::P2P;
+         Sync::Config pm_SyncConfig = {};
+
+         int pm_CheckDistance = 0;
+         int pm_LastVerified = 0;
+         bool pm_RollingBack = false;
+         RingBuffer<SavedInfo, 64> pm_SavedFrames;
+
          unique_ptr<Logger> logger = nullptr;
          RingBuffer<Event, 64> pm_EventQueue;
 
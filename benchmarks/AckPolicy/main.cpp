@@ -0,0 +1,304 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <algorithm>
+#include <cstdlib>
+
+#include "../ProtocolLink.h"
+
+/*
+ * What the ack policies cost in packets and what they do to the sender's
+ * pending output (GetNetworkStats send_queue_len, the inputs it's still holding
+ * for a resend).
+ *
+ * UdpProtocol endpoints over MemoryTransport in 1 ms steps, each case under
+ * AckPolicy::Delayed, AckPolicy::Immediate and an InputAck for every input that
+ * comes out, which is how SpectatorBackend used to ack:
+ *
+ *   - a spectator following a 60 Hz host for 60 s, 30 ms one way
+ *   - a spectator catching up on a 10,000 frame backlog, 15 +- 3 ms
+ *   - two players at 60 Hz for 60 s, 50 ms one way, 8 frame prediction window
+ *
+ * each at 0 and 5% loss.  Pending is sampled every time the sender sends.
+ *
+ *     AckPolicy_Bench [seconds]
+ */
+
+constexpr int INPUT_BYTES = 16;
+constexpr int PREDICTION_WINDOW = 8;
+constexpr uint64_t FRAME_US = 16667;
+
+enum class Acks
+{
+    PerInput,
+    Delayed,
+    Immediate,
+};
+
+static const char*
+    Name(Acks fp_Acks)
+{
+    switch (fp_Acks)
+    {
+        case Acks::PerInput:    return "ack per input";
+        case Acks::Delayed:     return "delayed";
+        case Acks::Immediate:   return "immediate";
+    }
+
+    return "?";
+}
+
+static void
+    Apply(Acks fp_Acks, GGPO::Bench::ProtocolNode& fp_Node)
+{
+    fp_Node.ack_every_input = fp_Acks == Acks::PerInput;
+
+    for (auto& endpoint : fp_Node.endpoints)
+    {
+        endpoint->protocol.SetAckPolicy(fp_Acks == Acks::Immediate ? GGPO::AckPolicy::Immediate : GGPO::AckPolicy::Delayed);
+    }
+}
+
+static int
+    PendingOutput(GGPO::Bench::ProtocolEndpoint* fp_Endpoint)
+{
+    GGPO::NetworkStats stats = { };
+
+    fp_Endpoint->protocol.GetNetworkStats(&stats);
+    return stats.network.send_queue_len;
+}
+
+static void
+    ReportPending(const std::string& fp_Name, std::vector<int>& fp_Samples)
+{
+    if (fp_Samples.empty())
+    {
+        return;
+    }
+
+    std::sort(fp_Samples.begin(), fp_Samples.end());
+
+    auto at = [&](double fp_Quantile) { return (double)fp_Samples[(size_t)(fp_Quantile * (fp_Samples.size() - 1))]; };
+
+    GGPO::Bench::Report(fp_Name + ", pending p50", at(0.5), "inputs");
+    GGPO::Bench::Report(fp_Name + ", pending p99", at(0.99), "inputs");
+    GGPO::Bench::Report(fp_Name + ", pending max", (double)fp_Samples.back(), "inputs");
+}
+
+static void
+    Following(Acks fp_Acks, int fp_Loss, int fp_Seconds)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 11);
+    GGPO::Bench::ProtocolNode host(network, "10.0.0.1", INPUT_BYTES);
+    GGPO::Bench::ProtocolNode spectator(network, "10.0.0.2", INPUT_BYTES);
+
+    network.SetLink({ 30000, 2000, fp_Loss });
+
+    GGPO::Bench::ProtocolEndpoint* to_spectator = host.Connect(&clock, 1000, "10.0.0.2", SPECTATOR_SEND_BURST);
+
+    spectator.Connect(&clock, 0, "10.0.0.1");
+    Apply(fp_Acks, host);
+    Apply(fp_Acks, spectator);
+
+    while (not host.Running() or not spectator.Running())
+    {
+        clock.Advance(1000000);
+        host.Pump();
+        spectator.Pump();
+    }
+
+    const long long datagrams = spectator.transport.datagrams;
+    uint64_t next_us = clock.ns / 1000;
+    std::vector<int> pending;
+    int frame = 0;
+
+    for (int ms = 0; ms < fp_Seconds * 1000; ms++)
+    {
+        clock.Advance(1000000);
+
+        if (clock.ns / 1000 >= next_us)
+        {
+            GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame++, INPUT_BYTES);
+
+            to_spectator->protocol.SendInput(input);
+            host.Flush();
+            pending.push_back(PendingOutput(to_spectator));
+            next_us += FRAME_US;
+        }
+
+        spectator.Pump();
+        host.Pump();
+    }
+
+    const std::string name = std::format("{}, {}% loss, following", Name(fp_Acks), fp_Loss);
+
+    GGPO::Bench::Report(name + ", out of the spectator", (double)(spectator.transport.datagrams - datagrams) / fp_Seconds, "datagrams/s");
+    ReportPending(name, pending);
+}
+
+static void
+    CatchUp(Acks fp_Acks, int fp_Loss, int fp_Backlog)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 3);
+    GGPO::Bench::ProtocolNode host(network, "10.0.0.1", INPUT_BYTES);
+    GGPO::Bench::ProtocolNode spectator(network, "10.0.0.2", INPUT_BYTES);
+
+    network.SetLink({ 15000, 3000, fp_Loss });
+
+    GGPO::Bench::ProtocolEndpoint* to_spectator = host.Connect(&clock, 1000, "10.0.0.2", SPECTATOR_SEND_BURST);
+    GGPO::Bench::ProtocolEndpoint* from_host = spectator.Connect(&clock, 0, "10.0.0.1");
+
+    Apply(fp_Acks, host);
+    Apply(fp_Acks, spectator);
+
+    while (not host.Running() or not spectator.Running())
+    {
+        clock.Advance(1000000);
+        host.Pump();
+        spectator.Pump();
+    }
+
+    int frame = 0;
+
+    host.transport.blocked = true;
+
+    for (; frame < fp_Backlog; frame++)
+    {
+        GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame, INPUT_BYTES);
+
+        to_spectator->protocol.SendInput(input);
+        host.Flush();
+    }
+
+    host.transport.blocked = false;
+
+    const long long datagrams = spectator.transport.datagrams;
+    uint64_t next_us = clock.ns / 1000;
+    int ms = 0;
+
+    while (from_host->received < frame - 1 and ms < 100000)
+    {
+        clock.Advance(1000000);
+        ms++;
+
+        if (clock.ns / 1000 >= next_us)
+        {
+            GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame++, INPUT_BYTES);
+
+            to_spectator->protocol.SendInput(input);
+            host.Flush();
+            next_us += FRAME_US;
+        }
+
+        spectator.Pump();
+        host.Pump();
+    }
+
+    if (from_host->received < frame - 1)
+    {
+        GGPO::PrintError(std::format("[!] {}, loss {}%: never caught up (at {} of {})", Name(fp_Acks), fp_Loss, from_host->received, frame - 1));
+        exit(EXIT_FAILURE);
+    }
+
+    const std::string name = std::format("{}, {}% loss, {} frame catch-up", Name(fp_Acks), fp_Loss, fp_Backlog);
+
+    GGPO::Bench::Report(name + ", took", ms / 1e3, "s");
+    GGPO::Bench::Report(name + ", out of the spectator", (double)(spectator.transport.datagrams - datagrams), "datagrams");
+}
+
+static void
+    Players(Acks fp_Acks, int fp_Loss, int fp_Seconds)
+{
+    struct Player
+    {
+        GGPO::Bench::ProtocolNode*      node;
+        GGPO::Bench::ProtocolEndpoint*  remote;
+        int                             frame;
+        uint64_t                        next_us;
+    };
+
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 5);
+    GGPO::Bench::ProtocolNode a(network, "10.0.0.1", INPUT_BYTES);
+    GGPO::Bench::ProtocolNode b(network, "10.0.0.2", INPUT_BYTES);
+
+    network.SetLink({ 50000, 2000, fp_Loss });
+
+    Player players[2] =
+    {
+        { &a, a.Connect(&clock, 1, "10.0.0.2"), 0, 0 },
+        { &b, b.Connect(&clock, 0, "10.0.0.1"), 0, 0 },
+    };
+
+    Apply(fp_Acks, a);
+    Apply(fp_Acks, b);
+
+    while (not a.Running() or not b.Running())
+    {
+        clock.Advance(1000000);
+        a.Pump();
+        b.Pump();
+    }
+
+    const long long datagrams = a.transport.datagrams + b.transport.datagrams;
+    std::vector<int> pending;
+
+    players[0].next_us = clock.ns / 1000;
+    players[1].next_us = clock.ns / 1000 + 5000;
+
+    for (int ms = 0; ms < fp_Seconds * 1000; ms++)
+    {
+        clock.Advance(1000000);
+
+        for (Player& player : players)
+        {
+            if (clock.ns / 1000 < player.next_us or player.remote->received < player.frame - PREDICTION_WINDOW)
+            {
+                continue;
+            }
+
+            GGPO::GameInput input = GGPO::Bench::ProtocolInput(player.frame++, INPUT_BYTES);
+
+            player.remote->protocol.SendInput(input);
+            player.node->Flush();
+            pending.push_back(PendingOutput(player.remote));
+            player.next_us += FRAME_US;
+        }
+
+        a.Pump();
+        b.Pump();
+    }
+
+    const std::string name = std::format("{}, {}% loss, two players", Name(fp_Acks), fp_Loss);
+
+    GGPO::Bench::Report(name + ", frames", (players[0].frame + players[1].frame) / 2.0, "frames/player");
+    GGPO::Bench::Report(name + ", sent", (double)(a.transport.datagrams + b.transport.datagrams - datagrams) / (2.0 * fp_Seconds), "datagrams/s/player");
+    ReportPending(name, pending);
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 60;
+
+    for (Acks acks : { Acks::PerInput, Acks::Delayed, Acks::Immediate })
+    {
+        for (int loss : { 0, 5 })
+        {
+            Following(acks, loss, seconds);
+            CatchUp(acks, loss, 10000);
+            Players(acks, loss, seconds);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#pragma once
+
+// every info line is a formatted write to a log file, that's all a benchmark would measure
+#define GGPO_DEFAULT_LOGGER_FLAGS Logger::Flags::WARNING_LOG | Logger::Flags::ERROR_LOG | Logger::Flags::FATAL_LOG | Logger::Flags::FLUSH_ERROR | Logger::Flags::FLUSH_FATAL
+
+#include "../tests/Common/SessionHarness.h"
+
+#include <chrono>
+
+/*
+ * Just enough for the benchmarks: a wall clock stopwatch, a way to keep the
+ * optimizer from deleting the thing we're timing, and one line per result so
+ * runs are easy to diff.  Build with a release config, debug numbers are noise.
+ */
+namespace GGPO::Bench
+{
+    class Stopwatch
+    {
+    public:
+        Stopwatch() :
+            _start(chrono::steady_clock::now())
+        {
+        }
+
+        double
+            Seconds()
+            const
+        {
+            return chrono::duration<double>(chrono::steady_clock::now() - _start).count();
+        }
+
+    private:
+        chrono::steady_clock::time_point _start;
+    };
+
+    template <typename T>
+    inline void
+        KeepAlive(const T& fp_Value)
+    {
+    #if defined(_MSC_VER)
+        static volatile const T* s_Sink;
+        s_Sink = &fp_Value;
+    #else
+        asm volatile("" : : "g"(&fp_Value) : "memory");
+    #endif
+    }
+
+    inline void
+        Report(const string& fp_Name, double fp_Value, const string& fp_Unit)
+    {
+        Print(format("{:<48} {:>14.2f} {}", fp_Name, fp_Value, fp_Unit));
+    }
+}
@@ -0,0 +1,203 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+
+#include "../ProtocolLink.h"
+
+/*
+ * Datagrams per second and udp/ip overhead with each tick's messages to a peer
+ * going out as one datagram, next to every message going out on its own the
+ * moment it's queued (SessionLimits::coalesce off).
+ *
+ * UdpProtocol endpoints over MemoryTransport, 30 ms one way, 60 s, called the
+ * way the backends call them once a 60 Hz frame: DoPoll, AddLocalInput (send and
+ * flush), then IncrementFrame's DoPoll.  4 byte inputs, 8 frame prediction
+ * window.  With a spectator, the host sends it every frame both players have
+ * confirmed, and the spectator polls at its own phase.
+ *
+ * Overhead is the 28 bytes of udp/ip header per datagram over the payload bytes.
+ *
+ *     Coalescing_Bench [seconds]
+ */
+
+constexpr int INPUT_BYTES = 4;
+constexpr int PREDICTION_WINDOW = 8;
+constexpr uint64_t FRAME_US = 16667;
+
+struct Machine
+{
+    Machine(GGPO::MemoryNetwork& fp_Network, const char* fp_Name, const char* fp_Ip) :
+        name(fp_Name),
+        node(fp_Network, fp_Ip, INPUT_BYTES)
+    {
+    }
+
+    const char*                         name;
+    GGPO::Bench::ProtocolNode           node;
+    GGPO::Bench::ProtocolEndpoint*      peer = nullptr;
+    int                                 frame = 0;
+    uint64_t                            next_us = 0;
+    long long                           datagrams = 0;
+    long long                           bytes = 0;
+};
+
+static void
+    Run(bool fp_Spectator, int fp_Loss, bool fp_Coalesce, int fp_Seconds)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 9);
+
+    network.SetLink({ 30000, 2000, fp_Loss });
+
+    Machine a(network, "player 1", "10.0.0.1");
+    Machine b(network, "player 2", "10.0.0.2");
+    Machine s(network, "spectator", "10.0.0.3");
+    std::vector<Machine*> machines = { &a, &b };
+    GGPO::Bench::ProtocolEndpoint* to_spectator = nullptr;
+
+    a.peer = a.node.Connect(&clock, 1, "10.0.0.2", 1);
+    b.peer = b.node.Connect(&clock, 0, "10.0.0.1", 1);
+
+    if (fp_Spectator)
+    {
+        to_spectator = a.node.Connect(&clock, 1000, "10.0.0.3", SPECTATOR_SEND_BURST);
+        s.peer = s.node.Connect(&clock, 0, "10.0.0.1", 1);
+        machines.push_back(&s);
+    }
+
+    for (Machine* machine : machines)
+    {
+        for (auto& endpoint : machine->node.endpoints)
+        {
+            endpoint->protocol.SetCoalescing(fp_Coalesce);
+        }
+    }
+
+    auto running = [&]()
+    {
+        for (Machine* machine : machines)
+        {
+            if (not machine->node.Running())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    while (not running())
+    {
+        clock.Advance(1000000);
+
+        for (Machine* machine : machines)
+        {
+            machine->node.Pump();
+        }
+    }
+
+    for (Machine* machine : machines)
+    {
+        machine->datagrams = machine->node.transport.datagrams;
+        machine->bytes = machine->node.transport.bytes;
+    }
+
+    const uint64_t start_us = clock.ns / 1000;
+    int spectator_frame = 0;
+
+    a.next_us = start_us;
+    b.next_us = start_us + 7000;
+    s.next_us = start_us + 3000;
+
+    for (int ms = 0; ms < fp_Seconds * 1000; ms++)
+    {
+        clock.Advance(1000000);
+
+        for (Machine* player : { &a, &b })
+        {
+            if (clock.ns / 1000 < player->next_us)
+            {
+                continue;
+            }
+
+            player->node.Pump();
+
+            if (player->peer->received >= player->frame - PREDICTION_WINDOW)
+            {
+                GGPO::GameInput input = GGPO::Bench::ProtocolInput(player->frame++, INPUT_BYTES);
+
+                player->peer->protocol.SendInput(input);
+                player->node.Flush();
+            }
+
+            // the spectator gets what both players have, SpectatorBackend's confirmed frames
+            while (player == &a and to_spectator and spectator_frame <= GGPO_MIN(a.frame - 1, a.peer->received))
+            {
+                GGPO::GameInput input = GGPO::Bench::ProtocolInput(spectator_frame++, INPUT_BYTES);
+
+                to_spectator->protocol.SendInput(input);
+            }
+
+            player->node.Pump();
+            player->next_us += FRAME_US;
+        }
+
+        if (fp_Spectator and clock.ns / 1000 >= s.next_us)
+        {
+            s.node.Pump();
+            s.next_us += FRAME_US;
+        }
+    }
+
+    if (fp_Spectator and s.peer->received < spectator_frame - 3 * PREDICTION_WINDOW)
+    {
+        GGPO::PrintError(std::format("[!] loss {}%: the spectator fell behind ({} of {})", fp_Loss, s.peer->received, spectator_frame - 1));
+        exit(EXIT_FAILURE);
+    }
+
+    const std::string name = std::format("{}, {}% loss, {}", fp_Spectator ? "two players + spectator" : "two players", fp_Loss, fp_Coalesce ? "coalesced" : "one per msg");
+    long long datagrams = 0;
+    long long bytes = 0;
+
+    for (Machine* machine : machines)
+    {
+        const long long sent = machine->node.transport.datagrams - machine->datagrams;
+        const long long payload = machine->node.transport.bytes - machine->bytes;
+
+        datagrams += sent;
+        bytes += payload;
+
+        GGPO::Bench::Report(std::format("{}, {} sent", name, machine->name), (double)sent / fp_Seconds, "datagrams/s");
+    }
+
+    GGPO::Bench::Report(name + ", total", (double)datagrams / fp_Seconds, "datagrams/s");
+    GGPO::Bench::Report(name + ", on the wire", (double)(bytes + UDP_HEADER_SIZE * datagrams) / fp_Seconds, "bytes/s");
+    GGPO::Bench::Report(name + ", udp/ip overhead", 100.0 * UDP_HEADER_SIZE * datagrams / GGPO_MAX(bytes, 1LL), "% of payload");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 60;
+
+    for (bool spectator : { false, true })
+    {
+        for (int loss : { 0, 5 })
+        {
+            for (bool coalesce : { false, true })
+            {
+                Run(spectator, loss, coalesce, seconds);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
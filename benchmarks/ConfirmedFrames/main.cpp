@@ -0,0 +1,327 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <climits>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../Benchmark.h"
+
+/*
+ * ConfirmedFrameTracker against the nested queue x endpoint walk PollNPlayers
+ * used to do every DoPoll, at 2, 3, 4 and 8 players (8 is the most a session
+ * takes, GAMEINPUT_MAX_PLAYERS).
+ *
+ * The walk is timed the way it shipped, with the Info line per queue and per
+ * endpoint it formatted on every pass, and again with those taken out so the
+ * walk itself shows too.  The lines go through a real Logger with the flags
+ * every benchmark runs with (warnings and up), so they're formatted and then
+ * filtered out, nothing is written.  With info logging on it's a file write
+ * per line on top of that.
+ *
+ * The endpoints are stand-ins for UdpProtocol: a last frame and connected flag
+ * per queue plus the changed-queue bits OnInput sets.  Each frame is one busy
+ * poll, where a packet from every remote endpoint moves every queue, then
+ * IDLE_POLLS polls with nothing new, about what a 60 Hz game polling between
+ * frames sees.
+ *
+ * Before timing, a randomized run (frames moving forward, disconnects, endpoints
+ * starting and stopping) checks the tracker gives the same answer as the walk.
+ *
+ *     ConfirmedFrames_Bench [frames]
+ */
+
+constexpr int IDLE_POLLS = 7;
+
+struct Endpoint
+{
+    Endpoint(int fp_Queues) :
+        last_frame(fp_Queues, -1),
+        disconnected(fp_Queues, false)
+    {
+    }
+
+    bool                running = false;
+    std::vector<int>    last_frame;
+    std::vector<bool>   disconnected;
+    uint32_t            changes = 0;
+};
+
+// fp_Logger is what PollNPlayers logged to, nullptr for the walk without its log lines
+static int
+    NestedWalk(const std::vector<Endpoint>& fp_Endpoints, const std::vector<int>& fp_Local, GGPO::Logger* fp_Logger = nullptr)
+{
+    const int players = (int)fp_Endpoints.size();
+    int total_min_confirmed = INT_MAX;
+
+    for (int queue = 0; queue < players; queue++)
+    {
+        bool queue_connected = true;
+        int queue_min_confirmed = INT_MAX;
+
+        if (fp_Logger)
+        {
+            fp_Logger->Info(std::format("considering queue {}.", queue), "p2p.cpp");
+        }
+
+        for (int i = 0; i < players; i++)
+        {
+            const Endpoint& endpoint = fp_Endpoints[i];
+
+            if (endpoint.running)
+            {
+                const bool connected = not endpoint.disconnected[queue];
+
+                queue_connected = queue_connected and connected;
+                queue_min_confirmed = GGPO_MIN(endpoint.last_frame[queue], queue_min_confirmed);
+
+                if (fp_Logger)
+                {
+                    fp_Logger->Info(std::format("  endpoint {}: connected = {}, last_received = {}, queue_min_confirmed = {}.", i, connected, endpoint.last_frame[queue], queue_min_confirmed), "p2p.cpp");
+                }
+            }
+            else if (fp_Logger)
+            {
+                fp_Logger->Info(std::format("  endpoint {}: ignoring... not running.", i), "p2p.cpp");
+            }
+        }
+
+        queue_min_confirmed = GGPO_MIN(fp_Local[queue], queue_min_confirmed);
+
+        if (fp_Logger)
+        {
+            fp_Logger->Info(std::format("  local endp: connected = {}, last_received = {}, queue_min_confirmed = {}.", true, fp_Local[queue], queue_min_confirmed), "p2p.cpp");
+        }
+
+        if (queue_connected)
+        {
+            total_min_confirmed = GGPO_MIN(queue_min_confirmed, total_min_confirmed);
+        }
+    }
+
+    return total_min_confirmed;
+}
+
+// what Peer2PeerBackend::UpdateConfirmedFrames and PollNPlayers do with it
+static int
+    Tracked(GGPO::ConfirmedFrameTracker& fp_Tracker, std::vector<Endpoint>& fp_Endpoints, const std::vector<int>& fp_Local)
+{
+    const int players = (int)fp_Endpoints.size();
+    const uint32_t all = players == 32 ? ~0u : (1u << players) - 1;
+
+    for (int i = 0; i < players; i++)
+    {
+        Endpoint& endpoint = fp_Endpoints[i];
+        uint32_t changes = endpoint.changes & all;
+
+        endpoint.changes = 0;
+
+        if (endpoint.running != fp_Tracker.IsEndpointRunning(i))
+        {
+            changes = all;
+        }
+
+        for (int queue = 0; changes; queue++, changes >>= 1)
+        {
+            if (changes & 1)
+            {
+                fp_Tracker.UpdateStatus(i, queue, not endpoint.disconnected[queue], endpoint.last_frame[queue]);
+            }
+        }
+
+        fp_Tracker.SetEndpointRunning(i, endpoint.running);
+    }
+
+    fp_Tracker.Refresh();
+
+    int total_min_confirmed = INT_MAX;
+
+    for (int queue = 0; queue < players; queue++)
+    {
+        const int queue_min_confirmed = GGPO_MIN(fp_Local[queue], fp_Tracker.QueueMinConfirmed(queue));
+
+        if (fp_Tracker.IsQueueConnected(queue))
+        {
+            total_min_confirmed = GGPO_MIN(queue_min_confirmed, total_min_confirmed);
+        }
+    }
+
+    return total_min_confirmed;
+}
+
+static int
+    Mismatches(int fp_Players, int fp_Trials)
+{
+    std::mt19937 random(5);
+    int mismatches = 0;
+
+    for (int trial = 0; trial < fp_Trials; trial++)
+    {
+        std::vector<Endpoint> endpoints(fp_Players, Endpoint(fp_Players));
+        std::vector<int> local(fp_Players, 0);
+        GGPO::ConfirmedFrameTracker tracker;
+
+        tracker.Init(fp_Players);
+
+        for (int step = 0; step < 300; step++)
+        {
+            Endpoint& endpoint = endpoints[random() % fp_Players];
+            const int queue = random() % fp_Players;
+            const int kind = random() % 10;
+
+            if (kind == 0)
+            {
+                endpoint.running = not endpoint.running;
+            }
+            else if (kind == 1 and not endpoint.disconnected[queue])
+            {
+                endpoint.disconnected[queue] = true;
+                endpoint.changes |= 1u << queue;
+            }
+            else if (const int advance = random() % 3)
+            {
+                endpoint.last_frame[queue] += advance;
+                endpoint.changes |= 1u << queue;
+            }
+
+            if (random() % 3 == 0)
+            {
+                for (int& frame : local)
+                {
+                    frame += random() % 2;
+                }
+            }
+
+            if (random() % 2 == 0 and NestedWalk(endpoints, local) != Tracked(tracker, endpoints, local))
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+static void
+    Polls(GGPO::Logger* fp_Logger, int fp_Players, int fp_Frames)
+{
+    std::vector<Endpoint> endpoints(fp_Players, Endpoint(fp_Players));
+    std::vector<int> local(fp_Players, 0);
+    GGPO::ConfirmedFrameTracker tracker;
+    long long logged_sum = 0;
+    long long nested_sum = 0;
+    long long tracked_sum = 0;
+
+    // endpoint 0 is us, every other one just got a packet that moved every queue
+    auto busy = [&](int fp_Frame)
+    {
+        for (int i = 1; i < fp_Players; i++)
+        {
+            for (int queue = 0; queue < fp_Players; queue++)
+            {
+                endpoints[i].last_frame[queue] = fp_Frame - i % 3;
+            }
+
+            endpoints[i].changes = ~0u;
+        }
+
+        for (int& frame : local)
+        {
+            frame = fp_Frame;
+        }
+    };
+
+    for (int i = 1; i < fp_Players; i++)
+    {
+        endpoints[i].running = true;
+    }
+
+    tracker.Init(fp_Players);
+
+    GGPO::Bench::Stopwatch logged;
+
+    for (int f = 0; f < fp_Frames; f++)
+    {
+        busy(f);
+
+        for (int poll = 0; poll <= IDLE_POLLS; poll++)
+        {
+            logged_sum += NestedWalk(endpoints, local, fp_Logger);
+            GGPO::Bench::KeepAlive(endpoints);
+        }
+    }
+
+    const double logged_seconds = logged.Seconds();
+    GGPO::Bench::Stopwatch nested;
+
+    for (int f = 0; f < fp_Frames; f++)
+    {
+        busy(f);
+
+        for (int poll = 0; poll <= IDLE_POLLS; poll++)
+        {
+            nested_sum += NestedWalk(endpoints, local);
+            GGPO::Bench::KeepAlive(endpoints);
+        }
+    }
+
+    const double nested_seconds = nested.Seconds();
+    GGPO::Bench::Stopwatch tracked;
+
+    for (int f = 0; f < fp_Frames; f++)
+    {
+        busy(f);
+
+        for (int poll = 0; poll <= IDLE_POLLS; poll++)
+        {
+            tracked_sum += Tracked(tracker, endpoints, local);
+            GGPO::Bench::KeepAlive(endpoints);
+        }
+    }
+
+    const double tracked_seconds = tracked.Seconds();
+
+    if (nested_sum != tracked_sum or logged_sum != tracked_sum)
+    {
+        GGPO::PrintError(std::format("[!] {} players: tracker and nested walk disagree", fp_Players));
+        exit(EXIT_FAILURE);
+    }
+
+    GGPO::Bench::Report(std::format("{} players, nested walk + its log lines (1 busy + {} idle polls)", fp_Players, IDLE_POLLS), logged_seconds / fp_Frames * 1e9, "ns/frame");
+    GGPO::Bench::Report(std::format("{} players, nested walk without them", fp_Players), nested_seconds / fp_Frames * 1e9, "ns/frame");
+    GGPO::Bench::Report(std::format("{} players, ConfirmedFrameTracker", fp_Players), tracked_seconds / fp_Frames * 1e9, "ns/frame");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int frames = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 20000;
+    const int players[] = { 2, 3, 4, GAMEINPUT_MAX_PLAYERS };
+    using GGPO::Logger;   // GGPO_DEFAULT_LOGGER_FLAGS names it unqualified
+
+    std::unique_ptr<Logger> logger = Logger::CreateUnique("ConfirmedFramesBenchLogger", GGPO_DEFAULT_LOGGER_FLAGS, GGPO_DEFAULT_LOG_OUTPUT_DIRECTORY);
+
+    for (int n : players)
+    {
+        if (const int mismatches = Mismatches(n, 200))
+        {
+            GGPO::PrintError(std::format("[!] {} players: tracker disagreed with the nested walk {} times", n, mismatches));
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (int n : players)
+    {
+        Polls(logger.get(), n, frames);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+#include <type_traits>
+
+#include "../Benchmark.h"
+
+/*
+ * FixedSession<2, 4> against the runtime sized path, 2 players x 4 bytes.
+ *
+ *  - Sync on its own: SynchronizeInputs on confirmed frames, runtime sizes
+ *    versus SynchronizeInputs<2, 4>.  Eight calls per frame so the clock read
+ *    around them doesn't swamp a call that's only a couple of copies.
+ *  - Whole sessions: two peers over a lossless MemoryTransport, once as plain
+ *    Peer2PeerBackends and once as FixedSession<2, 4>.  Reports SyncInput on
+ *    its own and the full frame (poll, add input, sync, increment).
+ *
+ *     FixedSession_Bench [frames]
+ */
+
+constexpr int PLAYERS = 2;
+constexpr int INPUT_BYTES = 4;
+constexpr int CALLS_PER_FRAME = 8;
+
+template <int Players, int InputBytes>
+static double
+    SynchronizeInputs(int fp_Frames)
+{
+    UdpMsg::connect_status status[UDP_MSG_MAX_PLAYERS];
+
+    for (auto& s : status)
+    {
+        s.disconnected = 0;
+        s.last_frame = -1;
+    }
+
+    GGPO::Sync sync(status);
+    GGPO::Sync::Config config = { MAX_PREDICTION_FRAMES, PLAYERS, INPUT_BYTES, 0 };
+    char values[PLAYERS * INPUT_BYTES];
+    double seconds = 0.0;
+
+    sync.Init(config);
+
+    for (int f = 0; f < fp_Frames; f++)
+    {
+        for (int p = 0; p < PLAYERS; p++)
+        {
+            GGPO::GameInput input;
+            char bits[INPUT_BYTES];
+
+            memset(bits, f + p, INPUT_BYTES);
+            input.init(p == 0 ? -1 : f, bits, INPUT_BYTES);
+
+            if (p == 0)
+            {
+                sync.AddLocalInput(p, input);
+            }
+            else
+            {
+                sync.AddRemoteInput(p, input);
+            }
+        }
+
+        GGPO::Bench::Stopwatch watch;
+
+        for (int k = 0; k < CALLS_PER_FRAME; k++)
+        {
+            sync.template SynchronizeInputs<Players, InputBytes>(values, sizeof values);
+            GGPO::Bench::KeepAlive(values);
+        }
+
+        seconds += watch.Seconds();
+
+        sync.IncrementFrame();
+        sync.SetLastConfirmedFrame(f);
+    }
+
+    return seconds / fp_Frames / CALLS_PER_FRAME * 1e9;
+}
+
+template <typename Backend>
+struct Pair
+{
+    Pair(GGPO::IClock* fp_Clock) :
+        network(fp_Clock, 2)
+    {
+        const char* ips[PLAYERS] = { "10.0.0.1", "10.0.0.2" };
+
+        network.SetLink({ 20000, 0, 0 });
+
+        for (int me = 0; me < PLAYERS; me++)
+        {
+            transports[me] = std::make_unique<GGPO::MemoryTransport>(network, ips[me], 7000);
+            if constexpr (std::is_same_v<Backend, GGPO::Peer2PeerBackend>)
+            {
+                sessions[me] = std::make_unique<Backend>("bench", transports[me].get(), PLAYERS, INPUT_BYTES);
+            }
+            else
+            {
+                sessions[me] = std::make_unique<Backend>("bench", transports[me].get());
+            }
+
+            sessions[me]->SetClock(fp_Clock);
+            sessions[me]->SetGame(&games[me]);
+
+            for (int n = 0; n < PLAYERS; n++)
+            {
+                GGPO::Player player = { };
+                GGPO::PlayerHandle handle;
+
+                player.size = sizeof player;
+                player.player_num = n + 1;
+
+                if (n == me)
+                {
+                    player.type = GGPO::PlayerType::Local;
+                    local[me] = player.player_num;
+                }
+                else
+                {
+                    player.type = GGPO::PlayerType::Remote;
+                    strcpy(player.u.remote.ip_address, ips[n]);
+                    player.u.remote.port = 7000;
+                }
+
+                sessions[me]->AddPlayer(&player, &handle);
+            }
+        }
+    }
+
+    GGPO::MemoryNetwork                      network;
+    std::unique_ptr<GGPO::MemoryTransport>   transports[PLAYERS];
+    std::unique_ptr<Backend>                 sessions[PLAYERS];
+    GGPO::Testing::ChecksumGame              games[PLAYERS];
+    GGPO::PlayerHandle                       local[PLAYERS];
+};
+
+template <typename Backend>
+static void
+    Sessions(const char* fp_Name, int fp_Frames)
+{
+    GGPO::Testing::ManualClock clock;
+    Pair<Backend> pair(&clock);
+    int synced = 0;
+    double sync_seconds = 0.0;
+    double frame_seconds = 0.0;
+
+    for (int tick = 0; tick < fp_Frames; tick++)
+    {
+        clock.Advance(GGPO::Testing::FRAME_NS);
+
+        for (int me = 0; me < PLAYERS; me++)
+        {
+            auto& session = *pair.sessions[me];
+            char input[INPUT_BYTES];
+            char values[PLAYERS * INPUT_BYTES];
+            int disconnect_flags;
+
+            GGPO::Bench::Stopwatch frame;
+
+            session.DoPoll(0);
+            GGPO::Testing::SessionPeer::MakeInput(me, pair.games[me].frame, INPUT_BYTES, input);
+
+            if (session.AddLocalInput(pair.local[me], input, INPUT_BYTES) != GGPO::ErrorCode::OK)
+            {
+                continue;
+            }
+
+            GGPO::Bench::Stopwatch sync;
+            const GGPO::ErrorCode result = session.SyncInput(values, sizeof values, &disconnect_flags);
+            sync_seconds += sync.Seconds();
+
+            if (result != GGPO::ErrorCode::OK)
+            {
+                continue;
+            }
+
+            pair.games[me].AdvanceFrame(values, sizeof values);
+            session.IncrementFrame();
+            frame_seconds += frame.Seconds();
+            synced++;
+        }
+    }
+
+    int compared;
+    const int same = GGPO::Testing::MatchingFrames(pair.games[0], pair.games[1], MAX_PREDICTION_FRAMES, &compared);
+
+    if (same != compared)
+    {
+        GGPO::PrintError(std::format("[!] {}: peers disagree on {} of {} frames", fp_Name, compared - same, compared));
+        exit(EXIT_FAILURE);
+    }
+
+    GGPO::Bench::Report(std::format("2x4 {}, SyncInput", fp_Name), sync_seconds / GGPO_MAX(synced, 1) * 1e9, "ns/call");
+    GGPO::Bench::Report(std::format("2x4 {}, whole frame", fp_Name), frame_seconds / GGPO_MAX(synced, 1) * 1e9, "ns/frame");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int frames = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 200000;
+
+    GGPO::Bench::Report("2x4 Sync::SynchronizeInputs, runtime sizes", SynchronizeInputs<0, 0>(frames), "ns/call");
+    GGPO::Bench::Report("2x4 Sync::SynchronizeInputs<2, 4>", SynchronizeInputs<PLAYERS, INPUT_BYTES>(frames), "ns/call");
+
+    Sessions<GGPO::Peer2PeerBackend>("Peer2PeerBackend", frames / 4);
+    Sessions<GGPO::FixedSession<PLAYERS, INPUT_BYTES>>("FixedSession<2, 4>", frames / 4);
+
+    return EXIT_SUCCESS;
+}
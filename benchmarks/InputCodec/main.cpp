@@ -0,0 +1,173 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../Benchmark.h"
+
+/*
+ * Bandwidth and encode/decode cost at 8 players x 32 bytes.
+ *
+ * First the codec on its own: 64 pending frames of analog-ish input (four 16 bit
+ * stick axes drifting every frame, a button toggling now and then, the rest
+ * still), the same window UdpProtocol would put in one packet.
+ *
+ * Then 8 whole sessions over MemoryTransport for 20 simulated seconds, reporting
+ * what GetNetworkStats says each link costs.  The harness input rewrites every
+ * byte every 5 to 12 frames, so that's closer to a worst case.  The link has
+ * jitter but no loss, loss mostly stretches the 8 way sync handshake (peers
+ * that finish first wait at the prediction barrier) rather than the bandwidth.
+ */
+
+constexpr int PLAYERS = 8;
+constexpr int INPUT_BYTES = 32;
+constexpr int SIZE = PLAYERS * INPUT_BYTES;
+constexpr int WINDOW = 64;
+
+static void
+    Codec(int fp_Rounds)
+{
+    std::mt19937 random(1);
+    std::vector<std::vector<char>> frames(WINDOW + 1, std::vector<char>(SIZE, 0));
+
+    for (int f = 1; f <= WINDOW; f++)
+    {
+        frames[f] = frames[f - 1];
+
+        for (int p = 0; p < PLAYERS; p++)
+        {
+            char* input = &frames[f][p * INPUT_BYTES];
+
+            for (int axis = 0; axis < 4; axis++)
+            {
+                int16_t value;
+                memcpy(&value, input + axis * 2, 2);
+                value = (int16_t)(value + (int)(random() % 65) - 32);
+                memcpy(input + axis * 2, &value, 2);
+            }
+
+            if (random() % 10 == 0)
+            {
+                input[8 + random() % 4] ^= (char)(1 << (random() % 8));
+            }
+        }
+    }
+
+    std::vector<uint8_t> bits(WINDOW * (1 + SIZE * (9 + GGPO::InputCodec_IndexBits(SIZE))) / 8 + 8);
+    std::vector<char> decoded(SIZE);
+    int num_bits = 0;
+
+    GGPO::Bench::Stopwatch encode;
+
+    for (int r = 0; r < fp_Rounds; r++)
+    {
+        num_bits = 0;
+
+        for (int f = 1; f <= WINDOW; f++)
+        {
+            GGPO::InputCodec_EncodeFrame(bits.data(), frames[f - 1].data(), frames[f].data(), SIZE, &num_bits);
+        }
+
+        GGPO::Bench::KeepAlive(bits);
+    }
+
+    const double encode_seconds = encode.Seconds();
+    GGPO::Bench::Stopwatch decode;
+
+    for (int r = 0; r < fp_Rounds; r++)
+    {
+        int offset = 0;
+
+        memcpy(decoded.data(), frames[0].data(), SIZE);
+
+        for (int f = 1; f <= WINDOW; f++)
+        {
+            GGPO::InputCodec_DecodeFrame(bits.data(), num_bits, decoded.data(), SIZE, &offset);
+        }
+
+        GGPO::Bench::KeepAlive(decoded);
+    }
+
+    const double decode_seconds = decode.Seconds();
+
+    if (memcmp(decoded.data(), frames[WINDOW].data(), SIZE) != 0)
+    {
+        GGPO::PrintError("[!] codec didn't round trip");
+        exit(EXIT_FAILURE);
+    }
+
+    GGPO::Bench::Report("8x32 codec, encoded size", num_bits / 8.0 / WINDOW, "bytes/frame");
+    GGPO::Bench::Report("8x32 codec, raw size", (double)SIZE, "bytes/frame");
+    GGPO::Bench::Report("8x32 codec, encode", encode_seconds / fp_Rounds / WINDOW * 1e9, "ns/frame");
+    GGPO::Bench::Report("8x32 codec, decode", decode_seconds / fp_Rounds / WINDOW * 1e9, "ns/frame");
+}
+
+static void
+    Sessions(int fp_Seconds)
+{
+    const char* ips[PLAYERS] = { "10.0.0.1", "10.0.0.2", "10.0.0.3", "10.0.0.4", "10.0.0.5", "10.0.0.6", "10.0.0.7", "10.0.0.8" };
+
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 36);
+    network.SetLink({ 30000, 3000, 0 });
+
+    std::vector<std::unique_ptr<GGPO::Testing::SessionPeer>> peers;
+
+    for (int i = 0; i < PLAYERS; i++)
+    {
+        peers.push_back(std::make_unique<GGPO::Testing::SessionPeer>(network, ips, PLAYERS, i, INPUT_BYTES, &clock));
+    }
+
+    for (int tick = 0; tick < 60 * fp_Seconds; tick++)
+    {
+        clock.Advance(GGPO::Testing::FRAME_NS);
+
+        for (auto& peer : peers)
+        {
+            peer->Step();
+        }
+    }
+
+    double kbps = 0.0;
+    int links = 0;
+    int stalls = 0;
+
+    for (auto& peer : peers)
+    {
+        for (int i = 0; i < PLAYERS; i++)
+        {
+            GGPO::NetworkStats stats;
+
+            if (i != peer->me and peer->session->GetNetworkStats(&stats, peer->handles[i]) == GGPO::ErrorCode::OK)
+            {
+                kbps += stats.network.kbps_sent;
+                links++;
+            }
+        }
+
+        stalls += peer->stalls;
+    }
+
+    GGPO::Bench::Report(std::format("8x32 sessions, {} s, frames on peer 1", fp_Seconds), peers[0]->game.frame, "frames");
+    GGPO::Bench::Report("8x32 sessions, sent per link", kbps / GGPO_MAX(links, 1), "kbps");
+    GGPO::Bench::Report("8x32 sessions, sent per peer (7 links)", kbps / GGPO_MAX(links, 1) * (PLAYERS - 1), "kbps");
+    GGPO::Bench::Report("8x32 sessions, prediction barrier stalls", stalls, "total");
+}
+
+int 
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    Codec(fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 20000);
+    Sessions(20);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../Benchmark.h"
+
+/*
+ * Input compare microbenchmark.  16k pairs of inputs per size, half of them
+ * differing by one bit somewhere random so the branch predictor can't learn the
+ * answer, compared with:
+ *
+ *  - memcmp with the size only known at runtime (what the queue used to do)
+ *  - InputBitsEqual(a, b, size), the runtime word-at-a-time loop
+ *  - CompareInputBits, the switch onto the fixed size templates the queue uses
+ *  - GameInput::bits_equal, which also pays for reading two whole GameInputs
+ *    (a few hundred bytes each, 16k of them don't fit in cache)
+ *
+ *     InputCompare_Bench [rounds]
+ */
+
+constexpr int PAIRS = 1 << 14;
+constexpr int STRIDE = 64;
+
+template <typename Compare>
+static void
+    Run(const char* fp_Name, int fp_Size, int fp_Rounds, const std::vector<char>& fp_A, const std::vector<char>& fp_B, Compare fp_Compare)
+{
+    int equal = 0;
+
+    for (int i = 0; i < PAIRS; i++) // warm up, untimed
+    {
+        equal += fp_Compare(&fp_A[i * STRIDE], &fp_B[i * STRIDE], fp_Size);
+    }
+
+    GGPO::Bench::Stopwatch watch;
+
+    for (int r = 0; r < fp_Rounds; r++)
+    {
+        for (int i = 0; i < PAIRS; i++)
+        {
+            equal += fp_Compare(&fp_A[i * STRIDE], &fp_B[i * STRIDE], fp_Size);
+        }
+    }
+
+    const double seconds = watch.Seconds();
+
+    GGPO::Bench::KeepAlive(equal);
+    GGPO::Bench::Report(std::format("{:>2} bytes, {}", fp_Size, fp_Name), seconds / ((double)fp_Rounds * PAIRS) * 1e9, "ns");
+}
+
+int 
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int rounds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 200;
+    std::mt19937 random(37);
+
+    for (int size : { 1, 2, 3, 4, 8, 12, 16, 32 })
+    {
+        std::vector<char> a(PAIRS * STRIDE);
+        std::vector<char> b;
+
+        for (char& c : a)
+        {
+            c = (char)random();
+        }
+
+        b = a;
+
+        for (int i = 0; i < PAIRS; i++)
+        {
+            if (random() & 1)
+            {
+                b[i * STRIDE + random() % size] ^= (char)(1 << (random() % 8));
+            }
+        }
+
+        std::vector<GGPO::GameInput> inputs_a(PAIRS);
+        std::vector<GGPO::GameInput> inputs_b(PAIRS);
+
+        for (int i = 0; i < PAIRS; i++)
+        {
+            inputs_a[i].init(i, &a[i * STRIDE], size);
+            inputs_b[i].init(i, &b[i * STRIDE], size);
+        }
+
+        Run("memcmp", size, rounds, a, b, [](const char* x, const char* y, int n) { return memcmp(x, y, n) == 0; });
+        Run("InputBitsEqual (runtime size)", size, rounds, a, b, [](const char* x, const char* y, int n) { return GGPO::InputBitsEqual(x, y, n); });
+        Run("CompareInputBits", size, rounds, a, b, [](const char* x, const char* y, int n) { return GGPO::CompareInputBits(x, y, n); });
+        Run("GameInput::bits_equal", size, rounds, a, b, [&](const char* x, const char*, int) {
+            const int i = (int)((x - a.data()) / STRIDE);
+            return inputs_a[i].bits_equal(inputs_b[i]);
+        });
+    }
+
+    return EXIT_SUCCESS;
+}
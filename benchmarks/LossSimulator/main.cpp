@@ -0,0 +1,200 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+
+#include "../ProtocolLink.h"
+
+/*
+ * How long two players spend stuck at the prediction barrier when packets go
+ * missing, which is what the resend timers are there for.
+ *
+ * Two UdpProtocol endpoints over MemoryTransport, 1 ms steps for 60 s.  Each
+ * side sends an input every 1/60 s as long as it's no more than 8 frames ahead
+ * of what it has from the other, otherwise it's stalled until it is.  Runs
+ * random loss, then a 300 ms outage every 5 s (the kind of thing wifi does),
+ * at 30 and 55 ms one way.
+ *
+ * Then a spectator 2,000 frames behind a host that isn't sending anything new,
+ * so only the resend timers and the acks move the backlog, in 1 ms steps over a
+ * 15 +- 3 ms link.
+ *
+ *     LossSimulator_Bench [seconds]
+ */
+
+constexpr int INPUT_BYTES = 16;
+constexpr int PREDICTION_WINDOW = 8;
+constexpr uint64_t FRAME_US = 16667;
+
+struct Player
+{
+    Player(GGPO::MemoryNetwork& fp_Network, const char* fp_Ip) :
+        node(fp_Network, fp_Ip, INPUT_BYTES)
+    {
+    }
+
+    // one game frame if it's due and we're inside the prediction window
+    void
+        Tick(uint64_t fp_NowUS)
+    {
+        if (fp_NowUS < next_us)
+        {
+            return;
+        }
+
+        if (remote->received < frame - PREDICTION_WINDOW)
+        {
+            stall_start_us = stall_start_us ? stall_start_us : fp_NowUS;
+            return;
+        }
+
+        if (stall_start_us)
+        {
+            const uint64_t stall = fp_NowUS - stall_start_us;
+
+            stalled_us += stall;
+            worst_stall_us = GGPO_MAX(worst_stall_us, stall);
+            stall_start_us = 0;
+        }
+
+        GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame++, INPUT_BYTES);
+
+        remote->protocol.SendInput(input);
+        node.Flush();
+        next_us += FRAME_US;
+    }
+
+    GGPO::Bench::ProtocolNode           node;
+    GGPO::Bench::ProtocolEndpoint*      remote = nullptr;
+    int                                 frame = 0;
+    uint64_t                            next_us = 0;
+    uint64_t                            stall_start_us = 0;
+    uint64_t                            stalled_us = 0;
+    uint64_t                            worst_stall_us = 0;
+};
+
+static void
+    Run(uint64_t fp_DelayUS, int fp_Loss, bool fp_Outages, int fp_Seconds)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 7);
+    const GGPO::MemoryNetwork::Link link = { fp_DelayUS, 2000, fp_Loss };
+    const GGPO::MemoryNetwork::Link outage = { fp_DelayUS, 2000, 100 };
+
+    network.SetLink(link);
+
+    Player a(network, "10.0.0.1");
+    Player b(network, "10.0.0.2");
+
+    a.remote = a.node.Connect(&clock, 1, "10.0.0.2");
+    b.remote = b.node.Connect(&clock, 0, "10.0.0.1");
+
+    while (not a.node.Running() or not b.node.Running())
+    {
+        clock.Advance(1000000);
+        a.node.Pump();
+        b.node.Pump();
+    }
+
+    const long long datagrams = a.node.transport.datagrams + b.node.transport.datagrams;
+
+    a.next_us = b.next_us = clock.ns / 1000;
+
+    for (int ms = 0; ms < fp_Seconds * 1000; ms++)
+    {
+        clock.Advance(1000000);
+
+        if (fp_Outages)
+        {
+            network.SetLink(ms % 5000 >= 4000 and ms % 5000 < 4300 ? outage : link);
+        }
+
+        a.Tick(clock.ns / 1000);
+        b.Tick(clock.ns / 1000);
+        a.node.Pump();
+        b.node.Pump();
+    }
+
+    const std::string name = std::format("{} ms one way, {}", fp_DelayUS / 1000, fp_Outages ? std::string("300 ms outage every 5 s") : std::format("{}% loss", fp_Loss));
+
+    GGPO::Bench::Report(name + ", stalled", (a.stalled_us + b.stalled_us) / 2e6, "s/player");
+    GGPO::Bench::Report(name + ", worst stall", GGPO_MAX(a.worst_stall_us, b.worst_stall_us) / 1e3, "ms");
+    GGPO::Bench::Report(name + ", datagrams", (a.node.transport.datagrams + b.node.transport.datagrams - datagrams) / (2.0 * fp_Seconds), "/s/player");
+}
+
+static void
+    IdleBacklog(int fp_Loss, int fp_Backlog)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 3);
+    GGPO::Bench::ProtocolNode host(network, "10.0.0.1", INPUT_BYTES);
+    GGPO::Bench::ProtocolNode spectator(network, "10.0.0.2", INPUT_BYTES);
+
+    network.SetLink({ 15000, 3000, fp_Loss });
+
+    GGPO::Bench::ProtocolEndpoint* to_spectator = host.Connect(&clock, 1000, "10.0.0.2", SPECTATOR_SEND_BURST);
+    GGPO::Bench::ProtocolEndpoint* from_host = spectator.Connect(&clock, 0, "10.0.0.1");
+
+    while (not host.Running() or not spectator.Running())
+    {
+        clock.Advance(1000000);
+        host.Pump();
+        spectator.Pump();
+    }
+
+    int frame = 0;
+
+    host.transport.blocked = true;
+
+    for (; frame < fp_Backlog; frame++)
+    {
+        GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame, INPUT_BYTES);
+
+        to_spectator->protocol.SendInput(input);
+        host.Flush();
+    }
+
+    host.transport.blocked = false;
+
+    int ms = 0;
+
+    while (from_host->received < frame - 1 and ms < 60000)
+    {
+        clock.Advance(1000000);
+        spectator.Pump();
+        host.Pump();
+        ms++;
+    }
+
+    GGPO::Bench::Report(std::format("{}% loss, {} frame backlog on an idle host, caught up in", fp_Loss, fp_Backlog), ms, "ms");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 60;
+
+    for (uint64_t delay_us : { 30000, 55000 })
+    {
+        for (int loss : { 0, 2, 10, 25 })
+        {
+            Run(delay_us, loss, false, seconds);
+        }
+
+        Run(delay_us, 0, true, seconds);
+    }
+
+    for (int loss : { 5, 20 })
+    {
+        IdleBacklog(loss, 2000);
+    }
+
+    return EXIT_SUCCESS;
+}
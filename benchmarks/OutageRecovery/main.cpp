@@ -0,0 +1,162 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+
+#include "../ProtocolLink.h"
+
+/*
+ * How fast a spectator gets back to its usual lag after a 1 s outage, and what
+ * the datagram cap does to fragmentation on the way.
+ *
+ * Host and spectator UdpProtocol endpoints over MemoryTransport, 30 ms one way,
+ * 64 byte inputs, one host frame every 1/60 s for 60 s.  Every 10 s the link
+ * goes dead both ways for 1 s.  The path has an mtu (1472 or 548 bytes of udp
+ * payload, a 1500 or 576 byte ip mtu) and every ip fragment is lost 2% of the
+ * time, so a datagram that doesn't fit the path is more likely to go missing.
+ *
+ * Recovery counts from the link coming back until the spectator is within 4
+ * frames of the host.  Datagrams are per outage, both ways, from when the link
+ * went down until recovery.
+ *
+ *     OutageRecovery_Bench [seconds]
+ */
+
+constexpr int INPUT_BYTES = 64;
+constexpr int FRAGMENT_LOSS_PERCENT = 2;
+constexpr int OUTAGE_EVERY = 600;           // frames
+constexpr int OUTAGE_FRAMES = 60;
+
+struct Case
+{
+    const char*     name;
+    int             path_payload;
+    int             max_datagram_size;
+    int             send_burst;
+};
+
+static void
+    Run(const Case& fp_Case, int fp_Seconds)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 3);
+    GGPO::Bench::ProtocolNode host(network, "10.0.0.1", INPUT_BYTES, 7);
+    GGPO::Bench::ProtocolNode spectator(network, "10.0.0.2", INPUT_BYTES, 11);
+
+    network.SetLink({ 30000, 2000, 0 });
+
+    GGPO::Bench::ProtocolEndpoint* to_spectator = host.Connect(&clock, 1000, "10.0.0.2", fp_Case.send_burst);
+    GGPO::Bench::ProtocolEndpoint* from_host = spectator.Connect(&clock, 0, "10.0.0.1");
+
+    for (GGPO::Bench::ProtocolNode* node : { &host, &spectator })
+    {
+        node->transport.path_payload = fp_Case.path_payload;
+        node->transport.fragment_loss_percent = FRAGMENT_LOSS_PERCENT;
+        node->endpoints[0]->protocol.SetMaxDatagramSize(fp_Case.max_datagram_size);
+    }
+
+    while (not host.Running() or not spectator.Running())
+    {
+        clock.Advance(1000000);
+        host.Pump();
+        spectator.Pump();
+    }
+
+    int frame = 0;
+
+    auto tick = [&]()
+    {
+        GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame++, INPUT_BYTES);
+
+        clock.Advance(GGPO::Testing::FRAME_NS);
+        to_spectator->protocol.SendInput(input);
+        host.Flush();
+        spectator.Pump();
+        host.Pump();
+    };
+
+    auto sent = [&]() { return host.transport.datagrams + spectator.transport.datagrams; };
+    auto fragmented = [&]() { return host.transport.fragmented + spectator.transport.fragmented; };
+
+    const int frames = fp_Seconds * 60;
+    long long outage_datagrams = 0;
+    long long outage_fragmented = 0;
+    long long datagrams_before = 0;
+    long long fragmented_before = 0;
+    int recovery_frames = 0;
+    int worst = 0;
+    int outages = 0;
+
+    for (int t = 0; t < frames; t++)
+    {
+        if (t % OUTAGE_EVERY == OUTAGE_EVERY / 2)
+        {
+            host.transport.blocked = spectator.transport.blocked = true;
+            datagrams_before = sent();
+            fragmented_before = fragmented();
+        }
+
+        if (t % OUTAGE_EVERY == OUTAGE_EVERY / 2 + OUTAGE_FRAMES)
+        {
+            const int start = t;
+
+            host.transport.blocked = spectator.transport.blocked = false;
+
+            while (from_host->received < frame - 4 and t < frames)
+            {
+                tick();
+                t++;
+            }
+
+            recovery_frames += t - start;
+            worst = GGPO_MAX(worst, t - start);
+            outage_datagrams += sent() - datagrams_before;
+            outage_fragmented += fragmented() - fragmented_before;
+            outages++;
+        }
+
+        tick();
+    }
+
+    if (outages == 0 or from_host->received < frame - 8)
+    {
+        GGPO::PrintError(std::format("[!] {}: no outage recovered from (spectator at {} of {})", fp_Case.name, from_host->received, frame - 1));
+        exit(EXIT_FAILURE);
+    }
+
+    const double frame_ms = GGPO::Testing::FRAME_NS / 1e6;
+
+    GGPO::Bench::Report(std::format("{}, recovery", fp_Case.name), recovery_frames * frame_ms / outages, "ms");
+    GGPO::Bench::Report(std::format("{}, worst recovery", fp_Case.name), worst * frame_ms, "ms");
+    GGPO::Bench::Report(std::format("{}, datagrams", fp_Case.name), (double)outage_datagrams / outages, "/outage");
+    GGPO::Bench::Report(std::format("{}, fragmented", fp_Case.name), (double)outage_fragmented / outages, "/outage");
+    GGPO::Bench::Report(std::format("{}, largest datagram", fp_Case.name), (double)GGPO_MAX(host.transport.largest, spectator.transport.largest), "bytes");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 60;
+    const Case cases[] =
+    {
+        { "1500 mtu, default cap, burst 16",    1472,   MAX_DATAGRAM_SIZE,  SPECTATOR_SEND_BURST },
+        { "1500 mtu, default cap, burst 1",     1472,   MAX_DATAGRAM_SIZE,  1 },
+        { "576 mtu, default cap, burst 16",     548,    MAX_DATAGRAM_SIZE,  SPECTATOR_SEND_BURST },
+        { "576 mtu, cap 508, burst 16",         548,    508,                SPECTATOR_SEND_BURST },
+        { "576 mtu, cap 508, burst 2",          548,    508,                PLAYER_SEND_BURST },
+    };
+
+    for (const Case& c : cases)
+    {
+        Run(c, seconds);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,249 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#pragma once
+
+#include "Benchmark.h"
+
+#include <memory>
+#include <vector>
+
+/*
+ * UdpProtocol endpoints over MemoryTransport with no backend on top, for the
+ * demos that are about what goes over the wire: catch-up, loss, acks, datagram
+ * counts.  A ProtocolNode is one machine, Pump() does what a backend's DoPoll
+ * does with its endpoints (receive, poll, drain events, flush) and checks every
+ * input comes out once and in order.
+ */
+namespace GGPO::Bench
+{
+    // what frame f's input is, mostly still with a few bytes that move, like someone holding buttons
+    inline GameInput
+        ProtocolInput(int fp_Frame, int fp_Size)
+    {
+        GameInput input;
+        char bits[GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS];   // sized for the combined input spectators get
+
+        for (int i = 0; i < fp_Size; i++)
+        {
+            bits[i] = (char)(i % 3 ? fp_Frame / 8 : fp_Frame * (7 + i));
+        }
+
+        input.init(fp_Frame, bits, fp_Size);
+        return input;
+    }
+
+    /*
+     * A MemoryTransport that counts what leaves it and can drop it on the way out,
+     * all of it while blocked is set (an outage) or fragment by fragment when a
+     * path mtu is set, so a datagram bigger than the path goes if any piece does.
+     */
+    class SimTransport : public MemoryTransport
+    {
+    public:
+        SimTransport(MemoryNetwork& fp_Network, const char* fp_Ip, uint16_t fp_Port, uint32_t fp_Seed = 1) :
+            MemoryTransport(fp_Network, fp_Ip, fp_Port),
+            _random(fp_Seed ? fp_Seed : 1)
+        {
+        }
+
+        void
+            Send(const TransportPacket* fp_Packets, int fp_Count)
+            override
+        {
+            for (int i = 0; i < fp_Count; i++)
+            {
+                const int length = fp_Packets[i].length;
+                const int fragments = path_payload > 0 ? (length + path_payload - 1) / path_payload : 1;
+                bool lost = blocked;
+
+                datagrams++;
+                bytes += length;
+                fragmented += fragments > 1;
+                largest = GGPO_MAX(largest, length);
+
+                for (int f = 0; f < fragments and not lost; f++)
+                {
+                    lost = fragment_loss_percent > 0 and (int)(Random() % 100) < fragment_loss_percent;
+                }
+
+                if (lost)
+                {
+                    dropped++;
+                    continue;
+                }
+
+                MemoryTransport::Send(&fp_Packets[i], 1);
+            }
+        }
+
+        bool        blocked = false;
+        int         path_payload = 0;           // udp payload that fits the path in one piece, 0 for no limit
+        int         fragment_loss_percent = 0;
+
+        long long   datagrams = 0;
+        long long   bytes = 0;
+        long long   fragmented = 0;
+        long long   dropped = 0;
+        int         largest = 0;
+
+    protected:
+        uint32_t
+            Random()
+        {
+            _random ^= _random << 13;
+            _random ^= _random >> 17;
+            _random ^= _random << 5;
+            return _random;
+        }
+
+        uint32_t    _random;
+    };
+
+    struct ProtocolEndpoint
+    {
+        UdpProtocol                 protocol;
+        UdpMsg::connect_status      status[UDP_MSG_MAX_PLAYERS];
+        int                         received = -1;  // newest frame that came out of it
+    };
+
+    class ProtocolNode
+    {
+    public:
+        ProtocolNode(MemoryNetwork& fp_Network, const char* fp_Ip, int fp_InputSize, uint32_t fp_Seed = 1) :
+            transport(fp_Network, fp_Ip, PORT, fp_Seed),
+            input_size(fp_InputSize)
+        {
+        }
+
+        // queue is what the remote end is to us, spectators get 1000 and up like the backends give them
+        ProtocolEndpoint*
+            Connect(IClock* fp_Clock, int fp_Queue, const char* fp_Ip, int fp_SendBurst = PLAYER_SEND_BURST, int fp_Pending = 16384)
+        {
+            auto endpoint = make_unique<ProtocolEndpoint>();
+            char ip[64];
+
+            for (auto& status : endpoint->status)
+            {
+                status.disconnected = 0;
+                status.last_frame = -1;
+            }
+
+            strcpy(ip, fp_Ip);
+
+            endpoint->protocol.SetClock(fp_Clock);
+            endpoint->protocol.Init(&transport, poll, fp_Queue, ip, PORT, endpoint->status, fp_Pending, fp_SendBurst);
+            endpoint->protocol.SetEventQueueLength(fp_Pending);
+            endpoint->protocol.Synchronize();
+
+            endpoints.push_back(move(endpoint));
+            return endpoints.back().get();
+        }
+
+        void
+            Pump()
+        {
+            TransportPacket packets[TRANSPORT_BATCH_SIZE];
+            int count;
+
+            do
+            {
+                count = transport.Receive(packets, TRANSPORT_BATCH_SIZE);
+
+                for (int i = 0; i < count; i++)
+                {
+                    UdpMsg* msg = ReceivedMsg(packets[i], &_scratch);
+
+                    for (auto& endpoint : endpoints)
+                    {
+                        if (endpoint->protocol.HandlesMsg(packets[i].peer, msg))
+                        {
+                            endpoint->protocol.OnMsg(msg, packets[i].length, packets[i].age_ns, packets[i].answered);
+                            break;
+                        }
+                    }
+                }
+            } while (count == TRANSPORT_BATCH_SIZE);
+
+            poll.Pump(0);
+
+            for (auto& endpoint : endpoints)
+            {
+                UdpProtocol::Event event;
+
+                while (endpoint->protocol.GetEvent(event))
+                {
+                    if (event.type == UdpProtocol::Event::Input)
+                    {
+                        Check(*endpoint, event.u.input.input);
+
+                        if (ack_every_input)
+                        {
+                            endpoint->protocol.SendInputAck();
+                        }
+                    }
+                }
+            }
+
+            Flush();
+        }
+
+        void
+            Flush()
+        {
+            for (auto& endpoint : endpoints)
+            {
+                endpoint->protocol.Flush();
+            }
+
+            transport.Flush();
+        }
+
+        bool
+            Running()
+            const
+        {
+            for (const auto& endpoint : endpoints)
+            {
+                if (not endpoint->protocol.IsRunning())
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        static constexpr uint16_t PORT = 7000;
+
+        SimTransport                                transport;
+        Poll                                        poll;
+        vector<unique_ptr<ProtocolEndpoint>>        endpoints;
+        int                                         input_size;
+        bool                                        ack_every_input = false;    // what SpectatorBackend did before the ack policies
+
+    protected:
+        void
+            Check(ProtocolEndpoint& fp_Endpoint, const GameInput& fp_Input)
+        {
+            const GameInput expected = ProtocolInput(fp_Input.frame, input_size);
+
+            if (fp_Input.frame != fp_Endpoint.received + 1 or fp_Input.size != input_size or memcmp(fp_Input.bits, expected.bits, input_size) != 0)
+            {
+                PrintError(format("[!] frame {} came out after {}, or with the wrong bits", fp_Input.frame, fp_Endpoint.received));
+                exit(EXIT_FAILURE);
+            }
+
+            fp_Endpoint.received = fp_Input.frame;
+        }
+
+        UdpMsg                                      _scratch = UdpMsg(UdpMsg::Invalid);
+    };
+}
@@ -0,0 +1,133 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../Benchmark.h"
+
+/*
+ * Frames verified per second per core for ReplayVerifier, at 1 worker and then
+ * doubling up to the core count (at least 4, so every perturbation runs).  The
+ * game keeps 1 KB of state and touches all of it every frame so save, load and
+ * advance cost something like a small real game.  Workers cycle through the
+ * usual perturbations: straight replay, 2 and 5 frame rollbacks, 8 frames with
+ * forced mispredictions.  Resimulated frames count, same as the report.
+ *
+ *     ReplayVerifier_Bench [frames]
+ */
+
+class StateGame : public GGPO::IReplayGame
+{
+public:
+    void
+        AdvanceFrame(const char* fp_Inputs, int fp_Size)
+        override
+    {
+        uint32_t mix = 2166136261u;
+
+        for (int i = 0; i < fp_Size; i++)
+        {
+            mix = (mix ^ (uint8_t)fp_Inputs[i]) * 16777619u;
+        }
+
+        for (uint32_t& word : _state)
+        {
+            word = (word ^ mix) * 2654435761u + 1;
+            mix = word >> 7;
+        }
+    }
+
+    void
+        SaveState(std::string& fp_Buffer, int* fp_Checksum)
+        override
+    {
+        fp_Buffer.assign((const char*)_state, sizeof _state);
+        *fp_Checksum = (int)_state[0];
+    }
+
+    void
+        LoadState(const std::string& fp_Buffer)
+        override
+    {
+        memcpy(_state, fp_Buffer.data(), sizeof _state);
+    }
+
+private:
+    uint32_t _state[256] = { };
+};
+
+// deterministic per player input that changes every few frames, like someone holding buttons
+static void
+    MakeInput(int fp_Player, int fp_Frame, char* fp_Out)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        fp_Out[i] = (char)((fp_Frame / (5 + fp_Player)) * (i + 1) + fp_Player);
+    }
+}
+
+int 
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int frames = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 20000;
+    const int cores = GGPO_MAX(1, (int)std::thread::hardware_concurrency());
+    const int max_workers = GGPO_MAX(cores, 4);
+    const GGPO::ReplayWorkerConfig perturbations[] = { { 0, 0 }, { 2, 0 }, { 5, 7 }, { 8, 3 } };
+
+    GGPO::ReplayRecording recording;
+    recording.num_players = 2;
+    recording.input_size = 4;
+
+    for (int f = 0; f < frames; f++)
+    {
+        char values[8];
+
+        MakeInput(0, f, values);
+        MakeInput(1, f, values + 4);
+        recording.AddFrame(values);
+    }
+
+    GGPO::Print(std::format("{} frames, 1 KB state, {} cores", frames, cores));
+
+    for (int workers = 1; ; workers = GGPO_MIN(workers * 2, max_workers))
+    {
+        std::vector<StateGame> games(workers);
+        std::vector<GGPO::IReplayGame*> game_ptrs;
+        std::vector<GGPO::ReplayWorkerConfig> configs;
+
+        for (int i = 0; i < workers; i++)
+        {
+            game_ptrs.push_back(&games[i]);
+            configs.push_back(perturbations[i % GGPO_ARRAY_SIZE(perturbations)]);
+        }
+
+        GGPO::ReplayVerifier verifier;
+        GGPO::ReplayReport report;
+
+        if (verifier.Run(recording, game_ptrs.data(), configs.data(), workers, &report) != GGPO::ErrorCode::OK)
+        {
+            GGPO::PrintError(std::format("[!] {} workers desynced at frame {}", workers, report.first_desync_frame));
+            return EXIT_FAILURE;
+        }
+
+        GGPO::Bench::Report(std::format("{} workers, frames/s/core", workers), report.frames_verified_per_second_per_core, "frames/s");
+        GGPO::Bench::Report(std::format("{} workers, simulated per verified frame", workers), (double)report.frames_simulated / ((double)frames * workers), "x");
+
+        if (workers == max_workers)
+        {
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
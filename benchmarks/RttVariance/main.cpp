@@ -0,0 +1,163 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#include "../Benchmark.h"
+
+/*
+ * How much of the measured RTT is the network and how much is when the game
+ * got around to polling.
+ *
+ * Two sessions over MemoryTransport on simulated time, each stepping once a
+ * frame at its own phase with +-1 ms of frame time jitter, like two games that
+ * don't know about each other's vsync.  Peer 1's ping and rtt variance come
+ * from GetNetworkStats once it's past the first 30 s.
+ *
+ * Every link runs twice: once with the arrival ages MemoryTransport hands out
+ * (what kernel timestamps give Udp), once through a transport that zeroes them,
+ * so the session only knows a packet arrived when it polled.  The true RTT is
+ * twice the link delay.
+ *
+ *     RttVariance_Bench [seconds]
+ */
+
+// a transport that can't tell when anything arrived, Tcp and Windows Udp are like this
+class AgelessTransport : public GGPO::MemoryTransport
+{
+public:
+    using MemoryTransport::MemoryTransport;
+
+    int
+        Receive(GGPO::TransportPacket* fp_Packets, int fp_Max)
+        override
+    {
+        const int count = MemoryTransport::Receive(fp_Packets, fp_Max);
+
+        for (int i = 0; i < count; i++)
+        {
+            fp_Packets[i].age_ns = 0;
+        }
+
+        return count;
+    }
+};
+
+struct Case
+{
+    const char*     name;
+    uint64_t        frame_us;
+    uint64_t        offset_us;
+    uint64_t        delay_us;
+    uint64_t        jitter_us;
+};
+
+static void
+    Run(const Case& fp_Case, bool fp_Ages, int fp_Seconds)
+{
+    const char* ips[2] = { "10.0.0.1", "10.0.0.2" };
+    constexpr uint64_t WARMUP_US = 30000000ULL;
+
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 7);
+    std::mt19937 random(3);
+
+    network.SetLink({ fp_Case.delay_us, fp_Case.jitter_us, 0 });
+
+    auto transport = [&](int fp_Me) -> std::unique_ptr<GGPO::MemoryTransport>
+    {
+        if (fp_Ages)
+        {
+            return std::make_unique<GGPO::MemoryTransport>(network, ips[fp_Me], 7000);
+        }
+
+        return std::make_unique<AgelessTransport>(network, ips[fp_Me], 7000);
+    };
+
+    GGPO::Testing::SessionPeer a(transport(0), ips, 2, 0, 2, &clock);
+    GGPO::Testing::SessionPeer b(transport(1), ips, 2, 1, 2, &clock);
+
+    const uint64_t start_us = clock.ns / 1000;
+    const uint64_t end_us = start_us + (uint64_t)fp_Seconds * 1000000ULL;
+    uint64_t next_a = start_us;
+    uint64_t next_b = start_us + fp_Case.offset_us;
+    double ping_sum = 0.0;
+    double ping_squares = 0.0;
+    double jitter_sum = 0.0;
+    int samples = 0;
+
+    auto frame = [&]() { return fp_Case.frame_us - 1000 + random() % 2001; };
+
+    while (GGPO_MIN(next_a, next_b) < end_us)
+    {
+        const uint64_t now_us = GGPO_MIN(next_a, next_b);
+
+        clock.ns = now_us * 1000;
+
+        if (now_us == next_a)
+        {
+            GGPO::NetworkStats stats;
+
+            a.Step();
+            next_a += frame();
+
+            if (now_us > start_us + WARMUP_US and a.session->GetNetworkStats(&stats, a.handles[1]) == GGPO::ErrorCode::OK)
+            {
+                ping_sum += (double)stats.network.ping_us;
+                ping_squares += (double)stats.network.ping_us * stats.network.ping_us;
+                jitter_sum += (double)stats.network.jitter_us;
+                samples++;
+            }
+        }
+
+        if (now_us == next_b)
+        {
+            b.Step();
+            next_b += frame();
+        }
+    }
+
+    if (samples == 0)
+    {
+        GGPO::PrintError(std::format("[!] {}: the sessions never got far enough to report", fp_Case.name));
+        exit(EXIT_FAILURE);
+    }
+
+    const double mean = ping_sum / samples;
+    const double sd = std::sqrt(GGPO_MAX(ping_squares / samples - mean * mean, 0.0));
+    const std::string name = std::format("{}, {}", fp_Case.name, fp_Ages ? "arrival ages" : "poll time");
+
+    GGPO::Bench::Report(name + ", ping", mean / 1000.0, "ms");
+    GGPO::Bench::Report(name + ", ping sd", sd / 1000.0, "ms");
+    GGPO::Bench::Report(name + ", rtt variance", jitter_sum / samples / 1000.0, "ms");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 300;
+    const Case cases[] =
+    {
+        { "60 Hz, link 20 ms",          16667,  7000,  20000, 0    },
+        { "60 Hz, link 20 +- 4 ms",     16667,  7000,  20000, 4000 },
+        { "60 Hz, link 5 +- 1 ms",      16667,  3000,  5000,  1000 },
+        { "30 Hz, link 40 +- 8 ms",     33333,  11000, 40000, 8000 },
+    };
+
+    for (const Case& c : cases)
+    {
+        Run(c, false, seconds);
+        Run(c, true, seconds);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+
+#include "../ProtocolLink.h"
+
+/*
+ * A spectator 10,000 frames behind its host, how long until it's caught up.
+ *
+ * Host and spectator UdpProtocol endpoints over a 15 +- 3 ms MemoryTransport
+ * link, 16 byte inputs.  Once the spectator has its first frame the link to it
+ * goes dead while the host runs 10,000 frames, then comes back and the host
+ * carries on at 60 Hz.  Caught up means within 3 frames of the host.
+ *
+ * Burst 1 is one input packet per send, how catch-up used to go, 16 is the
+ * SPECTATOR_SEND_BURST default.  Every frame has to come out once and in order.
+ *
+ *     SpectatorCatchUp_Bench [backlog]
+ */
+
+constexpr int INPUT_BYTES = 16;
+
+static void
+    CatchUp(int fp_Loss, int fp_Burst, int fp_Backlog)
+{
+    GGPO::Testing::ManualClock clock;
+    GGPO::MemoryNetwork network(&clock, 3);
+    GGPO::Bench::ProtocolNode host(network, "10.0.0.1", INPUT_BYTES);
+    GGPO::Bench::ProtocolNode spectator(network, "10.0.0.2", INPUT_BYTES);
+
+    network.SetLink({ 15000, 3000, fp_Loss });
+
+    GGPO::Bench::ProtocolEndpoint* to_spectator = host.Connect(&clock, 1000, "10.0.0.2", fp_Burst);
+    GGPO::Bench::ProtocolEndpoint* from_host = spectator.Connect(&clock, 0, "10.0.0.1");
+
+    while (not host.Running() or not spectator.Running())
+    {
+        clock.Advance(1000000);
+        host.Pump();
+        spectator.Pump();
+    }
+
+    int frame = 0;
+
+    auto send = [&]()
+    {
+        GGPO::GameInput input = GGPO::Bench::ProtocolInput(frame++, INPUT_BYTES);
+        to_spectator->protocol.SendInput(input);
+        host.Flush();
+    };
+
+    auto tick = [&]()
+    {
+        clock.Advance(GGPO::Testing::FRAME_NS);
+        send();
+        spectator.Pump();
+        host.Pump();
+    };
+
+    while (from_host->received < 0)
+    {
+        tick();
+    }
+
+    host.transport.blocked = true;
+
+    for (int i = 0; i < fp_Backlog; i++)
+    {
+        send();
+    }
+
+    host.transport.blocked = false;
+
+    const long long host_datagrams = host.transport.datagrams;
+    const long long spectator_datagrams = spectator.transport.datagrams;
+    GGPO::Bench::Stopwatch wall;
+    int ticks = 0;
+
+    while (from_host->received < frame - 3 and ticks < 20 * fp_Backlog)
+    {
+        tick();
+        ticks++;
+    }
+
+    if (from_host->received < frame - 3)
+    {
+        GGPO::PrintError(std::format("[!] loss {}%, burst {}: never caught up (at {} of {})", fp_Loss, fp_Burst, from_host->received, frame - 1));
+        exit(EXIT_FAILURE);
+    }
+
+    const std::string name = std::format("{}% loss, burst {:>2}", fp_Loss, fp_Burst);
+
+    GGPO::Bench::Report(name + ", frames to catch up", ticks, "frames");
+    GGPO::Bench::Report(name + ", host datagrams", (double)(host.transport.datagrams - host_datagrams), "datagrams");
+    GGPO::Bench::Report(name + ", spectator datagrams", (double)(spectator.transport.datagrams - spectator_datagrams), "datagrams");
+    GGPO::Bench::Report(name + ", time to simulate it", wall.Seconds() * 1e3, "ms");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int backlog = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 10000;
+
+    for (int loss : { 0, 5, 20 })
+    {
+        for (int burst : { 1, SPECTATOR_SEND_BURST })
+        {
+            CatchUp(loss, burst, backlog);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
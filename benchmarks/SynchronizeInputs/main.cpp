@@ -0,0 +1,187 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+
+#include "../Benchmark.h"
+
+/*
+ * The two Sync paths the compact input queues are for, driven straight through
+ * Sync with no network:
+ *
+ *  - SynchronizeInputs on frames that are already confirmed, the every-frame
+ *    cost of gathering everyone's input.
+ *  - Rollback replay: the remote inputs show up 7 frames late and change every
+ *    frame, so every CheckSimulation loads a state and resimulates 7 frames.
+ *
+ * The per call times include one steady_clock read (~20 ns on most boxes).
+ *
+ *     SynchronizeInputs_Bench [frames]
+ */
+
+constexpr int ROLLBACK_DEPTH = 7;
+
+class CheapGame : public GGPO::IReplayGame
+{
+public:
+    void
+        AdvanceFrame(const char* fp_Inputs, int fp_Size)
+        override
+    {
+        for (int i = 0; i < fp_Size; i++)
+        {
+            _acc = _acc * 31u + (uint8_t)fp_Inputs[i];
+        }
+    }
+
+    void
+        SaveState(std::string& fp_Buffer, int* fp_Checksum)
+        override
+    {
+        fp_Buffer.assign((const char*)&_acc, sizeof _acc);
+        *fp_Checksum = (int)_acc;
+    }
+
+    void
+        LoadState(const std::string& fp_Buffer)
+        override
+    {
+        memcpy(&_acc, fp_Buffer.data(), sizeof _acc);
+    }
+
+private:
+    uint64_t _acc = 0;
+};
+
+struct SyncRig
+{
+    SyncRig(int fp_Players, int fp_InputSize) :
+        sync(status)
+    {
+        for (auto& s : status)
+        {
+            s.disconnected = 0;
+            s.last_frame = -1;
+        }
+
+        GGPO::Sync::Config config = { MAX_PREDICTION_FRAMES, fp_Players, fp_InputSize, 0 };
+        sync.Init(config);
+        sync.SetGame(&game);
+    }
+
+    void
+        AddInput(int fp_Queue, int fp_Frame, int fp_InputSize, bool fp_Local)
+    {
+        GGPO::GameInput input;
+        char bits[GAMEINPUT_MAX_BYTES];
+
+        memset(bits, fp_Frame * 13 + fp_Queue, GGPO_MIN(fp_InputSize, (int)sizeof(bits)));
+        input.init(fp_Local ? -1 : fp_Frame, bits, fp_InputSize);
+
+        if (fp_Local)
+        {
+            sync.AddLocalInput(fp_Queue, input);
+        }
+        else
+        {
+            sync.AddRemoteInput(fp_Queue, input);
+        }
+    }
+
+    UdpMsg::connect_status        status[UDP_MSG_MAX_PLAYERS];
+    GGPO::Sync                    sync;
+    CheapGame                     game;
+};
+
+static void
+    Confirmed(int fp_Players, int fp_InputSize, int fp_Frames)
+{
+    SyncRig rig(fp_Players, fp_InputSize);
+    char values[GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS];
+    const int size = fp_Players * fp_InputSize;
+    double seconds = 0.0;
+
+    for (int f = 0; f < fp_Frames; f++)
+    {
+        for (int p = 0; p < fp_Players; p++)
+        {
+            rig.AddInput(p, f, fp_InputSize, p == 0);
+        }
+
+        GGPO::Bench::Stopwatch watch;
+        rig.sync.SynchronizeInputs(values, size);
+        seconds += watch.Seconds();
+
+        GGPO::Bench::KeepAlive(values);
+        rig.game.AdvanceFrame(values, size);
+        rig.sync.IncrementFrame();
+        rig.sync.SetLastConfirmedFrame(f);
+    }
+
+    GGPO::Bench::Report(std::format("{}x{} SynchronizeInputs, confirmed", fp_Players, fp_InputSize), seconds / fp_Frames * 1e9, "ns/call");
+}
+
+static void
+    Rollback(int fp_Players, int fp_InputSize, int fp_Frames)
+{
+    SyncRig rig(fp_Players, fp_InputSize);
+    char values[GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS];
+    const int size = fp_Players * fp_InputSize;
+    int delivered = 0;
+    int rollbacks = 0;
+    int resimulated = 0;
+    double seconds = 0.0;
+
+    for (int f = 0; f < fp_Frames; f++)
+    {
+        for (; delivered <= f - ROLLBACK_DEPTH; delivered++)
+        {
+            for (int p = 1; p < fp_Players; p++)
+            {
+                rig.AddInput(p, delivered, fp_InputSize, false);
+            }
+        }
+
+        GGPO::Bench::Stopwatch watch;
+        rig.sync.CheckSimulation();
+        seconds += watch.Seconds();
+
+        if (delivered > 0)
+        {
+            rig.sync.SetLastConfirmedFrame(delivered - 1);
+        }
+
+        rig.AddInput(0, f, fp_InputSize, true);
+        rig.sync.SynchronizeInputs(values, size);
+        rig.game.AdvanceFrame(values, size);
+        rig.sync.IncrementFrame();
+    }
+
+    int deepest;
+    rig.sync.TakeRollbackCounts(&rollbacks, &resimulated, &deepest);
+
+    GGPO::Bench::Report(std::format("{}x{} rollback, depth {}", fp_Players, fp_InputSize, deepest), seconds / GGPO_MAX(rollbacks, 1) * 1e6, "us/rollback");
+    GGPO::Bench::Report(std::format("{}x{} rollback, per resimulated frame", fp_Players, fp_InputSize), seconds / GGPO_MAX(resimulated, 1) * 1e9, "ns/frame");
+}
+
+int 
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int frames = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 50000;
+    const int configs[][2] = { { 2, 4 }, { 4, 8 }, { 8, 32 } };
+
+    for (const auto& config : configs)
+    {
+        Confirmed(config[0], config[1], frames);
+        Rollback(config[0], config[1], frames / 2);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <cstdlib>
+#include <thread>
+
+#include "../Benchmark.h"
+
+/*
+ * What ThreadedTransport does to the ping a session sees, and to the time the
+ * game thread spends in the network each frame.
+ *
+ * Two UdpProtocol endpoints on loopback, each on a thread of its own ticking at
+ * 60 Hz +-1 ms the way a backend drives them: receive everything, poll, send
+ * an input, flush.  Each frame also sends extra messages to a peer nobody is
+ * listening on, stand ins for everyone else's traffic so the sends weigh
+ * something.  The first 5 s are left out, that's the sync and the rtt settling.
+ *
+ * Ping and rttvar are the session's own (NetworkStats), averaged over every
+ * frame.  Network step is the game thread's time in Receive/OnMsg, the poll,
+ * SendInput and Flush.
+ *
+ *     ThreadedPing_Bench [seconds] [extra messages per frame]
+ */
+
+constexpr uint16_t UDP_PORT = 48201;
+constexpr uint16_t TCP_PORT = 48211;
+constexpr uint16_t NOBODY_PORT = 48221;
+constexpr int INPUT_BYTES = 4;
+constexpr uint64_t FRAME_US = 16667;
+constexpr uint64_t WARMUP_NS = 5000000000ULL;
+
+struct Side
+{
+    double      ping_us = 0;
+    double      jitter_us = 0;
+    double      step_us = 0;
+};
+
+static uint64_t
+    NowNS()
+{
+    return GGPO::MonotonicClock::Get().NowNS();
+}
+
+static Side
+    RunSide(bool fp_Threaded, GGPO::TransportType fp_Type, uint16_t fp_Port, uint16_t fp_RemotePort, int fp_Seconds, int fp_Extra)
+{
+    std::unique_ptr<GGPO::Transport> transport = fp_Threaded ? std::make_unique<GGPO::ThreadedTransport>(fp_Type, fp_Port) : GGPO::CreateTransport(fp_Type, fp_Port);
+    GGPO::UdpProtocol protocol;
+    GGPO::Poll poll;
+    UdpMsg scratch(UdpMsg::Invalid);
+    UdpMsg::connect_status status[UDP_MSG_MAX_PLAYERS];
+    GGPO::PeerId nobody = GGPO::INVALID_PEER_ID;
+    char ip[] = "127.0.0.1";
+
+    for (auto& connect : status)
+    {
+        connect.disconnected = 0;
+        connect.last_frame = -1;
+    }
+
+    protocol.Init(transport.get(), poll, 0, ip, fp_RemotePort, status);
+    protocol.Synchronize();
+
+    if (fp_Type == GGPO::TransportType::Udp)
+    {
+        (void)transport->Resolve(ip, NOBODY_PORT, &nobody);
+    }
+
+    const uint64_t start = NowNS();
+    const uint64_t end = start + (uint64_t)fp_Seconds * 1000000000ULL;
+    uint64_t in_network = 0;
+    double ping = 0;
+    double jitter = 0;
+    long long samples = 0;
+    long long frames = 0;
+    int frame = 0;
+
+    while (NowNS() < end)
+    {
+        const auto wake = std::chrono::steady_clock::now() + std::chrono::microseconds(FRAME_US - 1000 + rand() % 2001);
+        const uint64_t step_start = NowNS();
+        GGPO::TransportPacket packets[GGPO::TRANSPORT_BATCH_SIZE];
+        int count;
+
+        do
+        {
+            count = transport->Receive(packets, GGPO::TRANSPORT_BATCH_SIZE);
+
+            for (int i = 0; i < count; i++)
+            {
+                UdpMsg* msg = GGPO::ReceivedMsg(packets[i], &scratch);
+
+                if (protocol.HandlesMsg(packets[i].peer, msg))
+                {
+                    protocol.OnMsg(msg, packets[i].length, packets[i].age_ns, packets[i].answered);
+                }
+            }
+        } while (count == GGPO::TRANSPORT_BATCH_SIZE);
+
+        protocol.OnLoopPoll(nullptr);
+
+        GGPO::UdpProtocol::Event event;
+
+        while (protocol.GetEvent(event))
+        {
+        }
+
+        if (protocol.IsSynchronized())
+        {
+            GGPO::GameInput input;
+            char bits[INPUT_BYTES] = { 0x5a, 0x5a, 0x5a, 0x5a };
+
+            input.init(frame++, bits, INPUT_BYTES);
+            protocol.SendInput(input);
+        }
+
+        for (int i = 0; i < fp_Extra and nobody != GGPO::INVALID_PEER_ID; i++)
+        {
+            UdpMsg extra(UdpMsg::KeepAlive);
+            extra.hdr.magic = 0;
+            extra.hdr.sequence_number = 0;
+
+            GGPO::TransportPacket packet;
+            packet.peer = nobody;
+            packet.data = (const uint8_t*)&extra;
+            packet.length = extra.PacketSize();
+
+            transport->Send(&packet, 1);
+        }
+
+        protocol.Flush();
+        transport->Flush();
+
+        if (step_start > start + WARMUP_NS)
+        {
+            GGPO::NetworkStats stats;
+
+            in_network += NowNS() - step_start;
+            frames++;
+
+            protocol.GetNetworkStats(&stats);
+
+            if (stats.network.ping_us)
+            {
+                ping += (double)stats.network.ping_us;
+                jitter += (double)stats.network.jitter_us;
+                samples++;
+            }
+        }
+
+        std::this_thread::sleep_until(wake);
+    }
+
+    Side side;
+    side.step_us = frames ? (double)in_network / 1000.0 / (double)frames : 0;
+    side.ping_us = samples ? ping / (double)samples : 0;
+    side.jitter_us = samples ? jitter / (double)samples : 0;
+    return side;
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 15;
+    const int extra = fp_ArgCount > 2 ? atoi(fp_ArgVector[2]) : 16;
+
+    for (GGPO::TransportType type : { GGPO::TransportType::Udp, GGPO::TransportType::Tcp })
+    {
+        for (bool threaded : { false, true })
+        {
+            const uint16_t port = (type == GGPO::TransportType::Udp ? UDP_PORT : TCP_PORT) + (threaded ? 2 : 0);
+            const std::string name = std::format("{} {}", type == GGPO::TransportType::Udp ? "udp" : "tcp", threaded ? "threaded" : "direct");
+            Side remote;
+
+            std::thread other([&]() { remote = RunSide(threaded, type, port + 1, port, seconds + 1, extra); });
+            const Side local = RunSide(threaded, type, port, port + 1, seconds, extra);
+            other.join();
+
+            GGPO::Bench::Report(name + ", ping", local.ping_us, "us");
+            GGPO::Bench::Report(name + ", rttvar", local.jitter_us, "us");
+            GGPO::Bench::Report(name + ", network step", (local.step_us + remote.step_us) / 2, "us/frame");
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../Benchmark.h"
+
+/*
+ * What the Tcp fallback costs next to Udp.
+ *
+ * First for real on loopback: 64 byte messages once a millisecond from one
+ * transport to another, one way time from Send to the Receive that hands it
+ * out.  Sender and receiver run on the same thread, the receiver spins, so this
+ * is the transport and the kernel and nothing else.
+ *
+ * Then the part loopback can't show.  Without netem there's no loss to put on
+ * the wire, so it's a netem style model instead: one way delay d, independent
+ * loss p, an input every 1/60 s.
+ *
+ *  - udp: UdpProtocol resends everything unacked in every packet, so an input
+ *    lands with the first packet at or after it that gets through.
+ *  - tcp: a lost segment holds up everything behind it until it's resent.  Fast
+ *    retransmit needs 3 dup acks (3 later segments), otherwise it waits out an
+ *    RTO of max(200 ms, rtt + 4 * rttvar).
+ *
+ * Reports the latency each adds on top of d.
+ *
+ *     TransportLatency_Bench [messages]
+ */
+
+constexpr uint16_t UDP_PORT_A = 48101;
+constexpr uint16_t UDP_PORT_B = 48102;
+constexpr uint16_t TCP_PORT_A = 48111;
+constexpr uint16_t TCP_PORT_B = 48112;
+constexpr int MESSAGE_BYTES = 64;
+constexpr int WARMUP_MESSAGES = 20;
+
+static uint64_t
+    NowNS()
+{
+    return GGPO::MonotonicClock::Get().NowNS();
+}
+
+static double
+    Percentile(std::vector<double>& fp_Values, double fp_Fraction)
+{
+    std::sort(fp_Values.begin(), fp_Values.end());
+    return fp_Values[(size_t)((double)(fp_Values.size() - 1) * fp_Fraction)];
+}
+
+// one message a to b, returns how long it took in us or a negative number if it never showed up
+template <typename T>
+static double
+    OneWay(T& fp_A, T& fp_B, GGPO::PeerId fp_AToB)
+{
+    uint8_t message[MESSAGE_BYTES] = { };
+    GGPO::TransportPacket packets[GGPO::TRANSPORT_BATCH_SIZE];
+    GGPO::TransportPacket packet;
+    const uint64_t sent = NowNS();
+
+    memcpy(message, &sent, sizeof sent);
+
+    packet.peer = fp_AToB;
+    packet.data = message;
+    packet.length = MESSAGE_BYTES;
+
+    fp_A.Send(&packet, 1);
+    fp_A.Flush();
+
+    while (NowNS() - sent < 1000000000ULL)
+    {
+        const int count = fp_B.Receive(packets, GGPO::TRANSPORT_BATCH_SIZE);
+
+        for (int i = 0; i < count; i++)
+        {
+            uint64_t stamp;
+
+            memcpy(&stamp, packets[i].data, sizeof stamp);
+
+            if (stamp == sent)
+            {
+                return (double)(NowNS() - sent) / 1e3;
+            }
+        }
+
+        fp_A.Flush(); // a tcp dial that's still connecting sends on a later flush
+    }
+
+    return -1.0;
+}
+
+template <typename T>
+static void
+    Loopback(const char* fp_Name, uint16_t fp_PortA, uint16_t fp_PortB, int fp_Messages)
+{
+    T a;
+    T b;
+    GGPO::PeerId a_to_b;
+    GGPO::PeerId b_to_a;
+
+    a.Init(fp_PortA);
+    b.Init(fp_PortB);
+
+    const char* ip = a.GetFamily() == AF_INET6 ? "::1" : "127.0.0.1";
+
+    if (not a.Resolve(ip, fp_PortB, &a_to_b) or not b.Resolve(ip, fp_PortA, &b_to_a))
+    {
+        GGPO::PrintError(std::format("[!] {}: couldn't resolve loopback", fp_Name));
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<double> latencies;
+
+    for (int i = 0; i < WARMUP_MESSAGES + fp_Messages; i++)
+    {
+        const double us = OneWay(a, b, a_to_b);
+
+        if (us < 0.0)
+        {
+            GGPO::PrintError(std::format("[!] {}: message {} never arrived", fp_Name, i));
+            exit(EXIT_FAILURE);
+        }
+
+        if (i >= WARMUP_MESSAGES)
+        {
+            latencies.push_back(us);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    GGPO::Bench::Report(std::format("{} loopback 64 B @ 1 kHz, p50", fp_Name), Percentile(latencies, 0.50), "us");
+    GGPO::Bench::Report(std::format("{} loopback 64 B @ 1 kHz, p99", fp_Name), Percentile(latencies, 0.99), "us");
+}
+
+static void
+    Model(double fp_DelayMS, double fp_Loss)
+{
+    constexpr int INPUTS = 200000;
+    constexpr double PERIOD_MS = 1000.0 / 60.0;
+    const double rto_ms = GGPO_MAX(200.0, 2.0 * fp_DelayMS + 4.0 * 2.0);
+
+    std::mt19937_64 random(42);
+    std::bernoulli_distribution lost(fp_Loss);
+    std::vector<bool> dropped(INPUTS);
+    std::vector<double> udp(INPUTS);
+    std::vector<double> tcp(INPUTS);
+
+    for (int i = 0; i < INPUTS; i++)
+    {
+        dropped[i] = lost(random);
+    }
+
+    // udp: input i rides along until the first packet that gets through
+    int next_delivered = INPUTS;
+
+    for (int i = INPUTS - 1; i >= 0; i--)
+    {
+        if (not dropped[i])
+        {
+            next_delivered = i;
+        }
+
+        udp[i] = next_delivered < INPUTS ? (next_delivered - i) * PERIOD_MS : 1e9;
+    }
+
+    // tcp: when each segment first makes it across, then nothing gets out ahead of an earlier one
+    double head_of_line = 0.0;
+
+    for (int i = 0; i < INPUTS; i++)
+    {
+        double sent = i * PERIOD_MS;
+
+        while (lost(random))
+        {
+            const double fast_retransmit = (i + 3) * PERIOD_MS + 2.0 * fp_DelayMS;
+            sent = GGPO_MIN(fast_retransmit, sent + rto_ms);
+        }
+
+        head_of_line = GGPO_MAX(head_of_line, sent + fp_DelayMS);
+        tcp[i] = head_of_line - i * PERIOD_MS - fp_DelayMS;
+    }
+
+    for (auto* added : { &udp, &tcp })
+    {
+        double mean = 0.0;
+
+        for (double ms : *added)
+        {
+            mean += ms;
+        }
+
+        const char* name = added == &udp ? "udp" : "tcp";
+        const std::string config = std::format("{} model, {:.0f} ms one way, {:.0f}% loss", name, fp_DelayMS, fp_Loss * 100.0);
+
+        GGPO::Bench::Report(config + ", mean added", mean / INPUTS, "ms");
+        GGPO::Bench::Report(config + ", p99 added", Percentile(*added, 0.99), "ms");
+        GGPO::Bench::Report(config + ", p99.9 added", Percentile(*added, 0.999), "ms");
+    }
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int messages = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 2000;
+
+    Loopback<GGPO::Udp>("udp", UDP_PORT_A, UDP_PORT_B, messages);
+    Loopback<GGPO::Tcp>("tcp", TCP_PORT_A, TCP_PORT_B, messages);
+
+    for (double delay_ms : { 10.0, 40.0 })
+    {
+        for (double loss : { 0.0, 0.01, 0.02 })
+        {
+            Model(delay_ms, loss);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
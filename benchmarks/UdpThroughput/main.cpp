@@ -0,0 +1,163 @@
+/************************************************************************************************************
+ *                                          GGPO4ALL v0.0.1
+ *              Created by Ranyodh Mandur - ✨ 2025 and GroundStorm Studios, LLC. - ✨ 2009
+ *
+ *                                Licensed under the MIT License (MIT).
+ *                           For more details, see the LICENSE file or visit:
+ *                                  https://opensource.org/licenses/MIT
+ *
+ *                        GGPO4ALL is a free open source rollback netcode library
+************************************************************************************************************/
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+#include "../Benchmark.h"
+
+/*
+ * Packets per second and cpu per packet through the socket transports, Udp
+ * (recvmsg/sendto, GSO/GRO where linux has them) against UringUdp.
+ *
+ * A sender thread pushes 64 byte packets on loopback, 32 per Send/Flush, and
+ * the main thread drains them with Receive.  Both count their own thread cpu
+ * time, so the ns/pkt numbers are what each side costs no matter how the
+ * scheduler splits the box.  Runs flat out and then paced to 32 packets every
+ * 500 us (~64k pkt/s), where the receiver mostly finds a few packets waiting.
+ *
+ * Loopback drops whatever the receive buffer can't hold, so flat out "sent" and
+ * "received" aren't the same number.
+ *
+ *     UdpThroughput_Bench [seconds]
+ */
+
+constexpr int BATCH = 32;
+constexpr int PACKET_BYTES = 64;
+
+static uint64_t
+    ThreadCpuNS()
+{
+    timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+template <typename T>
+static void
+    Run(const char* fp_Name, uint16_t fp_Port, int fp_Seconds, int fp_PaceUS)
+{
+    std::atomic<bool> stop { false };
+    uint64_t sent = 0;
+    uint64_t tx_cpu = 0;
+
+    T rx;
+    GGPO::PeerId from;
+
+    rx.Init(fp_Port);
+    rx.Resolve("127.0.0.1", fp_Port + 1, &from);
+
+    std::thread tx([&]
+    {
+        T transport;
+        GGPO::PeerId to;
+        uint8_t message[PACKET_BYTES] = { };
+        GGPO::TransportPacket batch[BATCH];
+
+        transport.Init(fp_Port + 1);
+        transport.Resolve("127.0.0.1", fp_Port, &to);
+
+        for (auto& packet : batch)
+        {
+            packet.peer = to;
+            packet.data = message;
+            packet.length = PACKET_BYTES;
+        }
+
+        const uint64_t start = ThreadCpuNS();
+
+        while (not stop)
+        {
+            transport.Send(batch, BATCH);
+            transport.Flush();
+            sent += BATCH;
+
+            if (fp_PaceUS)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(fp_PaceUS));
+            }
+            else if (sent % 1024 == 0)
+            {
+                std::this_thread::yield(); // one cpu boxes need the receiver to get a turn
+            }
+        }
+
+        tx_cpu = ThreadCpuNS() - start;
+    });
+
+    GGPO::TransportPacket packets[GGPO::TRANSPORT_BATCH_SIZE];
+    uint64_t received = 0;
+    uint64_t busy_calls = 0;
+
+    const uint64_t start_cpu = ThreadCpuNS();
+    GGPO::Bench::Stopwatch wall;
+
+    while (wall.Seconds() < fp_Seconds)
+    {
+        const int count = rx.Receive(packets, GGPO::TRANSPORT_BATCH_SIZE);
+
+        if (count > 0)
+        {
+            received += count;
+            busy_calls++;
+        }
+        else if (fp_PaceUS)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(fp_PaceUS / 2));
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    const uint64_t rx_cpu = ThreadCpuNS() - start_cpu;
+    const double seconds = wall.Seconds();
+
+    stop = true;
+    tx.join();
+
+    if (received == 0)
+    {
+        GGPO::PrintError(std::format("[!] {}: nothing came through", fp_Name));
+        exit(EXIT_FAILURE);
+    }
+
+    GGPO::Bench::Report(std::format("{}, received", fp_Name), received / seconds, "pkt/s");
+    GGPO::Bench::Report(std::format("{}, receive cpu", fp_Name), (double)rx_cpu / received, "ns/pkt");
+    GGPO::Bench::Report(std::format("{}, sent", fp_Name), sent / seconds, "pkt/s");
+    GGPO::Bench::Report(std::format("{}, send cpu", fp_Name), (double)tx_cpu / GGPO_MAX(sent, 1), "ns/pkt");
+    GGPO::Bench::Report(std::format("{}, packets per non-empty Receive", fp_Name), (double)received / busy_calls, "pkts");
+}
+
+int
+    main(int fp_ArgCount, const char* fp_ArgVector[])
+{
+    const int seconds = fp_ArgCount > 1 ? atoi(fp_ArgVector[1]) : 5;
+
+    Run<GGPO::Udp>("udp, flat out", 47400, seconds, 0);
+
+#if defined(GGPO_IO_URING)
+    Run<GGPO::UringUdp>("uring, flat out", 47410, seconds, 0);
+#endif
+
+    Run<GGPO::Udp>("udp, 32 per 500 us", 47420, seconds, 500);
+
+#if defined(GGPO_IO_URING)
+    Run<GGPO::UringUdp>("uring, 32 per 500 us", 47430, seconds, 500);
+#else
+    GGPO::Print("no io_uring in this build, only plain udp", GGPO::Colours::BrightYellow);
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -121,7 +121,7 @@ before including GGPO4ALL anywhere in your code
 
  //=========================================================================================== Main Types ===========================================================================================//
 
-constexpr int MAX_PLAYERS = 4;
+constexpr int MAX_PLAYERS = 8;
 constexpr int MAX_PREDICTION_FRAMES = 8;
 constexpr int MAX_SPECTATORS = 32;
 
@@ -175,7 +175,7 @@ namespace GGPO
             } local;
             struct
             {
-                char           ip_address[32];
+                char           ip_address[64]; /* numeric v4 or v6, "192.168.0.2" or "2001:db8::2" */
                 unsigned short port;
             } remote;
         } u;
@@ -235,7 +235,7 @@ namespace GGPO
         Succeeded(ErrorCode fp_Result)
         noexcept
     {
-        return fp_Result == ErrorCode::SUCCESS;
+        return fp_Result == ErrorCode::OK or fp_Result == ErrorCode::SUCCESS; // the backends hand back OK, SUCCESS is what the C API calls it
     }
 
     constexpr int INVALID_HANDLE = -1;
@@ -359,9 +359,18 @@ namespace GGPO
      * minus the frame number of the last packet in the remote queue.
      *
      * network.ping - The roundtrip packet transmission time as calcuated
-     * by .net.  This will be roughly equal to the actual round trip
-     * packet transmission time + 2 the interval at which you call ggpo_idle
-     * or ggpo_advance_frame.
+     * by .net.  The time the other side sat on our report before polling
+     * is taken out, and where the platform has kernel receive timestamps
+     * (linux, mac) so is the time the reply sat on ours, so this is pretty
+     * much the wire.  Elsewhere it's the wire + up to one interval at which
+     * you call ggpo_idle or ggpo_advance_frame.
+     *
+     * network.ping_us - Same thing in microseconds, smoothed the way TCP
+     * does it (RFC 6298) with spikes thrown out.  ping is just this rounded
+     * down to whole milliseconds.
+     *
+     * network.jitter_us - The round trip time variance (rttvar) that goes
+     * with ping_us.
      *
      * network.kbps_sent - The estimated bandwidth used between the two
      * clients, in kilobits per second.
@@ -384,6 +393,8 @@ namespace GGPO
             int   recv_queue_len;
             int   ping;
             int   kbps_sent;
+            int64_t   ping_us;
+            int64_t   jitter_us;
         } network;
         struct
         {
@@ -1527,7 +1538,7 @@ namespace GGPO
 
     using GGPO_SOCKET = uint64_t;
 
-    #define GGPO_INVALID_SOCKET (-1)
+    #define GGPO_INVALID_SOCKET ((GGPO_SOCKET)-1) // same all-ones value socket() hands back as -1, typed so compares stay unsigned
 
     #define GGPO_GET_LAST_ERROR() errno
     #define GGPO_NETWORK_ERROR_CODE uint32_t
@@ -1542,48 +1553,108 @@ namespace GGPO
 
     constexpr int MAX_UDP_PACKET_SIZE = 4096;
 
+    /*
+     * Binds a non-blocking udp socket on bind_port (or up to retries ports past it).
+     * Tries for an AF_INET6 dual stack socket first so v6 only peers (mobile carriers
+     * behind NAT64 and friends) can reach us directly, v4 peers show up on it as v4
+     * mapped addresses (::ffff:a.b.c.d).  Falls back to plain AF_INET when the
+     * platform won't give us v6 or won't turn IPV6_V6ONLY off.  The family that
+     * stuck is written to family if you pass one.  Pass SOCK_STREAM for socket_type
+     * to get the tcp listen socket instead (still needs a listen() after).
+     */
     inline GGPO_SOCKET
         CreateSocket
         (
             uint16_t bind_port, 
             int retries,
-            Logger* logger
+            Logger* logger,
+            int* family = nullptr,
+            int socket_type = SOCK_DGRAM
         )
     {
-        GGPO_SOCKET f_Socket;
-        sockaddr_in f_SocketIn;
-        uint16_t port;
-        int optval = 1;
+        const int f_Families[] = { AF_INET6, AF_INET };
 
-        f_Socket = socket(AF_INET, SOCK_DGRAM, 0);
-        setsockopt(f_Socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof optval);
-        //NOT SURE ABOUT DEFAULT SOCKET CONFIGS ON POSIX SYSTEMS VS MICROSOFT
-        // setsockopt(f_Socket, SOL_SOCKET, SO_DONTLINGER, (const char*)&optval, sizeof optval);
+        for (int f_Family : f_Families)
+        {
+            GGPO_SOCKET f_Socket;
+            sockaddr_storage f_SocketIn;
+            uint16_t port;
+            int optval = 1;
 
-        // non-blocking...
-        #if defined(_WIN32) || defined(_WIN64)
-            u_long iMode = 1;
-            ioctlsocket(f_Socket, FIONBIO, &iMode);
-        #else
-            int flags = fcntl(f_Socket, F_GETFL, 0);
-            fcntl(f_Socket, F_SETFL, flags | O_NONBLOCK);
-        #endif
+            f_Socket = socket(f_Family, socket_type, 0);
 
-        f_SocketIn.sin_family = AF_INET;
-        f_SocketIn.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (f_Socket == GGPO_INVALID_SOCKET)
+            {
+                continue;
+            }
 
-        for (port = bind_port; port <= bind_port + retries; port++)
-        {
-            f_SocketIn.sin_port = htons(port);
+            if (f_Family == AF_INET6)
+            {
+                int v6only = 0;
+
+                if (setsockopt(f_Socket, IPPROTO_IPV6, IPV6_V6ONLY, (const char*)&v6only, sizeof v6only) == GGPO_SOCKET_ERROR)
+                {
+                    GGPO_CLOSE_SOCKET(f_Socket);
+                    continue;
+                }
+            }
+
+            setsockopt(f_Socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof optval);
+            //NOT SURE ABOUT DEFAULT SOCKET CONFIGS ON POSIX SYSTEMS VS MICROSOFT
+            // setsockopt(f_Socket, SOL_SOCKET, SO_DONTLINGER, (const char*)&optval, sizeof optval);
+
+            // non-blocking...
+            #if defined(_WIN32) || defined(_WIN64)
+                u_long iMode = 1;
+                ioctlsocket(f_Socket, FIONBIO, &iMode);
+            #else
+                int flags = fcntl(f_Socket, F_GETFL, 0);
+                fcntl(f_Socket, F_SETFL, flags | O_NONBLOCK);
+            #endif
 
-            if (bind(f_Socket, (sockaddr*)&f_SocketIn, sizeof f_SocketIn) != GGPO_SOCKET_ERROR)
+            memset(&f_SocketIn, 0, sizeof f_SocketIn);
+
+            sockaddr_in* f_In4 = (sockaddr_in*)&f_SocketIn;
+            sockaddr_in6* f_In6 = (sockaddr_in6*)&f_SocketIn;
+
+            if (f_Family == AF_INET6)
             {
-                logger->Info(format("Udp bound to port: {}.", port), "udp.cpp");
-                return f_Socket;
+                f_In6->sin6_family = AF_INET6;
+                f_In6->sin6_addr = in6addr_any;
+            }
+            else
+            {
+                f_In4->sin_family = AF_INET;
+                f_In4->sin_addr.s_addr = htonl(INADDR_ANY);
+            }
+
+            const socklen_t f_Length = (f_Family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+
+            for (port = bind_port; port <= bind_port + retries; port++)
+            {
+                if (f_Family == AF_INET6)
+                {
+                    f_In6->sin6_port = htons(port);
+                }
+                else
+                {
+                    f_In4->sin_port = htons(port);
+                }
+
+                if (bind(f_Socket, (sockaddr*)&f_SocketIn, f_Length) != GGPO_SOCKET_ERROR)
+                {
+                    logger->Info(format("{} bound to port: {} ({}).", socket_type == SOCK_STREAM ? "Tcp" : "Udp", port, f_Family == AF_INET6 ? "ipv6 dual stack" : "ipv4"), "udp.cpp");
+
+                    if (family)
+                    {
+                        *family = f_Family;
+                    }
+                    return f_Socket;
+                }
             }
-        }
 
-        GGPO_CLOSE_SOCKET(f_Socket);
+            GGPO_CLOSE_SOCKET(f_Socket);
+        }
 
         return GGPO_INVALID_SOCKET;
     }
@@ -1643,20 +1714,51 @@ namespace GGPO::Platform{
 
     // For game timers, netcode, frame delta, etc
 inline uint64_t 
-    GetMonotonicTimeMS() 
+    GetMonotonicTimeNS() 
     noexcept
 {
 #if defined(_WIN32) || defined(_WIN64)
-    return timeGetTime(); // 32-bit, wraps after ~49.7 days
-#elif defined(__linux__) || defined(__APPLE__)
+    static const uint64_t s_Frequency = []
+    {
+        LARGE_INTEGER f_Frequency;
+        QueryPerformanceFrequency(&f_Frequency);
+        return static_cast<uint64_t>(f_Frequency.QuadPart);
+    }();
+
+    LARGE_INTEGER f_Counter;
+    QueryPerformanceCounter(&f_Counter);
+
+    const uint64_t f_Ticks = static_cast<uint64_t>(f_Counter.QuadPart);
+
+    // split so ticks * 1e9 can't overflow
+    return (f_Ticks / s_Frequency) * 1000000000ULL + (f_Ticks % s_Frequency) * 1000000000ULL / s_Frequency;
+#elif defined(__linux__)
+    struct timespec t{};
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t); // not slewed by ntp
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+#elif defined(__APPLE__)
     struct timespec t{};
     clock_gettime(CLOCK_MONOTONIC, &t);
-    return static_cast<uint64_t>(t.tv_sec) * 1000ULL + t.tv_nsec / 1000000ULL;
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
 #else
     static_assert(false, "No monotonic time source available on this platform.");
 #endif
 }
 
+inline uint64_t 
+    GetMonotonicTimeUS() 
+    noexcept
+{
+    return GetMonotonicTimeNS() / 1000ULL;
+}
+
+inline uint64_t 
+    GetMonotonicTimeMS() 
+    noexcept
+{
+    return GetMonotonicTimeNS() / 1000000ULL;
+}
+
 // Other stuff im not sure about
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -1776,13 +1878,30 @@ constexpr int MAX_FRAME_ADVANTAGE = 9;
 //==================================================================================== UdpMsg ============================================================================================//
 
 constexpr int MAX_COMPRESSED_BITS = 4096;
-constexpr int UDP_MSG_MAX_PLAYERS = 4;
+constexpr int UDP_MSG_MAX_PLAYERS = 8;
 
+/*
+ * Frame header for the tcp transport.  A stream has no packet boundaries so every
+ * message goes out behind one of these, length is the payload size in network byte
+ * order.  The first frame on a connection we dial is a Hello carrying the port we
+ * listen on, the accepting side only sees our ephemeral source port otherwise and
+ * couldn't match us up with the address it was given for us.
+ */
 struct MessageTCP
 {
+    enum MsgType : uint8_t
+    {
+        Msg = 0,
+        Hello = 1,
+    };
 
+    uint16_t    length;
+    uint8_t     type;
+    uint8_t     reserved;
 };
 
+static_assert(sizeof(MessageTCP) == 4, "MessageTCP goes on the wire as is");
+
 //#pragma pack(push, 1)
 
 struct MessageUDP
@@ -1797,6 +1916,7 @@ struct MessageUDP
         QualityReply = 5,
         KeepAlive = 6,
         InputAck = 7,
+        Bundle = 8,     /* several of the others in one datagram, see UdpProtocol::PumpSendQueue() */
     };
 
     struct connect_status
@@ -1810,6 +1930,9 @@ struct MessageUDP
         uint16_t         magic;
         uint16_t         sequence_number;
         uint8_t          type;            /* packet type */
+        uint16_t         ack_seq;         /* newest sequence number we took in from them */
+        uint32_t         ack_bits;        /* bit n: we took ack_seq - n too.  0 until we've taken anything */
+        int32_t          ack_frame;       /* newest input frame we have from them, on every packet so anything can carry the ack */
     } hdr;
     union
     {
@@ -1834,6 +1957,7 @@ struct MessageUDP
         struct
         {
             uint32_t      pong;
+            uint32_t      hold; /* us the report sat with them before they answered, comes off the rtt */
         } quality_reply;
 
         struct
@@ -1843,24 +1967,19 @@ struct MessageUDP
             uint32_t            start_frame;
 
             int               disconnect_requested : 1;
-            int               ack_frame : 31;
 
             uint16_t            num_bits;
-            uint8_t             input_size; // XXX: shouldn't be in every single packet!
+            uint16_t            input_size; // XXX: shouldn't be in every single packet!
             uint8_t             bits[MAX_COMPRESSED_BITS]; /* must be last */
         } input;
 
-        struct
-        {
-            int               ack_frame : 31;
-        } input_ack;
-
     } u;
 
 public:
+    // not sizeof(hdr), without the pack above the union starts past the header's padding
     int PacketSize()
     {
-        return sizeof(hdr) + PayloadSize();
+        return (int)((char*)&u - (char*)this) + PayloadSize();
     }
 
     int PayloadSize()
@@ -1873,8 +1992,9 @@ public:
         case SyncReply:     return sizeof(u.sync_reply);
         case QualityReport: return sizeof(u.quality_report);
         case QualityReply:  return sizeof(u.quality_reply);
-        case InputAck:      return sizeof(u.input_ack);
+        case InputAck:      return 0; /* all in the header now */
         case KeepAlive:     return 0;
+        case Bundle:        return 0; /* never sent as a UdpMsg, the messages just follow the header */
         case Input:
             size = (int)((char*)&u.input.bits - (char*)&u.input);
             size += (u.input.num_bits + 7) / 8;